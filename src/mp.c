@@ -42,17 +42,97 @@
 #include <time.h>
 #include <ctype.h>
 #include <errno.h>
-#include <valgrind/valgrind.h>
+#if defined(__SSE2__) || defined(_M_X64) /* { */
+#   include <emmintrin.h>                                   /* Non-temporal stores */
+#endif /* } __SSE2__ */
+#ifndef MP_VALGRIND_NOT_AVAILABLE /* { */
+#   include <valgrind/valgrind.h>                            /* Without Valgrind, the one of the package defines MP_VALGRIND_NOT_AVAILABLE */
+#endif /* } MP_VALGRIND_NOT_AVAILABLE */
 #ifndef MP_VALGRIND_NOT_AVAILABLE /* { */
 #   pragma message("Compiled with the Valgrind extension")
 #   include <valgrind/memcheck.h>
 #endif /* } MP_VALGRIND_NOT_AVAILABLE */
 #include "mp.h"
+#include "mp_os.h"
+
+#ifndef va_copy
+#   define va_copy(d, s) ((d) = (s))                        /* Old compilers without C99 va_copy() */
+#endif
+
+#define MP_BLK_HDR_SZ ((sizeof(mpblock) + MP_DEF_ALIGN -1) & ~((size_t)MP_DEF_ALIGN -1)) /* Size of the header placed at the start of each block */
+#define MP_NT_MIN_SZ  (32 * 1024 * 1024)                      /* Memory set to zero with non-temporal stores from this size (bigger than the caches) */
+#define MP_RNG_TAIL   64                                    /* Ranges appended unsorted to the ownership index before merging them */
+#define MP_RNG_TRIES  4                                     /* Lookups without the lock while the index changes, before taking it */
+
+/* Typedefs and structures */
+typedef struct _mprange
+{
+    uchar             *start;                                /* First byte of the block (its header) */
+    uchar             *end;                                  /* First byte after the block */
+    mpblock           *block;                                /* Block covering the range */
+    int               mpid;                                  /* Memory pool owning the block */
+} mprange;
+
+typedef struct _mpcleanup
+{
+    void              (*fn)(void *arg);                      /* Cleanup callback */
+    void              *arg;                                  /* Argument given to it */
+    struct _mpcleanup *next;                                 /* Callback registered before */
+} mpcleanup;
+
+typedef struct _mprcy
+{
+    struct _mprcy     *next;                                 /* Next recycled block */
+    size_t            size;                                  /* Size of the memory of the block, header included */
+} mprcy;
 
 /* Prototypes */
 static void *mpget_chunk(size_t size, int mpid, size_t alignment);
+static void *mpget_aln_chunk(size_t size, int mpid, int cls);
 static void *mpadd_block(size_t size, int mpid, size_t alignment);
+static void *mpreuse_block(size_t size, int mpid, size_t alignment);
+static int mpblk_reusable(int mpid, mpblock *block);
+static void mpprefault(uchar *ptr, size_t size);
+static void mpnuma_place(int mpid, void *block, size_t size);
+static int mpattach_block(int mpid, mpblock *block);
+static void mpfree_blocks(int mpid);
+static mpblock *mpblk_alloc(int mpid, size_t size);
+static void mpblk_free(int mpid, mpblock *block, int recycle);
+static void mpblk_discard(mpblock *block);
+static void mpclr_block(int mpid, mpblock *block, size_t size);
+static void mpzero_nt(uchar *ptr, size_t size);
+static size_t mprcy_unit();
+static mpblock *mprcy_get();
+static int mprcy_put(int mpid, mpblock *block, size_t size);
+static void mprcy_spill(int keep);
+#if MP_THREAD_SAFE == 1 /* { */
+static void mprcy_exit();
+#endif /* } MP_THREAD_SAFE */
+static void mprfl_wake();
+#if MP_THREAD_SAFE == 1 /* { */
+static void *mprfl_main(void *arg);
+#endif /* } MP_THREAD_SAFE */
+static void *mpupstream_malloc_alloc(size_t size, size_t align, void *ctx);
+static void mpupstream_malloc_free(void *ptr, size_t size, void *ctx);
+static void *mpupstream_mmap_alloc(size_t size, size_t align, void *ctx);
+static void mpupstream_mmap_free(void *ptr, size_t size, void *ctx);
+static void mpcleanup_run(int mpid);
+static int mpvm_commit(int mpid, size_t size);
+static void *mpresize_last(void *ptr, size_t size, int mpid);
+static void *mpremap_chunk(void *ptr, size_t size, int mpid);
 static int mpadd_tot_phy_mem(size_t size2add, int sign);
+static int mplock();
+static void mpunlock();
+static int mpfind_owner(void *ptr, mpblock **block);
+static int mprng_add(int mpid, mpblock *block);
+static void mprng_del(mpblock *block);
+static void mprng_del_mpid(int mpid);
+static mprange *mprng_find(void *ptr);
+static void mprng_merge();
+static void mprng_free();
+static void *mpslab_refill(int mpid);
+static size_t mpslab_drain(int mpid);
+static int mpslab_cmp(const void *a, const void *b);
 
 /* Local variables */
 #if MP_THREAD_SAFE == 1 /* { */
@@ -71,6 +151,34 @@ static int mp_prev_mpid = MP_NO_MP_ID;                      /* Previous Memory P
 static size_t mp_tot_phy_mem = 0;                           /* Total physical memory used */
 static size_t volatile mp_mem_limit = 0;                    /* Memory limit */
 static size_t volatile mp_blk_sz = MP_DEF_BLK_SZ;           /* Memory limit */
+static size_t volatile mp_map_sz = MP_DEF_MAP_SZ;           /* Minimum size of the chunks with own mapping (0 = never) */
+static int volatile mp_colors = MP_DEF_COLORS;              /* Number of cache line offsets the start of the heap blocks rotates through */
+static const mpupstream mp_up_malloc = {&mpupstream_malloc_alloc, &mpupstream_malloc_free, NULL, FALSE}; /* Blocks of malloc() */
+static const mpupstream mp_up_mmap = {&mpupstream_mmap_alloc, &mpupstream_mmap_free, NULL, TRUE};       /* Blocks with own mapping */
+static size_t volatile mp_rcy_sz = MP_DEF_RCY_SZ;           /* Maximum size of the blocks kept in the depot for reuse (0 = no recycling) */
+static mprcy *mp_rcy_depot = NULL;                          /* Depot of recycled blocks shared by all threads */
+static size_t mp_rcy_depot_sz = 0;                          /* Size of the blocks in the depot */
+static MP_TLS_VOID *mp_rcy_mag = NULL;                      /* Magazine of recycled blocks of the thread (mprcy list) */
+static MP_TLS_INT mp_rcy_mag_cnt = 0;                       /* Number of blocks in the magazine of the thread */
+#if MP_THREAD_SAFE == 1 /* { */
+static MP_TLS_INT mp_rcy_onexit = FALSE;                    /* TRUE once mprcy_exit() runs when the thread ends */
+#endif /* } MP_THREAD_SAFE */
+#if MP_THREAD_SAFE == 1 /* { */
+static MP_COND_T mp_rfl_cond = MP_COND_INIT_VAL;            /* The refill thread waits on it (with mplock()) for spare blocks to make */
+static MP_THRH_T mp_rfl_thread;                             /* Refill thread, while mp_rfl_run */
+#    ifndef _WIN32
+static MP_MUTEX_T mp_rfl_mutex = MP_MUTEX_INIT_VAL;         /* Held across the start and the stop of the refill thread */
+static MP_MUTEX_T *mp_rfl_mutex_p = &mp_rfl_mutex;          /* Refill thread mutex pointer */
+#    else
+static MP_MUTEX_T *mp_rfl_mutex_p = NULL;                   /* Refill thread mutex pointer */
+#    endif
+static int mp_rfl_run = FALSE;                              /* TRUE while the refill thread runs (see mpset_refill()) */
+#endif /* } MP_THREAD_SAFE */
+static mprange * volatile mp_rng_arr = NULL;                /* Ownership index: address ranges of the blocks of all pools */
+static int volatile mp_rng_cnt = 0;                         /* Number of ranges in the ownership index */
+static int volatile mp_rng_srt = 0;                         /* Number of leading ranges sorted by address */
+static int mp_rng_max = 0;                                  /* Number of slots allocated for the ownership index */
+static unsigned int volatile mp_rng_seq = 0;                /* Sequence of the changes of the index, odd while one is being done */
 
 /* Global variables */
 #if MP_THREAD_SAFE == 1
@@ -81,7 +189,7 @@ int  mperrno = 0;
 char *mperrstr = NULL;
 #endif
 
-mp mp_arr[MP_MAX_MP_ID -1];                                 /* Array of memory pools */
+mp mp_arr[MP_MAX_MP_ID];                                    /* Array of memory pools */
 
 
 /****************************************************************************
@@ -90,7 +198,8 @@ mp mp_arr[MP_MAX_MP_ID -1];                                 /* Array of memory p
 |*
 |* Description;
 |*
-|*     Adds a new block to our memory pool.
+|*     Adds a new block to our memory pool. With coloring (see mpset_colors())
+|*     the memory of heap blocks starts some cache lines after the header.
 |*
 |* Return:
 |*     a pointer to a block of memory of the required size within our memory
@@ -100,34 +209,43 @@ mp mp_arr[MP_MAX_MP_ID -1];                                 /* Array of memory p
 |*
 |* Modifications:
 |* 20140811    JG    Initial version
+|* 20261019    JG    Coloring of the start of the heap blocks
+|* 20261019    JG    NUMA policy of the memory pool
+|* 20261019    JG    Blocks taken from the provider of the memory pool
+|* 20261019    JG    Blocks of the default size taken from the recycler
+|* 20261019    JG    Empty blocks of the memory pool used first
+|* 20261019    JG    Spare block of the refill thread swapped in
 |*
 ****************************************************************************/
 static void *mpadd_block(size_t size, int mpid, size_t alignment)
 {
     void *chunk = NULL;
     size_t block_size = mpget_blksz() + alignment -1;
-    mpblock *curr_block = NULL;
+    mp *curr_mp = &mp_arr[mpid];
     mpblock *new_block = NULL;
+    char type = MP_BLK_HEAP;
+    size_t color = 0;
+    int dirty = FALSE;
     mperrno = MP_ERRNO_SUCCESS;
 
     /* Parameters check was done on mpget_chunk() */
 
     /* Check if the memory pool was initialized */
-    if (mp_arr[mpid].init != 'Y')
+    if (curr_mp->init != 'Y')
     {
         if (mpid == MP_DEF_MP_ID)
         {
-            mp_arr[mpid].init = 'Y';
-            strncpy(mp_arr[mpid].descr, MP_DEF_MP_DESCR, sizeof(mp_arr[mpid].descr));
-            mp_arr[mpid].descr[sizeof(mp_arr[mpid].descr) -1] = '\0';
+            curr_mp->init = 'Y';
+            strncpy(curr_mp->descr, MP_DEF_MP_DESCR, sizeof(curr_mp->descr));
+            curr_mp->descr[sizeof(curr_mp->descr) -1] = '\0';
 #if MP_THREAD_SAFE == 1
             /* Threads should aquire a new Memory Pool, so we assume
              * The thread calling the default one is the main thread */
-            mp_arr[mpid].thread_id = MP_CURR_THREAD;
+            curr_mp->thread_id = MP_CURR_THREAD;
 #endif
 
 #ifndef MP_VALGRIND_NOT_AVAILABLE
-            VALGRIND_CREATE_MEMPOOL((void *)&mp_arr[mpid], 0, 1);
+            VALGRIND_CREATE_MEMPOOL((void *)curr_mp, 0, 1);
 #endif
         }
         else
@@ -137,71 +255,122 @@ static void *mpadd_block(size_t size, int mpid, size_t alignment)
         }
     }
 
-    /* Set memory limit */
-    if (mp_mem_limit <= 0) /* Don't care about thread race */
+    /* Override default size if needed */
+    if (size > mpget_blksz())
     {
-        if (sizeof(size_t) > 4)
-        {
-            mp_mem_limit = MP_DEF_MEM_LIMIT_64;
-        }
-        else
+        block_size = size + alignment -1;
+
+        /* Big chunks get their own mapping, in whole pages, unless the blocks come from a provider */
+        if (mp_map_sz > 0 && size >= mp_map_sz && curr_mp->upstream.block_alloc == NULL)
         {
-            mp_mem_limit = MP_DEF_MEM_LIMIT_32;
+            size_t pgsz = mp_vm_pgsz();
+
+            type = MP_BLK_MAP;
+            block_size = ((MP_BLK_HDR_SZ + block_size + pgsz -1) & ~(pgsz -1)) - MP_BLK_HDR_SZ;
         }
     }
 
-    /* Creating new memory pool block */
-    new_block = (mpblock *)malloc(sizeof(mpblock));
-    if (new_block == NULL)
+    /* Empty blocks of the memory pool (reserved or cleared) are used before adding new ones */
+    if (type == MP_BLK_HEAP && size <= mpget_blksz() && (chunk = mpreuse_block(size, mpid, alignment)) != NULL)
     {
-        mperrno = MP_ERRNO_ALLO;
-        return NULL;
+        return chunk;
     }
-    memset(new_block, 0x00, sizeof(mpblock));
-    new_block->block = NULL;
-    new_block->next = NULL;
 
-    /* Override default size if needed */
-    if (size > mpget_blksz())
+    /* Blocks of different pools, and consecutive ones of a pool, start at different cache sets */
+    if (type == MP_BLK_HEAP && mp_colors > 1)
     {
-        block_size = size + alignment -1;
+        color = (size_t)((mpid + curr_mp->block_cnt) % mp_colors) * MP_CACHE_LINE;
+    }
+
+    /* Latency-sensitive pools take the spare block of the refill thread, zero and already faulted in */
+    if (curr_mp->spare && type == MP_BLK_HEAP && size <= mpget_blksz() && alignment <= MP_CACHE_LINE &&
+            curr_mp->upstream.block_alloc == NULL && curr_mp->numa_policy == MP_NUMA_NONE &&
+            (new_block = (mpblock *)MP_ATOMIC_XCHG_PTR(&curr_mp->spare_block, NULL)) != NULL)
+    {
+        mprfl_wake();
+
+        /* Made with the unit of a former block size */
+        if (new_block->size != mprcy_unit())
+        {
+            MP_SYS_FREE(new_block);
+            new_block = NULL;
+        }
+        else
+        {
+            block_size = new_block->size - MP_BLK_HDR_SZ - color;
+        }
+    }
+
+    /* With recycling, heap blocks of the default size are all of one size, so any of them can be reused */
+    if (new_block == NULL && mp_rcy_sz > 0 && type == MP_BLK_HEAP && size <= mpget_blksz() && alignment <= MP_CACHE_LINE &&
+            curr_mp->upstream.block_alloc == NULL && curr_mp->numa_policy == MP_NUMA_NONE)
+    {
+        block_size = mprcy_unit() - MP_BLK_HDR_SZ - color;
+        new_block = mprcy_get();
+        dirty = new_block != NULL;
     }
 
     /* Check memory limit */
     if ((mperrno = mpadd_tot_phy_mem(block_size, +1)) != MP_ERRNO_SUCCESS)
     {
-        free(new_block);
+        if (new_block != NULL)
+        {
+            MP_SYS_FREE(new_block);
+        }
         return NULL;
     }
 
-    /* Setting new memory pool block info */
-    new_block->block = (uchar *)malloc(block_size);
-    if (new_block->block == NULL)
+    /* Creating new memory pool block: header and memory in one single allocation */
+    if (type == MP_BLK_MAP)
+    {
+        new_block = (mpblock *)mp_vm_map(MP_BLK_HDR_SZ + block_size);
+    }
+    else if (new_block == NULL)
+    {
+        new_block = mpblk_alloc(mpid, MP_BLK_HDR_SZ + color + block_size);
+        dirty = curr_mp->upstream.block_alloc != NULL && !curr_mp->upstream.zeroed;
+    }
+    if (new_block == NULL)
     {
+        mpadd_tot_phy_mem(block_size, -1);
         mperrno = MP_ERRNO_ALLO;
         return NULL;
     }
+
+    /* Placed on the NUMA node(s) of the pool while we are in the owning thread */
+    if (curr_mp->numa_policy != MP_NUMA_NONE)
+    {
+        mpnuma_place(mpid, new_block, MP_BLK_HDR_SZ + color + block_size);
+    }
+
+    /* Setting new memory pool block info */
+    new_block->type = type;
+    new_block->numa = curr_mp->numa_policy != MP_NUMA_NONE;
+    new_block->block = (uchar *)new_block + MP_BLK_HDR_SZ + color;
     new_block->size = block_size;
     new_block->used = alignment - ((uintptr_t)new_block->block % alignment);
     new_block->used = new_block->used == alignment ? 0 : new_block->used;
     chunk = new_block->block + new_block->used;
     new_block->used += size;
-    new_block->next = NULL;
+    new_block->zero = new_block->used;
+    curr_mp->last_dirty = 0;
+    if (dirty)
+    {
+        /* Nothing known about the content of the block */
+        new_block->zero = new_block->size;
+        curr_mp->last_dirty = size;
+    }
 #ifndef MP_VALGRIND_NOT_AVAILABLE
     VALGRIND_MAKE_MEM_NOACCESS(new_block->block, new_block->size);
 #endif
 
     /* Attach new memory block to our memory pool */
-    if (mp_arr[mpid].head_block != NULL)
-    {
-        curr_block = mp_arr[mpid].tail_block;
-        curr_block->next = new_block;
-    }
-    else
+    if (mpattach_block(mpid, new_block) != MP_ERRNO_SUCCESS)
     {
-        mp_arr[mpid].head_block = new_block;
+        mpblk_free(mpid, new_block, TRUE);
+        mpadd_tot_phy_mem(block_size, -1);
+        return NULL;
     }
-    mp_arr[mpid].tail_block = new_block;
 
     /* Deliver required chunk of memory */
     return chunk;
@@ -210,288 +379,376 @@ static void *mpadd_block(size_t size, int mpid, size_t alignment)
 
 /****************************************************************************
 |*
-|* Function: mpget_chunk
+|* Function: mpreuse_block
 |*
 |* Description;
 |*
-|*     Gets a chunk of memory of the specified size from the memmory pool 
-|*     with id mpid and aligned to alignment.
+|*     Makes the next empty heap block of the memory pool, reserved by
+|*     mpreserve() or cleared by mpclr(), its tail block and takes the chunk
+|*     from it. The blocks are looked at from the index next_blk on, which 
+|*     goes back to the first block on mpclr(), so each one is looked at once.
 |*
 |* Return:
-|*     a pointer to a block of memory of the required size within our memory
-|*     pool.
+|*     a pointer to the chunk
+|*     NULL if there is no empty block
 |*
 |* Author: Javier Gutierrez (JG)
 |*
 |* Modifications:
-|* 20140811    JG    Initial version
+|* 20261019    JG    Initial version
+|* 20261019    JG    Blocks looked at by mpblk_reusable()
 |*
 ****************************************************************************/
-static void *mpget_chunk(size_t size, int mpid, size_t alignment)
+static void *mpreuse_block(size_t size, int mpid, size_t alignment)
 {
-    void *chunk = NULL;
-    mp *curr_mp = NULL;
+    mp *curr_mp = &mp_arr[mpid];
     mpblock *curr_block = NULL;
-    mperrno = MP_ERRNO_SUCCESS;
-
-    /* We decided not to support negative sizes */
-    if (size < 0) /* Works only when size_t is signed */
-    {
-        mperrno = MP_ERRNO_SZNG;
-        return NULL;   
-    }
-
-    /* Memory pool ID out of limit */
-    if (mpid > MP_MAX_MP_ID -1 || mpid < 0)
-    {
-        mperrno = MP_ERRNO_MPID;
-        return NULL;
-    }
-
-    /* Memory pool ID not initiliazed */
-    if (mp_arr[mpid].init != 'Y' && mpid != MP_DEF_MP_ID)
-    {
-        mperrno = MP_ERRNO_NOIN;
-        return NULL;
-    }
-
-    /* Alignment out of limits: Alignment is not power of 2 or is less than size of void * */
-    if ((alignment & (alignment -1)) != 0 ||
-            alignment < sizeof(void *))
-    {
-        mperrno = MP_ERRNO_EXAL;
-        return NULL;
-    }
+    size_t margin = 0;
 
-    /* Setting right alignment */
-    if (alignment < MP_DEF_ALIGN)
-    {
-        alignment = MP_DEF_ALIGN;
-    }
-
-    /* Not to fail if size is 0 we deliver a pointer anyway */
-    if (size == 0)
-    {
-        /* TODO: In this case we should return some lost memory chunk */
-        size = 1;
-    }
-
-    curr_mp = &mp_arr[mpid];
-#if MP_THREAD_SAFE == 1
-    /* Check thread ID */
-    if (!(mpid == MP_DEF_MP_ID && curr_mp->init != 'Y'))
+    for ( ; curr_mp->next_blk < curr_mp->block_cnt; curr_mp->next_blk++)
     {
-        if (MP_THREAD_EQ(curr_mp->thread_id, MP_CURR_THREAD) == 0)
+        curr_block = curr_mp->blocks[curr_mp->next_blk];
+        if (!mpblk_reusable(mpid, curr_block))
         {
-            mperrno = MP_ERRNO_THRD;
-            return NULL;
+            continue;
         }
-    }
-#endif
-
-    /* Get memory chunk */
-    if (curr_mp->head_block == NULL)
-    {
-        /* First time using this pool, creating block with right alignment */
-        chunk = mpadd_block(size, mpid, alignment);
-    }
-    else
-    {
-        /* Block already in used */
-        int margin = 0;
 
-        /* Check if last memory block has enough space */
-        curr_block = curr_mp->tail_block;
-        margin = alignment - ((uintptr_t)(curr_block->block + curr_block->used) % alignment);
+        margin = alignment - ((uintptr_t)curr_block->block % alignment);
         margin = margin == alignment ? 0 : margin;
-        if (curr_block->size > curr_block->used + margin + size)
+        if (curr_block->size < margin + size)
         {
-            curr_block->used += margin;
-            chunk = curr_block->block + curr_block->used;
-            curr_block->used += size;
+            continue;
         }
 
-        if (chunk == NULL)
-        {
-            /* No space in last memory block, creating new memory block */
-            chunk = mpadd_block(size, mpid, alignment);
-        }
+        curr_mp->next_blk++;
+        curr_mp->tail_block = curr_block;
+        curr_block->used = margin;
+        curr_mp->last_dirty = curr_block->zero > curr_block->used ? curr_block->zero - curr_block->used : 0;
+        curr_block->used += size;
+        curr_block->zero = curr_block->zero > curr_block->used ? curr_block->zero : curr_block->used;
 
+        return curr_block->block + margin;
     }
 
-#ifndef MP_VALGRIND_NOT_AVAILABLE
-    VALGRIND_MEMPOOL_ALLOC((void *)&mp_arr[mpid], chunk, size);
-#endif
-
-    return chunk;
+    return NULL;
 }
 
 /****************************************************************************
 |*
-|* Function: mpmalloc
+|* Function: mpblk_reusable
 |*
 |* Description;
 |*
-|*     Analog to malloc() but allocating a piece of memory from our private 
-|*     pool on current pool id (selected with mpset()).
+|*     Finds out whether block is an empty heap block that mpreuse_block() 
+|*     can make the tail block: not the tail block itself, nor the block of
+|*     an alignment class, which stays theirs even when empty.
 |*
 |* Return:
-|*     a pointer to a block of memory of the required size within our memory
-|*     pool.
+|*     TRUE if the block can be reused
+|*     FALSE otherwise
 |*
 |* Author: Javier Gutierrez (JG)
 |*
 |* Modifications:
-|* 20140811    JG    Initial version
+|* 20261019    JG    Initial version
 |*
 ****************************************************************************/
-void *mpmalloc(size_t size)
+static int mpblk_reusable(int mpid, mpblock *block)
 {
-    return mpmalloc_mpid(size, mp_cur_mpid);
+    mp *curr_mp = &mp_arr[mpid];
+    int k = 0;
+
+    if (block->type != MP_BLK_HEAP || block->used > 0 || block == curr_mp->tail_block)
+    {
+        return FALSE;
+    }
+
+    for (k = 0; k < curr_mp->aln_cnt; k++)
+    {
+        if (curr_mp->aln_block[k] == block)
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
 }
 
 /****************************************************************************
 |*
-|* Function: mpmalloc_mpid
+|* Function: mpprefault
 |*
 |* Description;
 |*
-|*     Analog to malloc() but allocating a piece of memory from our private 
-|*     pool on a certain pool id
+|*     Faults in for writing the pages of size bytes from ptr, keeping 
+|*     their content: at once with mp_vm_populate() if the system has it,
+|*     otherwise touching each page.
 |*
 |* Return:
-|*     a pointer to a block of memory of the required size within our memory
-|*     pool.
+|*     n/a
 |*
 |* Author: Javier Gutierrez (JG)
 |*
 |* Modifications:
-|* 20140811    JG    Initial version
+|* 20261019    JG    Initial version
 |*
 ****************************************************************************/
-void *mpmalloc_mpid(size_t size, int mpid)
+static void mpprefault(uchar *ptr, size_t size)
 {
-    return mpget_chunk(size, mpid, MP_DEF_ALIGN);
+    size_t pgsz = mp_vm_pgsz();
+    volatile uchar *page = (volatile uchar *)((uintptr_t)ptr & ~((uintptr_t)pgsz -1));
+    volatile uchar *end = (volatile uchar *)(ptr + size);
+
+    if (size == 0 || mp_vm_populate((void *)page, (size_t)(end - page)) == MP_ERRNO_SUCCESS)
+    {
+        return;
+    }
+
+    /* The first byte of each page of the range: the one of ptr itself in the first page */
+    page = (volatile uchar *)ptr;
+    while (page < end)
+    {
+        *page = *page;
+        page = (volatile uchar *)(((uintptr_t)page + pgsz) & ~((uintptr_t)pgsz -1));
+    }
 }
 
 /****************************************************************************
 |*
-|* Function: mpmemalign
+|* Function: mpnuma_place
 |*
 |* Description;
 |*
-|*     Analog to memalign() but allocating a piece of memory from our private 
-|*     pool on current pool id (selected with mpset()) and aligned to the 
-|*     desired alignment.
+|*     Applies the NUMA policy of the memory pool to a new block of size 
+|*     bytes (header included) and touches each of its pages, so they are 
+|*     placed now by the owning thread and not later by whichever thread 
+|*     writes them first. The block is zero and stays zero. Nothing is done
+|*     on machines with a single node. Errors are ignored, the block can 
+|*     be used anyway.
 |*
 |* Return:
-|*     a pointer to a block of memory of the required size within our memory
-|*     pool.
+|*     n/a
 |*
 |* Author: Javier Gutierrez (JG)
 |*
 |* Modifications:
-|* 20140811    JG    Initial version
+|* 20261019    JG    Initial version
 |*
 ****************************************************************************/
-void *mpmemalign(size_t alignment, size_t size)
+static void mpnuma_place(int mpid, void *block, size_t size)
 {
-    return mpmemalign_mpid(alignment, size, mp_cur_mpid);
+    volatile uchar *page = (volatile uchar *)block;
+    volatile uchar *end = (volatile uchar *)block + size;
+    size_t pgsz = mp_vm_pgsz();
+
+    if (mp_numa_nodes() <= 1)
+    {
+        return;
+    }
+
+    (void)mp_numa_bind(block, size, mp_arr[mpid].numa_policy, mp_arr[mpid].numa_node);
+
+    for ( ; page < end; page += pgsz)
+    {
+        *page = 0;
+    }
 }
 
 /****************************************************************************
 |*
-|* Function: mpmemalign_mpid
+|* Function: mpattach_block
 |*
 |* Description;
 |*
-|*     Analog to malloc() but allocating a piece of memory from our private 
-|*     pool on a certain pool id and aligned to the desired alignment.
+|*     Appends a block to the array of blocks of the memory pool and makes 
+|*     it the tail block. The array grows by doubling its size. Blocks of 
+|*     type MP_BLK_MAP hold a single chunk that mprealloc() may grow, so they 
+|*     never become the tail block from which next chunks are taken. The
+|*     block is registered in the ownership index used by mpowner().
+|*
+|*     The array holds pointers to the headers, which stay at the start of
+|*     each block, and not the headers themselves. The header of a block 
+|*     must keep its address for all its life: it is pointed to by the tail
+|*     block and by the ownership index, read by other threads without the
+|*     lock (see mpfind_owner()), while this array moves when it grows and
+|*     is compacted by mpclr() and mptrim().
+|*     Walks over the whole pool still load the headers, one cache line 
+|*     per block, but the addresses come from the array and not from the 
+|*     previous header, so the loads do not wait for each other as along 
+|*     a linked list.
 |*
 |* Return:
-|*     a pointer to a block of memory of the required size within our memory
-|*     pool.
+|*     MP_ERRNO_SUCCESS if success
+|*     MP_ERRNO_ALLO if error
 |*
 |* Author: Javier Gutierrez (JG)
 |*
 |* Modifications:
-|* 20140811    JG    Initial version
+|* 20261019    JG    Initial version
+|* 20261019    JG    Why the array holds pointers documented
 |*
 ****************************************************************************/
-void *mpmemalign_mpid(size_t alignment, size_t size, int mpid)
+static int mpattach_block(int mpid, mpblock *block)
 {
-    return mpget_chunk(size, mpid, alignment);
+    mp *curr_mp = &mp_arr[mpid];
+
+    /* Make room for the new block in the array of blocks */
+    if (curr_mp->block_cnt >= curr_mp->block_max)
+    {
+        int block_max = curr_mp->block_max <= 0 ? MP_DEF_BLK_ARR_SZ : curr_mp->block_max * 2;
+        mpblock **blocks = (mpblock **)MP_SYS_REALLOC(curr_mp->blocks, block_max * sizeof(mpblock *));
+
+        if (blocks == NULL)
+        {
+            mperrno = MP_ERRNO_ALLO;
+            return MP_ERRNO_ALLO;
+        }
+        curr_mp->blocks = blocks;
+        curr_mp->block_max = block_max;
+    }
+
+    /* Register the range of the block in the ownership index */
+    if ((mperrno = mplock()) != MP_ERRNO_SUCCESS)
+    {
+        return mperrno;
+    }
+    mperrno = mprng_add(mpid, block);
+    mpunlock();
+    if (mperrno != MP_ERRNO_SUCCESS)
+    {
+        return mperrno;
+    }
+
+    curr_mp->blocks[curr_mp->block_cnt++] = block;
+    if (block->type == MP_BLK_MAP)
+    {
+        curr_mp->map_cnt++;
+    }
+    else
+    {
+        curr_mp->tail_block = block;
+    }
+
+    return MP_ERRNO_SUCCESS;
 }
 
 /****************************************************************************
 |*
-|* Function: mpcalloc
+|* Function: mpfree_blocks
 |*
 |* Description;
 |*
-|*     Analog to calloc() but allocating a piece of memory from our private 
-|*     pool on current pool id (selected with mpset()).
+|*     Gives back all the memory blocks of the memory pool and its array of
+|*     blocks, discounting them from the total physical memory used.
 |*
 |* Return:
-|*     a pointer to a block of memory of the required size within our memory
-|*     pool.
+|*     n/a
 |*
 |* Author: Javier Gutierrez (JG)
 |*
 |* Modifications:
-|* 20140811    JG    Initial version
+|* 20261019    JG    Initial version
+|* 20261019    JG    Buffers of the caller are not given back
 |*
 ****************************************************************************/
-void *mpcalloc(size_t nelem, size_t size)
+static void mpfree_blocks(int mpid)
 {
-    return mpcalloc_mpid(nelem, size, mp_cur_mpid);
-}
+    mp *curr_mp = &mp_arr[mpid];
+    int i = 0;
 
-/****************************************************************************
-|*
-|* Function: mpcalloc_mpid
-|*
+    /* Unregister the blocks before giving them back, their addresses can be reused */
+    if (curr_mp->block_cnt > 0 && mplock() == MP_ERRNO_SUCCESS)
+    {
+        mprng_del_mpid(mpid);
+        mpunlock();
+    }
+
+    if (curr_mp->type == MP_TYPE_VM && curr_mp->tail_block != NULL)
+    {
+        /* The only block is the header of the reserved range */
+        mpadd_tot_phy_mem(curr_mp->vm_commit, -1); /* No need to check for error */
+        mp_vm_release(curr_mp->tail_block, MP_BLK_HDR_SZ + curr_mp->tail_block->size);
+    }
+    else
+    {
+        for (i = 0; i < curr_mp->block_cnt; i++)
+        {
+            /* The buffer of the caller is neither counted nor given back */
+            if (curr_mp->blocks[i]->type == MP_BLK_BUF)
+            {
+                continue;
+            }
+            mpadd_tot_phy_mem(curr_mp->blocks[i]->size, -1); /* No need to check for error */
+            mpblk_free(mpid, curr_mp->blocks[i], TRUE);
+        }
+    }
+    MP_SYS_FREE(curr_mp->blocks);
+
+    curr_mp->blocks = NULL;
+    curr_mp->block_cnt = 0;
+    curr_mp->block_max = 0;
+    curr_mp->map_cnt = 0;
+    curr_mp->tail_block = NULL;
+    curr_mp->next_blk = 0;
+    curr_mp->last_chunk = NULL;
+    curr_mp->vm_commit = 0;
+    curr_mp->intern_tbl = NULL;
+    curr_mp->intern_cnt = 0;
+    curr_mp->intern_max = 0;
+    curr_mp->slab_free = NULL;
+    curr_mp->slab_free_cnt = 0;
+    curr_mp->slab_remote = NULL;
+    memset(curr_mp->aln_block, 0x00, sizeof(curr_mp->aln_block));
+    curr_mp->cleanups = NULL;
+}
+
+/****************************************************************************
+|*
+|* Function: mpblk_alloc
+|*
 |* Description;
 |*
-|*     Analog to calloc() but allocating a piece of memory from our private 
-|*     pool on a certain pool id
+|*     Takes the memory of a new heap block of size bytes (header included)
+|*     from the provider of the memory pool (see mpset_upstream()), or else
+|*     zeroed from the heap: fresh memory of calloc() is zero without 
+|*     touching it (mmap or new heap).
 |*
 |* Return:
-|*     a pointer to a block of memory of the required size within our memory
-|*     pool.
+|*     pointer to the memory of the block
+|*     NULL if not available
 |*
 |* Author: Javier Gutierrez (JG)
 |*
 |* Modifications:
-|* 20140811    JG    Initial version
+|* 20261019    JG    Initial version
 |*
 ****************************************************************************/
-void *mpcalloc_mpid(size_t nelem, size_t size, int mpid)
+static mpblock *mpblk_alloc(int mpid, size_t size)
 {
-    /* Allocate */
-    void *chunk =  mpget_chunk(size * nelem, mpid, MP_DEF_ALIGN);
+    mpupstream *upstream = &mp_arr[mpid].upstream;
 
-    /* Initialize */
-    if (chunk != NULL)
+    if (upstream->block_alloc != NULL)
     {
-        memset(chunk, 0x00, size * nelem);
+        return (mpblock *)upstream->block_alloc(size, MP_DEF_ALIGN, upstream->ctx);
     }
 
-    return chunk;
+    return (mpblock *)MP_SYS_CALLOC(1, size);
 }
 
 /****************************************************************************
 |*
-|* Function: mpfree
+|* Function: mpblk_free
 |*
 |* Description;
 |*
-|*     Analog to free() but it's a dummy function that doesn't do anything.
-|*     The reason is that this memory pool is a dynamic memory pool allocated
-|*     for which the single memory chunks cannot be free-ed, but only the 
-|*     whole memory pool. So the reason of this funcion is for 3rd party software 
-|*     enabling a custom memory management and on which the malloc(), realloc(),
-|*     free(), etc. can be overriden with own functions.
+|*     Gives back the memory of a block to where it was taken from: its own
+|*     mapping, the provider of the memory pool or the heap. The size given
+|*     to the provider is the one it delivered, header and color included.
+|*     Heap blocks go first to the recycler, unless recycle is FALSE (their
+|*     pages were given back already, see mptrim()). Blocks placed with a 
+|*     NUMA policy are reset to the default one first: otherwise the heap,
+|*     or the provider, would keep it for whatever reuses the pages, and 
+|*     the mapping of the heap would stay split where the policy changes.
 |*
 |* Return:
 |*     n/a
@@ -499,26 +756,45 @@ void *mpcalloc_mpid(size_t nelem, size_t size, int mpid)
 |* Author: Javier Gutierrez (JG)
 |*
 |* Modifications:
-|* 20140811    JG    Initial version
+|* 20261019    JG    Initial version
+|* 20261019    JG    Heap blocks kept by the recycler
+|* 20261019    JG    NUMA policy reset
+|* 20261019    JG    recycle parameter
 |*
 ****************************************************************************/
-void mpfree(void *ptr)
+static void mpblk_free(int mpid, mpblock *block, int recycle)
 {
-    mpfree_mpid(ptr, mp_cur_mpid);
+    mpupstream *upstream = &mp_arr[mpid].upstream;
+
+    if (block->numa && block->type != MP_BLK_MAP)
+    {
+        (void)mp_numa_bind(block, (size_t)(block->block - (uchar *)block) + block->size, MP_NUMA_NONE, 0); /* Given back anyway */
+        block->numa = FALSE;
+    }
+
+    if (block->type == MP_BLK_MAP)
+    {
+        mp_vm_release(block, MP_BLK_HDR_SZ + block->size);
+    }
+    else if (upstream->block_free != NULL)
+    {
+        upstream->block_free(block, (size_t)(block->block - (uchar *)block) + block->size, upstream->ctx);
+    }
+    else if (!recycle || !mprcy_put(mpid, block, (size_t)(block->block - (uchar *)block) + block->size))
+    {
+        MP_SYS_FREE(block);
+    }
 }
 
 /****************************************************************************
 |*
-|* Function: mpfree_mpid
+|* Function: mpblk_discard
 |*
 |* Description;
 |*
-|*     Analog to free() but it's a dummy function that doesn't do anything.
-|*     The reason is that this memory pool is a dynamic memory pool allocated
-|*     for which the single memory chunks cannot be free-ed, but only the 
-|*     whole memory pool. So the reason of this funcion is for 3rd party software 
-|*     enabling a custom memory management and on which the malloc(), realloc(),
-|*     free(), etc. can be overriden with own functions.
+|*     Gives back to the OS the physical memory of the whole pages inside
+|*     the memory of a heap block about to be given back, so it is released
+|*     even if the heap (or the recycler) keeps the addresses.
 |*
 |* Return:
 |*     n/a
@@ -526,408 +802,4273 @@ void mpfree(void *ptr)
 |* Author: Javier Gutierrez (JG)
 |*
 |* Modifications:
-|* 20140811    JG    Initial version
+|* 20261019    JG    Initial version
 |*
 ****************************************************************************/
-void mpfree_mpid(void *ptr, int mpid)
+static void mpblk_discard(mpblock *block)
 {
-#ifndef MP_VALGRIND_NOT_AVAILABLE
-    VALGRIND_MEMPOOL_FREE((void *)&mp_arr[mpid], ptr);
-#endif
-    return;
+    size_t pgsz = mp_vm_pgsz();
+    uintptr_t start = ((uintptr_t)block->block + pgsz -1) & ~((uintptr_t)pgsz -1);
+    uintptr_t end = ((uintptr_t)block->block + block->size) & ~((uintptr_t)pgsz -1);
+
+    if (end > start)
+    {
+        (void)mp_vm_discard((void *)start, (size_t)(end - start)); /* The memory is given back anyway */
+    }
 }
 
 /****************************************************************************
 |*
-|* Function: mprealloc
+|* Function: mpclr_block
 |*
 |* Description;
 |*
-|*     Analog to realloc() but allocating a piece of memory from our private 
-|*     pool on current pool id (selected with mpset()).
+|*     Applies the clear policy of the memory pool to the first size bytes
+|*     of a block, its used memory: MP_CLR_ZERO sets them to zero with
+|*     non-temporal stores, MP_CLR_DISCARD gives back their whole pages to
+|*     the OS, which delivers them as zero when touched again, and sets to
+|*     zero the rest. Pages are only discarded for heap blocks from at least
+|*     MP_CLR_DISCARD_MIN bytes, on systems reading them back as zero. When 
+|*     nothing else of the block was written, the whole block is zero.
 |*
 |* Return:
-|*     a pointer to a block of memory of the required size within our memory
-|*     pool and with the content of ptr if available.
+|*     n/a
 |*
 |* Author: Javier Gutierrez (JG)
 |*
 |* Modifications:
-|* 20140811    JG    Initial version
+|* 20261019    JG    Initial version
 |*
 ****************************************************************************/
-void *mprealloc(void *ptr, size_t size)
+static void mpclr_block(int mpid, mpblock *block, size_t size)
 {
-    return mprealloc_mpid(ptr, size, mp_cur_mpid);
+    uchar *start = block->block;
+    uchar *end = block->block + size;
+
+    if (size == 0)
+    {
+        return;
+    }
+
+    if (mp_arr[mpid].clr_policy == MP_CLR_DISCARD && MP_VM_DISCARD_ZERO && size >= MP_CLR_DISCARD_MIN &&
+            block->type == MP_BLK_HEAP && mp_arr[mpid].upstream.block_alloc == NULL)
+    {
+        size_t pgsz = mp_vm_pgsz();
+        uchar *blk_end = (uchar *)((uintptr_t)(block->block + block->size) & ~((uintptr_t)pgsz -1));
+
+        /* Whole pages from the first one after the start up to the one of the end */
+        start = (uchar *)(((uintptr_t)block->block + pgsz -1) & ~((uintptr_t)pgsz -1));
+        end = (uchar *)(((uintptr_t)end + pgsz -1) & ~((uintptr_t)pgsz -1));
+        end = end > blk_end ? blk_end : end;
+        if (end <= start || mp_vm_discard(start, (size_t)(end - start)) != MP_ERRNO_SUCCESS)
+        {
+            start = block->block;
+            end = block->block;
+        }
+        end = end > block->block + size ? block->block + size : end;
+        memset(block->block, 0x00, (size_t)(start - block->block));
+        start = end;
+        end = block->block + size;
+    }
+    if (end > start)
+    {
+        mpzero_nt(start, (size_t)(end - start));
+    }
+
+    if (block->zero <= size)
+    {
+        block->zero = 0;
+    }
 }
 
 /****************************************************************************
 |*
-|* Function: mprealloc_mpid
+|* Function: mpzero_nt
 |*
 |* Description;
 |*
-|*     Analog to realloc() but allocating a piece of memory from our private 
-|*     pool on a certain pool id
+|*     Sets to zero size bytes from ptr. From MP_NT_MIN_SZ bytes, on CPUs 
+|*     with SSE2, with non-temporal stores: the memory is written without 
+|*     being read into the caches nor evicting the data in use from them.
 |*
 |* Return:
-|*     a pointer to a block of memory of the required size within our memory
-|*     pool and with the content of ptr if available.
+|*     n/a
 |*
 |* Author: Javier Gutierrez (JG)
 |*
 |* Modifications:
-|* 20140811    JG    Initial version
+|* 20261019    JG    Initial version
 |*
 ****************************************************************************/
-void *mprealloc_mpid(void *ptr, size_t size, int mpid)
+static void mpzero_nt(uchar *ptr, size_t size)
 {
-    void *chunk = NULL;
-    uintptr_t ptrdiff = 0;
+#if defined(__SSE2__) || defined(_M_X64) /* { */
+    uchar *end = ptr + size;
+    uchar *curr = (uchar *)(((uintptr_t)ptr + 15) & ~(uintptr_t)15);
+    __m128i zero = _mm_setzero_si128();
 
-    /* Allocate new chunk of memory */
-    chunk = mpget_chunk(size, mpid, MP_DEF_ALIGN);
-
-    /* Copy content of all memory chunk */
-    if (ptr != NULL && chunk != NULL)
+    if (size < MP_NT_MIN_SZ)
     {
-        /* Valgrind can yell here invalid or initiliazed read. 
-         * At this point we don't know the size of previous pointer, so 
-         * we need to copy as much as possible, therefore part of it
-         * might not be initiliazed */
-
-        /* Not to overlap */
-        ptrdiff = (uintptr_t)chunk - (uintptr_t)ptr;
-
-#ifndef MP_VALGRIND_NOT_AVAILABLE
-        VALGRIND_DISABLE_ERROR_REPORTING;
-#endif
-
-        if (ptrdiff < size)
-        {
-            memcpy(chunk, ptr, ptrdiff);
-        }
-        else
-        {
-            memcpy(chunk, ptr, size);
-        }
-
-#ifndef MP_VALGRIND_NOT_AVAILABLE
-        VALGRIND_ENABLE_ERROR_REPORTING;
-#endif
+        memset(ptr, 0x00, size);
+        return;
     }
 
-    return chunk;
+    memset(ptr, 0x00, (size_t)(curr - ptr));
+    for ( ; curr + 64 <= end; curr += 64)
+    {
+        _mm_stream_si128((__m128i *)curr, zero);
+        _mm_stream_si128((__m128i *)(curr + 16), zero);
+        _mm_stream_si128((__m128i *)(curr + 32), zero);
+        _mm_stream_si128((__m128i *)(curr + 48), zero);
+    }
+    _mm_sfence(); /* Visible before the memory is delivered again */
+    memset(curr, 0x00, (size_t)(end - curr));
+#else /* } __SSE2__ { */
+    memset(ptr, 0x00, size);
+#endif /* } __SSE2__ */
 }
 
 /****************************************************************************
 |*
-|* Function: mpstrdup
+|* Function: mprcy_unit
 |*
 |* Description;
 |*
-|*     Returns a pointer to a new string that is a duplicate of s1.
+|*     Size of the memory of the recycled blocks, header included: a block 
+|*     of the default size with room for any color and for any alignment
+|*     up to a cache line.
 |*
 |* Return:
-|*     a pointer to duplicated string.
+|*     size of the recycled blocks
 |*
 |* Author: Javier Gutierrez (JG)
 |*
 |* Modifications:
-|* 20140811    JG    Initial version
+|* 20261019    JG    Initial version
 |*
 ****************************************************************************/
-char *mpstrdup(const char *s1)
+static size_t mprcy_unit()
 {
-    return mpstrdup_mpid(s1, mp_cur_mpid);
+    size_t color = mp_colors > 1 ? (size_t)(mp_colors - 1) * MP_CACHE_LINE : 0;
+
+    return MP_BLK_HDR_SZ + color + mpget_blksz() + MP_CACHE_LINE - 1;
 }
 
 /****************************************************************************
 |*
-|* Function: mpstrdup_mpid
+|* Function: mprcy_get
 |*
 |* Description;
 |*
-|*     Returns a pointer to a new string that is a duplicate of s1.
+|*     Takes a block from the magazine of the thread. An empty magazine is 
+|*     first refilled with up to half of its size from the depot. The block
+|*     is no longer counted as memory of the recycler. Blocks of a former
+|*     unit (mpset_blksz(), mpset_colors()) found on the way are given back.
 |*
 |* Return:
-|*     a pointer to duplicated string or NULL if s1 is NULL.
+|*     pointer to the memory of the block, not zero
+|*     NULL if no block is available
 |*
 |* Author: Javier Gutierrez (JG)
 |*
 |* Modifications:
-|* 20140811    JG    Initial version
+|* 20261019    JG    Initial version
 |*
 ****************************************************************************/
-char *mpstrdup_mpid(const char *s1, int mpid)
+static mpblock *mprcy_get()
 {
-    char *str = NULL;
-    size_t str_len = 0;
+    mprcy *rcy = NULL;
+    size_t unit = mprcy_unit();
+    int err = mperrno;
 
-    /* Check parameters */
-    if (s1 == NULL)
+    if (mp_rcy_mag == NULL && mplock() == MP_ERRNO_SUCCESS)
     {
-        return NULL;
+        while (mp_rcy_depot != NULL && mp_rcy_mag_cnt < MP_RCY_MAG_SZ / 2)
+        {
+            rcy = mp_rcy_depot;
+            mp_rcy_depot = rcy->next;
+            mp_rcy_depot_sz -= rcy->size;
+            rcy->next = (mprcy *)mp_rcy_mag;
+            mp_rcy_mag = rcy;
+            mp_rcy_mag_cnt++;
+        }
+        mpunlock();
     }
 
-    str_len = strlen(s1) +1;
-    /* Allocate memory for new string */
-    str =  (char *)mpmalloc_mpid(str_len, mpid);
-
-    /* Duplicate string in allocated memory */
-    if (str != NULL)
+    while ((rcy = (mprcy *)mp_rcy_mag) != NULL)
     {
-        strncpy(str, s1, str_len);
+        mp_rcy_mag = rcy->next;
+        mp_rcy_mag_cnt--;
+        mpadd_tot_phy_mem(rcy->size, -1); /* No need to check for error */
+        if (rcy->size == unit)
+        {
+            break;
+        }
+        MP_SYS_FREE(rcy);
     }
+    mperrno = err;
 
-    return str;
+    return (mpblock *)rcy;
 }
 
 /****************************************************************************
 |*
-|* Function: mpasprintf_mpid
+|* Function: mprcy_put
 |*
 |* Description;
 |*
-|*     anolog to sprintf() except that allocates a string large enough to hold
-|*     the output. Same functionality of asprintf().
+|*     Keeps a heap block of size bytes (header included) for reuse, if it 
+|*     is of the size of the recycled blocks and the memory limit allows it:
+|*     recycled blocks count as used memory. The block goes to the magazine
+|*     of the thread; a full magazine moves half of its blocks to the depot,
+|*     and those not fitting in the depot are given back to the heap. Blocks
+|*     of pools with a NUMA policy are not recycled: their pages are bound.
 |*
 |* Return:
-|*     The number of bytes allocated on success
-|*     -1 on error and the content of strp is undefined on error.
+|*     TRUE if the block was kept
+|*     FALSE if it must be given back
 |*
 |* Author: Javier Gutierrez (JG)
 |*
 |* Modifications:
-|* 20140815    JG    Initial version
+|* 20261019    JG    Initial version
+|* 20261019    JG    Magazine moved to the depot when the thread ends
 |*
 ****************************************************************************/
-int mpasprintf(char **strp, const char *fmt, ...)
+static int mprcy_put(int mpid, mpblock *block, size_t size)
 {
-    int rc = 0;
-    int len = 0;
-    va_list ap;
+    mprcy *rcy = (mprcy *)block;
+    int err = mperrno;
 
-    /* Check parameters */
-    if (fmt == NULL || strp == NULL)
+    if (mp_rcy_sz == 0 || size != mprcy_unit() || mp_arr[mpid].numa_policy != MP_NUMA_NONE ||
+            mpadd_tot_phy_mem(size, +1) != MP_ERRNO_SUCCESS)
     {
-        mperrno = MP_ERRNO_PARM;
-        return -1;
+        mperrno = err;
+        return FALSE;
     }
 
-    /* Find out actual length of the built string */
-    va_start (ap, fmt);
-#ifdef _WIN32
-    len = _vscprintf(fmt, ap) + 1;
-#else
-    len = vsnprintf(NULL, 0, fmt, ap) + 1;
+    rcy->size = size;
+    rcy->next = (mprcy *)mp_rcy_mag;
+    mp_rcy_mag = rcy;
+    mp_rcy_mag_cnt++;
+
+#if MP_THREAD_SAFE == 1
+    /* The magazine is not reachable once the thread ends: it goes to the depot then */
+    if (!mp_rcy_onexit)
+    {
+        mp_rcy_onexit = mp_thread_onexit(&mprcy_exit) == MP_ERRNO_SUCCESS;
+    }
 #endif
-    va_end(ap);
 
-    /* Deliver string */
-    if (len > 0)
+    /* Full magazine: half of it to the depot */
+    if (mp_rcy_mag_cnt > MP_RCY_MAG_SZ)
     {
-        *strp = (char *)mpmalloc(len);
-        if (*strp != NULL)
-        {
-            va_start (ap, fmt);
-            rc = vsprintf(*strp, fmt, ap);
-            va_end(ap);
-        }
+        mprcy_spill(MP_RCY_MAG_SZ / 2);
     }
+    mperrno = err;
 
-    return rc;
+    return TRUE;
 }
 
 /****************************************************************************
 |*
-|* Function: mpasprintf_mpid
+|* Function: mprcy_spill
 |*
 |* Description;
 |*
-|*     anolog to sprintf() except that allocates a string large enough to hold
-|*     the output.
+|*     Moves the blocks of the magazine of the thread beyond keep to the 
+|*     depot. Those not fitting in the depot are given back to the heap.
 |*
 |* Return:
-|*     The number of bytes allocated on success
-|*     -1 on error and the content of strp is undefined on error.
+|*     n/a
 |*
 |* Author: Javier Gutierrez (JG)
 |*
 |* Modifications:
-|* 20140815    JG    Initial version
+|* 20261019    JG    Initial version
 |*
 ****************************************************************************/
-int mpasprintf_mpid(char **strp, int mpid, const char *fmt, ...)
+static void mprcy_spill(int keep)
 {
-    int rc = 0;
-    int len = 0;
-    va_list ap;
+    mprcy *rcy = NULL;
+    mprcy *spill = NULL;
+    size_t spill_sz = 0;
 
-    /* Check parameters */
-    if (fmt == NULL || strp == NULL)
+    if (mp_rcy_mag_cnt <= keep || mplock() != MP_ERRNO_SUCCESS)
     {
-        mperrno = MP_ERRNO_PARM;
-        return -1;
+        return;
     }
-
-    /* Find out actual length of the built string */
-    va_start (ap, fmt);
-#ifdef _WIN32
-    len = _vscprintf(fmt, ap) + 1;
-#else
-    len = vsnprintf(NULL, 0, fmt, ap) + 1;
-#endif
-    va_end(ap);
-
-    /* Deliver string */
-    if (len > 0)
+    while (mp_rcy_mag_cnt > keep)
     {
-        *strp = (char *)mpmalloc_mpid(len, mpid);
-        if (*strp != NULL)
+        rcy = (mprcy *)mp_rcy_mag;
+        mp_rcy_mag = rcy->next;
+        mp_rcy_mag_cnt--;
+        if (mp_rcy_depot_sz + rcy->size <= mp_rcy_sz)
+        {
+            rcy->next = mp_rcy_depot;
+            mp_rcy_depot = rcy;
+            mp_rcy_depot_sz += rcy->size;
+        }
+        else
         {
-            va_start (ap, fmt);
-            rc = vsprintf(*strp, fmt, ap);
-            va_end(ap);
+            rcy->next = spill;
+            spill = rcy;
         }
     }
+    mpunlock();
 
-    return rc;
+    /* Given back out of the lock */
+    while ((rcy = spill) != NULL)
+    {
+        spill = rcy->next;
+        spill_sz += rcy->size;
+        MP_SYS_FREE(rcy);
+    }
+    if (spill_sz > 0)
+    {
+        mpadd_tot_phy_mem(spill_sz, -1); /* No need to check for error */
+    }
 }
 
+#if MP_THREAD_SAFE == 1 /* { */
 /****************************************************************************
 |*
-|* Function: mpnew
+|* Function: mprcy_exit
 |*
 |* Description;
 |*
-|*     Initializes the next memory pool available in the array of memory pools 
-|*     and assignes the corresponding description
+|*     Run when a thread which recycled blocks ends (see mp_thread_onexit()):
+|*     its magazine goes to the depot, where other threads reuse it, or is
+|*     given back, so it does not stay counted as used memory.
 |*
 |* Return:
-|*     the memory pool ID of the new allocated memory pool    
+|*     n/a
 |*
 |* Author: Javier Gutierrez (JG)
 |*
 |* Modifications:
-|* 20140811    JG    Initial version
+|* 20261019    JG    Initial version
 |*
 ****************************************************************************/
-int mpnew(char *descr)
+static void mprcy_exit()
 {
-    int i = 0, mpid = MP_ERRNO_EXMP;
-    char *curr_descr = NULL;
-    mperrno = MP_ERRNO_SUCCESS;
+    int err = mperrno;
 
-    /* Check parameter */
-    if (descr == NULL)
-    {
-        curr_descr = "-";
-    }
-    else
-    {
-        curr_descr = descr;
-    }
+    mprcy_spill(0);
+    mp_rcy_onexit = FALSE;
+    mperrno = err;
+}
+#endif /* } MP_THREAD_SAFE */
 
-#if MP_THREAD_SAFE == 1 /* { */
+/****************************************************************************
+|*
+|* Function: mpcleanup_run
+|*
+|* Description;
+|*
+|*     Runs the cleanup callbacks of the memory pool, the last registered 
+|*     first. Each one is unlinked before being called, so a callback can 
+|*     register new ones, which are run too. The records are given back 
+|*     once run.
+|*
+|* Return:
+|*     n/a
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|* 20261019    JG    Records given back to the C library
+|*
+****************************************************************************/
+static void mpcleanup_run(int mpid)
+{
+    mpcleanup *cleanup = NULL;
 
-#   if _WIN32 /* { */
-    if ((mperrno = mp_mutex_init(&mp_mutex_p)) != MP_ERRNO_SUCCESS)
+    while ((cleanup = mp_arr[mpid].cleanups) != NULL)
     {
-        return mperrno;
+        mp_arr[mpid].cleanups = cleanup->next;
+        cleanup->fn(cleanup->arg);
+        MP_SYS_FREE(cleanup);
     }
-#   endif /* } _WIN32 */
+}
+
+/****************************************************************************
+|*
+|* Function: mpvm_commit
+|*
+|* Description;
+|*
+|*     Makes sure the first size bytes of the range reserved for a memory
+|*     pool of type MP_TYPE_VM are committed. Pages are committed in steps 
+|*     of the block size (mpget_blksz()) so that only a few calls to the 
+|*     system are needed while the pool grows.
+|*
+|* Return:
+|*     MP_ERRNO_SUCCESS if success
+|*     MP_ERRNO_NOMM, MP_ERRNO_EXMM, MP_ERRNO_SYSE if error
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+static int mpvm_commit(int mpid, size_t size)
+{
+    mp *curr_mp = &mp_arr[mpid];
+    uchar *base = (uchar *)curr_mp->tail_block;
+    size_t vm_size = MP_BLK_HDR_SZ + curr_mp->tail_block->size;
+    size_t pgsz = mp_vm_pgsz();
+    size_t commit = 0;
+
+    if (size <= curr_mp->vm_commit)
+    {
+        return MP_ERRNO_SUCCESS;
+    }
+
+    if (size > vm_size)
+    {
+        mperrno = MP_ERRNO_NOMM;
+        return MP_ERRNO_NOMM;
+    }
+
+    /* Commit at least one block size each time, rounded to pages */
+    commit = size - curr_mp->vm_commit < mpget_blksz() ? curr_mp->vm_commit + mpget_blksz() : size;
+    commit = (commit + pgsz -1) & ~(pgsz -1);
+    commit = commit > vm_size ? vm_size : commit;
+
+    if ((mperrno = mpadd_tot_phy_mem(commit - curr_mp->vm_commit, +1)) != MP_ERRNO_SUCCESS)
+    {
+        return mperrno;
+    }
+
+    if (mp_vm_commit(base + curr_mp->vm_commit, commit - curr_mp->vm_commit) != MP_ERRNO_SUCCESS)
+    {
+        mpadd_tot_phy_mem(commit - curr_mp->vm_commit, -1);
+        mperrno = MP_ERRNO_SYSE;
+        return MP_ERRNO_SYSE;
+    }
+
+    curr_mp->vm_commit = commit;
+
+    return MP_ERRNO_SUCCESS;
+}
+
+/****************************************************************************
+|*
+|* Function: mpget_chunk
+|*
+|* Description;
+|*
+|*     Gets a chunk of memory of the specified size from the memmory pool 
+|*     with id mpid and aligned to alignment.
+|*
+|* Return:
+|*     a pointer to a block of memory of the required size within our memory
+|*     pool.
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20140811    JG    Initial version
+|* 20261019    JG    Alignments covered by an alignment class use its block
+|*
+****************************************************************************/
+static void *mpget_chunk(size_t size, int mpid, size_t alignment)
+{
+    void *chunk = NULL;
+    mp *curr_mp = NULL;
+    mpblock *curr_block = NULL;
+    int cls = 0;
+    mperrno = MP_ERRNO_SUCCESS;
+
+    /* We decided not to support negative sizes */
+    if (size < 0) /* Works only when size_t is signed */
+    {
+        mperrno = MP_ERRNO_SZNG;
+        return NULL;   
+    }
+
+    /* Memory pool ID out of limit */
+    if (mpid > MP_MAX_MP_ID -1 || mpid < 0)
+    {
+        mperrno = MP_ERRNO_MPID;
+        return NULL;
+    }
+
+    /* Memory pool ID not initiliazed */
+    if (mp_arr[mpid].init != 'Y' && mpid != MP_DEF_MP_ID)
+    {
+        mperrno = MP_ERRNO_NOIN;
+        return NULL;
+    }
+
+    /* Slab pools only deliver objects with mpslab_alloc() */
+    if (mp_arr[mpid].type == MP_TYPE_SLAB)
+    {
+        mperrno = MP_ERRNO_PARM;
+        return NULL;
+    }
+
+    /* Alignment out of limits: Alignment is not power of 2 or is less than size of void * */
+    if ((alignment & (alignment -1)) != 0 ||
+            alignment < sizeof(void *))
+    {
+        mperrno = MP_ERRNO_EXAL;
+        return NULL;
+    }
+
+    /* Setting right alignment */
+    if (alignment < MP_DEF_ALIGN)
+    {
+        alignment = MP_DEF_ALIGN;
+    }
+
+    /* Not to fail if size is 0 we deliver a pointer anyway */
+    if (size == 0)
+    {
+        /* TODO: In this case we should return some lost memory chunk */
+        size = 1;
+    }
+
+    curr_mp = &mp_arr[mpid];
+#if MP_THREAD_SAFE == 1
+    /* Check thread ID */
+    if (!(mpid == MP_DEF_MP_ID && curr_mp->init != 'Y'))
+    {
+        if (MP_THREAD_EQ(curr_mp->thread_id, MP_CURR_THREAD) == 0)
+        {
+            mperrno = MP_ERRNO_THRD;
+            return NULL;
+        }
+    }
+#endif
+
+    /* Smallest alignment class covering the alignment, if any */
+    while (alignment > MP_DEF_ALIGN && cls < curr_mp->aln_cnt && curr_mp->aln_cls[cls] < alignment)
+    {
+        cls++;
+    }
+
+    /* Get memory chunk */
+    if (alignment > MP_DEF_ALIGN && cls < curr_mp->aln_cnt)
+    {
+        /* Taken from the block of the alignment class, without padding */
+        chunk = mpget_aln_chunk(size, mpid, cls);
+    }
+    else if (curr_mp->tail_block == NULL)
+    {
+        /* First time using this pool, creating block with right alignment */
+        chunk = mpadd_block(size, mpid, alignment);
+    }
+    else
+    {
+        /* Block already in used */
+        int margin = 0;
+
+        /* Check if last memory block has enough space */
+        curr_block = curr_mp->tail_block;
+        margin = alignment - ((uintptr_t)(curr_block->block + curr_block->used) % alignment);
+        margin = margin == alignment ? 0 : margin;
+        if (curr_block->size > curr_block->used + margin + size &&
+                (curr_mp->type != MP_TYPE_VM ||
+                 mpvm_commit(mpid, MP_BLK_HDR_SZ + curr_block->used + margin + size) == MP_ERRNO_SUCCESS))
+        {
+            curr_block->used += margin;
+            chunk = curr_block->block + curr_block->used;
+            curr_mp->last_dirty = curr_block->zero > curr_block->used ? curr_block->zero - curr_block->used : 0;
+            curr_block->used += size;
+            curr_block->zero = curr_block->zero > curr_block->used ? curr_block->zero : curr_block->used;
+        }
+
+        if (chunk == NULL)
+        {
+            if (curr_mp->type == MP_TYPE_VM)
+            {
+                /* The reserved range is the whole pool, it cannot grow */
+                mperrno = mperrno == MP_ERRNO_SUCCESS ? MP_ERRNO_NOMM : mperrno;
+                return NULL;
+            }
+
+            /* No space in last memory block, creating new memory block */
+            chunk = mpadd_block(size, mpid, alignment);
+        }
+
+    }
+
+    if (chunk != NULL)
+    {
+        curr_mp->last_chunk = chunk;
+    }
+
+#ifndef MP_VALGRIND_NOT_AVAILABLE
+    VALGRIND_MEMPOOL_ALLOC((void *)&mp_arr[mpid], chunk, size);
+#endif
+
+    return chunk;
+}
+
+/****************************************************************************
+|*
+|* Function: mpget_aln_chunk
+|*
+|* Description;
+|*
+|*     Gets a chunk of memory of the specified size from the block of the 
+|*     alignment class cls of the memory pool mpid. The size is rounded up
+|*     to the alignment of the class, so the next chunk of the class is 
+|*     aligned without padding and no other chunk shares its cache lines. 
+|*     When the block of the class is full a new one is added, which does 
+|*     not replace the tail block of the memory pool.
+|*
+|* Return:
+|*     a pointer to the chunk of memory
+|*     NULL if error
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+static void *mpget_aln_chunk(size_t size, int mpid, int cls)
+{
+    mp *curr_mp = &mp_arr[mpid];
+    mpblock *curr_block = curr_mp->aln_block[cls];
+    mpblock *tail_block = curr_mp->tail_block;
+    size_t alignment = curr_mp->aln_cls[cls];
+    size_t margin = 0;
+    void *chunk = NULL;
+
+    if (size > (size_t)-1 - alignment)
+    {
+        mperrno = MP_ERRNO_PARM;
+        return NULL;
+    }
+    size = (size + alignment -1) & ~(alignment -1);
+
+    if (curr_block != NULL)
+    {
+        /* Only the first chunk of the block (or after mpclr()) needs a margin */
+        margin = alignment - ((uintptr_t)(curr_block->block + curr_block->used) % alignment);
+        margin = margin == alignment ? 0 : margin;
+        if (curr_block->size - curr_block->used >= margin + size)
+        {
+            curr_block->used += margin;
+            chunk = curr_block->block + curr_block->used;
+            curr_mp->last_dirty = curr_block->zero > curr_block->used ? curr_block->zero - curr_block->used : 0;
+            curr_block->used += size;
+            curr_block->zero = curr_block->zero > curr_block->used ? curr_block->zero : curr_block->used;
+            return chunk;
+        }
+    }
+
+    /* New block for the class, the tail block of the pool stays the same */
+    if ((chunk = mpadd_block(size, mpid, alignment)) != NULL && curr_mp->tail_block != tail_block)
+    {
+        curr_mp->aln_block[cls] = curr_mp->tail_block;
+        curr_mp->tail_block = tail_block;
+    }
+
+    return chunk;
+}
+
+/****************************************************************************
+|*
+|* Function: mpmalloc
+|*
+|* Description;
+|*
+|*     Analog to malloc() but allocating a piece of memory from our private 
+|*     pool on current pool id (selected with mpset()).
+|*
+|* Return:
+|*     a pointer to a block of memory of the required size within our memory
+|*     pool.
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20140811    JG    Initial version
+|*
+****************************************************************************/
+void *mpmalloc(size_t size)
+{
+    return mpmalloc_mpid(size, mp_cur_mpid);
+}
+
+/****************************************************************************
+|*
+|* Function: mpmalloc_mpid
+|*
+|* Description;
+|*
+|*     Analog to malloc() but allocating a piece of memory from our private 
+|*     pool on a certain pool id
+|*
+|* Return:
+|*     a pointer to a block of memory of the required size within our memory
+|*     pool.
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20140811    JG    Initial version
+|*
+****************************************************************************/
+void *mpmalloc_mpid(size_t size, int mpid)
+{
+    return mpget_chunk(size, mpid, MP_DEF_ALIGN);
+}
+
+/****************************************************************************
+|*
+|* Function: mpmemalign
+|*
+|* Description;
+|*
+|*     Analog to memalign() but allocating a piece of memory from our private 
+|*     pool on current pool id (selected with mpset()) and aligned to the 
+|*     desired alignment.
+|*
+|* Return:
+|*     a pointer to a block of memory of the required size within our memory
+|*     pool.
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20140811    JG    Initial version
+|*
+****************************************************************************/
+void *mpmemalign(size_t alignment, size_t size)
+{
+    return mpmemalign_mpid(alignment, size, mp_cur_mpid);
+}
+
+/****************************************************************************
+|*
+|* Function: mpmemalign_mpid
+|*
+|* Description;
+|*
+|*     Analog to malloc() but allocating a piece of memory from our private 
+|*     pool on a certain pool id and aligned to the desired alignment.
+|*
+|* Return:
+|*     a pointer to a block of memory of the required size within our memory
+|*     pool.
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20140811    JG    Initial version
+|*
+****************************************************************************/
+void *mpmemalign_mpid(size_t alignment, size_t size, int mpid)
+{
+    return mpget_chunk(size, mpid, alignment);
+}
+
+/****************************************************************************
+|*
+|* Function: mpcalloc
+|*
+|* Description;
+|*
+|*     Analog to calloc() but allocating a piece of memory from our private 
+|*     pool on current pool id (selected with mpset()).
+|*
+|* Return:
+|*     a pointer to a block of memory of the required size within our memory
+|*     pool.
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20140811    JG    Initial version
+|*
+****************************************************************************/
+void *mpcalloc(size_t nelem, size_t size)
+{
+    return mpcalloc_mpid(nelem, size, mp_cur_mpid);
+}
+
+/****************************************************************************
+|*
+|* Function: mpcalloc_mpid
+|*
+|* Description;
+|*
+|*     Analog to calloc() but allocating a piece of memory from our private 
+|*     pool on a certain pool id. Blocks are zero when taken from the system
+|*     and each block remembers up to where it was ever used, so only the 
+|*     part of the chunk below that mark is set to zero.
+|*
+|* Return:
+|*     a pointer to a block of memory of the required size within our memory
+|*     pool.
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20140811    JG    Initial version
+|* 20261019    JG    memset() only on memory which might not be zero
+|*
+****************************************************************************/
+void *mpcalloc_mpid(size_t nelem, size_t size, int mpid)
+{
+    void *chunk = NULL;
+    size_t dirty = 0;
+
+    /* Overflow of nelem * size: the division is needed only for big factors */
+    if (((nelem | size) >> (sizeof(size_t) * 4)) != 0 &&
+            size != 0 && nelem > ((size_t)-1) / size)
+    {
+        mperrno = MP_ERRNO_PARM;
+        return NULL;
+    }
+
+    /* Allocate */
+    if ((chunk = mpget_chunk(size * nelem, mpid, MP_DEF_ALIGN)) == NULL)
+    {
+        return NULL;
+    }
+
+    /* Initialize only what might have been used before */
+    dirty = mp_arr[mpid].last_dirty < size * nelem ? mp_arr[mpid].last_dirty : size * nelem;
+    memset(chunk, 0x00, dirty);
+#ifndef MP_VALGRIND_NOT_AVAILABLE
+    VALGRIND_MAKE_MEM_DEFINED((uchar *)chunk + dirty, size * nelem - dirty);
+#endif
+
+    return chunk;
+}
+
+/****************************************************************************
+|*
+|* Function: mpmalloc_batch
+|*
+|* Description;
+|*
+|*     Allocates n chunks of memory from the memory pool mpid at once. The 
+|*     size of the chunk i is sizes[i] and its alignment aligns[i] (NULL for
+|*     MP_DEF_ALIGN on all of them). The chunks are laid out back to back in 
+|*     one piece of the pool, so the parameters of the pool are checked and 
+|*     the pool is bumped only once. The pointers to the chunks are written 
+|*     in out_ptrs. The last chunk can be resized in place by mprealloc().
+|*
+|* Return:
+|*     MP_ERRNO_SUCCESS on success
+|*     MP_ERRNO_* otherwise, and out_ptrs is not modified.
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+int mpmalloc_batch(int mpid, size_t n, const size_t *sizes, const size_t *aligns, void **out_ptrs)
+{
+    uchar *chunk = NULL;
+    size_t total = 0;
+    size_t max_align = MP_DEF_ALIGN;
+    size_t align = 0;
+    size_t size = 0;
+    size_t i = 0;
+
+    if (n == 0 || sizes == NULL || out_ptrs == NULL)
+    {
+        mperrno = MP_ERRNO_PARM;
+        return mperrno;
+    }
+
+    /* Layout relative to a start aligned to the biggest alignment */
+    for (i = 0; i < n; i++)
+    {
+        align = aligns == NULL ? MP_DEF_ALIGN : aligns[i];
+        if ((align & (align -1)) != 0 || align < sizeof(void *))
+        {
+            mperrno = MP_ERRNO_EXAL;
+            return mperrno;
+        }
+        align = align < MP_DEF_ALIGN ? MP_DEF_ALIGN : align;
+        max_align = align > max_align ? align : max_align;
+
+        size = sizes[i] == 0 ? 1 : sizes[i];
+        if (total > (size_t)-1 - (align -1) ||
+                ((total + align -1) & ~(align -1)) > (size_t)-1 - size)
+        {
+            mperrno = MP_ERRNO_PARM;
+            return mperrno;
+        }
+        total = ((total + align -1) & ~(align -1)) + size;
+    }
+
+    /* One chunk for all */
+    if ((chunk = mpget_chunk(total, mpid, max_align)) == NULL)
+    {
+        return mperrno;
+    }
+
+    /* Same layout again, this time with the pointers */
+    total = 0;
+    for (i = 0; i < n; i++)
+    {
+        align = aligns == NULL || aligns[i] < MP_DEF_ALIGN ? MP_DEF_ALIGN : aligns[i];
+        total = (total + align -1) & ~(align -1);
+        out_ptrs[i] = chunk + total;
+        total += sizes[i] == 0 ? 1 : sizes[i];
+    }
+
+    /* mprealloc() can grow the last chunk as it ends where the pool ends */
+    mp_arr[mpid].last_chunk = (uchar *)out_ptrs[n -1];
+
+    return MP_ERRNO_SUCCESS;
+}
+
+/****************************************************************************
+|*
+|* Function: mpmalloc_soa
+|*
+|* Description;
+|*
+|*     Allocates from the memory pool mpid a structure of arrays: ncols 
+|*     columns of nelem elements each, the elements of the column i being of 
+|*     elem_sizes[i] bytes. The columns are laid out back to back in one piece 
+|*     of the pool and each of them starts on a boundary of MP_SOA_ALIGN bytes
+|*     (a cache line), so they can be processed with SIMD instructions. The 
+|*     pointers to the columns are written in cols.
+|*
+|* Return:
+|*     MP_ERRNO_SUCCESS on success
+|*     MP_ERRNO_* otherwise, and cols is not modified.
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+int mpmalloc_soa(int mpid, size_t ncols, size_t nelem, const size_t *elem_sizes, void **cols)
+{
+    uchar *chunk = NULL;
+    size_t total = 0;
+    size_t size = 0;
+    size_t i = 0;
+
+    if (ncols == 0 || elem_sizes == NULL || cols == NULL)
+    {
+        mperrno = MP_ERRNO_PARM;
+        return mperrno;
+    }
+
+    /* Each column rounded up to the next boundary */
+    for (i = 0; i < ncols; i++)
+    {
+        if (elem_sizes[i] != 0 && nelem > ((size_t)-1 - MP_SOA_ALIGN) / elem_sizes[i])
+        {
+            mperrno = MP_ERRNO_PARM;
+            return mperrno;
+        }
+        size = (elem_sizes[i] * nelem + MP_SOA_ALIGN -1) & ~((size_t)MP_SOA_ALIGN -1);
+        if (total > (size_t)-1 - size)
+        {
+            mperrno = MP_ERRNO_PARM;
+            return mperrno;
+        }
+        total += size;
+    }
+
+    if ((chunk = mpget_chunk(total, mpid, MP_SOA_ALIGN)) == NULL)
+    {
+        return mperrno;
+    }
+
+    total = 0;
+    for (i = 0; i < ncols; i++)
+    {
+        cols[i] = chunk + total;
+        total += (elem_sizes[i] * nelem + MP_SOA_ALIGN -1) & ~((size_t)MP_SOA_ALIGN -1);
+    }
+
+    return MP_ERRNO_SUCCESS;
+}
+
+/****************************************************************************
+|*
+|* Function: mpfree
+|*
+|* Description;
+|*
+|*     Analog to free() but it's a dummy function that doesn't do anything.
+|*     The reason is that this memory pool is a dynamic memory pool allocated
+|*     for which the single memory chunks cannot be free-ed, but only the 
+|*     whole memory pool. So the reason of this funcion is for 3rd party software 
+|*     enabling a custom memory management and on which the malloc(), realloc(),
+|*     free(), etc. can be overriden with own functions.
+|*     The memory pool is the one owning ptr (see mpowner()), or the current
+|*     one if ptr was not delivered by any pool.
+|*
+|* Return:
+|*     n/a
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20140811    JG    Initial version
+|* 20261019    JG    Route to the memory pool owning ptr
+|*
+****************************************************************************/
+void mpfree(void *ptr)
+{
+    int mpid = mpfind_owner(ptr, NULL);
+
+    mpfree_mpid(ptr, mpid >= 0 ? mpid : mp_cur_mpid);
+}
+
+/****************************************************************************
+|*
+|* Function: mpfree_mpid
+|*
+|* Description;
+|*
+|*     Analog to free() but it's a dummy function that doesn't do anything.
+|*     The reason is that this memory pool is a dynamic memory pool allocated
+|*     for which the single memory chunks cannot be free-ed, but only the 
+|*     whole memory pool. So the reason of this funcion is for 3rd party software 
+|*     enabling a custom memory management and on which the malloc(), realloc(),
+|*     free(), etc. can be overriden with own functions.
+|*     The objects of slab pools are the exception: they are given back with
+|*     mpslab_free().
+|*
+|* Return:
+|*     n/a
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20140811    JG    Initial version
+|* 20261019    JG    Give back objects of slab pools
+|*
+****************************************************************************/
+void mpfree_mpid(void *ptr, int mpid)
+{
+#ifdef MP_DEBUG
+    /* Reject pointers delivered by other memory pools or not by us at all */
+    if (ptr != NULL && mpfind_owner(ptr, NULL) != mpid)
+    {
+        mperrno = MP_ERRNO_NOWN;
+        return;
+    }
+#endif
+    /* Objects of slab pools are really given back */
+    if (mpid >= 0 && mpid < MP_MAX_MP_ID && mp_arr[mpid].type == MP_TYPE_SLAB)
+    {
+        mpslab_free(ptr, mpid);
+        return;
+    }
+#ifndef MP_VALGRIND_NOT_AVAILABLE
+    VALGRIND_MEMPOOL_FREE((void *)&mp_arr[mpid], ptr);
+#endif
+    return;
+}
+
+/****************************************************************************
+|*
+|* Function: mprealloc
+|*
+|* Description;
+|*
+|*     Analog to realloc() but allocating a piece of memory from the private 
+|*     pool owning ptr (see mpowner()). If ptr is NULL or it was not 
+|*     delivered by any pool, the current pool id (selected with mpset()) 
+|*     is used.
+|*
+|* Return:
+|*     a pointer to a block of memory of the required size within our memory
+|*     pool and with the content of ptr if available.
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20140811    JG    Initial version
+|* 20261019    JG    Route to the memory pool owning ptr
+|*
+****************************************************************************/
+void *mprealloc(void *ptr, size_t size)
+{
+    int mpid = mpfind_owner(ptr, NULL);
+
+    return mprealloc_mpid(ptr, size, mpid >= 0 ? mpid : mp_cur_mpid);
+}
+
+/****************************************************************************
+|*
+|* Function: mprealloc_mpid
+|*
+|* Description;
+|*
+|*     Analog to realloc() but allocating a piece of memory from our private 
+|*     pool on a certain pool id
+|*
+|* Return:
+|*     a pointer to a block of memory of the required size within our memory
+|*     pool and with the content of ptr if available.
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20140811    JG    Initial version
+|*
+****************************************************************************/
+void *mprealloc_mpid(void *ptr, size_t size, int mpid)
+{
+    void *chunk = NULL;
+    uintptr_t ptrdiff = 0;
+
+#ifdef MP_DEBUG
+    /* Reject pointers delivered by other memory pools or not by us at all */
+    if (ptr != NULL && mpfind_owner(ptr, NULL) != mpid)
+    {
+        mperrno = MP_ERRNO_NOWN;
+        return NULL;
+    }
+#endif
+
+    /* The last chunk delivered by the pool is resized in place */
+    if ((chunk = mpresize_last(ptr, size, mpid)) != NULL)
+    {
+        return chunk;
+    }
+
+    /* Chunks with own mapping are resized without copying */
+    if ((chunk = mpremap_chunk(ptr, size, mpid)) != NULL)
+    {
+        return chunk;
+    }
+
+    /* Allocate new chunk of memory */
+    chunk = mpget_chunk(size, mpid, MP_DEF_ALIGN);
+
+    /* Copy content of all memory chunk */
+    if (ptr != NULL && chunk != NULL)
+    {
+        /* Valgrind can yell here invalid or initiliazed read. 
+         * At this point we don't know the size of previous pointer, so 
+         * we need to copy as much as possible, therefore part of it
+         * might not be initiliazed */
+
+        /* Not to overlap */
+        ptrdiff = (uintptr_t)chunk - (uintptr_t)ptr;
+
+#ifndef MP_VALGRIND_NOT_AVAILABLE
+        VALGRIND_DISABLE_ERROR_REPORTING;
+#endif
+
+        if (ptrdiff < size)
+        {
+            memcpy(chunk, ptr, ptrdiff);
+        }
+        else
+        {
+            memcpy(chunk, ptr, size);
+        }
+
+#ifndef MP_VALGRIND_NOT_AVAILABLE
+        VALGRIND_ENABLE_ERROR_REPORTING;
+#endif
+    }
+
+    return chunk;
+}
+
+/****************************************************************************
+|*
+|* Function: mpresize_last
+|*
+|* Description;
+|*
+|*     Resizes in place the chunk ptr if it is the last chunk delivered by the
+|*     memory pool and the new size still fits in the tail block. On memory 
+|*     pools of type MP_TYPE_VM this always works while the reserved range 
+|*     is not exhausted.
+|*
+|* Return:
+|*     ptr if it was resized in place
+|*     NULL otherwise, mperrno is not set.
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+static void *mpresize_last(void *ptr, size_t size, int mpid)
+{
+    mp *curr_mp = NULL;
+    mpblock *curr_block = NULL;
+    size_t offset = 0;
+
+    if (ptr == NULL || mpid > MP_MAX_MP_ID -1 || mpid < 0)
+    {
+        return NULL;
+    }
+
+    curr_mp = &mp_arr[mpid];
+    if ((uchar *)ptr != curr_mp->last_chunk || curr_mp->tail_block == NULL)
+    {
+        return NULL;
+    }
+
+#if MP_THREAD_SAFE == 1
+    if (MP_THREAD_EQ(curr_mp->thread_id, MP_CURR_THREAD) == 0)
+    {
+        return NULL;
+    }
+#endif
+
+    size = size == 0 ? 1 : size;
+    curr_block = curr_mp->tail_block;
+    if ((uchar *)ptr < curr_block->block || (uchar *)ptr >= curr_block->block + curr_block->size)
+    {
+        /* The last chunk has its own mapping */
+        return NULL;
+    }
+    offset = (uchar *)ptr - curr_block->block;
+    if (size > curr_block->size - offset)
+    {
+        return NULL;
+    }
+
+    if (curr_mp->type == MP_TYPE_VM &&
+            mpvm_commit(mpid, MP_BLK_HDR_SZ + offset + size) != MP_ERRNO_SUCCESS)
+    {
+        return NULL;
+    }
+
+    curr_block->used = offset + size;
+    curr_block->zero = curr_block->zero > curr_block->used ? curr_block->zero : curr_block->used;
+
+#ifndef MP_VALGRIND_NOT_AVAILABLE
+    VALGRIND_MEMPOOL_CHANGE((void *)curr_mp, ptr, ptr, size);
+#endif
+
+    return ptr;
+}
+
+/****************************************************************************
+|*
+|* Function: mpremap_chunk
+|*
+|* Description;
+|*
+|*     Resizes the chunk ptr if it lives in a block of type MP_BLK_MAP. The 
+|*     mapping is grown by the system (mremap() on Linux) which moves the 
+|*     page tables instead of copying the bytes, so the peak of memory used
+|*     is not doubled during the copy.
+|*
+|* Return:
+|*     the pointer to the resized chunk, which might have been moved
+|*     NULL if ptr is not in a block of type MP_BLK_MAP or on error. 
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+static void *mpremap_chunk(void *ptr, size_t size, int mpid)
+{
+    mp *curr_mp = NULL;
+    mpblock *curr_block = NULL;
+    mpblock *new_block = NULL;
+    size_t offset = 0;
+    size_t map_size = 0;
+    size_t pgsz = mp_vm_pgsz();
+    int i = 0;
+
+    if (ptr == NULL || mpid > MP_MAX_MP_ID -1 || mpid < 0)
+    {
+        return NULL;
+    }
+
+    curr_mp = &mp_arr[mpid];
+    if (curr_mp->map_cnt <= 0 || curr_mp->type == MP_TYPE_SLAB)
+    {
+        return NULL;
+    }
+
+#if MP_THREAD_SAFE == 1
+    if (MP_THREAD_EQ(curr_mp->thread_id, MP_CURR_THREAD) == 0)
+    {
+        return NULL;
+    }
+#endif
+
+    /* Find the block holding the chunk and its slot, big chunks are usually recent */
+    if (mpfind_owner(ptr, &curr_block) != mpid || curr_block->type != MP_BLK_MAP)
+    {
+        return NULL;
+    }
+    for (i = curr_mp->block_cnt -1; i >= 0 && curr_mp->blocks[i] != curr_block; i--);
+    if (i < 0)
+    {
+        return NULL;
+    }
+
+    size = size == 0 ? 1 : size;
+    offset = (uchar *)ptr - curr_block->block;
+
+    /* Still fits in the mapping */
+    if (size <= curr_block->size - offset)
+    {
+        curr_block->used = offset + size;
+        curr_block->zero = curr_block->zero > curr_block->used ? curr_block->zero : curr_block->used;
+        return ptr;
+    }
+
+    if (size > ((size_t)-1) - MP_BLK_HDR_SZ - offset - pgsz)
+    {
+        return NULL;
+    }
+    map_size = (MP_BLK_HDR_SZ + offset + size + pgsz -1) & ~(pgsz -1);
+
+    if (mpadd_tot_phy_mem(map_size - MP_BLK_HDR_SZ - curr_block->size, +1) != MP_ERRNO_SUCCESS)
+    {
+        return NULL;
+    }
+
+    /* The range is moved in the ownership index while no other pool can take the old addresses */
+    if (mplock() != MP_ERRNO_SUCCESS)
+    {
+        mpadd_tot_phy_mem(map_size - MP_BLK_HDR_SZ - curr_block->size, -1);
+        return NULL;
+    }
+    mprng_del(curr_block);
+    new_block = (mpblock *)mp_vm_remap(curr_block, MP_BLK_HDR_SZ + curr_block->size, map_size);
+    if (new_block == NULL)
+    {
+        mprng_add(mpid, curr_block); /* Slot just freed, it cannot fail */
+        mpunlock();
+        mpadd_tot_phy_mem(map_size - MP_BLK_HDR_SZ - curr_block->size, -1);
+        return NULL;
+    }
+
+    new_block->block = (uchar *)new_block + MP_BLK_HDR_SZ;
+    new_block->size = map_size - MP_BLK_HDR_SZ;
+    new_block->used = offset + size;
+    new_block->zero = new_block->zero > new_block->used ? new_block->zero : new_block->used;
+    mprng_add(mpid, new_block);
+    mpunlock();
+    curr_mp->blocks[i] = new_block;
+    if (curr_mp->last_chunk == (uchar *)ptr)
+    {
+        curr_mp->last_chunk = new_block->block + offset;
+    }
+
+#ifndef MP_VALGRIND_NOT_AVAILABLE
+    VALGRIND_MEMPOOL_CHANGE((void *)curr_mp, ptr, new_block->block + offset, size);
+#endif
+
+    return new_block->block + offset;
+}
+
+/****************************************************************************
+|*
+|* Function: mpowner
+|*
+|* Description;
+|*
+|*     Finds the memory pool owning the chunk ptr. All blocks of all memory
+|*     pools are registered in an index of address ranges, so the lookup is
+|*     a binary search and does not depend on the number of pools.
+|*
+|* Return:
+|*     the memory pool ID owning ptr if success
+|*     MP_ERRNO_PARM, MP_ERRNO_NOWN if error
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+int mpowner(void *ptr)
+{
+    int mpid = MP_NO_MP_ID;
+
+    mperrno = MP_ERRNO_SUCCESS;
+
+    if (ptr == NULL)
+    {
+        mperrno = MP_ERRNO_PARM;
+        return MP_ERRNO_PARM;
+    }
+
+    if ((mpid = mpfind_owner(ptr, NULL)) < 0)
+    {
+        mperrno = MP_ERRNO_NOWN;
+        return MP_ERRNO_NOWN;
+    }
+
+    return mpid;
+}
+
+/****************************************************************************
+|*
+|* Function: mpstrdup
+|*
+|* Description;
+|*
+|*     Returns a pointer to a new string that is a duplicate of s1.
+|*
+|* Return:
+|*     a pointer to duplicated string.
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20140811    JG    Initial version
+|*
+****************************************************************************/
+char *mpstrdup(const char *s1)
+{
+    return mpstrdup_mpid(s1, mp_cur_mpid);
+}
+
+/****************************************************************************
+|*
+|* Function: mpstrdup_mpid
+|*
+|* Description;
+|*
+|*     Returns a pointer to a new string that is a duplicate of s1.
+|*
+|* Return:
+|*     a pointer to duplicated string or NULL if s1 is NULL.
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20140811    JG    Initial version
+|*
+****************************************************************************/
+char *mpstrdup_mpid(const char *s1, int mpid)
+{
+    char *str = NULL;
+    size_t str_len = 0;
+
+    /* Check parameters */
+    if (s1 == NULL)
+    {
+        return NULL;
+    }
+
+    str_len = strlen(s1) +1;
+    /* Allocate memory for new string */
+    str =  (char *)mpmalloc_mpid(str_len, mpid);
+
+    /* Duplicate string in allocated memory */
+    if (str != NULL)
+    {
+        strncpy(str, s1, str_len);
+    }
+
+    return str;
+}
+
+/****************************************************************************
+|*
+|* Function: mpintern
+|*
+|* Description;
+|*
+|*     Returns the canonical copy in the memory pool mpid of the len bytes 
+|*     of s, adding it the first time. Equal strings interned in the same
+|*     pool get the same pointer, so they can be compared as pointers and 
+|*     they are stored once. The copy is null terminated and must not be 
+|*     modified. The table is a hash set with open addressing which lives,
+|*     as the strings, in the pool: mpclr() and mpdel() empty it.
+|*
+|* Return:
+|*     a pointer to the interned string
+|*     NULL if error
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+const char *mpintern(int mpid, const char *s, size_t len)
+{
+    mp *curr_mp = NULL;
+    mpistr *tbl = NULL;
+    char *str = NULL;
+    unsigned int hash = 2166136261u;
+    size_t i = 0;
+    size_t j = 0;
+
+    mperrno = MP_ERRNO_SUCCESS;
+
+    /* Check parameters */
+    if (s == NULL)
+    {
+        mperrno = MP_ERRNO_PARM;
+        return NULL;
+    }
+
+    if (mpid > MP_MAX_MP_ID -1 || mpid < 0)
+    {
+        mperrno = MP_ERRNO_MPID;
+        return NULL;
+    }
+
+    curr_mp = &mp_arr[mpid];
+#if MP_THREAD_SAFE == 1
+    /* Check thread ID */
+    if (curr_mp->init == 'Y' && MP_THREAD_EQ(curr_mp->thread_id, MP_CURR_THREAD) == 0)
+    {
+        mperrno = MP_ERRNO_THRD;
+        return NULL;
+    }
+#endif
+
+    /* FNV-1a */
+    for (i = 0; i < len; i++)
+    {
+        hash = (hash ^ (uchar)s[i]) * 16777619u;
+    }
+
+    /* Look for the string */
+    if (curr_mp->intern_tbl != NULL)
+    {
+        for (i = hash & (curr_mp->intern_max -1); curr_mp->intern_tbl[i].str != NULL; i = (i +1) & (curr_mp->intern_max -1))
+        {
+            if (curr_mp->intern_tbl[i].hash == hash && curr_mp->intern_tbl[i].len == len &&
+                    memcmp(curr_mp->intern_tbl[i].str, s, len) == 0)
+            {
+                return curr_mp->intern_tbl[i].str;
+            }
+        }
+    }
+
+    /* Keep the table at most 3/4 full, the previous one is left in the pool */
+    if ((curr_mp->intern_cnt +1) * 4 > curr_mp->intern_max * 3)
+    {
+        size_t intern_max = curr_mp->intern_max == 0 ? MP_DEF_INTERN_SZ : curr_mp->intern_max * 2;
+
+        if ((tbl = (mpistr *)mpcalloc_mpid(intern_max, sizeof(mpistr), mpid)) == NULL)
+        {
+            return NULL;
+        }
+
+        for (j = 0; j < curr_mp->intern_max; j++)
+        {
+            if (curr_mp->intern_tbl[j].str == NULL)
+            {
+                continue;
+            }
+            for (i = curr_mp->intern_tbl[j].hash & (intern_max -1); tbl[i].str != NULL; i = (i +1) & (intern_max -1));
+            tbl[i] = curr_mp->intern_tbl[j];
+        }
+
+        curr_mp->intern_tbl = tbl;
+        curr_mp->intern_max = intern_max;
+        for (i = hash & (intern_max -1); tbl[i].str != NULL; i = (i +1) & (intern_max -1));
+    }
+
+    /* Add the string */
+    if ((str = (char *)mpmalloc_mpid(len +1, mpid)) == NULL)
+    {
+        return NULL;
+    }
+    memcpy(str, s, len);
+    str[len] = '\0';
+
+    curr_mp->intern_tbl[i].str = str;
+    curr_mp->intern_tbl[i].len = len;
+    curr_mp->intern_tbl[i].hash = hash;
+    curr_mp->intern_cnt++;
+
+    return str;
+}
+
+/****************************************************************************
+|*
+|* Function: mpasprintf
+|*
+|* Description;
+|*
+|*     anolog to sprintf() except that allocates a string large enough to hold
+|*     the output. Same functionality of asprintf().
+|*
+|* Return:
+|*     The number of bytes allocated on success
+|*     -1 on error and the content of strp is undefined on error.
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20140815    JG    Initial version
+|* 20261019    JG    Formatting moved to mpvasprintf_mpid()
+|*
+****************************************************************************/
+int mpasprintf(char **strp, const char *fmt, ...)
+{
+    int rc = 0;
+    va_list ap;
+
+    va_start(ap, fmt);
+    rc = mpvasprintf_mpid(strp, mp_cur_mpid, fmt, ap);
+    va_end(ap);
+
+    return rc;
+}
+
+/****************************************************************************
+|*
+|* Function: mpasprintf_mpid
+|*
+|* Description;
+|*
+|*     anolog to sprintf() except that allocates a string large enough to hold
+|*     the output.
+|*
+|* Return:
+|*     The number of bytes allocated on success
+|*     -1 on error and the content of strp is undefined on error.
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20140815    JG    Initial version
+|* 20261019    JG    Formatting moved to mpvasprintf_mpid()
+|*
+****************************************************************************/
+int mpasprintf_mpid(char **strp, int mpid, const char *fmt, ...)
+{
+    int rc = 0;
+    va_list ap;
+
+    va_start(ap, fmt);
+    rc = mpvasprintf_mpid(strp, mpid, fmt, ap);
+    va_end(ap);
+
+    return rc;
+}
+
+/****************************************************************************
+|*
+|* Function: mpvasprintf
+|*
+|* Description;
+|*
+|*     Same as mpasprintf() but with a va_list instead of a variable number
+|*     of arguments. Same functionality of vasprintf().
+|*
+|* Return:
+|*     The number of bytes allocated on success
+|*     -1 on error and the content of strp is undefined on error.
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+int mpvasprintf(char **strp, const char *fmt, va_list ap)
+{
+    return mpvasprintf_mpid(strp, mp_cur_mpid, fmt, ap);
+}
+
+/****************************************************************************
+|*
+|* Function: mpvasprintf_mpid
+|*
+|* Description;
+|*
+|*     Same as mpasprintf_mpid() but with a va_list instead of a variable 
+|*     number of arguments. The string is formatted straight into the free 
+|*     space of the tail block and only the bytes used are then taken from 
+|*     the block, so the format is processed once. Only when the output does 
+|*     not fit there, it is formatted a second time into a new chunk.
+|*
+|* Return:
+|*     The number of bytes allocated on success
+|*     -1 on error and the content of strp is undefined on error.
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+int mpvasprintf_mpid(char **strp, int mpid, const char *fmt, va_list ap)
+{
+    int len = -1;
+    uchar *dst = NULL;
+    size_t avail = 0;
+    mpblock *curr_block = NULL;
+    va_list aq;
+
+    /* Check parameters */
+    if (fmt == NULL || strp == NULL)
+    {
+        mperrno = MP_ERRNO_PARM;
+        return -1;
+    }
+
+    /* Free space of the tail block, errors on the pool are left to mpget_chunk() */
+    if (mpid >= 0 && mpid < MP_MAX_MP_ID && (curr_block = mp_arr[mpid].tail_block) != NULL
+#if MP_THREAD_SAFE == 1
+            && MP_THREAD_EQ(mp_arr[mpid].thread_id, MP_CURR_THREAD) != 0
+#endif
+       )
+    {
+        size_t end = curr_block->size;
+        size_t used = (curr_block->used + MP_DEF_ALIGN -1) & ~((size_t)MP_DEF_ALIGN -1);
+
+        /* Only the committed pages of a reserved range can be written */
+        if (mp_arr[mpid].type == MP_TYPE_VM)
+        {
+            end = mp_arr[mpid].vm_commit - MP_BLK_HDR_SZ;
+        }
+        if (((uintptr_t)curr_block->block % MP_DEF_ALIGN) == 0 && used < end)
+        {
+            dst = curr_block->block + used;
+            avail = end - used;
+        }
+    }
+
+    if (dst != NULL)
+    {
+#ifndef MP_VALGRIND_NOT_AVAILABLE
+        VALGRIND_MAKE_MEM_UNDEFINED(dst, avail);
+#endif
+        va_copy(aq, ap);
+        len = vsnprintf((char *)dst, avail, fmt, aq);
+        va_end(aq);
+
+        /* The bytes written are not zero anymore */
+        if (len >= 0)
+        {
+            size_t written = (size_t)len +1 < avail ? (size_t)len +1 : avail;
+
+            if (curr_block->zero < (size_t)(dst - curr_block->block) + written)
+            {
+                curr_block->zero = (size_t)(dst - curr_block->block) + written;
+            }
+        }
+
+        /* Fits: take from the block exactly the bytes written */
+        if (len >= 0 && (size_t)len +1 < avail)
+        {
+            if ((*strp = (char *)mpget_chunk(len +1, mpid, MP_DEF_ALIGN)) == NULL)
+            {
+                return -1;
+            }
+            if (*strp != (char *)dst)
+            {
+                memcpy(*strp, dst, len +1);
+            }
+#ifndef MP_VALGRIND_NOT_AVAILABLE
+            VALGRIND_MAKE_MEM_DEFINED(*strp, len +1);
+#endif
+            return len;
+        }
+#ifndef MP_VALGRIND_NOT_AVAILABLE
+        VALGRIND_MAKE_MEM_NOACCESS(dst, avail);
+#endif
+    }
+
+    /* Find out actual length of the built string */
+    if (len < 0)
+    {
+        va_copy(aq, ap);
+#ifdef _WIN32
+        len = _vscprintf(fmt, aq);
+#else
+        len = vsnprintf(NULL, 0, fmt, aq);
+#endif
+        va_end(aq);
+    }
+    if (len < 0)
+    {
+        mperrno = MP_ERRNO_PARM;
+        return -1;
+    }
+
+    /* Deliver string */
+    if ((*strp = (char *)mpget_chunk(len +1, mpid, MP_DEF_ALIGN)) == NULL)
+    {
+        return -1;
+    }
+
+    return vsnprintf(*strp, len +1, fmt, ap);
+}
+
+/****************************************************************************
+|*
+|* Function: mpnew
+|*
+|* Description;
+|*
+|*     Initializes the next memory pool available in the array of memory pools 
+|*     and assignes the corresponding description
+|*
+|* Return:
+|*     the memory pool ID of the new allocated memory pool    
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20140811    JG    Initial version
+|*
+****************************************************************************/
+int mpnew(char *descr)
+{
+    int i = 0, mpid = MP_ERRNO_EXMP;
+    char *curr_descr = NULL;
+    mperrno = MP_ERRNO_SUCCESS;
+
+    /* Check parameter */
+    if (descr == NULL)
+    {
+        curr_descr = "-";
+    }
+    else
+    {
+        curr_descr = descr;
+    }
+
+#if MP_THREAD_SAFE == 1 /* { */
+
+#   if _WIN32 /* { */
+    if ((mperrno = mp_mutex_init(&mp_mutex_p)) != MP_ERRNO_SUCCESS)
+    {
+        return mperrno;
+    }
+#   endif /* } _WIN32 */
 
     MP_MUTEX_LOCK(mp_mutex_p); /* No UT but checked with helgrind */
 #endif /* } MP_THREAD_SAFE */
-    /* Find next available memory pool */
-    for(i = 0; i < MP_MAX_MP_ID; i++)
+    /* Find next available memory pool */
+    for(i = 0; i < MP_MAX_MP_ID; i++)
+    {
+        if (mp_arr[i].init != 'Y')
+        {
+            if (i == MP_DEF_MP_ID)
+            { 
+                continue;
+            }
+            mp_arr[i].init = 'Y';
+            strncpy(mp_arr[i].descr, curr_descr, sizeof(mp_arr[i].descr));
+            mp_arr[i].descr[sizeof(mp_arr[i].descr) -1] = '\0';
+#if MP_THREAD_SAFE == 1
+            mp_arr[i].thread_id = MP_CURR_THREAD;
+#endif
+            mp_arr[i].blocks = NULL;
+            mp_arr[i].block_cnt = 0;
+            mp_arr[i].block_max = 0;
+            mp_arr[i].map_cnt = 0;
+            mp_arr[i].tail_block = NULL;
+            mp_arr[i].next_blk = 0;
+            mp_arr[i].last_chunk = NULL;
+            mp_arr[i].type = MP_TYPE_BLK;
+            mp_arr[i].vm_commit = 0;
+            mp_arr[i].last_dirty = 0;
+            mp_arr[i].intern_tbl = NULL;
+            mp_arr[i].intern_cnt = 0;
+            mp_arr[i].intern_max = 0;
+            mp_arr[i].slab_sz = 0;
+            mp_arr[i].slab_free = NULL;
+            mp_arr[i].slab_free_cnt = 0;
+            mp_arr[i].slab_remote = NULL;
+            mp_arr[i].aln_cnt = 0;
+            mp_arr[i].numa_policy = MP_NUMA_NONE;
+            mp_arr[i].numa_node = 0;
+            mp_arr[i].cleanups = NULL;
+            mp_arr[i].clr_policy = MP_CLR_RESET;
+            mp_arr[i].trim_clr = FALSE;
+            mp_arr[i].trim_keep = MP_NO_TRIM;
+            memset(&mp_arr[i].upstream, 0x00, sizeof(mp_arr[i].upstream));
+            memset(mp_arr[i].aln_block, 0x00, sizeof(mp_arr[i].aln_block));
+            mpid = i;
+
+#ifndef MP_VALGRIND_NOT_AVAILABLE
+            VALGRIND_CREATE_MEMPOOL((void *)&mp_arr[mpid], 0, 1);
+#endif
+            break;
+        }
+    }
+#if MP_THREAD_SAFE == 1
+    MP_MUTEX_UNLOCK(mp_mutex_p);
+#endif
+
+    mperrno = mpid == MP_ERRNO_EXMP ? MP_ERRNO_EXMP : mperrno;
+    return mpid;
+}
+
+/****************************************************************************
+|*
+|* Function: mpnew_vm
+|*
+|* Description;
+|*
+|*     Initializes the next memory pool available as a pool of type 
+|*     MP_TYPE_VM: one contiguous range of size bytes of virtual memory is 
+|*     reserved up front (the default size when size is 0) and its pages are
+|*     committed as the allocations advance. The pool has a single block, so
+|*     no memory is lost at the end of blocks and the last allocation can 
+|*     always grow in place with mprealloc().
+|*
+|* Return:
+|*     the memory pool ID of the new allocated memory pool    
+|*     MP_ERRNO_EXMP, MP_ERRNO_ALLO, MP_ERRNO_EXMM, MP_ERRNO_SYSE if error
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+int mpnew_vm(char *descr, size_t size)
+{
+    int mpid = MP_ERRNO_EXMP;
+    int rc = MP_ERRNO_SUCCESS;
+    size_t pgsz = mp_vm_pgsz();
+    uchar *base = NULL;
+    mpblock *vm_block = NULL;
+
+    /* Reserved size in whole pages */
+    if (size == 0)
+    {
+        size = sizeof(size_t) > 4 ? MP_DEF_VM_SZ_64 : MP_DEF_VM_SZ_32;
+    }
+    if (size > ((size_t)-1) - pgsz)
+    {
+        mperrno = MP_ERRNO_PARM;
+        return MP_ERRNO_PARM;
+    }
+    size = (size + MP_BLK_HDR_SZ + pgsz -1) & ~(pgsz -1);
+
+    if ((mpid = mpnew(descr)) < 0)
+    {
+        return mpid;
+    }
+
+    /* Reserve the range and commit the first page, holding the header */
+    if ((base = (uchar *)mp_vm_reserve(size)) == NULL)
+    {
+        mpdel(mpid);
+        mperrno = MP_ERRNO_ALLO;
+        return MP_ERRNO_ALLO;
+    }
+
+    if ((rc = mpadd_tot_phy_mem(pgsz, +1)) != MP_ERRNO_SUCCESS)
+    {
+        mp_vm_release(base, size);
+        mpdel(mpid);
+        mperrno = rc;
+        return rc;
+    }
+
+    if (mp_vm_commit(base, pgsz) != MP_ERRNO_SUCCESS)
+    {
+        mpadd_tot_phy_mem(pgsz, -1);
+        mp_vm_release(base, size);
+        mpdel(mpid);
+        mperrno = MP_ERRNO_SYSE;
+        return MP_ERRNO_SYSE;
+    }
+
+    vm_block = (mpblock *)base;
+    vm_block->type = MP_BLK_HEAP;
+    vm_block->numa = FALSE;
+    vm_block->block = base + MP_BLK_HDR_SZ;
+    vm_block->size = size - MP_BLK_HDR_SZ;
+    vm_block->used = 0;
+    vm_block->zero = 0;
+
+    if ((rc = mpattach_block(mpid, vm_block)) != MP_ERRNO_SUCCESS)
+    {
+        mpadd_tot_phy_mem(pgsz, -1);
+        mp_vm_release(base, size);
+        mpdel(mpid);
+        mperrno = rc;
+        return rc;
+    }
+    mp_arr[mpid].type = MP_TYPE_VM;
+    mp_arr[mpid].vm_commit = pgsz;
+
+#ifndef MP_VALGRIND_NOT_AVAILABLE
+    VALGRIND_MAKE_MEM_NOACCESS(vm_block->block, pgsz - MP_BLK_HDR_SZ);
+#endif
+
+    mperrno = MP_ERRNO_SUCCESS;
+    return mpid;
+}
+
+/****************************************************************************
+|*
+|* Function: mpnew_buf
+|*
+|* Description;
+|*
+|*     Initializes the next memory pool available on the buffer buf of len
+|*     bytes given by the caller (a stack buffer, a static area, etc.). The 
+|*     chunks are taken from the buffer first and from blocks of the heap 
+|*     when it is full. mpclr() gives these blocks back and makes the pool 
+|*     start again on the buffer, which is never given back by the library:
+|*     it must outlive the memory pool and is not counted in the memory 
+|*     limit. Its header is placed at the start of the buffer.
+|*
+|* Return:
+|*     the memory pool ID of the new allocated memory pool    
+|*     MP_ERRNO_PARM, MP_ERRNO_EXMP, MP_ERRNO_ALLO if error
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+int mpnew_buf(char *descr, void *buf, size_t len)
+{
+    int mpid = MP_ERRNO_EXMP;
+    int rc = MP_ERRNO_SUCCESS;
+    size_t pad = 0;
+    mpblock *buf_block = NULL;
+
+    mperrno = MP_ERRNO_SUCCESS;
+
+    /* Room for the header, aligned, and at least one chunk */
+    if (buf != NULL)
+    {
+        pad = (MP_DEF_ALIGN - (uintptr_t)buf % MP_DEF_ALIGN) % MP_DEF_ALIGN;
+    }
+    if (buf == NULL || len < pad + MP_BLK_HDR_SZ + MP_DEF_ALIGN)
+    {
+        mperrno = MP_ERRNO_PARM;
+        return MP_ERRNO_PARM;
+    }
+
+    if ((mpid = mpnew(descr)) < 0)
+    {
+        return mpid;
+    }
+
+    buf_block = (mpblock *)((uchar *)buf + pad);
+    buf_block->type = MP_BLK_BUF;
+    buf_block->numa = FALSE;
+    buf_block->block = (uchar *)buf_block + MP_BLK_HDR_SZ;
+    buf_block->size = len - pad - MP_BLK_HDR_SZ;
+    buf_block->used = 0;
+    buf_block->zero = buf_block->size; /* Nothing known about its content */
+
+    if ((rc = mpattach_block(mpid, buf_block)) != MP_ERRNO_SUCCESS)
+    {
+        mpdel(mpid);
+        mperrno = rc;
+        return rc;
+    }
+
+#ifndef MP_VALGRIND_NOT_AVAILABLE
+    VALGRIND_MAKE_MEM_NOACCESS(buf_block->block, buf_block->size);
+#endif
+
+    mperrno = MP_ERRNO_SUCCESS;
+    return mpid;
+}
+
+/****************************************************************************
+|*
+|* Function: mpnew_slab
+|*
+|* Description;
+|*
+|*     Creates/initializes a new memory pool as mpnew() does, but holding 
+|*     only objects of size bytes, delivered by mpslab_alloc(). The objects
+|*     are packed one after the other in the blocks of the pool and the 
+|*     free ones are linked through their first bytes, so they can be given
+|*     back one by one with mpslab_free() and reused.
+|*
+|* Return:
+|*     the memory pool ID of the new allocated memory pool    
+|*     MP_ERRNO_PARM, MP_ERRNO_EXMP if error
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+int mpnew_slab(char *descr, size_t size)
+{
+    int mpid = MP_ERRNO_EXMP;
+
+    /* Objects are aligned and big enough to link them when free */
+    if (size == 0 || size > ((size_t)-1) - MP_DEF_ALIGN)
+    {
+        mperrno = MP_ERRNO_PARM;
+        return MP_ERRNO_PARM;
+    }
+    size = (size + MP_DEF_ALIGN -1) & ~((size_t)MP_DEF_ALIGN -1);
+    size = size < sizeof(void *) ? sizeof(void *) : size;
+
+    if ((mpid = mpnew(descr)) < 0)
+    {
+        return mpid;
+    }
+
+    mp_arr[mpid].type = MP_TYPE_SLAB;
+    mp_arr[mpid].slab_sz = size;
+
+    return mpid;
+}
+
+/****************************************************************************
+|*
+|* Function: mpslab_alloc
+|*
+|* Description;
+|*
+|*     Delivers an object from the slab pool mpid: the first one of the free
+|*     list or else the next one of the tail block. When the free list is 
+|*     empty, the objects given back by other threads are moved to it first.
+|*     Only the thread owning the pool can call it, checked before any of 
+|*     the paths.
+|*
+|* Return:
+|*     a pointer to the object, not initialized
+|*     NULL if error
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|* 20261019    JG    Thread ID checked for all paths
+|*
+****************************************************************************/
+void *mpslab_alloc(int mpid)
+{
+    mp *curr_mp = NULL;
+    mpblock *curr_block = NULL;
+    void *obj = NULL;
+
+    if (mpid > MP_MAX_MP_ID -1 || mpid < 0 || mp_arr[mpid].type != MP_TYPE_SLAB)
+    {
+        mperrno = mpid > MP_MAX_MP_ID -1 || mpid < 0 ? MP_ERRNO_MPID : MP_ERRNO_PARM;
+        return NULL;
+    }
+    curr_mp = &mp_arr[mpid];
+
+#if MP_THREAD_SAFE == 1
+    /* Check thread ID */
+    if (MP_THREAD_EQ(curr_mp->thread_id, MP_CURR_THREAD) == 0)
+    {
+        mperrno = MP_ERRNO_THRD;
+        return NULL;
+    }
+#endif
+
+    /* Reuse a free object, taking first those given back by other threads if needed */
+    if ((obj = curr_mp->slab_free) != NULL ||
+            (curr_mp->slab_remote != NULL && mpslab_drain(mpid) > 0 && (obj = curr_mp->slab_free) != NULL))
+    {
+#ifndef MP_VALGRIND_NOT_AVAILABLE
+        VALGRIND_MAKE_MEM_DEFINED(obj, sizeof(void *));
+#endif
+        curr_mp->slab_free = *(void **)obj;
+        curr_mp->slab_free_cnt--;
+#ifndef MP_VALGRIND_NOT_AVAILABLE
+        VALGRIND_MEMPOOL_ALLOC((void *)curr_mp, obj, curr_mp->slab_sz);
+#endif
+        return obj;
+    }
+
+    /* Next object of the tail block */
+    if ((curr_block = curr_mp->tail_block) != NULL && curr_block->size - curr_block->used >= curr_mp->slab_sz)
+    {
+        obj = curr_block->block + curr_block->used;
+        curr_block->used += curr_mp->slab_sz;
+        curr_block->zero = curr_block->zero > curr_block->used ? curr_block->zero : curr_block->used;
+#ifndef MP_VALGRIND_NOT_AVAILABLE
+        VALGRIND_MEMPOOL_ALLOC((void *)curr_mp, obj, curr_mp->slab_sz);
+#endif
+        return obj;
+    }
+
+    return mpslab_refill(mpid);
+}
+
+/****************************************************************************
+|*
+|* Function: mpslab_refill
+|*
+|* Description;
+|*
+|*     Adds a new block to the slab pool mpid and delivers its first object.
+|*     The thread ID is checked by mpslab_alloc().
+|*
+|* Return:
+|*     a pointer to the object, not initialized
+|*     NULL if error
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|* 20261019    JG    Thread ID check moved to mpslab_alloc()
+|*
+****************************************************************************/
+static void *mpslab_refill(int mpid)
+{
+    void *obj = NULL;
+
+    mperrno = MP_ERRNO_SUCCESS;
+
+    obj = mpadd_block(mp_arr[mpid].slab_sz, mpid, MP_DEF_ALIGN);
+
+#ifndef MP_VALGRIND_NOT_AVAILABLE
+    if (obj != NULL)
+    {
+        VALGRIND_MEMPOOL_ALLOC((void *)&mp_arr[mpid], obj, mp_arr[mpid].slab_sz);
+    }
+#endif
+
+    return obj;
+}
+
+/****************************************************************************
+|*
+|* Function: mpslab_free
+|*
+|* Description;
+|*
+|*     Gives back the object ptr to the slab pool mpid, at the head of its 
+|*     free list, to be delivered again by mpslab_alloc(). Any thread can 
+|*     give back objects: those not owning the pool push them, without 
+|*     locks, on a stack that the owner drains when its free list is empty.
+|*
+|* Return:
+|*     n/a
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+void mpslab_free(void *ptr, int mpid)
+{
+    mp *curr_mp = NULL;
+
+    if (ptr == NULL)
+    {
+        return;
+    }
+    if (mpid > MP_MAX_MP_ID -1 || mpid < 0 || mp_arr[mpid].type != MP_TYPE_SLAB)
+    {
+        mperrno = mpid > MP_MAX_MP_ID -1 || mpid < 0 ? MP_ERRNO_MPID : MP_ERRNO_PARM;
+        return;
+    }
+#ifdef MP_DEBUG
+    /* Reject pointers delivered by other memory pools or not by us at all */
+    if (mpfind_owner(ptr, NULL) != mpid)
+    {
+        mperrno = MP_ERRNO_NOWN;
+        return;
+    }
+#endif
+    curr_mp = &mp_arr[mpid];
+
+#if MP_THREAD_SAFE == 1
+    /* Other threads push the object on the lock-free stack of the owner */
+    if (MP_THREAD_EQ(curr_mp->thread_id, MP_CURR_THREAD) == 0)
+    {
+        void *head = NULL;
+
+        do
+        {
+            head = curr_mp->slab_remote;
+            *(void **)ptr = head;
+        } while (!MP_ATOMIC_CAS_PTR(&curr_mp->slab_remote, head, ptr));
+
+#ifndef MP_VALGRIND_NOT_AVAILABLE
+        VALGRIND_MEMPOOL_FREE((void *)curr_mp, ptr);
+#endif
+        return;
+    }
+#endif
+
+    *(void **)ptr = curr_mp->slab_free;
+    curr_mp->slab_free = ptr;
+    curr_mp->slab_free_cnt++;
+
+#ifndef MP_VALGRIND_NOT_AVAILABLE
+    VALGRIND_MEMPOOL_FREE((void *)curr_mp, ptr);
+#endif
+}
+
+/****************************************************************************
+|*
+|* Function: mpslab_drain
+|*
+|* Description;
+|*
+|*     Moves at once all objects given back by other threads to the slab 
+|*     pool mpid to the head of its free list. Only the thread owning the 
+|*     pool takes from the stack, so a single exchange is enough.
+|*
+|* Return:
+|*     the number of objects moved
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+static size_t mpslab_drain(int mpid)
+{
+    mp *curr_mp = &mp_arr[mpid];
+    void *head = MP_ATOMIC_XCHG_PTR(&curr_mp->slab_remote, NULL);
+    void *tail = head;
+    size_t cnt = 0;
+
+    if (head == NULL)
+    {
+        return 0;
+    }
+
+#ifndef MP_VALGRIND_NOT_AVAILABLE
+    VALGRIND_DISABLE_ERROR_REPORTING;
+#endif
+    for (cnt = 1; *(void **)tail != NULL; cnt++)
+    {
+        tail = *(void **)tail;
+    }
+    *(void **)tail = curr_mp->slab_free;
+#ifndef MP_VALGRIND_NOT_AVAILABLE
+    VALGRIND_ENABLE_ERROR_REPORTING;
+#endif
+
+    curr_mp->slab_free = head;
+    curr_mp->slab_free_cnt += cnt;
+
+    return cnt;
+}
+
+/****************************************************************************
+|*
+|* Function: mpslab_foreach
+|*
+|* Description;
+|*
+|*     Calls fn(ptr, arg) for every live object of the slab pool mpid, 
+|*     block after block and in order of address within each block. The 
+|*     sweep stops when fn returns non zero. fn may give back with 
+|*     mpslab_free() the object it gets, but it must not allocate from the 
+|*     pool.
+|*
+|* Return:
+|*     the number of objects passed to fn if success
+|*     MP_ERRNO_MPID, MP_ERRNO_PARM, MP_ERRNO_THRD, MP_ERRNO_ALLO if error
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+int mpslab_foreach(int mpid, int (*fn)(void *ptr, void *arg), void *arg)
+{
+    mp *curr_mp = NULL;
+    void **free_arr = NULL;
+    void *obj = NULL;
+    size_t free_cnt = 0;
+    size_t offset = 0;
+    int cnt = 0;
+    int i = 0;
+
+    mperrno = MP_ERRNO_SUCCESS;
+
+    /* Check parameters */
+    if (mpid > MP_MAX_MP_ID -1 || mpid < 0)
+    {
+        mperrno = MP_ERRNO_MPID;
+        return MP_ERRNO_MPID;
+    }
+    if (fn == NULL || mp_arr[mpid].type != MP_TYPE_SLAB)
+    {
+        mperrno = MP_ERRNO_PARM;
+        return MP_ERRNO_PARM;
+    }
+    curr_mp = &mp_arr[mpid];
+
+#if MP_THREAD_SAFE == 1
+    /* Check thread ID */
+    if (MP_THREAD_EQ(curr_mp->thread_id, MP_CURR_THREAD) == 0)
+    {
+        mperrno = MP_ERRNO_THRD;
+        return MP_ERRNO_THRD;
+    }
+#endif
+
+    /* Free objects sorted by address, to skip them */
+    if (curr_mp->slab_remote != NULL)
+    {
+        mpslab_drain(mpid);
+    }
+    if (curr_mp->slab_free_cnt > 0)
+    {
+        if ((free_arr = (void **)MP_SYS_MALLOC(curr_mp->slab_free_cnt * sizeof(void *))) == NULL)
+        {
+            mperrno = MP_ERRNO_ALLO;
+            return MP_ERRNO_ALLO;
+        }
+#ifndef MP_VALGRIND_NOT_AVAILABLE
+        VALGRIND_DISABLE_ERROR_REPORTING;
+#endif
+        for (obj = curr_mp->slab_free; obj != NULL && free_cnt < curr_mp->slab_free_cnt; obj = *(void **)obj)
+        {
+            free_arr[free_cnt++] = obj;
+        }
+#ifndef MP_VALGRIND_NOT_AVAILABLE
+        VALGRIND_ENABLE_ERROR_REPORTING;
+#endif
+        qsort(free_arr, free_cnt, sizeof(void *), mpslab_cmp);
+    }
+
+    for (i = 0; i < curr_mp->block_cnt; i++)
+    {
+        mpblock *curr_block = curr_mp->blocks[i];
+
+        /* Objects start at the first aligned address of the block */
+        offset = (MP_DEF_ALIGN - (uintptr_t)curr_block->block % MP_DEF_ALIGN) % MP_DEF_ALIGN;
+        for (; offset + curr_mp->slab_sz <= curr_block->used; offset += curr_mp->slab_sz)
+        {
+            obj = curr_block->block + offset;
+            if (free_cnt > 0 && bsearch(&obj, free_arr, free_cnt, sizeof(void *), mpslab_cmp) != NULL)
+            {
+                continue;
+            }
+
+            cnt++;
+            if (fn(obj, arg) != 0)
+            {
+                MP_SYS_FREE(free_arr);
+                return cnt;
+            }
+        }
+    }
+
+    MP_SYS_FREE(free_arr);
+
+    return cnt;
+}
+
+/****************************************************************************
+|*
+|* Function: mpslab_cmp
+|*
+|* Description;
+|*
+|*     Compares two object pointers by address, for qsort() and bsearch().
+|*
+|* Return:
+|*     <0, 0, >0 as strcmp()
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+static int mpslab_cmp(const void *a, const void *b)
+{
+    uintptr_t ptr_a = (uintptr_t)*(void * const *)a;
+    uintptr_t ptr_b = (uintptr_t)*(void * const *)b;
+
+    return (ptr_a > ptr_b) - (ptr_a < ptr_b);
+}
+
+/****************************************************************************
+|*
+|* Function: mppush
+|*
+|* Description;
+|*
+|*     Moves the current memory pool ID to the stack and makes mpid the 
+|*     current one. The stack has only one element, for now.
+|*
+|* Return:
+|*     MP_ERRNO_SUCCESS if success
+|*     MP_ERRNO_MPID, MP_ERRNO_NOIN if error
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20140811    JG    Initial version
+|*
+****************************************************************************/
+int mppush(int mpid)
+{
+    mperrno = MP_ERRNO_SUCCESS;
+
+    /* Memory pool ID out of limit */
+    if (mpid > MP_MAX_MP_ID -1 || mpid < 0)
+    {
+        mperrno = MP_ERRNO_MPID;
+        return MP_ERRNO_MPID;
+    }
+
+    /* Memory pool ID not initiliazed */
+    if (mp_arr[mpid].init != 'Y' && mpid != MP_DEF_MP_ID)
+    {
+        mperrno = MP_ERRNO_NOIN;
+        return MP_ERRNO_NOIN;
+    }
+
+    /* Push */
+    mp_prev_mpid = mp_cur_mpid;
+    mp_cur_mpid = mpid;
+
+    return MP_ERRNO_SUCCESS;
+}
+
+/****************************************************************************
+|*
+|* Function: mppop
+|*
+|* Description;
+|*
+|*     Sets the previous Memory Pool ID as the current one
+|*
+|* Return:
+|*     MP_ERRNO_SUCCESS if success
+|*     MP_ERRNO_NOPP if error
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20140811    JG    Initial version
+|*
+****************************************************************************/
+int mppop()
+{
+    mperrno = MP_ERRNO_SUCCESS;
+
+    /* Nothing to pop */
+    if (mp_prev_mpid < 0 || mp_prev_mpid > MP_MAX_MP_ID -1)
+    {
+        mperrno = MP_ERRNO_NOPP;
+        return MP_ERRNO_NOPP;
+    }
+
+    /* Pop */
+    mp_cur_mpid = mp_prev_mpid;
+    mp_prev_mpid = MP_NO_MP_ID;
+
+    return MP_ERRNO_SUCCESS;
+}
+
+/****************************************************************************
+|*
+|* Function: mpset
+|*
+|* Description;
+|*
+|*     Sets the current memory pool ID
+|*
+|* Return:
+|*     MP_ERRNO_SUCCESS if success
+|*     MP_ERRNO_MPID, MP_ERRNO_NOIN, MP_ERRNO_THRD if error
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20140811    JG    Initial version
+|* 20261019    JG    The default memory pool can be set before its first use
+|*
+****************************************************************************/
+int mpset(int mpid)
+{
+    mperrno = MP_ERRNO_SUCCESS;
+
+    /* Memory pool ID out of limit */
+    if (mpid > MP_MAX_MP_ID -1 || mpid < 0)
+    {
+        mperrno = MP_ERRNO_MPID;
+        return MP_ERRNO_MPID;
+    }
+
+    /* Memory pool ID not initiliazed */
+    if (mp_arr[mpid].init != 'Y' && mpid != MP_DEF_MP_ID)
+    {
+        mperrno = MP_ERRNO_NOIN;
+        return MP_ERRNO_NOIN;
+    }
+
+#if MP_THREAD_SAFE == 1
+    /* Check thread ID. The default memory pool is not owned until its first use */
+    if (mp_arr[mpid].init == 'Y' && MP_THREAD_EQ(mp_arr[mpid].thread_id, MP_CURR_THREAD) == 0)
+    {
+        mperrno = MP_ERRNO_THRD;
+        return MP_ERRNO_THRD;
+    }
+#endif
+
+    /* Set */
+    mp_cur_mpid = mpid;
+
+    return MP_ERRNO_SUCCESS;
+}
+
+/****************************************************************************
+|*
+|* Function: mpget
+|*
+|* Description;
+|*
+|*     Gets the current memory pool ID
+|*
+|* Return:
+|*     the current memory pool ID
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20140811    JG    Initial version
+|*
+****************************************************************************/
+int mpget()
+{
+    return mp_cur_mpid;
+}
+
+/****************************************************************************
+|*
+|* Function: mpdel
+|*
+|* Description;
+|*
+|*     Deletes a given memory pool
+|*
+|* Return:
+|*     MP_ERRNO_SUCCESS if success
+|*     MP_ERRNO_MPID, MP_ERRNO_THRD if error
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20140811    JG    Initial version
+|* 20261019    JG    Runs the cleanup callbacks
+|* 20261019    JG    Slot released under the lock of mpnew()
+|* 20261019    JG    Spare block given back
+|*
+****************************************************************************/
+int mpdel(int mpid)
+{
+    mpblock *spare_block = NULL;
+    mperrno = MP_ERRNO_SUCCESS;
+
+    /* Memory pool ID out of limit */
+    if (mpid > MP_MAX_MP_ID -1 || mpid < 0)
+    {
+        mperrno = MP_ERRNO_MPID;
+        return MP_ERRNO_MPID;
+    }
+
+#if MP_THREAD_SAFE == 1
+    /* Check thread ID */
+    if (MP_THREAD_EQ(mp_arr[mpid].thread_id, MP_CURR_THREAD) == 0)
+    {
+        mperrno = MP_ERRNO_THRD;
+        return MP_ERRNO_THRD;
+    }
+#endif
+
+    /* Cleanups first, their objects can still be used */
+    mpcleanup_run(mpid);
+
+    /* Deallocating all memory blocks in given memory pool */
+    mpfree_blocks(mpid);
+
+#ifndef MP_VALGRIND_NOT_AVAILABLE
+    // VVALGRIND_MEMPOOL_TRIM((void *)&mp_arr[mpid], curr_block->block, 0);
+    VALGRIND_DESTROY_MEMPOOL((void *)&mp_arr[mpid]);
+#endif
+
+    /* Under the lock of mpnew(): once init is cleared another thread can take the slot,
+     * and the refill thread gives it no more spare blocks */
+    if (mplock() == MP_ERRNO_SUCCESS)
+    {
+        spare_block = (mpblock *)MP_ATOMIC_XCHG_PTR(&mp_arr[mpid].spare_block, NULL);
+        memset(&mp_arr[mpid], 0x00, sizeof(mp));
+        mp_arr[mpid].blocks = NULL;
+        mp_arr[mpid].tail_block = NULL;
+        mpunlock();
+    }
+    if (spare_block != NULL)
+    {
+        MP_SYS_FREE(spare_block);
+    }
+
+    return MP_ERRNO_SUCCESS;
+}
+
+/****************************************************************************
+|*
+|* Function: mpdel_all
+|*
+|* Description;
+|*
+|*     Deletes all memory pools. This should be called by the main thread.
+|*
+|* Return:
+|*     MP_ERRNO_SUCCESS
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20140811    JG    Initial version
+|* 20261019    JG    Runs the cleanup callbacks
+|* 20261019    JG    Empties the recycler
+|* 20261019    JG    Stops the refill thread, spare blocks given back
+|* 20261019    JG    Used memory not reset, other threads' magazines counted
+|* 20261019    JG    Arrays of the ownership index given back
+|*
+****************************************************************************/
+int mpdel_all()
+{
+    int i = 0;
+
+    /* No spare blocks made while the memory pools go */
+    mpset_refill(FALSE);
+
+    /* All the cleanups before any memory is given back, objects of a pool can refer to others */
+    for (i = 0; i < MP_MAX_MP_ID; i ++)
+    {
+        if (mp_arr[i].init == 'Y')
+        {
+            mpcleanup_run(i);
+        }
+    }
+
+    for (i = 0; i < MP_MAX_MP_ID; i ++)
+    {
+        if (mp_arr[i].init != 'Y')
+            continue;
+
+        mpfree_blocks(i);
+        if (mp_arr[i].spare_block != NULL)
+        {
+            MP_SYS_FREE(mp_arr[i].spare_block);
+        }
+
+#ifndef MP_VALGRIND_NOT_AVAILABLE
+        // VVALGRIND_MEMPOOL_TRIM((void *)&mp_arr[i], curr_block->block, 0);
+        VALGRIND_DESTROY_MEMPOOL((void *)&mp_arr[i]);
+#endif
+        memset(&mp_arr[i], 0x00, sizeof(mp));
+        mp_arr[i].blocks = NULL;
+        mp_arr[i].tail_block = NULL;
+    }
+
+    /* The blocks in the magazines of other threads stay counted until they are given back */
+    mpflush_rcy();
+
+    if (mplock() == MP_ERRNO_SUCCESS)
+    {
+        mprng_free();
+        mpunlock();
+    }
+
+    return MP_ERRNO_SUCCESS;
+}
+
+/****************************************************************************
+|*
+|* Function: mpclr
+|*
+|* Description;
+|*
+|*     Resets the used memory of the given memory pool to 0, so it is 
+|*     delivered again. The content of the memory is kept, set to zero or
+|*     given back as set by mpset_clr().
+|*
+|* Return:
+|*     MP_ERRNO_SUCCESS if success
+|*     MP_ERRNO_MPID, MP_ERRNO_THRD if error
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20140811    JG    Initial version
+|* 20261019    JG    Runs the cleanup callbacks
+|* 20261019    JG    Pools on a buffer give back their other blocks
+|* 20261019    JG    Trim of the memory pool (see mpset_trim())
+|* 20261019    JG    Clear policy of the memory pool (see mpset_clr())
+|* 20261019    JG    All the blocks are used again, not only the tail one
+|*
+****************************************************************************/
+int mpclr(int mpid)
+{
+    int i = 0;
+    int j = 0;
+    int buf_pool = FALSE;
+
+    mperrno = MP_ERRNO_SUCCESS;
+
+    /* Memory pool ID out of limit */
+    if (mpid > MP_MAX_MP_ID -1 || mpid < 0)
+    {
+        mperrno = MP_ERRNO_MPID;
+        return MP_ERRNO_MPID;
+    }
+
+#if MP_THREAD_SAFE == 1
+    /* Check thread ID */
+    if (MP_THREAD_EQ(mp_arr[mpid].thread_id, MP_CURR_THREAD) == 0)
+    {
+        mperrno = MP_ERRNO_THRD;
+        return MP_ERRNO_THRD;
+    }
+#endif
+
+    /* Cleanups first, their objects are in the memory about to be cleared */
+    mpcleanup_run(mpid);
+
+    /* A pool on a buffer of the caller goes back to it */
+    buf_pool = mp_arr[mpid].block_cnt > 0 && mp_arr[mpid].blocks[0]->type == MP_BLK_BUF;
+
+    /* Set the used parameter of each memory block to zero */
+    for (i = 0; i < mp_arr[mpid].block_cnt; i++)
+    {
+        mpblock *curr_block = mp_arr[mpid].blocks[i];
+
+        /* Blocks with own mapping are never reused, neither the overflow of a buffer, so they are given back */
+        if (curr_block->type == MP_BLK_MAP || (buf_pool && curr_block->type == MP_BLK_HEAP))
+        {
+            if (mplock() == MP_ERRNO_SUCCESS)
+            {
+                mprng_del(curr_block);
+                mpunlock();
+            }
+            mpadd_tot_phy_mem(curr_block->size, -1);
+            mpblk_free(mpid, curr_block, TRUE);
+            continue;
+        }
+
+        /* The pages of a memory pool of type MP_TYPE_VM beyond the first one are decommitted below */
+        if (mp_arr[mpid].clr_policy != MP_CLR_RESET)
+        {
+            size_t vm_keep = mp_vm_pgsz() - MP_BLK_HDR_SZ;
+
+            mpclr_block(mpid, curr_block, mp_arr[mpid].type == MP_TYPE_VM && curr_block->used > vm_keep ? vm_keep : curr_block->used);
+        }
+        curr_block->used = 0;
+        mp_arr[mpid].blocks[j++] = curr_block;
+    }
+    mp_arr[mpid].block_cnt = j;
+    mp_arr[mpid].next_blk = 0;
+    mp_arr[mpid].map_cnt = 0;
+    mp_arr[mpid].last_chunk = NULL;
+    if (buf_pool)
+    {
+        mp_arr[mpid].tail_block = mp_arr[mpid].blocks[0];
+        memset(mp_arr[mpid].aln_block, 0x00, sizeof(mp_arr[mpid].aln_block));
+    }
+
+    /* The intern table and its strings were in the memory just cleared */
+    mp_arr[mpid].intern_tbl = NULL;
+    mp_arr[mpid].intern_cnt = 0;
+    mp_arr[mpid].intern_max = 0;
+    mp_arr[mpid].slab_free = NULL;
+    mp_arr[mpid].slab_free_cnt = 0;
+    (void)MP_ATOMIC_XCHG_PTR(&mp_arr[mpid].slab_remote, NULL); /* Objects given back by other threads are cleared too */
+
+    /* Give back to the OS the pages committed after the one of the header */
+    if (mp_arr[mpid].type == MP_TYPE_VM && mp_arr[mpid].vm_commit > mp_vm_pgsz())
+    {
+        size_t pgsz = mp_vm_pgsz();
+
+        if (mp_vm_decommit((uchar *)mp_arr[mpid].tail_block + pgsz, mp_arr[mpid].vm_commit - pgsz) == MP_ERRNO_SUCCESS)
+        {
+            mpadd_tot_phy_mem(mp_arr[mpid].vm_commit - pgsz, -1);
+            mp_arr[mpid].vm_commit = pgsz;
+
+            /* Decommitted pages come back as zero */
+            if (mp_arr[mpid].tail_block->zero > pgsz - MP_BLK_HDR_SZ)
+            {
+                mp_arr[mpid].tail_block->zero = pgsz - MP_BLK_HDR_SZ;
+            }
+        }
+    }
+
+#ifndef MP_VALGRIND_NOT_AVAILABLE
+    // VALGRIND_MEMPOOL_TRIM((void *)&mp_arr[mpid], curr_block->block, 0);
+#endif
+
+    if (mp_arr[mpid].trim_clr)
+    {
+        return mptrim(mpid, mp_arr[mpid].trim_keep);
+    }
+
+    return MP_ERRNO_SUCCESS;
+}
+
+/****************************************************************************
+|*
+|* Function: mptrim
+|*
+|* Description;
+|*
+|*     Gives back the memory of the memory pool beyond keep_bytes, keeping
+|*     the memory pool alive. The blocks holding chunks are always kept; 
+|*     the empty ones (after mpclr()) are kept, the tail block first, while
+|*     the total stays within keep_bytes and the rest are given back with 
+|*     their pages. Memory pools of type MP_TYPE_VM give back the committed
+|*     pages beyond the chunks and keep_bytes.
+|*
+|* Return:
+|*     MP_ERRNO_SUCCESS if success
+|*     MP_ERRNO_MPID, MP_ERRNO_NOIN, MP_ERRNO_THRD if error
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|* 20261019    JG    Trimmed blocks not kept by the recycler
+|*
+****************************************************************************/
+int mptrim(int mpid, size_t keep_bytes)
+{
+    mp *curr_mp = NULL;
+    mpblock *curr_block = NULL;
+    size_t kept = 0;
+    int keep_tail = FALSE;
+    int i = 0;
+    int j = 0;
+    int k = 0;
+
+    mperrno = MP_ERRNO_SUCCESS;
+
+    /* Memory pool ID out of limit */
+    if (mpid > MP_MAX_MP_ID -1 || mpid < 0)
+    {
+        mperrno = MP_ERRNO_MPID;
+        return MP_ERRNO_MPID;
+    }
+
+    curr_mp = &mp_arr[mpid];
+    if (curr_mp->init != 'Y')
+    {
+        /* The default memory pool has no block yet */
+        mperrno = mpid == MP_DEF_MP_ID ? MP_ERRNO_SUCCESS : MP_ERRNO_NOIN;
+        return mperrno;
+    }
+
+#if MP_THREAD_SAFE == 1
+    /* Check thread ID */
+    if (MP_THREAD_EQ(curr_mp->thread_id, MP_CURR_THREAD) == 0)
+    {
+        mperrno = MP_ERRNO_THRD;
+        return MP_ERRNO_THRD;
+    }
+#endif
+
+    if (curr_mp->type == MP_TYPE_VM)
+    {
+        size_t pgsz = mp_vm_pgsz();
+        size_t keep = 0;
+
+        if (curr_mp->tail_block == NULL || keep_bytes >= curr_mp->vm_commit)
+        {
+            return MP_ERRNO_SUCCESS;
+        }
+
+        /* The header and the chunks stay committed */
+        keep = MP_BLK_HDR_SZ + (curr_mp->tail_block->used > keep_bytes ? curr_mp->tail_block->used : keep_bytes);
+        keep = (keep + pgsz -1) & ~(pgsz -1);
+        if (keep < curr_mp->vm_commit &&
+                mp_vm_decommit((uchar *)curr_mp->tail_block + keep, curr_mp->vm_commit - keep) == MP_ERRNO_SUCCESS)
+        {
+            mpadd_tot_phy_mem(curr_mp->vm_commit - keep, -1);
+            curr_mp->vm_commit = keep;
+
+            /* Decommitted pages come back as zero */
+            if (curr_mp->tail_block->zero > keep - MP_BLK_HDR_SZ)
+            {
+                curr_mp->tail_block->zero = keep - MP_BLK_HDR_SZ;
+            }
+        }
+
+        return MP_ERRNO_SUCCESS;
+    }
+
+    /* Blocks holding chunks, with own mapping or of a buffer of the caller are kept */
+    for (i = 0; i < curr_mp->block_cnt; i++)
+    {
+        curr_block = curr_mp->blocks[i];
+        if (curr_block->type == MP_BLK_HEAP && curr_block->used > 0)
+        {
+            kept += curr_block->size;
+        }
+        else if (curr_block->type == MP_BLK_MAP)
+        {
+            kept += curr_block->size;
+        }
+    }
+
+    /* The tail block first, the next chunks are taken from it */
+    curr_block = curr_mp->tail_block;
+    if (curr_block != NULL && curr_block->type == MP_BLK_HEAP && curr_block->used == 0 &&
+            kept < keep_bytes && curr_block->size <= keep_bytes - kept)
+    {
+        kept += curr_block->size;
+        keep_tail = TRUE;
+    }
+
+    for (i = 0; i < curr_mp->block_cnt; i++)
+    {
+        curr_block = curr_mp->blocks[i];
+
+        if (curr_block->type != MP_BLK_HEAP || curr_block->used > 0 || (curr_block == curr_mp->tail_block && keep_tail))
+        {
+            curr_mp->blocks[j++] = curr_block;
+            continue;
+        }
+        if (curr_block != curr_mp->tail_block && kept < keep_bytes && curr_block->size <= keep_bytes - kept)
+        {
+            kept += curr_block->size;
+            curr_mp->blocks[j++] = curr_block;
+            continue;
+        }
+
+        /* Empty block beyond the memory to keep */
+        if (mplock() == MP_ERRNO_SUCCESS)
+        {
+            mprng_del(curr_block);
+            mpunlock();
+        }
+        if (curr_block == curr_mp->tail_block)
+        {
+            curr_mp->tail_block = NULL;
+        }
+        for (k = 0; k < curr_mp->aln_cnt; k++)
+        {
+            if (curr_mp->aln_block[k] == curr_block)
+            {
+                curr_mp->aln_block[k] = NULL;
+            }
+        }
+        mpadd_tot_phy_mem(curr_block->size, -1);
+        if (curr_mp->upstream.block_free == NULL)
+        {
+            mpblk_discard(curr_block);
+        }
+        mpblk_free(mpid, curr_block, FALSE); /* Pages already given back, no use to the recycler */
+    }
+    curr_mp->block_cnt = j;
+    curr_mp->next_blk = 0;
+
+    return MP_ERRNO_SUCCESS;
+}
+
+/****************************************************************************
+|*
+|* Function: mpset_clr
+|*
+|* Description;
+|*
+|*     Sets what mpclr() does with the used memory of the memory pool:
+|*     MP_CLR_RESET (the default) leaves it as it is, MP_CLR_ZERO sets it to
+|*     zero and MP_CLR_DISCARD gives back its pages (see mpclr_block()).
+|*
+|* Return:
+|*     MP_ERRNO_SUCCESS if success
+|*     MP_ERRNO_MPID, MP_ERRNO_NOIN, MP_ERRNO_THRD, MP_ERRNO_PARM if error
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+int mpset_clr(int mpid, int policy)
+{
+    mperrno = MP_ERRNO_SUCCESS;
+
+    /* Memory pool ID out of limit */
+    if (mpid > MP_MAX_MP_ID -1 || mpid < 0)
+    {
+        mperrno = MP_ERRNO_MPID;
+        return MP_ERRNO_MPID;
+    }
+
+    /* Memory pool ID not initiliazed */
+    if (mp_arr[mpid].init != 'Y' && mpid != MP_DEF_MP_ID)
+    {
+        mperrno = MP_ERRNO_NOIN;
+        return MP_ERRNO_NOIN;
+    }
+
+#if MP_THREAD_SAFE == 1
+    /* Check thread ID */
+    if (mp_arr[mpid].init == 'Y' && MP_THREAD_EQ(mp_arr[mpid].thread_id, MP_CURR_THREAD) == 0)
+    {
+        mperrno = MP_ERRNO_THRD;
+        return MP_ERRNO_THRD;
+    }
+#endif
+
+    if (policy != MP_CLR_RESET && policy != MP_CLR_ZERO && policy != MP_CLR_DISCARD)
+    {
+        mperrno = MP_ERRNO_PARM;
+        return MP_ERRNO_PARM;
+    }
+
+    mp_arr[mpid].clr_policy = policy;
+
+    return MP_ERRNO_SUCCESS;
+}
+
+/****************************************************************************
+|*
+|* Function: mpreserve
+|*
+|* Description;
+|*
+|*     Makes sure the memory pool has bytes of memory available without 
+|*     adding blocks: the rest of the tail block and its empty blocks count
+|*     (not those of the alignment classes, see mpblk_reusable()), and 
+|*     blocks of the default size are added, empty, until they cover bytes. Memory pools of type MP_TYPE_VM commit the pages instead. With
+|*     MP_RSV_PREFAULT the pages of all that memory are faulted in too. The
+|*     next allocations up to bytes then neither allocate nor fault.
+|*
+|* Return:
+|*     MP_ERRNO_SUCCESS if success
+|*     MP_ERRNO_MPID, MP_ERRNO_NOIN, MP_ERRNO_THRD, MP_ERRNO_PARM,
+|*     MP_ERRNO_EXMM, MP_ERRNO_ALLO, MP_ERRNO_NOMM if error
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|* 20261019    JG    Blocks of the alignment classes not counted
+|*
+****************************************************************************/
+int mpreserve(int mpid, size_t bytes, int flags)
+{
+    mp *curr_mp = NULL;
+    mpblock *tail_block = NULL;
+    mpblock *curr_block = NULL;
+    size_t avail = 0;
+    size_t last_dirty = 0;
+    int next_blk = 0;
+    int rc = MP_ERRNO_SUCCESS;
+    int i = 0;
+
+    mperrno = MP_ERRNO_SUCCESS;
+
+    /* Memory pool ID out of limit */
+    if (mpid > MP_MAX_MP_ID -1 || mpid < 0)
+    {
+        mperrno = MP_ERRNO_MPID;
+        return MP_ERRNO_MPID;
+    }
+
+    curr_mp = &mp_arr[mpid];
+
+    /* Memory pool ID not initiliazed */
+    if (curr_mp->init != 'Y' && mpid != MP_DEF_MP_ID)
+    {
+        mperrno = MP_ERRNO_NOIN;
+        return MP_ERRNO_NOIN;
+    }
+
+#if MP_THREAD_SAFE == 1
+    /* Check thread ID */
+    if (curr_mp->init == 'Y' && MP_THREAD_EQ(curr_mp->thread_id, MP_CURR_THREAD) == 0)
+    {
+        mperrno = MP_ERRNO_THRD;
+        return MP_ERRNO_THRD;
+    }
+#endif
+
+    if ((flags & ~MP_RSV_PREFAULT) != 0)
+    {
+        mperrno = MP_ERRNO_PARM;
+        return MP_ERRNO_PARM;
+    }
+
+    if (curr_mp->type == MP_TYPE_VM)
+    {
+        curr_block = curr_mp->tail_block;
+        if (bytes > curr_block->size - curr_block->used)
+        {
+            mperrno = MP_ERRNO_NOMM;
+            return MP_ERRNO_NOMM;
+        }
+        if ((rc = mpvm_commit(mpid, MP_BLK_HDR_SZ + curr_block->used + bytes)) != MP_ERRNO_SUCCESS)
+        {
+            return rc;
+        }
+        if (flags & MP_RSV_PREFAULT)
+        {
+            mpprefault(curr_block->block + curr_block->used, bytes);
+        }
+        return MP_ERRNO_SUCCESS;
+    }
+
+    /* Memory available: the rest of the tail block and the empty blocks */
+    if ((tail_block = curr_mp->tail_block) != NULL)
+    {
+        avail = tail_block->size - tail_block->used;
+    }
+    for (i = curr_mp->next_blk; i < curr_mp->block_cnt; i++)
+    {
+        if (mpblk_reusable(mpid, curr_mp->blocks[i]))
+        {
+            avail += curr_mp->blocks[i]->size;
+        }
+    }
+
+    /* New empty blocks, the tail block and the last chunk stay the same */
+    next_blk = curr_mp->next_blk;
+    last_dirty = curr_mp->last_dirty;
+    while (avail < bytes)
+    {
+        curr_mp->next_blk = curr_mp->block_cnt;
+        if (mpadd_block(1, mpid, MP_DEF_ALIGN) == NULL)
+        {
+            rc = mperrno;
+            break;
+        }
+        curr_block = curr_mp->tail_block;
+        curr_block->zero = curr_block->zero > curr_block->used ? curr_block->zero : 0;
+        curr_block->used = 0;
+        curr_mp->tail_block = tail_block;
+        avail += curr_block->size;
+    }
+    curr_mp->next_blk = next_blk;
+    curr_mp->last_dirty = last_dirty;
+
+    if (flags & MP_RSV_PREFAULT)
+    {
+        if (tail_block != NULL)
+        {
+            mpprefault(tail_block->block + tail_block->used, tail_block->size - tail_block->used);
+        }
+        for (i = curr_mp->next_blk; i < curr_mp->block_cnt; i++)
+        {
+            curr_block = curr_mp->blocks[i];
+            if (mpblk_reusable(mpid, curr_block))
+            {
+                mpprefault(curr_block->block, curr_block->size);
+            }
+        }
+    }
+
+    mperrno = rc;
+    return rc;
+}
+
+/****************************************************************************
+|*
+|* Function: mpset_trim
+|*
+|* Description;
+|*
+|*     Sets the trim policy of the memory pool: each mpclr() is followed by
+|*     mptrim(mpid, keep_bytes). MP_NO_TRIM (the default) sets it off.
+|*
+|* Return:
+|*     MP_ERRNO_SUCCESS if success
+|*     MP_ERRNO_MPID, MP_ERRNO_NOIN, MP_ERRNO_THRD if error
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+int mpset_trim(int mpid, size_t keep_bytes)
+{
+    mperrno = MP_ERRNO_SUCCESS;
+
+    /* Memory pool ID out of limit */
+    if (mpid > MP_MAX_MP_ID -1 || mpid < 0)
+    {
+        mperrno = MP_ERRNO_MPID;
+        return MP_ERRNO_MPID;
+    }
+
+    /* Memory pool ID not initiliazed */
+    if (mp_arr[mpid].init != 'Y' && mpid != MP_DEF_MP_ID)
+    {
+        mperrno = MP_ERRNO_NOIN;
+        return MP_ERRNO_NOIN;
+    }
+
+#if MP_THREAD_SAFE == 1
+    /* Check thread ID */
+    if (mp_arr[mpid].init == 'Y' && MP_THREAD_EQ(mp_arr[mpid].thread_id, MP_CURR_THREAD) == 0)
+    {
+        mperrno = MP_ERRNO_THRD;
+        return MP_ERRNO_THRD;
+    }
+#endif
+
+    mp_arr[mpid].trim_clr = keep_bytes != MP_NO_TRIM;
+    mp_arr[mpid].trim_keep = keep_bytes;
+
+    return MP_ERRNO_SUCCESS;
+}
+
+/****************************************************************************
+|*
+|* Function: mpset_memlim
+|*
+|* Description;
+|*
+|*     Sets the memory limit
+|*
+|* Return:
+|*     n/a
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20140811    JG    Initial version
+|*
+****************************************************************************/
+void mpset_memlim(size_t size)
+{
+    mp_mem_limit = size;
+    return;
+}
+
+/****************************************************************************
+|*
+|* Function: mpget_memlim
+|*
+|* Description;
+|*
+|*     Gets the current memory limit
+|*
+|* Return:
+|*     memory limit
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20140813    JG    Initial version
+|*
+****************************************************************************/
+size_t mpget_memlim()
+{
+    return mp_mem_limit;
+}
+
+/****************************************************************************
+|*
+|* Function: mpset_blksz
+|*
+|* Description;
+|*
+|*     Sets the memory block size
+|*
+|* Return:
+|*     n/a
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20150103    JG    Initial version
+|*
+****************************************************************************/
+void mpset_blksz(size_t size)
+{
+    mp_blk_sz = size;
+    return;
+}
+
+/****************************************************************************
+|*
+|* Function: mpget_blksz
+|*
+|* Description;
+|*
+|*     Gets the current memory limit
+|*
+|* Return:
+|*     memory limit
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20150103    JG    Initial version
+|*
+****************************************************************************/
+size_t mpget_blksz()
+{
+    return mp_blk_sz;
+}
+
+/****************************************************************************
+|*
+|* Function: mpset_mapsz
+|*
+|* Description;
+|*
+|*     Sets the minimum size of the chunks which get their own mapping.
+|*     0 disables it.
+|*
+|* Return:
+|*     n/a
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+void mpset_mapsz(size_t size)
+{
+    mp_map_sz = size;
+    return;
+}
+
+/****************************************************************************
+|*
+|* Function: mpget_mapsz
+|*
+|* Description;
+|*
+|*     Gets the minimum size of the chunks which get their own mapping
+|*
+|* Return:
+|*     minimum size of the chunks with own mapping
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+size_t mpget_mapsz()
+{
+    return mp_map_sz;
+}
+
+/****************************************************************************
+|*
+|* Function: mpset_colors
+|*
+|* Description;
+|*
+|*     Sets the number of colors of the heap blocks: the start of the memory
+|*     of each new block is moved by a multiple of MP_CACHE_LINE, from 0 to 
+|*     colors -1 cache lines, depending on the memory pool and the number of
+|*     its blocks. 0 or 1 disables the coloring.
+|*
+|* Return:
+|*     n/a
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+void mpset_colors(int colors)
+{
+    mp_colors = colors < 0 ? 0 : colors;
+    return;
+}
+
+/****************************************************************************
+|*
+|* Function: mpget_colors
+|*
+|* Description;
+|*
+|*     Gets the number of colors of the heap blocks
+|*
+|* Return:
+|*     number of colors (0 = no coloring)
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+int mpget_colors()
+{
+    return mp_colors;
+}
+
+/****************************************************************************
+|*
+|* Function: mpset_rcysz
+|*
+|* Description;
+|*
+|*     Sets the maximum size of the blocks kept in the depot of the recycler
+|*     (0 = no recycling, the recycler is emptied)
+|*
+|* Return:
+|*     n/a
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+void mpset_rcysz(size_t size)
+{
+    mp_rcy_sz = size;
+    if (size == 0)
+    {
+        mpflush_rcy();
+    }
+    return;
+}
+
+/****************************************************************************
+|*
+|* Function: mpget_rcysz
+|*
+|* Description;
+|*
+|*     Gets the maximum size of the blocks kept in the depot of the recycler
+|*
+|* Return:
+|*     size of the depot (0 = no recycling)
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+size_t mpget_rcysz()
+{
+    return mp_rcy_sz;
+}
+
+/****************************************************************************
+|*
+|* Function: mpflush_rcy
+|*
+|* Description;
+|*
+|*     Gives back to the heap the recycled blocks of the magazine of the 
+|*     calling thread and of the depot. The magazines of the other threads
+|*     stay; they go to the depot when their thread ends.
+|*
+|* Return:
+|*     n/a
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+void mpflush_rcy()
+{
+    mprcy *rcy = NULL;
+    mprcy *depot = NULL;
+    size_t size = 0;
+    int err = mperrno;
+
+    if (mplock() == MP_ERRNO_SUCCESS)
+    {
+        depot = mp_rcy_depot;
+        mp_rcy_depot = NULL;
+        mp_rcy_depot_sz = 0;
+        mpunlock();
+    }
+
+    while ((rcy = depot) != NULL)
+    {
+        depot = rcy->next;
+        size += rcy->size;
+        MP_SYS_FREE(rcy);
+    }
+    while ((rcy = (mprcy *)mp_rcy_mag) != NULL)
+    {
+        mp_rcy_mag = rcy->next;
+        size += rcy->size;
+        MP_SYS_FREE(rcy);
+    }
+    mp_rcy_mag_cnt = 0;
+
+    if (size > 0)
+    {
+        mpadd_tot_phy_mem(size, -1); /* No need to check for error */
+    }
+    mperrno = err;
+}
+
+/****************************************************************************
+|*
+|* Function: mpset_refill
+|*
+|* Description;
+|*
+|*     Starts (on TRUE) or stops the refill thread of the library. While it
+|*     runs it keeps a spare heap block of the default size, zero and with
+|*     its pages faulted in, for each memory pool marked with mpset_spare().
+|*     When the tail block of such a memory pool is full its owner takes 
+|*     the spare block with one atomic exchange instead of allocating, and
+|*     the refill thread makes the next one meanwhile. Starts and stops are
+|*     serialized by their own mutex, held until the thread is started or 
+|*     joined, so the handle of the thread is never joined twice nor 
+|*     overwritten while a thread runs. mp_rfl_run is still changed with
+|*     the main mutex locked, as the refill thread reads it.
+|*
+|* Return:
+|*     MP_ERRNO_SUCCESS if success
+|*     MP_ERRNO_SYSE if the thread could not be started
+|*     MP_ERRNO_PARM if the library is not thread safe
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|* 20261019    JG    Start and stop serialized by mp_rfl_mutex
+|*
+****************************************************************************/
+int mpset_refill(int on)
+{
+#if MP_THREAD_SAFE == 1 /* { */
+    int rc = MP_ERRNO_SUCCESS;
+
+    mperrno = MP_ERRNO_SUCCESS;
+
+    if ((rc = mp_mutex_init(&mp_rfl_mutex_p)) != MP_ERRNO_SUCCESS)
+    {
+        mperrno = rc;
+        return rc;
+    }
+    MP_MUTEX_LOCK(mp_rfl_mutex_p);
+
+    /* Already in the state asked for: only changed with mp_rfl_mutex locked */
+    if (mp_rfl_run == (on ? TRUE : FALSE))
+    {
+        MP_MUTEX_UNLOCK(mp_rfl_mutex_p);
+        return MP_ERRNO_SUCCESS;
+    }
+
+    if ((rc = mplock()) != MP_ERRNO_SUCCESS)
+    {
+        MP_MUTEX_UNLOCK(mp_rfl_mutex_p);
+        mperrno = rc;
+        return rc;
+    }
+    mp_rfl_run = on ? TRUE : FALSE;
+    if (!on)
+    {
+        MP_COND_SIGNAL(&mp_rfl_cond);
+    }
+    mpunlock();
+
+    if (!on)
+    {
+        mp_thread_join(mp_rfl_thread);
+    }
+    else if ((rc = mp_thread_start(&mp_rfl_thread, &mprfl_main, NULL)) != MP_ERRNO_SUCCESS)
+    {
+        mplock();
+        mp_rfl_run = FALSE;
+        mpunlock();
+    }
+    MP_MUTEX_UNLOCK(mp_rfl_mutex_p);
+
+    mperrno = rc;
+    return rc;
+#else /* } MP_THREAD_SAFE { */
+    if (on)
+    {
+        mperrno = MP_ERRNO_PARM;
+        return MP_ERRNO_PARM;
+    }
+
+    mperrno = MP_ERRNO_SUCCESS;
+    return MP_ERRNO_SUCCESS;
+#endif /* } MP_THREAD_SAFE */
+}
+
+/****************************************************************************
+|*
+|* Function: mpset_spare
+|*
+|* Description;
+|*
+|*     Marks the memory pool as latency-sensitive (on TRUE): the refill 
+|*     thread (see mpset_refill()) keeps a spare block for it. Heap blocks
+|*     only, not for memory pools with a provider or a NUMA policy. With
+|*     FALSE the spare block is given back.
+|*
+|* Return:
+|*     MP_ERRNO_SUCCESS if success
+|*     MP_ERRNO_MPID, MP_ERRNO_NOIN, MP_ERRNO_THRD, MP_ERRNO_PARM if error
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+int mpset_spare(int mpid, int on)
+{
+    mp *curr_mp = NULL;
+    mpblock *spare_block = NULL;
+    int rc = MP_ERRNO_SUCCESS;
+
+    mperrno = MP_ERRNO_SUCCESS;
+
+    /* Memory pool ID out of limit */
+    if (mpid > MP_MAX_MP_ID -1 || mpid < 0)
+    {
+        mperrno = MP_ERRNO_MPID;
+        return MP_ERRNO_MPID;
+    }
+
+    curr_mp = &mp_arr[mpid];
+
+    /* Memory pool ID not initiliazed */
+    if (curr_mp->init != 'Y' && mpid != MP_DEF_MP_ID)
+    {
+        mperrno = MP_ERRNO_NOIN;
+        return MP_ERRNO_NOIN;
+    }
+
+#if MP_THREAD_SAFE == 1
+    /* Check thread ID */
+    if (curr_mp->init == 'Y' && MP_THREAD_EQ(curr_mp->thread_id, MP_CURR_THREAD) == 0)
+    {
+        mperrno = MP_ERRNO_THRD;
+        return MP_ERRNO_THRD;
+    }
+#endif
+
+    /* The range of a memory pool of type MP_TYPE_VM does not take blocks */
+    if (curr_mp->type == MP_TYPE_VM)
+    {
+        mperrno = MP_ERRNO_PARM;
+        return MP_ERRNO_PARM;
+    }
+
+    /* Under the lock the refill thread looks at the memory pools with */
+    if ((rc = mplock()) != MP_ERRNO_SUCCESS)
+    {
+        mperrno = rc;
+        return rc;
+    }
+    curr_mp->spare = on ? TRUE : FALSE;
+    if (!on)
+    {
+        spare_block = (mpblock *)MP_ATOMIC_XCHG_PTR(&curr_mp->spare_block, NULL);
+    }
+    mpunlock();
+
+    if (spare_block != NULL)
+    {
+        MP_SYS_FREE(spare_block);
+    }
+    if (on)
+    {
+        mprfl_wake();
+    }
+
+    return MP_ERRNO_SUCCESS;
+}
+
+/****************************************************************************
+|*
+|* Function: mprfl_wake
+|*
+|* Description;
+|*
+|*     Wakes up the refill thread: a spare block was taken or is wanted.
+|*
+|* Return:
+|*     n/a
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+static void mprfl_wake()
+{
+#if MP_THREAD_SAFE == 1 /* { */
+    if (mplock() == MP_ERRNO_SUCCESS)
+    {
+        MP_COND_SIGNAL(&mp_rfl_cond);
+        mpunlock();
+    }
+#endif /* } MP_THREAD_SAFE */
+}
+
+#if MP_THREAD_SAFE == 1 /* { */
+/****************************************************************************
+|*
+|* Function: mprfl_main
+|*
+|* Description;
+|*
+|*     Refill thread: makes a spare block for each memory pool marked with
+|*     mpset_spare() which has none, and waits to be woken up when all have
+|*     one. The block, of the size of a recycled block (see mprcy_unit()), 
+|*     is allocated and faulted in without the lock, so the owners of the 
+|*     memory pools never wait for it. Its size is kept in the header until
+|*     the owner takes it. The spare blocks are not counted in the memory 
+|*     used until taken.
+|*
+|* Return:
+|*     NULL
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+static void *mprfl_main(void *arg)
+{
+    mp *curr_mp = NULL;
+    mpblock *block = NULL;
+    size_t unit = 0;
+    int i = 0;
+
+    (void)arg;
+
+    mplock();
+    while (mp_rfl_run)
     {
-        if (mp_arr[i].init != 'Y')
+        /* First memory pool waiting for a spare block */
+        for (i = 0; i < MP_MAX_MP_ID; i++)
         {
-            if (i == MP_DEF_MP_ID)
-            { 
-                continue;
+            curr_mp = &mp_arr[i];
+            if (curr_mp->init == 'Y' && curr_mp->spare && curr_mp->spare_block == NULL &&
+                    curr_mp->upstream.block_alloc == NULL && curr_mp->numa_policy == MP_NUMA_NONE)
+            {
+                break;
             }
-            mp_arr[i].init = 'Y';
-            strncpy(mp_arr[i].descr, curr_descr, sizeof(mp_arr[i].descr));
-            mp_arr[i].descr[sizeof(mp_arr[i].descr) -1] = '\0';
+        }
+        if (i == MP_MAX_MP_ID)
+        {
+            MP_COND_WAIT(&mp_rfl_cond, mp_mutex_p);
+            continue;
+        }
+
+        unit = mprcy_unit();
+        mpunlock();
+        if ((block = (mpblock *)MP_SYS_CALLOC(1, unit)) != NULL)
+        {
+            mpprefault((uchar *)block, unit);
+            block->size = unit;
+        }
+        mplock();
+
+        if (block == NULL)
+        {
+            /* Out of memory: until a block is taken or wanted again */
+            MP_COND_WAIT(&mp_rfl_cond, mp_mutex_p);
+        }
+        else if (curr_mp->init != 'Y' || !curr_mp->spare ||
+                !MP_ATOMIC_CAS_PTR(&curr_mp->spare_block, NULL, block))
+        {
+            /* The memory pool was deleted or has no more a spare block meanwhile */
+            MP_SYS_FREE(block);
+        }
+    }
+    mpunlock();
+
+    return NULL;
+}
+#endif /* } MP_THREAD_SAFE */
+
+/****************************************************************************
+|*
+|* Function: mpadd_alncls
+|*
+|* Description;
+|*
+|*     Adds to the memory pool mpid an alignment class. The chunks requested
+|*     with an alignment bigger than MP_DEF_ALIGN are taken from the block 
+|*     of the smallest class covering it instead of the tail block, so they
+|*     need no padding and small chunks are not interleaved with them.
+|*
+|* Return:
+|*     MP_ERRNO_SUCCESS if success
+|*     MP_ERRNO_MPID, MP_ERRNO_NOIN, MP_ERRNO_THRD, MP_ERRNO_EXAL, 
+|*     MP_ERRNO_PARM if error
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+int mpadd_alncls(int mpid, size_t alignment)
+{
+    mp *curr_mp = NULL;
+    int i = 0;
+
+    mperrno = MP_ERRNO_SUCCESS;
+
+    /* Memory pool ID out of limit */
+    if (mpid > MP_MAX_MP_ID -1 || mpid < 0)
+    {
+        mperrno = MP_ERRNO_MPID;
+        return mperrno;
+    }
+
+    curr_mp = &mp_arr[mpid];
+    if (curr_mp->init != 'Y' && mpid != MP_DEF_MP_ID)
+    {
+        mperrno = MP_ERRNO_NOIN;
+        return mperrno;
+    }
+
 #if MP_THREAD_SAFE == 1
-            mp_arr[i].thread_id = MP_CURR_THREAD;
+    if (curr_mp->init == 'Y' && MP_THREAD_EQ(curr_mp->thread_id, MP_CURR_THREAD) == 0)
+    {
+        mperrno = MP_ERRNO_THRD;
+        return mperrno;
+    }
 #endif
-            mp_arr[i].head_block = NULL;
-            mp_arr[i].tail_block = NULL;
-            mpid = i;
 
-#ifndef MP_VALGRIND_NOT_AVAILABLE
-            VALGRIND_CREATE_MEMPOOL((void *)&mp_arr[mpid], 0, 1);
+    /* Power of 2 over the default alignment */
+    if ((alignment & (alignment -1)) != 0 || alignment <= MP_DEF_ALIGN)
+    {
+        mperrno = MP_ERRNO_EXAL;
+        return mperrno;
+    }
+
+    /* Pools of one range or of one size of objects have a single cursor */
+    if (curr_mp->type != MP_TYPE_BLK)
+    {
+        mperrno = MP_ERRNO_PARM;
+        return mperrno;
+    }
+
+    /* Keep the classes sorted */
+    while (i < curr_mp->aln_cnt && curr_mp->aln_cls[i] < alignment)
+    {
+        i++;
+    }
+    if (i < curr_mp->aln_cnt && curr_mp->aln_cls[i] == alignment)
+    {
+        return MP_ERRNO_SUCCESS;
+    }
+    if (curr_mp->aln_cnt >= MP_MAX_ALN_CLS)
+    {
+        mperrno = MP_ERRNO_PARM;
+        return mperrno;
+    }
+    memmove(&curr_mp->aln_cls[i +1], &curr_mp->aln_cls[i], (curr_mp->aln_cnt - i) * sizeof(curr_mp->aln_cls[0]));
+    memmove(&curr_mp->aln_block[i +1], &curr_mp->aln_block[i], (curr_mp->aln_cnt - i) * sizeof(curr_mp->aln_block[0]));
+    curr_mp->aln_cls[i] = alignment;
+    curr_mp->aln_block[i] = NULL;
+    curr_mp->aln_cnt++;
+
+    return MP_ERRNO_SUCCESS;
+}
+
+/****************************************************************************
+|*
+|* Function: mpset_numa
+|*
+|* Description;
+|*
+|*     Sets the NUMA policy of the blocks added from now on to the memory 
+|*     pool mpid: MP_NUMA_NONE (the default of the system), MP_NUMA_LOCAL 
+|*     (on the node of the thread owning the pool), MP_NUMA_BIND (on node) 
+|*     or MP_NUMA_INTERLEAVE (over all nodes). Blocks with a policy are 
+|*     touched by the owning thread when added, so their pages are placed 
+|*     at once. On memory pools of type MP_TYPE_VM the policy is set on the 
+|*     whole reserved range. On machines with a single node it is only 
+|*     remembered.
+|*
+|* Return:
+|*     MP_ERRNO_SUCCESS if success
+|*     MP_ERRNO_MPID, MP_ERRNO_NOIN, MP_ERRNO_THRD, MP_ERRNO_PARM, 
+|*     MP_ERRNO_SYSE if error
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+int mpset_numa(int mpid, int policy, int node)
+{
+    mp *curr_mp = NULL;
+
+    mperrno = MP_ERRNO_SUCCESS;
+
+    /* Memory pool ID out of limit */
+    if (mpid > MP_MAX_MP_ID -1 || mpid < 0)
+    {
+        mperrno = MP_ERRNO_MPID;
+        return mperrno;
+    }
+
+    curr_mp = &mp_arr[mpid];
+    if (curr_mp->init != 'Y' && mpid != MP_DEF_MP_ID)
+    {
+        mperrno = MP_ERRNO_NOIN;
+        return mperrno;
+    }
+
+#if MP_THREAD_SAFE == 1
+    if (curr_mp->init == 'Y' && MP_THREAD_EQ(curr_mp->thread_id, MP_CURR_THREAD) == 0)
+    {
+        mperrno = MP_ERRNO_THRD;
+        return mperrno;
+    }
 #endif
-            break;
-        }
+
+    if (policy < MP_NUMA_NONE || policy > MP_NUMA_INTERLEAVE ||
+            (policy == MP_NUMA_BIND && (node < 0 || node >= mp_numa_nodes())))
+    {
+        mperrno = MP_ERRNO_PARM;
+        return mperrno;
+    }
+
+    /* The reserved range of virtual memory gets its pages as it is committed */
+    if (curr_mp->type == MP_TYPE_VM && curr_mp->tail_block != NULL &&
+            mp_numa_bind(curr_mp->tail_block, MP_BLK_HDR_SZ + curr_mp->tail_block->size, policy, node) != MP_ERRNO_SUCCESS)
+    {
+        mperrno = MP_ERRNO_SYSE;
+        return mperrno;
+    }
+
+    curr_mp->numa_policy = policy;
+    curr_mp->numa_node = node;
+
+    return MP_ERRNO_SUCCESS;
+}
+
+/****************************************************************************
+|*
+|* Function: mpcleanup_register
+|*
+|* Description;
+|*
+|*     Registers fn to be called with arg when the memory pool mpid is 
+|*     cleared or deleted (mpclr(), mpdel(), mpdel_all()), the last 
+|*     registered first. So objects owning other resources (files, 
+|*     mappings, C++ objects) can live in the memory pool, slab pools 
+|*     included. The callbacks are run once: after mpclr() they must be 
+|*     registered again. A callback must not clear nor delete its memory 
+|*     pool. Their records are taken from the C library and not from the 
+|*     memory pool: no chunk is taken from it, so slab pools keep only 
+|*     their objects and the last chunk can still grow in place.
+|*
+|* Return:
+|*     MP_ERRNO_SUCCESS if success
+|*     MP_ERRNO_MPID, MP_ERRNO_NOIN, MP_ERRNO_THRD, MP_ERRNO_PARM, 
+|*     MP_ERRNO_ALLO if error
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|* 20261019    JG    Record taken from the C library, slab pools allowed
+|*
+****************************************************************************/
+int mpcleanup_register(int mpid, void (*fn)(void *arg), void *arg)
+{
+    mpcleanup *cleanup = NULL;
+
+    mperrno = MP_ERRNO_SUCCESS;
+
+    /* Memory pool ID out of limit */
+    if (mpid > MP_MAX_MP_ID -1 || mpid < 0)
+    {
+        mperrno = MP_ERRNO_MPID;
+        return mperrno;
+    }
+
+    if (mp_arr[mpid].init != 'Y' && mpid != MP_DEF_MP_ID)
+    {
+        mperrno = MP_ERRNO_NOIN;
+        return mperrno;
     }
+
 #if MP_THREAD_SAFE == 1
-    MP_MUTEX_UNLOCK(mp_mutex_p);
+    if (mp_arr[mpid].init == 'Y' && MP_THREAD_EQ(mp_arr[mpid].thread_id, MP_CURR_THREAD) == 0)
+    {
+        mperrno = MP_ERRNO_THRD;
+        return mperrno;
+    }
 #endif
 
-    mperrno = mpid == MP_ERRNO_EXMP ? MP_ERRNO_EXMP : mperrno;
-    return mpid;
+    if (fn == NULL)
+    {
+        mperrno = MP_ERRNO_PARM;
+        return mperrno;
+    }
+
+    if ((cleanup = (mpcleanup *)MP_SYS_MALLOC(sizeof(mpcleanup))) == NULL)
+    {
+        mperrno = MP_ERRNO_ALLO;
+        return mperrno;
+    }
+
+    cleanup->fn = fn;
+    cleanup->arg = arg;
+    cleanup->next = mp_arr[mpid].cleanups;
+    mp_arr[mpid].cleanups = cleanup;
+
+    return MP_ERRNO_SUCCESS;
 }
 
 /****************************************************************************
 |*
-|* Function: mppush
+|* Function: mpset_upstream
 |*
 |* Description;
 |*
-|*     Moves the current memory pool ID to the stack and makes mpid the 
-|*     current one. The stack has only one element, for now.
+|*     Sets the provider of the blocks of the memory pool mpid: its 
+|*     block_alloc() callback delivers the memory of each new block and 
+|*     block_free() takes it back with the same size, both with ctx. The 
+|*     provider is copied. With a provider even the big chunks are taken 
+|*     from it, no own mapping is used. NULL sets back the default (blocks 
+|*     of the heap). It can only be set while the memory pool has no block.
 |*
 |* Return:
 |*     MP_ERRNO_SUCCESS if success
-|*     MP_ERRNO_MPID, MP_ERRNO_NOIN if error
+|*     MP_ERRNO_MPID, MP_ERRNO_NOIN, MP_ERRNO_THRD, MP_ERRNO_PARM if error
 |*
 |* Author: Javier Gutierrez (JG)
 |*
 |* Modifications:
-|* 20140811    JG    Initial version
+|* 20261019    JG    Initial version
 |*
 ****************************************************************************/
-int mppush(int mpid)
+int mpset_upstream(int mpid, const mpupstream *upstream)
 {
+    mp *curr_mp = NULL;
+
     mperrno = MP_ERRNO_SUCCESS;
 
     /* Memory pool ID out of limit */
     if (mpid > MP_MAX_MP_ID -1 || mpid < 0)
     {
         mperrno = MP_ERRNO_MPID;
-        return MP_ERRNO_MPID;
+        return mperrno;
     }
 
-    /* Memory pool ID not initiliazed */
-    if (mp_arr[mpid].init != 'Y' && mpid != MP_DEF_MP_ID)
+    curr_mp = &mp_arr[mpid];
+    if (curr_mp->init != 'Y' && mpid != MP_DEF_MP_ID)
     {
         mperrno = MP_ERRNO_NOIN;
-        return MP_ERRNO_NOIN;
+        return mperrno;
     }
 
-    /* Push */
-    mp_prev_mpid = mp_cur_mpid;
-    mp_cur_mpid = mpid;
+#if MP_THREAD_SAFE == 1
+    if (curr_mp->init == 'Y' && MP_THREAD_EQ(curr_mp->thread_id, MP_CURR_THREAD) == 0)
+    {
+        mperrno = MP_ERRNO_THRD;
+        return mperrno;
+    }
+#endif
+
+    /* Blocks are given back to where they were taken from, the range of a VM pool is its own */
+    if ((upstream != NULL && (upstream->block_alloc == NULL || upstream->block_free == NULL)) ||
+            curr_mp->block_cnt > 0 || curr_mp->type == MP_TYPE_VM)
+    {
+        mperrno = MP_ERRNO_PARM;
+        return mperrno;
+    }
+
+    if (upstream == NULL)
+    {
+        memset(&curr_mp->upstream, 0x00, sizeof(curr_mp->upstream));
+    }
+    else
+    {
+        curr_mp->upstream = *upstream;
+    }
 
     return MP_ERRNO_SUCCESS;
 }
 
 /****************************************************************************
 |*
-|* Function: mppop
+|* Function: mpupstream_malloc
 |*
 |* Description;
 |*
-|*     Sets the previous Memory Pool ID as the current one
+|*     Provider of blocks (see mpset_upstream()) taking them with malloc()
+|*     and giving them back with free(). The blocks are not zero.
 |*
 |* Return:
-|*     MP_ERRNO_SUCCESS if success
-|*     MP_ERRNO_NOPP if error
+|*     pointer to the provider
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+const mpupstream *mpupstream_malloc()
+{
+    return &mp_up_malloc;
+}
+
+/****************************************************************************
+|*
+|* Function: mpupstream_mmap
+|*
+|* Description;
+|*
+|*     Provider of blocks (see mpset_upstream()) mapping each of them on its
+|*     own (mmap(), VirtualAlloc()) in whole pages, given back to the system
+|*     at once. The blocks are zero.
+|*
+|* Return:
+|*     pointer to the provider
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+const mpupstream *mpupstream_mmap()
+{
+    return &mp_up_mmap;
+}
+
+/****************************************************************************
+|*
+|* Function: mpstrerror
+|*
+|* Description;
+|*
+|*     Delivers the current error message string
+|*
+|* Return:
+|*     error message string
 |*
 |* Author: Javier Gutierrez (JG)
 |*
@@ -935,279 +5076,489 @@ int mppush(int mpid)
 |* 20140811    JG    Initial version
 |*
 ****************************************************************************/
-int mppop()
+char *mpstrerror()
 {
-    mperrno = MP_ERRNO_SUCCESS;
+    switch (mperrno)
+    {
+        case MP_ERRNO_SUCCESS:
+            return "";
+        case MP_ERRNO_MPID:
+            return MP_ERRSTR_MPID;
+        case MP_ERRNO_SZNG:
+            return MP_ERRSTR_SZNG;
+        case MP_ERRNO_NOMM:
+            return MP_ERRSTR_NOMM;
+        case MP_ERRNO_EXMM:
+            return MP_ERRSTR_EXMM;
+        case MP_ERRNO_ALLO:
+            return MP_ERRSTR_ALLO;
+        case MP_ERRNO_EXAL:
+            return MP_ERRSTR_EXAL;
+        case MP_ERRNO_NOIN:
+            return MP_ERRSTR_NOIN;
+        case MP_ERRNO_EXMP:
+            return MP_ERRSTR_EXMP;
+        case MP_ERRNO_NOPP:
+            return MP_ERRSTR_NOPP;
+        case MP_ERRNO_DISP:
+            return MP_ERRSTR_DISP;
+        case MP_ERRNO_PARM:
+            return MP_ERRSTR_PARM;
+        case MP_ERRNO_THRD:
+            return MP_ERRSTR_THRD;
+        case MP_ERRNO_NOWN:
+            return MP_ERRSTR_NOWN;
+        case MP_ERRNO_SYSE:
+            return strerror(errno); // TODO replace with reentrant
+    }
 
-    /* Nothing to pop */
-    if (mp_prev_mpid < 0 || mp_prev_mpid > MP_MAX_MP_ID -1)
+    return "Error number not recognized";
+}
+
+/****************************************************************************
+|*
+|* Function: mpadd_tot_phy_mem
+|*
+|* Description;
+|*
+|*     Atomic function to modify the current total physical memory used
+|*
+|* Return:
+|*     MP_ERRNO_SUCCESS if success
+|*     MP_ERRNO_EXMM if error
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20150101    JG    Initial version
+|*
+****************************************************************************/
+static int mpadd_tot_phy_mem(size_t size2add, int sign)
+{
+#if MP_THREAD_SAFE == 1 /* { */
+
+#   if _WIN32 /* { */
+    if ((mperrno = mp_mutex_init(&mp_mutex_p)) != MP_ERRNO_SUCCESS)
     {
-        mperrno = MP_ERRNO_NOPP;
-        return MP_ERRNO_NOPP;
+        return mperrno;
     }
+#   endif /* } _WIN32 */
 
-    /* Pop */
-    mp_cur_mpid = mp_prev_mpid;
-    mp_prev_mpid = MP_NO_MP_ID;
+	MP_MUTEX_LOCK(mp_mutex_p);
+#endif /* } MP_THREAD_SAFE */
+
+    /* Set memory limit */
+    if (mp_mem_limit <= 0)
+    {
+        if (sizeof(size_t) > 4)
+        {
+            mp_mem_limit = MP_DEF_MEM_LIMIT_64;
+        }
+        else
+        {
+            mp_mem_limit = MP_DEF_MEM_LIMIT_32;
+        }
+    }
+
+    if (sign >= 0 && mp_tot_phy_mem + size2add > mp_mem_limit)
+    {
+#if MP_THREAD_SAFE == 1
+        MP_MUTEX_UNLOCK(mp_mutex_p);
+#endif
+        mperrno = MP_ERRNO_EXMM;
+        return MP_ERRNO_EXMM;
+    }
+
+    mp_tot_phy_mem += (size2add * ((sign >= 0) - (sign < 0)));
+
+#if MP_THREAD_SAFE == 1
+    MP_MUTEX_UNLOCK(mp_mutex_p);
+#endif
 
     return MP_ERRNO_SUCCESS;
 }
 
 /****************************************************************************
 |*
-|* Function: mpset
+|* Function: mplock
 |*
 |* Description;
 |*
-|*     Sets the current memory pool ID
+|*     Locks the mutex protecting the data shared by all threads.
 |*
 |* Return:
 |*     MP_ERRNO_SUCCESS if success
-|*     MP_ERRNO_MPID, MP_ERRNO_NOIN, MP_ERRNO_THRD if error
+|*     error of mp_mutex_init() if error
 |*
 |* Author: Javier Gutierrez (JG)
 |*
 |* Modifications:
-|* 20140811    JG    Initial version
+|* 20261019    JG    Initial version
 |*
 ****************************************************************************/
-int mpset(int mpid)
+static int mplock()
 {
-    mperrno = MP_ERRNO_SUCCESS;
+#if MP_THREAD_SAFE == 1 /* { */
+#   if _WIN32 /* { */
+    int rc = MP_ERRNO_SUCCESS;
 
-    /* Memory pool ID out of limit */
-    if (mpid > MP_MAX_MP_ID -1 || mpid < 0)
+    if ((rc = mp_mutex_init(&mp_mutex_p)) != MP_ERRNO_SUCCESS)
     {
-        mperrno = MP_ERRNO_MPID;
-        return MP_ERRNO_MPID;
+        return rc;
+    }
+#   endif /* } _WIN32 */
+
+    MP_MUTEX_LOCK(mp_mutex_p);
+#endif /* } MP_THREAD_SAFE */
+
+    return MP_ERRNO_SUCCESS;
+}
+
+/****************************************************************************
+|*
+|* Function: mpunlock
+|*
+|* Description;
+|*
+|*     Unlocks the mutex locked by mplock().
+|*
+|* Return:
+|*     n/a
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+static void mpunlock()
+{
+#if MP_THREAD_SAFE == 1
+    MP_MUTEX_UNLOCK(mp_mutex_p);
+#endif
+}
+
+/****************************************************************************
+|*
+|* Function: mpfind_owner
+|*
+|* Description;
+|*
+|*     Looks up ptr in the ownership index. If block is not NULL it gets the
+|*     block holding ptr. mperrno is not modified. Readers do not lock: the
+|*     index is a sequence lock, looked up again if it changed meanwhile,
+|*     and its arrays are not given back while readers can be on them (see 
+|*     mprng_add()). The lock is only taken if it keeps changing.
+|*
+|* Return:
+|*     the memory pool ID owning ptr
+|*     MP_NO_MP_ID if ptr is NULL or it was not delivered by any pool
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|* 20261019    JG    Lookup without the lock
+|*
+****************************************************************************/
+static int mpfind_owner(void *ptr, mpblock **block)
+{
+    mprange *rng = NULL;
+    mpblock *rng_block = NULL;
+    int mpid = MP_NO_MP_ID;
+    unsigned int seq = 0;
+    int i = 0;
+
+    if (ptr == NULL || mp_rng_cnt == 0)
+    {
+        return MP_NO_MP_ID;
+    }
+
+    /* Without the lock: the result holds if no change of the index started or ended meanwhile */
+    for (i = 0; i < MP_RNG_TRIES; i++)
+    {
+        seq = mp_rng_seq;
+        MP_ATOMIC_FENCE();
+        if (seq & 1)
+        {
+            continue;
+        }
+        mpid = MP_NO_MP_ID;
+        if ((rng = mprng_find(ptr)) != NULL)
+        {
+            mpid = rng->mpid;
+            rng_block = rng->block;
+        }
+        MP_ATOMIC_FENCE();
+        if (mp_rng_seq == seq)
+        {
+            if (block != NULL && mpid >= 0)
+            {
+                *block = rng_block;
+            }
+            return mpid;
+        }
     }
 
-    /* Memory pool ID not initiliazed */
-    if (mp_arr[mpid].init != 'Y' && mpid != MP_DEF_MP_ID)
+    /* The index keeps changing */
+    if (mplock() != MP_ERRNO_SUCCESS)
     {
-        mperrno = MP_ERRNO_NOIN;
-        return MP_ERRNO_NOIN;
+        return MP_NO_MP_ID;
     }
-
-#if MP_THREAD_SAFE == 1
-    /* Check thread ID */
-    if (MP_THREAD_EQ(mp_arr[mpid].thread_id, MP_CURR_THREAD) == 0)
+    mpid = MP_NO_MP_ID;
+    if ((rng = mprng_find(ptr)) != NULL)
     {
-        mperrno = MP_ERRNO_THRD;
-        return MP_ERRNO_THRD;
+        mpid = rng->mpid;
+        if (block != NULL)
+        {
+            *block = rng->block;
+        }
     }
-#endif
-
-    /* Set */
-    mp_cur_mpid = mpid;
+    mpunlock();
 
-    return MP_ERRNO_SUCCESS;
+    return mpid;
 }
 
 /****************************************************************************
 |*
-|* Function: mpget
+|* Function: mprng_add
 |*
 |* Description;
 |*
-|*     Gets the current memory pool ID
+|*     Registers the range of block in the ownership index. The range is 
+|*     appended unsorted, once MP_RNG_TAIL ranges are pending they are 
+|*     merged into the sorted part. The mutex must be locked. The index 
+|*     grows into a new array: the former one is kept, linked from the slot
+|*     before the ranges, until mpdel_all(), as lookups without the lock 
+|*     can still be reading it.
 |*
 |* Return:
-|*     the current memory pool ID
+|*     MP_ERRNO_SUCCESS if success
+|*     MP_ERRNO_ALLO if error
 |*
 |* Author: Javier Gutierrez (JG)
 |*
 |* Modifications:
-|* 20140811    JG    Initial version
+|* 20261019    JG    Initial version
+|* 20261019    JG    Sequence lock, former arrays kept
 |*
 ****************************************************************************/
-int mpget()
+static int mprng_add(int mpid, mpblock *block)
 {
-    return mp_cur_mpid;
+    int cnt = mp_rng_cnt;
+
+    if (cnt >= mp_rng_max)
+    {
+        int rng_max = mp_rng_max <= 0 ? MP_RNG_TAIL * 2 : mp_rng_max * 2;
+        mprange *rng_arr = (mprange *)MP_SYS_MALLOC((rng_max +1) * sizeof(mprange));
+
+        if (rng_arr == NULL)
+        {
+            return MP_ERRNO_ALLO;
+        }
+
+        /* The slot before the ranges links the former array, still read by lookups without the lock */
+        rng_arr[0].start = mp_rng_arr != NULL ? (uchar *)(mp_rng_arr -1) : NULL;
+        rng_arr++;
+        if (cnt > 0)
+        {
+            memcpy(rng_arr, mp_rng_arr, cnt * sizeof(mprange));
+        }
+
+        /* Published before the count grows beyond the former array */
+        mp_rng_arr = rng_arr;
+        mp_rng_max = rng_max;
+        MP_ATOMIC_FENCE();
+    }
+
+    mp_rng_seq++;
+    MP_ATOMIC_FENCE();
+    mp_rng_arr[cnt].start = (uchar *)block;
+    mp_rng_arr[cnt].end = block->block + block->size;
+    mp_rng_arr[cnt].block = block;
+    mp_rng_arr[cnt].mpid = mpid;
+    MP_ATOMIC_FENCE();
+    mp_rng_cnt = cnt +1;
+
+    if (mp_rng_cnt - mp_rng_srt >= MP_RNG_TAIL)
+    {
+        mprng_merge();
+    }
+    MP_ATOMIC_FENCE();
+    mp_rng_seq++;
+
+    return MP_ERRNO_SUCCESS;
 }
 
 /****************************************************************************
 |*
-|* Function: mpdel
+|* Function: mprng_del
 |*
 |* Description;
 |*
-|*     Deletes a given memory pool
+|*     Removes the range of block from the ownership index. The mutex must 
+|*     be locked.
 |*
 |* Return:
-|*     MP_ERRNO_SUCCESS if success
-|*     MP_ERRNO_MPID, MP_ERRNO_THRD if error
+|*     n/a
 |*
 |* Author: Javier Gutierrez (JG)
 |*
 |* Modifications:
-|* 20140811    JG    Initial version
+|* 20261019    JG    Initial version
+|* 20261019    JG    Sequence lock
 |*
 ****************************************************************************/
-int mpdel(int mpid)
+static void mprng_del(mpblock *block)
 {
-    mpblock *curr_block = NULL;
-    mpblock *temp_block = NULL;
-
-    mperrno = MP_ERRNO_SUCCESS;
+    mprange *rng = mprng_find(block); /* The header is the start of the range */
+    int i = 0;
 
-    /* Memory pool ID out of limit */
-    if (mpid > MP_MAX_MP_ID -1 || mpid < 0)
+    if (rng == NULL || rng->block != block)
     {
-        mperrno = MP_ERRNO_MPID;
-        return MP_ERRNO_MPID;
+        return;
     }
 
-#if MP_THREAD_SAFE == 1
-    /* Check thread ID */
-    if (MP_THREAD_EQ(mp_arr[mpid].thread_id, MP_CURR_THREAD) == 0)
+    mp_rng_seq++;
+    MP_ATOMIC_FENCE();
+    i = rng - mp_rng_arr;
+    if (i < mp_rng_srt)
     {
-        mperrno = MP_ERRNO_THRD;
-        return MP_ERRNO_THRD;
+        memmove(&mp_rng_arr[i], &mp_rng_arr[i +1], (mp_rng_cnt - i -1) * sizeof(mprange));
+        mp_rng_srt--;
     }
-#endif
-
-    /* Deallocating all memory blocks in given memory pool */
-    curr_block = mp_arr[mpid].head_block;
-    while(curr_block != NULL)
+    else
     {
-        if (curr_block->block != NULL)
-        {
-            free(curr_block->block);
-        }
-        mpadd_tot_phy_mem(curr_block->size, -1); /* No need to check for error */
-        temp_block = curr_block;
-        curr_block = curr_block->next;
-        free(temp_block);
+        mp_rng_arr[i] = mp_rng_arr[mp_rng_cnt -1];
     }
-
-#ifndef MP_VALGRIND_NOT_AVAILABLE
-    // VVALGRIND_MEMPOOL_TRIM((void *)&mp_arr[mpid], curr_block->block, 0);
-    VALGRIND_DESTROY_MEMPOOL((void *)&mp_arr[mpid]);
-#endif
-    memset(&mp_arr[mpid], 0x00, sizeof(mp));
-    mp_arr[mpid].head_block = NULL;
-    mp_arr[mpid].tail_block = NULL;
-
-    return MP_ERRNO_SUCCESS;
+    mp_rng_cnt--;
+    MP_ATOMIC_FENCE();
+    mp_rng_seq++;
 }
 
 /****************************************************************************
 |*
-|* Function: mpdel_all
+|* Function: mprng_del_mpid
 |*
 |* Description;
 |*
-|*     Deletes all memory pools. This should be called by the main thread.
+|*     Removes all ranges of memory pool mpid from the ownership index in a
+|*     single pass. The mutex must be locked. The arrays of the index stay 
+|*     even if it gets empty, mpdel_all() gives them back (see mprng_free()).
 |*
 |* Return:
-|*     MP_ERRNO_SUCCESS
+|*     n/a
 |*
 |* Author: Javier Gutierrez (JG)
 |*
 |* Modifications:
-|* 20140811    JG    Initial version
+|* 20261019    JG    Initial version
+|* 20261019    JG    Sequence lock, arrays not freed
 |*
 ****************************************************************************/
-int mpdel_all()
+static void mprng_del_mpid(int mpid)
 {
-    mpblock *curr_block = NULL;
-    mpblock *temp_block = NULL;
     int i = 0;
+    int j = 0;
+    int srt = 0;
 
-    for (i = 0; i < MP_MAX_MP_ID; i ++)
+    mp_rng_seq++;
+    MP_ATOMIC_FENCE();
+    for (i = 0; i < mp_rng_cnt; i++)
     {
-        if (mp_arr[i].init != 'Y')
+        if (mp_rng_arr[i].mpid == mpid)
+        {
             continue;
-
-        curr_block = mp_arr[i].head_block;
-        while(curr_block != NULL)
+        }
+        if (i < mp_rng_srt)
         {
-            if (curr_block->block != NULL)
-            {
-                free(curr_block->block);
-            }
-            temp_block = curr_block;
-            curr_block = curr_block->next;
-            free(temp_block);
+            srt++;
         }
-
-#ifndef MP_VALGRIND_NOT_AVAILABLE
-        // VVALGRIND_MEMPOOL_TRIM((void *)&mp_arr[i], curr_block->block, 0);
-        VALGRIND_DESTROY_MEMPOOL((void *)&mp_arr[i]);
-#endif
-        memset(&mp_arr[i], 0x00, sizeof(mp));
-        mp_arr[i].head_block = NULL;
-        mp_arr[i].tail_block = NULL;
+        mp_rng_arr[j++] = mp_rng_arr[i];
     }
-
-    mp_tot_phy_mem = 0;
-
-    return MP_ERRNO_SUCCESS;
+    mp_rng_cnt = j;
+    mp_rng_srt = srt;
+    MP_ATOMIC_FENCE();
+    mp_rng_seq++;
 }
 
 /****************************************************************************
 |*
-|* Function: mpclr
+|* Function: mprng_find
 |*
 |* Description;
 |*
-|*     Clears to 0 all memory used in the given memory pool.
+|*     Finds the range holding ptr: binary search on the sorted part of the
+|*     ownership index and linear search on the pending ranges. Without the
+|*     mutex locked the result is only valid if the index did not change 
+|*     meanwhile (see mpfind_owner()), but it never reads beyond the array.
 |*
 |* Return:
-|*     MP_ERRNO_SUCCESS if success
-|*     MP_ERRNO_MPID, MP_ERRNO_THRD if error
+|*     a pointer to the range holding ptr
+|*     NULL if not found
 |*
 |* Author: Javier Gutierrez (JG)
 |*
 |* Modifications:
-|* 20140811    JG    Initial version
+|* 20261019    JG    Initial version
+|* 20261019    JG    Safe without the mutex
 |*
 ****************************************************************************/
-int mpclr(int mpid)
+static mprange *mprng_find(void *ptr)
 {
-    mpblock *curr_block = NULL;
+    mprange *arr = NULL;
+    int cnt = mp_rng_cnt;
+    int srt = 0;
+    int lo = 0;
+    int hi = 0;
+    int i = 0;
 
-    mperrno = MP_ERRNO_SUCCESS;
+    /* The count first: an array holding it was published before it */
+    MP_ATOMIC_FENCE();
+    arr = mp_rng_arr;
+    srt = mp_rng_srt;
+    hi = srt = srt < cnt ? srt : cnt;
 
-    /* Memory pool ID out of limit */
-    if (mpid > MP_MAX_MP_ID -1 || mpid < 0)
+    /* Last sorted range starting at or before ptr */
+    while (lo < hi)
     {
-        mperrno = MP_ERRNO_MPID;
-        return MP_ERRNO_MPID;
-    }
+        int mid = lo + (hi - lo) / 2;
 
-#if MP_THREAD_SAFE == 1
-    /* Check thread ID */
-    if (MP_THREAD_EQ(mp_arr[mpid].thread_id, MP_CURR_THREAD) == 0)
+        if (arr[mid].start <= (uchar *)ptr)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    if (lo > 0 && (uchar *)ptr < arr[lo -1].end)
     {
-        mperrno = MP_ERRNO_THRD;
-        return MP_ERRNO_THRD;
+        return &arr[lo -1];
     }
-#endif
 
-    /* Set the used parameter of each memory block to zero */
-    curr_block = mp_arr[mpid].head_block;
-    while(curr_block != NULL)
+    for (i = srt; i < cnt; i++)
     {
-        curr_block->used = 0;
-        curr_block = curr_block->next;
+        if ((uchar *)ptr >= arr[i].start && (uchar *)ptr < arr[i].end)
+        {
+            return &arr[i];
+        }
     }
 
-#ifndef MP_VALGRIND_NOT_AVAILABLE
-    // VALGRIND_MEMPOOL_TRIM((void *)&mp_arr[mpid], curr_block->block, 0);
-#endif
-
-    return MP_ERRNO_SUCCESS;
+    return NULL;
 }
 
 /****************************************************************************
 |*
-|* Function: mpset_memlim
+|* Function: mprng_merge
 |*
 |* Description;
 |*
-|*     Sets the memory limit
+|*     Sorts the pending ranges of the ownership index and merges them, from
+|*     the end, into the sorted part. The mutex must be locked. The pending 
+|*     ranges are few and sorted by insertion, as qsort() might call malloc()
+|*     and reach a malloc() interposer while the mutex is locked.
 |*
 |* Return:
 |*     n/a
@@ -1215,180 +5566,174 @@ int mpclr(int mpid)
 |* Author: Javier Gutierrez (JG)
 |*
 |* Modifications:
-|* 20140811    JG    Initial version
+|* 20261019    JG    Initial version
+|* 20261019    JG    Insertion sort instead of qsort()
 |*
 ****************************************************************************/
-void mpset_memlim(size_t size)
+static void mprng_merge()
 {
-    mp_mem_limit = size;
-    return;
+    mprange tail[MP_RNG_TAIL];
+    mprange rng;
+    int i = mp_rng_srt -1;
+    int j = mp_rng_cnt - mp_rng_srt -1;
+    int k = mp_rng_cnt -1;
+    int m = 0;
+    int n = 0;
+
+    memcpy(tail, &mp_rng_arr[mp_rng_srt], (j +1) * sizeof(mprange));
+    for (m = 1; m <= j; m++)
+    {
+        rng = tail[m];
+        for (n = m; n > 0 && tail[n -1].start > rng.start; n--)
+        {
+            tail[n] = tail[n -1];
+        }
+        tail[n] = rng;
+    }
+
+    while (j >= 0)
+    {
+        if (i >= 0 && mp_rng_arr[i].start > tail[j].start)
+        {
+            mp_rng_arr[k--] = mp_rng_arr[i--];
+        }
+        else
+        {
+            mp_rng_arr[k--] = tail[j--];
+        }
+    }
+
+    mp_rng_srt = mp_rng_cnt;
 }
 
 /****************************************************************************
 |*
-|* Function: mpget_memlim
+|* Function: mprng_free
 |*
 |* Description;
 |*
-|*     Gets the current memory limit
+|*     Gives back the arrays of the ownership index, the current one and the
+|*     former ones linked from it, once it is empty. The mutex must be 
+|*     locked and no lookup can be running.
 |*
 |* Return:
-|*     memory limit
+|*     n/a
 |*
 |* Author: Javier Gutierrez (JG)
 |*
 |* Modifications:
-|* 20140813    JG    Initial version
+|* 20261019    JG    Initial version
 |*
 ****************************************************************************/
-size_t mpget_memlim()
+static void mprng_free()
 {
-    return mp_mem_limit;
+    mprange *rng_arr = mp_rng_arr != NULL ? mp_rng_arr -1 : NULL;
+    mprange *prev = NULL;
+
+    if (mp_rng_cnt > 0)
+    {
+        return;
+    }
+
+    while (rng_arr != NULL)
+    {
+        prev = (mprange *)rng_arr[0].start;
+        MP_SYS_FREE(rng_arr);
+        rng_arr = prev;
+    }
+    mp_rng_arr = NULL;
+    mp_rng_max = 0;
+    mp_rng_srt = 0;
 }
 
 /****************************************************************************
 |*
-|* Function: mpset_blksz
+|* Function: mpupstream_malloc_alloc
 |*
 |* Description;
 |*
-|*     Sets the memory block size
+|*     block_alloc() of the provider mpupstream_malloc(). malloc() aligns 
+|*     for any type, so align is always met.
 |*
 |* Return:
-|*     n/a
+|*     pointer to the memory, NULL if not available
 |*
 |* Author: Javier Gutierrez (JG)
 |*
 |* Modifications:
-|* 20150103    JG    Initial version
+|* 20261019    JG    Initial version
 |*
 ****************************************************************************/
-void mpset_blksz(size_t size)
+static void *mpupstream_malloc_alloc(size_t size, size_t align, void *ctx)
 {
-    mp_blk_sz = size;
-    return;
+    return MP_SYS_MALLOC(size);
 }
 
 /****************************************************************************
 |*
-|* Function: mpget_blksz
+|* Function: mpupstream_malloc_free
 |*
 |* Description;
 |*
-|*     Gets the current memory limit
+|*     block_free() of the provider mpupstream_malloc()
 |*
 |* Return:
-|*     memory limit
+|*     n/a
 |*
 |* Author: Javier Gutierrez (JG)
 |*
 |* Modifications:
-|* 20150103    JG    Initial version
+|* 20261019    JG    Initial version
 |*
 ****************************************************************************/
-size_t mpget_blksz()
+static void mpupstream_malloc_free(void *ptr, size_t size, void *ctx)
 {
-    return mp_blk_sz;
+    MP_SYS_FREE(ptr);
 }
 
 /****************************************************************************
 |*
-|* Function: mpstrerror
+|* Function: mpupstream_mmap_alloc
 |*
 |* Description;
 |*
-|*     Delivers the current error message string
+|*     block_alloc() of the provider mpupstream_mmap(). Mappings are page 
+|*     aligned.
 |*
 |* Return:
-|*     error message string
+|*     pointer to the memory, NULL if not available
 |*
 |* Author: Javier Gutierrez (JG)
 |*
 |* Modifications:
-|* 20140811    JG    Initial version
+|* 20261019    JG    Initial version
 |*
 ****************************************************************************/
-char *mpstrerror()
+static void *mpupstream_mmap_alloc(size_t size, size_t align, void *ctx)
 {
-    switch (mperrno)
-    {
-        case MP_ERRNO_SUCCESS:
-            return "";
-        case MP_ERRNO_MPID:
-            return MP_ERRSTR_MPID;
-        case MP_ERRNO_SZNG:
-            return MP_ERRSTR_SZNG;
-        case MP_ERRNO_NOMM:
-            return MP_ERRSTR_NOMM;
-        case MP_ERRNO_EXMM:
-            return MP_ERRSTR_EXMM;
-        case MP_ERRNO_ALLO:
-            return MP_ERRSTR_ALLO;
-        case MP_ERRNO_EXAL:
-            return MP_ERRSTR_EXAL;
-        case MP_ERRNO_NOIN:
-            return MP_ERRSTR_NOIN;
-        case MP_ERRNO_EXMP:
-            return MP_ERRSTR_EXMP;
-        case MP_ERRNO_NOPP:
-            return MP_ERRSTR_NOPP;
-        case MP_ERRNO_DISP:
-            return MP_ERRSTR_DISP;
-        case MP_ERRNO_PARM:
-            return MP_ERRSTR_PARM;
-        case MP_ERRNO_THRD:
-            return MP_ERRSTR_THRD;
-        case MP_ERRNO_SYSE:
-            return strerror(errno); // TODO replace with reentrant
-    }
-
-    return "Error number not recognized";
+    return mp_vm_map(size);
 }
 
 /****************************************************************************
 |*
-|* Function: mpadd_tot_phy_mem
+|* Function: mpupstream_mmap_free
 |*
 |* Description;
 |*
-|*     Atomic function to modify the current total physical memory used
+|*     block_free() of the provider mpupstream_mmap()
 |*
 |* Return:
-|*     MP_ERRNO_SUCCESS if success
-|*     MP_ERRNO_EXMM if error
+|*     n/a
 |*
 |* Author: Javier Gutierrez (JG)
 |*
 |* Modifications:
-|* 20150101    JG    Initial version
+|* 20261019    JG    Initial version
 |*
 ****************************************************************************/
-static int mpadd_tot_phy_mem(size_t size2add, int sign)
+static void mpupstream_mmap_free(void *ptr, size_t size, void *ctx)
 {
-#if MP_THREAD_SAFE == 1 /* { */
-
-#   if _WIN32 /* { */
-    if ((mperrno = mp_mutex_init(&mp_mutex_p)) != MP_ERRNO_SUCCESS)
-    {
-        return mperrno;
-    }
-#   endif /* } _WIN32 */
-
-	MP_MUTEX_LOCK(mp_mutex_p);
-#endif /* } MP_THREAD_SAFE */
-
-    if (sign >= 0 && mp_tot_phy_mem + size2add > mp_mem_limit)
-    {
-        mperrno = MP_ERRNO_EXMM;
-        return MP_ERRNO_EXMM;
-    }
-
-    mp_tot_phy_mem += (size2add * ((sign >= 0) - (sign < 0)));
-
-#if MP_THREAD_SAFE == 1
-    MP_MUTEX_UNLOCK(mp_mutex_p);
-#endif
-
-    return MP_ERRNO_SUCCESS;
+    mp_vm_release(ptr, size);
 }
+
 /* EOF */
@@ -25,6 +25,7 @@
 |*
 |* When         Who     Pos     What
 |* 20140801     JG              Initial version
+|* 20261019     JG              C linkage for C++, internal structures hidden from it
 |*
 ****************************************************************************/
 
@@ -35,12 +36,19 @@
 #include <stdarg.h>
 
 /* Defines */
-#define MP_THREAD_SAFE 1                                    /* 1 = Thread safe. Deactivate if threads are not needed */
+#ifndef MP_THREAD_SAFE
+#   define MP_THREAD_SAFE 1                                 /* 1 = Thread safe. Build with -DMP_THREAD_SAFE=0 if threads are not needed */
+#endif
+/* #define MP_DEBUG */                                      /* mpfree_mpid() and mprealloc_mpid() reject pointers of other pools */
 
 #if MP_THREAD_SAFE == 1
 #   include "mp_os.h"
 #endif
 
+#ifdef __cplusplus /* { */
+extern "C" {
+#endif /* } __cplusplus */
+
 #ifndef TRUE
     #define FALSE 0
     #define TRUE (!FALSE)
@@ -52,8 +60,39 @@
 #define MP_DEF_MP_DESCR          "Default"                  /* Description for the default memory pool */
 #define MP_DEF_ALIGN             8                          /* Default memory alignment in our pool */
 #define MP_DEF_BLK_SZ            (250 * 1024)               /* Default size of each block inside the each  memory pool (250 Kb)*/
+#define MP_DEF_MAP_SZ            (1024 * 1024)              /* Chunks from this size (1 Mb) get their own mapping, grown by mprealloc() without copying */
+#define MP_DEF_BLK_ARR_SZ        16                         /* Initial number of slots of the array of blocks of each memory pool */
+#define MP_CACHE_LINE            64                         /* Size of a cache line, step of the colors of the blocks */
+#define MP_DEF_COLORS            0                          /* Default number of colors of the blocks (0 = no coloring) */
+#define MP_DEF_RCY_SZ            0                          /* Default size of the depot of recycled blocks (0 = no recycling) */
+#define MP_RCY_MAG_SZ            8                          /* Recycled blocks kept by each thread before going to the depot */
+#define MP_CLR_RESET             0                          /* mpclr() only resets the memory pool, the old content stays */
+#define MP_CLR_ZERO              1                          /* mpclr() sets to zero the used memory (non-temporal stores) */
+#define MP_CLR_DISCARD           2                          /* mpclr() gives back the used pages, zero when used again */
+#define MP_CLR_DISCARD_MIN       (64 * 1024)                /* MP_CLR_DISCARD: smaller used memory of a block is set to zero */
+#define MP_RSV_PREFAULT          1                          /* mpreserve(): the pages of the memory reserved are faulted in */
+#define MP_NO_TRIM               ((size_t)-1)               /* mpset_trim(): no trim when the memory pool is cleared */
+#define MP_MAX_ALN_CLS           4                          /* Maximum number of alignment classes of each memory pool */
+#define MP_SOA_ALIGN             64                         /* Alignment of the columns delivered by mpmalloc_soa() (a cache line) */
+#define MP_DEF_INTERN_SZ         64                         /* Initial number of slots of the intern table of each memory pool */
 #define MP_DEF_MEM_LIMIT_64      ((size_t)5 * 1024 * 1024 * 1024)    /* Default memory usage limit (5 Gb for 64 bits) */
 #define MP_DEF_MEM_LIMIT_32      ((size_t)3 * 1024 * 1024 * 1024)    /* Default memory usage limit (3 Gb for 32 bits) */
+#define MP_DEF_VM_SZ_64          ((size_t)64 * 1024 * 1024 * 1024)   /* Default address range reserved by mpnew_vm() (64 Gb for 64 bits) */
+#define MP_DEF_VM_SZ_32          ((size_t)512 * 1024 * 1024)         /* Default address range reserved by mpnew_vm() (512 Mb for 32 bits) */
+
+#define MP_TYPE_BLK              0                          /* Memory pool made of a chain of heap blocks */
+#define MP_TYPE_VM               1                          /* Memory pool made of one reserved range of virtual memory */
+#define MP_TYPE_SLAB             2                          /* Memory pool made of a chain of heap blocks holding objects of one size */
+
+#define MP_NUMA_NONE             0                          /* NUMA policy of the system: pages placed where first touched */
+#define MP_NUMA_LOCAL            1                          /* NUMA: blocks placed, and touched, on the node of the owning thread */
+#define MP_NUMA_BIND             2                          /* NUMA: blocks placed on one node */
+#define MP_NUMA_INTERLEAVE       3                          /* NUMA: pages of the blocks spread over all nodes */
+#define MP_NUMA_MAX_NODES        64                         /* Maximum number of NUMA nodes handled */
+
+#define MP_BLK_HEAP              0                          /* Memory block taken from the heap */
+#define MP_BLK_MAP               1                          /* Memory block holding one big chunk in its own mapping */
+#define MP_BLK_BUF               2                          /* Memory block in a buffer of the caller (mpnew_buf()), never given back */
 
 #define MP_MAX_DESCR_LEN         128
 
@@ -70,6 +109,7 @@
 #define MP_ERRNO_DISP            -100                       /* Display error */
 #define MP_ERRNO_PARM            -110                       /* Error on Function parameter */
 #define MP_ERRNO_THRD            -130                       /* Expected different thread ID */
+#define MP_ERRNO_NOWN            -140                       /* Pointer not owned by the memory pool(s) */
 #define MP_ERRNO_SYSE            -990                       /* System error. In this case errno message is delivered */
 
 #define MP_ERRSTR_MPID           "Memory pool ID out of range"
@@ -84,29 +124,76 @@
 #define MP_ERRSTR_DISP           "Error displaying a message"
 #define MP_ERRSTR_PARM           "Error on parameter passed to the function"
 #define MP_ERRSTR_THRD           "Expected different thread ID"
+#define MP_ERRSTR_NOWN           "Pointer was not delivered by the memory pool"
 #define MP_ERRSTR_SYSE           "System error"             /* This message is not delivered but strerror(errno) */
 
 /* Typedefs and structures */
 typedef unsigned char uchar;
 
+typedef struct _mpupstream
+{
+    void              *(*block_alloc)(size_t size, size_t align, void *ctx); /* Memory of a new block, NULL if not available */
+    void              (*block_free)(void *ptr, size_t size, void *ctx);      /* Gives back a block of block_alloc() */
+    void              *ctx;                                  /* Context given to both callbacks */
+    int               zeroed;                                /* TRUE if the blocks are delivered set to zero */
+} mpupstream;
+
+#ifndef __cplusplus /* { Internal structures, in C++ mp is the namespace of mp.hpp */
 typedef struct _mpblock
 {
     size_t            size;                                  /* Size of the memory block (*block) */
     size_t            used;                                  /* Amount of memory used in the memory block */
-    uchar             *block;                                /* Pointer to the actual memory block */
-    struct _mpblock   *next;                                 /* Pointer to the next memory pool block */
+    uchar             *block;                                /* Pointer to the actual memory block (right after this header) */
+    size_t            zero;                                  /* Bytes of the block from this offset are known to be zero */
+    char              type;                                  /* MP_BLK_HEAP, MP_BLK_MAP or MP_BLK_BUF */
+    char              numa;                                  /* TRUE if placed with the NUMA policy of its pool, reset when given back */
 } mpblock;
 
+typedef struct _mpistr
+{
+    char              *str;                                  /* Interned string, NULL if the slot is free */
+    size_t            len;                                   /* Length of the string */
+    unsigned int      hash;                                  /* Hash of the string */
+} mpistr;
+
 typedef struct _mp
 {
     char              init;                                  /* Y/N whether the memory pool was initialized or not */
     char              descr[MP_MAX_DESCR_LEN];               /* Memory pool description */
-    mpblock           *head_block;                           /* Pointer to the first memory pool block */
+    mpblock           **blocks;                              /* Array of pointers to the memory pool blocks, in order of creation (see mpattach_block() for why not the headers themselves) */
+    int               block_cnt;                             /* Number of blocks in the array */
+    int               block_max;                             /* Number of slots allocated for the array */
+    int               map_cnt;                               /* Number of blocks of type MP_BLK_MAP in the array */
     mpblock           *tail_block;                           /* Pointer to the last memory pool block */
+    int               next_blk;                              /* Index of the first block looked at for an empty one when the tail block is full */
+    uchar             *last_chunk;                           /* Last chunk delivered, mprealloc() can resize it in place */
+    size_t            last_dirty;                            /* Leading bytes of the last chunk which might not be zero */
+    char              type;                                  /* MP_TYPE_BLK or MP_TYPE_VM */
+    size_t            vm_commit;                             /* MP_TYPE_VM: bytes committed from the start of the range */
+    mpistr            *intern_tbl;                           /* Intern table (open addressing), allocated in the pool */
+    size_t            intern_cnt;                            /* Number of strings in the intern table */
+    size_t            intern_max;                            /* Number of slots of the intern table (power of 2) */
+    size_t            slab_sz;                               /* MP_TYPE_SLAB: size of the objects */
+    void              *slab_free;                            /* MP_TYPE_SLAB: list of free objects, linked through their first bytes */
+    size_t            slab_free_cnt;                         /* MP_TYPE_SLAB: number of objects in the free list */
+    void * volatile   slab_remote;                           /* MP_TYPE_SLAB: objects given back by other threads (lock-free stack) */
+    size_t            aln_cls[MP_MAX_ALN_CLS];               /* Alignment classes, sorted ascending */
+    mpblock           *aln_block[MP_MAX_ALN_CLS];            /* Block from which each alignment class takes its chunks */
+    int               aln_cnt;                               /* Number of alignment classes */
+    int               numa_policy;                           /* NUMA policy of the blocks (MP_NUMA_*) */
+    int               numa_node;                             /* MP_NUMA_BIND: node of the blocks */
+    struct _mpcleanup *cleanups;                             /* Cleanup callbacks, last registered first, records of the C library */
+    mpupstream        upstream;                              /* Provider of the blocks, the heap if block_alloc is NULL */
+    int               clr_policy;                            /* What mpclr() does with the used memory (MP_CLR_*) */
+    int               trim_clr;                              /* TRUE if mpclr() trims the memory pool (see mpset_trim()) */
+    size_t            trim_keep;                             /* Bytes kept by the trim of mpclr() */
+    int               spare;                                 /* TRUE if the refill thread keeps a spare block (see mpset_spare()) */
+    mpblock * volatile spare_block;                          /* Spare block, pre-faulted by the refill thread, swapped in atomically */
 #if MP_THREAD_SAFE == 1
     MP_THREAD_T       thread_id;                             /* Thread ID */
 #endif
 } mp;
+#endif /* } __cplusplus */
 
 /* Prototypes */
 
@@ -116,16 +203,28 @@ void *mpmemalign(size_t alignment, size_t size);
 void *mpmemalign_mpid(size_t alignment, size_t size, int mpid);
 void *mpcalloc(size_t nelem, size_t size);
 void *mpcalloc_mpid(size_t nelem, size_t size, int mpid);
+int mpmalloc_batch(int mpid, size_t n, const size_t *sizes, const size_t *aligns, void **out_ptrs);
+int mpmalloc_soa(int mpid, size_t ncols, size_t nelem, const size_t *elem_sizes, void **cols);
 void mpfree(void *ptr);
 void mpfree_mpid(void *ptr, int mpid);
 void *mprealloc(void *ptr, size_t size);
 void *mprealloc_mpid(void *ptr, size_t size, int mpid);
+int mpowner(void *ptr);
 char *mpstrdup(const char *s1);
 char *mpstrdup_mpid(const char *s1, int mpid);
+const char *mpintern(int mpid, const char *s, size_t len);
 int mpasprintf(char **strp, const char *fmt, ...);
 int mpasprintf_mpid(char **strp, int mpid, const char *fmt, ...);
+int mpvasprintf(char **strp, const char *fmt, va_list ap);
+int mpvasprintf_mpid(char **strp, int mpid, const char *fmt, va_list ap);
 
 int mpnew(char *descr);
+int mpnew_vm(char *descr, size_t size);
+int mpnew_slab(char *descr, size_t size);
+int mpnew_buf(char *descr, void *buf, size_t len);
+void *mpslab_alloc(int mpid);
+void mpslab_free(void *ptr, int mpid);
+int mpslab_foreach(int mpid, int (*fn)(void *ptr, void *arg), void *arg);
 int mppush(int mpid);
 int mppop();
 int mpget();
@@ -133,16 +232,39 @@ int mpset(int mpid);
 int mpdel(int mpid);
 int mpdel_all();
 int mpclr(int mpid);
+int mptrim(int mpid, size_t keep_bytes);
+int mpset_trim(int mpid, size_t keep_bytes);
+int mpset_clr(int mpid, int policy);
+int mpreserve(int mpid, size_t bytes, int flags);
 void mpprn();
 int mpdmp(char *filename);
 void mpset_memlim(size_t size);
 size_t mpget_memlim();
 void mpset_blksz(size_t size);
 size_t mpget_blksz();
+void mpset_mapsz(size_t size);
+size_t mpget_mapsz();
+void mpset_colors(int colors);
+int mpget_colors();
+void mpset_rcysz(size_t size);
+size_t mpget_rcysz();
+void mpflush_rcy();
+int mpset_refill(int on);
+int mpset_spare(int mpid, int on);
+int mpadd_alncls(int mpid, size_t alignment);
+int mpset_numa(int mpid, int policy, int node);
+int mpcleanup_register(int mpid, void (*fn)(void *arg), void *arg);
+int mpset_upstream(int mpid, const mpupstream *upstream);
+const mpupstream *mpupstream_malloc();
+const mpupstream *mpupstream_mmap();
 
 char *mpstrerror();
 int mptrc_set_fn(int (*function)(FILE *fd, char *fmt, va_list ap));
 
+#ifdef __cplusplus /* { */
+}
+#endif /* } __cplusplus */
+
 #endif /* } _MP_H_ */
 
 /* EOF */
@@ -0,0 +1,360 @@
+/****************************************************************************
+|*
+|* tap3edit Tools (http://www.tap3edit.com)
+|*
+|* Copyright (c) 2014-2018, Javier Gutierrez <https://github.com/tap3edit/mp>
+|*
+|* Permission to use, copy, modify, and/or distribute this software for any
+|* purpose with or without fee is hereby granted, provided that the above
+|* copyright notice and this permission notice appear in all copies.
+|*
+|* THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+|* WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+|* MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+|* ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+|* WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+|* ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+|* OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+|*
+|*
+|* Module: mp.hpp
+|*
+|* Description: C++ adapters of the memory pools (header only).
+|*
+|*  mp::resource   std::pmr::memory_resource on a memory pool (C++17)
+|*  mp::allocator  STL allocator on a memory pool
+|*  mp::pool       Memory pool owned by a C++ object (mpnew() / mpdel())
+|*  mp::scope      Makes a memory pool the current one for a block
+|*  mp::make       Objects and arrays constructed in a memory pool
+|*
+|*  Containers using them take their memory from the memory pool, so whole
+|*  object graphs are released with one mpclr() or mpdel(). The memory is
+|*  given back with mpfree_mpid(), which really releases it on slab pools.
+|*  Destructors are not run by mpclr() or mpdel(): the containers must be
+|*  destroyed (or simply not used any more, when their elements own nothing)
+|*  before.
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|*
+|* When         Who     Pos     What
+|* 20261019     JG              Initial version
+|*
+****************************************************************************/
+
+#ifndef _MP_HPP_ /* { */
+#define _MP_HPP_
+
+/* Includes */
+#include <cstddef>
+#include <cstdio>
+#include <limits>
+#include <new>
+#include <stdexcept>
+#include <utility>
+#if __cplusplus >= 201703L /* { */
+#   include <memory_resource>
+#endif /* } __cplusplus */
+
+#include "mp.h"
+
+namespace mp {
+
+/****************************************************************************
+|*
+|* Class: error
+|*
+|* Description;
+|*
+|*     Exception thrown when a function of the library fails. code() is the
+|*     MP_ERRNO_* returned by it.
+|*
+****************************************************************************/
+class error : public std::runtime_error
+{
+public:
+    explicit error(int code) : std::runtime_error(mpstrerror()), code_(code) {}
+
+    int code() const noexcept { return code_; }
+
+private:
+    int code_;
+};
+
+/* Alignment accepted by mpmemalign_mpid() for a C++ alignment */
+constexpr std::size_t align_of(std::size_t alignment)
+{
+    return alignment < MP_DEF_ALIGN ? MP_DEF_ALIGN : alignment;
+}
+
+/* Memory of the memory pool mpid, std::bad_alloc if not available */
+inline void *alloc(std::size_t size, std::size_t alignment, int mpid)
+{
+    void *ptr = mpmemalign_mpid(align_of(alignment), size, mpid);
+
+    if (ptr == NULL)
+    {
+        throw std::bad_alloc();
+    }
+
+    return ptr;
+}
+
+#if __cplusplus >= 201703L /* { */
+
+/****************************************************************************
+|*
+|* Class: resource
+|*
+|* Description;
+|*
+|*     std::pmr::memory_resource taking the memory from the memory pool
+|*     given on construction (by default the current one).
+|*
+****************************************************************************/
+class resource : public std::pmr::memory_resource
+{
+public:
+    explicit resource(int mpid = mpget()) noexcept : mpid_(mpid) {}
+
+    int mpid() const noexcept { return mpid_; }
+
+private:
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override
+    {
+        return alloc(bytes, alignment, mpid_);
+    }
+
+    void do_deallocate(void *ptr, std::size_t, std::size_t) override
+    {
+        mpfree_mpid(ptr, mpid_);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+    {
+        const resource *res = dynamic_cast<const resource *>(&other);
+
+        return res != NULL && res->mpid_ == mpid_;
+    }
+
+    int mpid_;
+};
+
+#endif /* } __cplusplus */
+
+/****************************************************************************
+|*
+|* Class: allocator
+|*
+|* Description;
+|*
+|*     STL allocator taking the memory from the memory pool given on
+|*     construction (by default the current one). Allocators of the same
+|*     memory pool are equal. As std::pmr::polymorphic_allocator, it is not
+|*     propagated on assignment: a container stays in its memory pool.
+|*
+****************************************************************************/
+template <class T>
+class allocator
+{
+public:
+    typedef T value_type;
+
+    allocator() noexcept : mpid_(mpget()) {}
+    explicit allocator(int mpid) noexcept : mpid_(mpid) {}
+    template <class U> allocator(const allocator<U> &other) noexcept : mpid_(other.mpid()) {}
+
+    int mpid() const noexcept { return mpid_; }
+
+    T *allocate(std::size_t n)
+    {
+        if (n > std::numeric_limits<std::size_t>::max() / sizeof(T))
+        {
+            throw std::bad_array_new_length();
+        }
+
+        return static_cast<T *>(alloc(n * sizeof(T), alignof(T), mpid_));
+    }
+
+    void deallocate(T *ptr, std::size_t) noexcept
+    {
+        mpfree_mpid(ptr, mpid_);
+    }
+
+private:
+    int mpid_;
+};
+
+template <class T, class U>
+bool operator==(const allocator<T> &a, const allocator<U> &b) noexcept
+{
+    return a.mpid() == b.mpid();
+}
+
+template <class T, class U>
+bool operator!=(const allocator<T> &a, const allocator<U> &b) noexcept
+{
+    return a.mpid() != b.mpid();
+}
+
+/****************************************************************************
+|*
+|* Class: pool
+|*
+|* Description;
+|*
+|*     Memory pool created on construction with mpnew() and deleted with
+|*     mpdel() on destruction. It can be moved, not copied.
+|*
+****************************************************************************/
+class pool
+{
+public:
+    explicit pool(const char *descr) : mpid_(mpnew(const_cast<char *>(descr)))
+    {
+        if (mpid_ < 0)
+        {
+            throw error(mpid_);
+        }
+    }
+
+    pool(pool &&other) noexcept : mpid_(other.mpid_) { other.mpid_ = MP_NO_MP_ID; }
+
+    pool &operator=(pool &&other) noexcept
+    {
+        std::swap(mpid_, other.mpid_);
+        return *this;
+    }
+
+    pool(const pool &) = delete;
+    pool &operator=(const pool &) = delete;
+
+    ~pool()
+    {
+        if (mpid_ >= 0)
+        {
+            mpdel(mpid_);
+        }
+    }
+
+    int mpid() const noexcept { return mpid_; }
+
+    void clear()
+    {
+        int rc = mpclr(mpid_);
+
+        if (rc != MP_ERRNO_SUCCESS)
+        {
+            throw error(rc);
+        }
+    }
+
+private:
+    int mpid_;
+};
+
+/****************************************************************************
+|*
+|* Class: scope
+|*
+|* Description;
+|*
+|*     Makes a memory pool the current one (mpset()) for the life of the
+|*     object and restores the previous one on destruction, also when an
+|*     exception leaves the block. Unlike mppush() / mppop(), scopes nest.
+|*
+****************************************************************************/
+class scope
+{
+public:
+    explicit scope(int mpid) : prev_(mpget())
+    {
+        int rc = mpset(mpid);
+
+        if (rc != MP_ERRNO_SUCCESS)
+        {
+            throw error(rc);
+        }
+    }
+
+    explicit scope(const pool &p) : scope(p.mpid()) {}
+
+    scope(const scope &) = delete;
+    scope &operator=(const scope &) = delete;
+
+    ~scope() { mpset(prev_); }
+
+private:
+    int prev_;
+};
+
+/* Object of type T constructed with args in the memory pool mpid. Size and alignment are constants */
+template <class T, class... Args>
+T *make_mpid(int mpid, Args &&... args)
+{
+    void *ptr = alloc(sizeof(T), alignof(T), mpid);
+
+    try
+    {
+        return ::new (ptr) T(std::forward<Args>(args)...);
+    }
+    catch (...)
+    {
+        mpfree_mpid(ptr, mpid);
+        throw;
+    }
+}
+
+/* Object of type T constructed with args in the current memory pool */
+template <class T, class... Args>
+T *make(Args &&... args)
+{
+    return make_mpid<T>(mpget(), std::forward<Args>(args)...);
+}
+
+/* Array of n value-initialized objects of type T in the memory pool mpid */
+template <class T>
+T *make_array_mpid(int mpid, std::size_t n)
+{
+    T *arr = NULL;
+    std::size_t i = 0;
+
+    if (n > std::numeric_limits<std::size_t>::max() / sizeof(T))
+    {
+        throw std::bad_array_new_length();
+    }
+    arr = static_cast<T *>(alloc(n * sizeof(T), alignof(T), mpid));
+
+    try
+    {
+        for (i = 0; i < n; i++)
+        {
+            ::new (static_cast<void *>(arr + i)) T();
+        }
+    }
+    catch (...)
+    {
+        while (i > 0)
+        {
+            arr[--i].~T();
+        }
+        mpfree_mpid(arr, mpid);
+        throw;
+    }
+
+    return arr;
+}
+
+/* Array of n value-initialized objects of type T in the current memory pool */
+template <class T>
+T *make_array(std::size_t n)
+{
+    return make_array_mpid<T>(mpget(), n);
+}
+
+} /* namespace mp */
+
+#endif /* } _MP_HPP_ */
+
+/* EOF */
@@ -33,14 +33,30 @@
 ****************************************************************************/
 
 /* Includes and defines */
+#ifndef _WIN32 /* { */
+#   define _DEFAULT_SOURCE                                  /* MAP_ANONYMOUS and madvise() under -std=c99 */
+#   define _GNU_SOURCE                                      /* mremap() */
+#endif /* } _WIN32 */
 #include <stdio.h>
+#include <string.h>
 #if _WIN32
 #   include <windows.h>
 #   include <stdlib.h>
+#else
+#   include <stdint.h>
+#   include <unistd.h>
+#   include <sys/mman.h>
+#   include <sys/syscall.h>
 #endif
 #include "mp.h"
 #include "mp_os.h"
 
+#define MPOL_DEFAULT     0                                  /* Modes and flags of mbind(), as in <numaif.h> */
+#define MPOL_PREFERRED   1
+#define MPOL_BIND        2
+#define MPOL_INTERLEAVE  3
+#define MPOL_MF_MOVE     (1 << 1)
+
 /* Prototypes */
 
 /* Structs */
@@ -106,6 +122,674 @@ int mp_mutex_init(MP_MUTEX_T **mutex_p)
 
 	return MP_ERRNO_SUCCESS;
 }
+#else /* } MP_THREAD_SAFE { */
+
+/****************************************************************************
+|*
+|* Function: mp_xchg_ptr
+|*
+|* Description;
+|*
+|*     MP_ATOMIC_XCHG_PTR() when the library is not thread safe: sets *p to
+|*     n without any atomic operation.
+|*
+|* Return:
+|*     the previous value of *p
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+void *mp_xchg_ptr(void **p, void *n)
+{
+    void *o = *p;
+
+    *p = n;
+
+    return o;
+}
+#endif /* } MP_THREAD_SAFE */
+
+/****************************************************************************
+|*
+|* Function: mp_thread_start
+|*
+|* Description;
+|*
+|*     Starts a thread of the library itself running fn(arg). On Windows fn
+|*     is run through mp_thread_main(), as the entry point of a thread has 
+|*     another signature there.
+|*
+|* Return:
+|*     MP_ERRNO_SUCCESS on success
+|*     MP_ERRNO_SYSE if the thread could not be started
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+#if MP_THREAD_SAFE == 1 /* { */
+#   if _WIN32 /* { */
+typedef struct _mp_thread_arg
+{
+    void *(*fn)(void *);
+    void *arg;
+} mp_thread_arg;
+
+static DWORD WINAPI mp_thread_main(LPVOID param)
+{
+    mp_thread_arg targ = *(mp_thread_arg *)param;
+
+    free(param);
+    targ.fn(targ.arg);
+
+    return 0;
+}
+#   endif /* } _WIN32 */
+
+int mp_thread_start(MP_THRH_T *thread, void *(*fn)(void *), void *arg)
+{
+#   if _WIN32 /* { */
+    mp_thread_arg *targ = (mp_thread_arg *)malloc(sizeof(mp_thread_arg));
+
+    if (targ == NULL)
+    {
+        return MP_ERRNO_SYSE;
+    }
+    targ->fn = fn;
+    targ->arg = arg;
+    if ((*thread = CreateThread(NULL, 0, mp_thread_main, targ, 0, NULL)) == NULL)
+    {
+        free(targ);
+        return MP_ERRNO_SYSE;
+    }
+#   else /* } _WIN32 { */
+    if (pthread_create(thread, NULL, fn, arg) != 0)
+    {
+        return MP_ERRNO_SYSE;
+    }
+#   endif /* } _WIN32 */
+
+    return MP_ERRNO_SUCCESS;
+}
+
+/****************************************************************************
+|*
+|* Function: mp_thread_join
+|*
+|* Description;
+|*
+|*     Waits for the end of a thread started with mp_thread_start().
+|*
+|* Return:
+|*     n/a
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+void mp_thread_join(MP_THRH_T thread)
+{
+#   if _WIN32 /* { */
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+#   else /* } _WIN32 { */
+    pthread_join(thread, NULL);
+#   endif /* } _WIN32 */
+}
+#endif /* } MP_THREAD_SAFE */
+
+/****************************************************************************
+|*
+|* Function: mp_thread_onexit
+|*
+|* Description;
+|*
+|*     Makes fn run when the calling thread ends (thread-specific data with
+|*     a destructor, a fiber local storage callback on Windows). fn is one
+|*     for the whole library; each thread calls this function once, before
+|*     it has anything to give back. It does not run for the thread ending
+|*     the process with exit().
+|*
+|* Return:
+|*     MP_ERRNO_SUCCESS on success
+|*     MP_ERRNO_SYSE if it could not be registered
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+#if MP_THREAD_SAFE == 1 /* { */
+static void (* volatile mp_exit_fn)(void) = NULL;          /* Function run by the threads ending */
+#   if _WIN32 /* { */
+static DWORD mp_exit_idx = FLS_OUT_OF_INDEXES;              /* Fiber local storage slot with the callback */
+static INIT_ONCE mp_exit_once = INIT_ONCE_STATIC_INIT;
+
+static VOID NTAPI mp_exit_run(PVOID value)
+{
+    if (value != NULL && mp_exit_fn != NULL)
+    {
+        mp_exit_fn();
+    }
+}
+
+static BOOL CALLBACK mp_exit_init(PINIT_ONCE once, PVOID param, PVOID *ctx)
+{
+    (void)once;
+    (void)param;
+    (void)ctx;
+    mp_exit_idx = FlsAlloc(mp_exit_run);
+
+    return TRUE;
+}
+#   else /* } _WIN32 { */
+static pthread_key_t mp_exit_key;                           /* Thread-specific data with the destructor */
+static pthread_once_t mp_exit_once = PTHREAD_ONCE_INIT;
+static int mp_exit_rc = 0;                                  /* Result of pthread_key_create() */
+
+static void mp_exit_run(void *value)
+{
+    (void)value;
+    if (mp_exit_fn != NULL)
+    {
+        mp_exit_fn();
+    }
+}
+
+static void mp_exit_init(void)
+{
+    mp_exit_rc = pthread_key_create(&mp_exit_key, mp_exit_run);
+}
+#   endif /* } _WIN32 */
+
+int mp_thread_onexit(void (*fn)(void))
+{
+    mp_exit_fn = fn;
+
+#   if _WIN32 /* { */
+    InitOnceExecuteOnce(&mp_exit_once, mp_exit_init, NULL, NULL);
+    if (mp_exit_idx == FLS_OUT_OF_INDEXES || !FlsSetValue(mp_exit_idx, &mp_exit_idx))
+    {
+        return MP_ERRNO_SYSE;
+    }
+#   else /* } _WIN32 { */
+    pthread_once(&mp_exit_once, mp_exit_init);
+    if (mp_exit_rc != 0 || pthread_setspecific(mp_exit_key, &mp_exit_key) != 0)
+    {
+        return MP_ERRNO_SYSE;
+    }
+#   endif /* } _WIN32 */
+
+    return MP_ERRNO_SUCCESS;
+}
 #endif /* } MP_THREAD_SAFE */
 
+/****************************************************************************
+|*
+|* Function: mp_vm_pgsz
+|*
+|* Description;
+|*
+|*     Delivers the size of a page of virtual memory. This is the granularity
+|*     of mp_vm_commit() and mp_vm_decommit().
+|*
+|* Return:
+|*     the page size in bytes
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+size_t mp_vm_pgsz()
+{
+    static size_t pgsz = 0;
+
+    if (pgsz == 0) /* Don't care about thread race, same value for all */
+    {
+#ifdef _WIN32 /* { */
+        SYSTEM_INFO si;
+        GetSystemInfo(&si);
+        pgsz = (size_t)si.dwPageSize;
+#else /* } _WIN32 { */
+        long sz = sysconf(_SC_PAGESIZE);
+        pgsz = sz > 0 ? (size_t)sz : 4096;
+#endif /* } _WIN32 */
+    }
+
+    return pgsz;
+}
+
+/****************************************************************************
+|*
+|* Function: mp_vm_reserve
+|*
+|* Description;
+|*
+|*     Reserves a range of contiguous virtual addresses of the given size
+|*     without any physical memory behind it. The range is not accessible
+|*     until its pages are committed with mp_vm_commit().
+|*
+|* Return:
+|*     pointer to the start of the range, page aligned
+|*     NULL on error
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+void *mp_vm_reserve(size_t size)
+{
+    void *addr = NULL;
+
+#ifdef _WIN32 /* { */
+    addr = VirtualAlloc(NULL, size, MEM_RESERVE, PAGE_NOACCESS);
+#else /* } _WIN32 { */
+    addr = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (addr == MAP_FAILED)
+    {
+        addr = NULL;
+    }
+#endif /* } _WIN32 */
+
+    return addr;
+}
+
+/****************************************************************************
+|*
+|* Function: mp_vm_commit
+|*
+|* Description;
+|*
+|*     Makes accessible (read/write) the pages of a range previously reserved
+|*     with mp_vm_reserve(). addr must be page aligned. Committed pages are
+|*     zero until first written.
+|*
+|* Return:
+|*     MP_ERRNO_SUCCESS on success
+|*     MP_ERRNO_SYSE on error
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+int mp_vm_commit(void *addr, size_t size)
+{
+#ifdef _WIN32 /* { */
+    if (VirtualAlloc(addr, size, MEM_COMMIT, PAGE_READWRITE) == NULL)
+#else /* } _WIN32 { */
+    if (mprotect(addr, size, PROT_READ | PROT_WRITE) != 0)
+#endif /* } _WIN32 */
+    {
+        return MP_ERRNO_SYSE;
+    }
+
+    return MP_ERRNO_SUCCESS;
+}
+
+/****************************************************************************
+|*
+|* Function: mp_vm_decommit
+|*
+|* Description;
+|*
+|*     Gives back to the OS the physical memory behind the committed pages
+|*     of the range and makes them inaccessible again. The addresses stay
+|*     reserved. addr must be page aligned.
+|*
+|* Return:
+|*     MP_ERRNO_SUCCESS on success
+|*     MP_ERRNO_SYSE on error
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+int mp_vm_decommit(void *addr, size_t size)
+{
+#ifdef _WIN32 /* { */
+    if (VirtualFree(addr, size, MEM_DECOMMIT) == 0)
+#else /* } _WIN32 { */
+    if (madvise(addr, size, MADV_DONTNEED) != 0 ||
+            mprotect(addr, size, PROT_NONE) != 0)
+#endif /* } _WIN32 */
+    {
+        return MP_ERRNO_SYSE;
+    }
+
+    return MP_ERRNO_SUCCESS;
+}
+
+/****************************************************************************
+|*
+|* Function: mp_vm_discard
+|*
+|* Description;
+|*
+|*     Gives back to the OS the physical memory behind the pages of the
+|*     range, which stay accessible: on Linux they are read back as zero, 
+|*     elsewhere their content is undefined. addr must be page aligned.
+|*
+|* Return:
+|*     MP_ERRNO_SUCCESS on success
+|*     MP_ERRNO_SYSE on error
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+int mp_vm_discard(void *addr, size_t size)
+{
+#ifdef _WIN32 /* { */
+    if (VirtualAlloc(addr, size, MEM_RESET, PAGE_READWRITE) == NULL)
+#else /* } _WIN32 { */
+    if (madvise(addr, size, MADV_DONTNEED) != 0)
+#endif /* } _WIN32 */
+    {
+        return MP_ERRNO_SYSE;
+    }
+
+    return MP_ERRNO_SUCCESS;
+}
+
+/****************************************************************************
+|*
+|* Function: mp_vm_populate
+|*
+|* Description;
+|*
+|*     Faults in for writing all the pages of the range at once, as 
+|*     MAP_POPULATE does for a new mapping, without changing their content.
+|*     addr must be page aligned. Only on Linux from 5.14 
+|*     (MADV_POPULATE_WRITE); elsewhere the caller has to touch the pages.
+|*
+|* Return:
+|*     MP_ERRNO_SUCCESS on success
+|*     MP_ERRNO_SYSE on error or if not available
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+int mp_vm_populate(void *addr, size_t size)
+{
+#if defined(MADV_POPULATE_WRITE) /* { */
+    if (madvise(addr, size, MADV_POPULATE_WRITE) == 0)
+    {
+        return MP_ERRNO_SUCCESS;
+    }
+#else /* } MADV_POPULATE_WRITE { */
+    (void)addr;
+    (void)size;
+#endif /* } MADV_POPULATE_WRITE */
+
+    return MP_ERRNO_SYSE;
+}
+
+/****************************************************************************
+|*
+|* Function: mp_vm_release
+|*
+|* Description;
+|*
+|*     Releases a whole range reserved with mp_vm_reserve(), committed pages
+|*     included.
+|*
+|* Return:
+|*     MP_ERRNO_SUCCESS on success
+|*     MP_ERRNO_SYSE on error
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+int mp_vm_release(void *addr, size_t size)
+{
+#ifdef _WIN32 /* { */
+    if (VirtualFree(addr, 0, MEM_RELEASE) == 0)
+#else /* } _WIN32 { */
+    if (munmap(addr, size) != 0)
+#endif /* } _WIN32 */
+    {
+        return MP_ERRNO_SYSE;
+    }
+
+    return MP_ERRNO_SUCCESS;
+}
+
+/****************************************************************************
+|*
+|* Function: mp_vm_map
+|*
+|* Description;
+|*
+|*     Maps a range of size bytes of zeroed memory ready to be used (read 
+|*     and write). It must be given back with mp_vm_release().
+|*
+|* Return:
+|*     pointer to the start of the range, page aligned
+|*     NULL on error
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+void *mp_vm_map(size_t size)
+{
+    void *addr = NULL;
+
+#ifdef _WIN32 /* { */
+    addr = VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else /* } _WIN32 { */
+    addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED)
+    {
+        addr = NULL;
+    }
+#endif /* } _WIN32 */
+
+    return addr;
+}
+
+/****************************************************************************
+|*
+|* Function: mp_vm_remap
+|*
+|* Description;
+|*
+|*     Resizes a range mapped with mp_vm_map() keeping its content. On Linux
+|*     mremap() moves the page tables instead of the bytes, elsewhere a new
+|*     range is mapped and the content copied. The range might be moved.
+|*
+|* Return:
+|*     pointer to the start of the resized range
+|*     NULL on error, the original range is kept untouched
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+void *mp_vm_remap(void *addr, size_t old_size, size_t new_size)
+{
+    void *new_addr = NULL;
+
+#if defined(__linux__) /* { */
+    new_addr = mremap(addr, old_size, new_size, MREMAP_MAYMOVE);
+    if (new_addr == MAP_FAILED)
+    {
+        new_addr = NULL;
+    }
+#else /* } __linux__ { */
+    if ((new_addr = mp_vm_map(new_size)) != NULL)
+    {
+        memcpy(new_addr, addr, old_size < new_size ? old_size : new_size);
+        mp_vm_release(addr, old_size);
+    }
+#endif /* } __linux__ */
+
+    return new_addr;
+}
+
+/****************************************************************************
+|*
+|* Function: mp_numa_nodes
+|*
+|* Description;
+|*
+|*     Delivers the number of NUMA nodes of the machine, read once from 
+|*     /sys/devices/system/node/online on Linux. Elsewhere, or if it cannot
+|*     be read, the machine is taken as a single node.
+|*
+|* Return:
+|*     number of NUMA nodes (1 at least)
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+int mp_numa_nodes()
+{
+    static int nodes = 0;
+
+    if (nodes == 0) /* Don't care about thread race, same value for all */
+    {
+        int cnt = 1;
+#if defined(__linux__) /* { */
+        FILE *fp = NULL;
+        int from = 0;
+        int to = 0;
+        char sep = '\0';
+
+        /* List of ranges as "0-1,3" */
+        if ((fp = fopen("/sys/devices/system/node/online", "r")) != NULL)
+        {
+            while (fscanf(fp, "%d", &from) == 1)
+            {
+                to = from;
+                if ((sep = (char)fgetc(fp)) == '-')
+                {
+                    if (fscanf(fp, "%d", &to) != 1)
+                    {
+                        break;
+                    }
+                    sep = (char)fgetc(fp);
+                }
+                cnt = to + 1 > cnt ? to + 1 : cnt;
+                if (sep != ',')
+                {
+                    break;
+                }
+            }
+            fclose(fp);
+        }
+#endif /* } __linux__ */
+        nodes = cnt > MP_NUMA_MAX_NODES ? MP_NUMA_MAX_NODES : cnt;
+    }
+
+    return nodes;
+}
+
+/****************************************************************************
+|*
+|* Function: mp_numa_bind
+|*
+|* Description;
+|*
+|*     Sets the NUMA policy (MP_NUMA_*) of the whole pages of a range with 
+|*     mbind(): MP_NUMA_LOCAL places the pages on the node of the thread 
+|*     touching them first, MP_NUMA_BIND on node and MP_NUMA_INTERLEAVE 
+|*     spreads them over all nodes. Pages already placed are moved. 
+|*     MP_NUMA_NONE resets the range to the default policy, without moving
+|*     its pages. Partial pages at the ends of the range are left as they 
+|*     are. It does nothing on machines of one node and on other systems 
+|*     than Linux.
+|*
+|* Return:
+|*     MP_ERRNO_SUCCESS on success
+|*     MP_ERRNO_SYSE on error
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|* 20261019    JG    MP_NUMA_NONE resets the policy
+|*
+****************************************************************************/
+int mp_numa_bind(void *addr, size_t size, int policy, int node)
+{
+#if defined(__linux__) && defined(SYS_mbind) /* { */
+    unsigned long mask[(MP_NUMA_MAX_NODES + 8 * sizeof(unsigned long) -1) / (8 * sizeof(unsigned long))];
+    unsigned long bits = 8 * sizeof(unsigned long);
+    uintptr_t start = ((uintptr_t)addr + mp_vm_pgsz() -1) & ~(uintptr_t)(mp_vm_pgsz() -1);
+    uintptr_t end = ((uintptr_t)addr + size) & ~(uintptr_t)(mp_vm_pgsz() -1);
+    int mode = MPOL_DEFAULT;
+    int flags = MPOL_MF_MOVE;
+    int nodes = mp_numa_nodes();
+    int i = 0;
+
+    if (nodes <= 1 || start >= end)
+    {
+        return MP_ERRNO_SUCCESS;
+    }
+
+    memset(mask, 0x00, sizeof(mask));
+    switch (policy)
+    {
+        case MP_NUMA_NONE:
+            mode = MPOL_DEFAULT; /* Empty set of nodes, pages left where they are */
+            flags = 0;
+            break;
+        case MP_NUMA_LOCAL:
+            mode = MPOL_PREFERRED; /* Empty set of nodes: the local one */
+            break;
+        case MP_NUMA_BIND:
+            mode = MPOL_BIND;
+            mask[node / bits] |= 1UL << (node % bits);
+            break;
+        default:
+            mode = MPOL_INTERLEAVE;
+            for (i = 0; i < nodes; i++)
+            {
+                mask[i / bits] |= 1UL << (i % bits);
+            }
+    }
+
+    /* maxnode counts one more than the bits the kernel reads */
+    if (syscall(SYS_mbind, (void *)start, (unsigned long)(end - start), mode, mask,
+                (unsigned long)MP_NUMA_MAX_NODES + 1, flags) != 0)
+    {
+        return MP_ERRNO_SYSE;
+    }
+#endif /* } __linux__ */
+
+    return MP_ERRNO_SUCCESS;
+}
+
 /* EOF */
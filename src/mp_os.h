@@ -32,8 +32,9 @@
 #define _MP_OS_H_
 
 /* Includes */
+#include <stddef.h>
 
-#ifdef MP_THREAD_SAFE /* { */
+#if MP_THREAD_SAFE == 1 /* { */
 #   ifndef WIN32 /* { */
 #       include <pthread.h>
 #   else /* } WIN32 { */
@@ -43,7 +44,7 @@
 
 /* Defines */
 
-#ifdef MP_THREAD_SAFE /* { */
+#if MP_THREAD_SAFE == 1 /* { */
 #   ifndef WIN32 /* { */
 #       define MP_MUTEX_T           pthread_mutex_t                     /* Mutex datatype */
 #       define MP_MUTEX_INIT(a)     pthread_mutex_init(a, NULL)         /* Mutex init */
@@ -54,8 +55,17 @@
 #       define MP_THREAD_T          pthread_t                           /* Thread datatype */
 #       define MP_TLS_INT           __thread int                        /* TLS int */
 #       define MP_TLS_CHAR          __thread char                       /* TLS char */
+#       define MP_TLS_VOID          __thread void                       /* TLS pointer (to void) */
 #       define MP_CURR_THREAD       pthread_self()                      /* Returns thread Id */
 #       define MP_THREAD_EQ(a,b)    pthread_equal(a, b)                 /* Returns zero if two threads are equal */
+#       define MP_ATOMIC_CAS_PTR(p,o,n) __sync_bool_compare_and_swap(p, o, n)           /* Sets *p to n if it is o, non zero if done */
+#       define MP_ATOMIC_XCHG_PTR(p,n)  __atomic_exchange_n(p, n, __ATOMIC_ACQ_REL)     /* Sets *p to n, returns the previous value */
+#       define MP_ATOMIC_FENCE()        __sync_synchronize()                            /* Full memory barrier */
+#       define MP_COND_T            pthread_cond_t                      /* Condition variable datatype */
+#       define MP_COND_INIT_VAL     PTHREAD_COND_INITIALIZER            /* Condition variable initial value */
+#       define MP_COND_WAIT(c,m)    pthread_cond_wait(c, m)             /* Waits on c, releasing the locked mutex m meanwhile */
+#       define MP_COND_SIGNAL(c)    pthread_cond_signal(c)              /* Wakes up a thread waiting on c */
+#       define MP_THRH_T            pthread_t                           /* Handle of a thread started by the library */
 #   else /* } WIN32 { */
 #       define MP_MUTEX_T           CRITICAL_SECTION
 #       define MP_MUTEX_INIT(a)     (!InitializeCriticalSection(a)
@@ -66,25 +76,83 @@
 #       define MP_THREAD_T          long
 #       define MP_TLS_INT           __declspec(thread) int
 #       define MP_TLS_CHAR          __declspec(thread) char
+#       define MP_TLS_VOID          __declspec(thread) void
 #       define MP_CURR_THREAD       ((long)GetCurrentThreadId())
 #       define MP_THREAD_EQ(a,b)    (a == b)
+#       define MP_ATOMIC_CAS_PTR(p,o,n) (InterlockedCompareExchangePointer((PVOID volatile *)(p), n, o) == (o))
+#       define MP_ATOMIC_XCHG_PTR(p,n)  InterlockedExchangePointer((PVOID volatile *)(p), n)
+#       define MP_ATOMIC_FENCE()        MemoryBarrier()
+#       define MP_COND_T            CONDITION_VARIABLE
+#       define MP_COND_INIT_VAL     CONDITION_VARIABLE_INIT
+#       define MP_COND_WAIT(c,m)    SleepConditionVariableCS(c, m, INFINITE)
+#       define MP_COND_SIGNAL(c)    WakeConditionVariable(c)
+#       define MP_THRH_T            HANDLE
 #   endif /* } WIN32 */
 #else /* } MP_THREAD_SAFE { */
-#       define MP_MUTEX_T           /* TODO */
-#       define MP_MUTEX_INIT(a)     /* TODO */
-#       define MP_MUTEX_DSTRY(a)    /* TODO */
+#       define MP_MUTEX_T           char                                /* No mutex needed */
+#       define MP_MUTEX_INIT(a)     0
+#       define MP_MUTEX_DSTRY(a)    ((void)0)
+#       define MP_MUTEX_LOCK(a)     ((void)0)
+#       define MP_MUTEX_UNLOCK(a)   ((void)0)
 #       define MP_THREAD_T          char
 #       define MP_TLS_INT           int
 #       define MP_TLS_CHAR          char
+#       define MP_TLS_VOID          void
 #       define MP_CURR_THREAD       ((char)'\0')
 #       define MP_THREAD_EQ(a,b)    (a == b)
+#       define MP_ATOMIC_CAS_PTR(p,o,n) (*(p) == (o) ? (*(p) = (n), 1) : 0)
+#       define MP_ATOMIC_XCHG_PTR(p,n)  mp_xchg_ptr((void **)(p), n)
+#       define MP_ATOMIC_FENCE()        ((void)0)
 #endif /* } MP_THREAD_SAFE */
 
+/* Pages given back by mp_vm_discard() are read back as zero */
+#if defined(__linux__) /* { */
+#       define MP_VM_DISCARD_ZERO   1
+#else /* } __linux__ { */
+#       define MP_VM_DISCARD_ZERO   0
+#endif /* } __linux__ */
+
+/* Memory of the library itself (blocks, tables): the shared library takes it from
+ * the C library directly, so it never reaches a malloc() interposer (mp_preload.c) */
+#if defined(MP_LIBC_ALLOC) /* { */
+#       define MP_SYS_MALLOC(s)     __libc_malloc(s)
+#       define MP_SYS_CALLOC(n,s)   __libc_calloc(n, s)
+#       define MP_SYS_REALLOC(p,s)  __libc_realloc(p, s)
+#       define MP_SYS_FREE(p)       __libc_free(p)
+#else /* } MP_LIBC_ALLOC { */
+#       define MP_SYS_MALLOC(s)     malloc(s)
+#       define MP_SYS_CALLOC(n,s)   calloc(n, s)
+#       define MP_SYS_REALLOC(p,s)  realloc(p, s)
+#       define MP_SYS_FREE(p)       free(p)
+#endif /* } MP_LIBC_ALLOC */
+
 /* Prototypes */
 
 #if MP_THREAD_SAFE == 1 /* { */
 int mp_mutex_init(MP_MUTEX_T **mutex_p);
-#endif
+int mp_thread_start(MP_THRH_T *thread, void *(*fn)(void *), void *arg);
+void mp_thread_join(MP_THRH_T thread);
+int mp_thread_onexit(void (*fn)(void));
+#else /* } MP_THREAD_SAFE { */
+void *mp_xchg_ptr(void **p, void *n);
+#endif /* } MP_THREAD_SAFE */
+size_t mp_vm_pgsz();
+void *mp_vm_reserve(size_t size);
+int mp_vm_commit(void *addr, size_t size);
+int mp_vm_decommit(void *addr, size_t size);
+int mp_vm_discard(void *addr, size_t size);
+int mp_vm_populate(void *addr, size_t size);
+int mp_vm_release(void *addr, size_t size);
+void *mp_vm_map(size_t size);
+void *mp_vm_remap(void *addr, size_t old_size, size_t new_size);
+int mp_numa_nodes();
+int mp_numa_bind(void *addr, size_t size, int policy, int node);
+#if defined(MP_LIBC_ALLOC) /* { */
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t nelem, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void __libc_free(void *ptr);
+#endif /* } MP_LIBC_ALLOC */
 
 #endif /* } _MP_OS_H_ */
 /* EOF */
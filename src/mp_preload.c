@@ -0,0 +1,351 @@
+/****************************************************************************
+|*
+|* tap3edit Tools (http://www.tap3edit.com)
+|*
+|* Copyright (c) 2014-2018, Javier Gutierrez <https://github.com/tap3edit/mp>
+|*
+|* Permission to use, copy, modify, and/or distribute this software for any
+|* purpose with or without fee is hereby granted, provided that the above
+|* copyright notice and this permission notice appear in all copies.
+|*
+|* THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+|* WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+|* MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+|* ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+|* WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+|* ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+|* OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+|*
+|*
+|* Module: mp_preload.c
+|*
+|* Description: malloc() interposer (libmp_preload.so, Linux with glibc).
+|*
+|*  Loaded with LD_PRELOAD it replaces malloc(), calloc(), realloc(), free()
+|*  and posix_memalign() of the whole program. While a thread has made a
+|*  memory pool other than the default one active (mpset(), mppush()), its
+|*  allocations are taken from that memory pool; otherwise, and when the
+|*  memory pool cannot deliver them, from the C library. So legacy code
+|*  calling malloc() can be run inside a memory pool and its memory be
+|*  released at once with mpclr() or mpdel().
+|*
+|*  Each chunk taken from a memory pool is preceded by its size, so realloc()
+|*  knows how much to copy, and by a tag derived from its address, so free()
+|*  and realloc() of chunks of the C library mostly skip the owner lookup.
+|*  free() of a chunk of a memory pool does nothing, as mpfree(). The chunks
+|*  must not be used, nor given to free(), once their memory pool was 
+|*  deleted.
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|*
+|* When         Who     Pos     What
+|* 20261019     JG              Initial version
+|* 20261019     JG              Tag before the chunks of the memory pools
+|*
+****************************************************************************/
+
+/* Includes and defines */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+
+#include "mp.h"
+#include "mp_os.h"
+
+#define MPPL_MIN_ALIGN   16                                 /* Alignment of malloc() on 64 bits, room for the tag and the size before the chunk */
+#define MPPL_TAG(p)      ((size_t)(uintptr_t)(p) ^ (size_t)0x6d70706c5441472dULL) /* Tag stored before the chunk p of a memory pool */
+
+/* Prototypes */
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t nelem, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void __libc_free(void *ptr);
+void *__libc_memalign(size_t alignment, size_t size);
+static void *mppl_alloc(size_t alignment, size_t size);
+static size_t *mppl_owned(void *ptr);
+
+/* Global variables */
+extern MP_TLS_INT mperrno;
+static MP_TLS_INT mppl_busy = 0;                            /* Inside the library: its own allocations go to the C library */
+static int volatile mppl_used = 0;                          /* A chunk was taken from a memory pool: free() must look for owners */
+
+
+/****************************************************************************
+|*
+|* Function: malloc
+|*
+|* Description;
+|*
+|*     malloc() of the C library taking the memory from the active memory
+|*     pool of the thread, if any.
+|*
+|* Return:
+|*     pointer to the memory, NULL if error
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+void *malloc(size_t size)
+{
+    void *ptr = mppl_alloc(MPPL_MIN_ALIGN, size);
+
+    return ptr != NULL ? ptr : __libc_malloc(size);
+}
+
+/****************************************************************************
+|*
+|* Function: calloc
+|*
+|* Description;
+|*
+|*     calloc() of the C library taking the memory from the active memory
+|*     pool of the thread, if any.
+|*
+|* Return:
+|*     pointer to the memory set to zero, NULL if error
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+void *calloc(size_t nelem, size_t size)
+{
+    void *ptr = NULL;
+
+    if (size != 0 && nelem > ((size_t)-1) / size)
+    {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    if ((ptr = mppl_alloc(MPPL_MIN_ALIGN, nelem * size)) != NULL)
+    {
+        memset(ptr, 0x00, nelem * size);
+        return ptr;
+    }
+
+    return __libc_calloc(nelem, size);
+}
+
+/****************************************************************************
+|*
+|* Function: realloc
+|*
+|* Description;
+|*
+|*     realloc() of the C library. Chunks of a memory pool are copied to a
+|*     new chunk taken as malloc() does; chunks of the C library stay in the
+|*     C library.
+|*
+|* Return:
+|*     pointer to the memory, NULL if error
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+void *realloc(void *ptr, size_t size)
+{
+    size_t *hdr = NULL;
+    void *new_ptr = NULL;
+
+    if (ptr == NULL)
+    {
+        return malloc(size);
+    }
+
+    if ((hdr = mppl_owned(ptr)) == NULL)
+    {
+        return __libc_realloc(ptr, size);
+    }
+
+    /* Chunk of a memory pool */
+    if (size == 0)
+    {
+        return NULL;
+    }
+    if (size <= *hdr)
+    {
+        return ptr;
+    }
+    if ((new_ptr = malloc(size)) != NULL)
+    {
+        memcpy(new_ptr, ptr, *hdr);
+    }
+
+    return new_ptr;
+}
+
+/****************************************************************************
+|*
+|* Function: free
+|*
+|* Description;
+|*
+|*     free() of the C library. Chunks of a memory pool are released with
+|*     their memory pool, so nothing is done for them.
+|*
+|* Return:
+|*     n/a
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+void free(void *ptr)
+{
+    if (ptr != NULL && mppl_owned(ptr) == NULL)
+    {
+        __libc_free(ptr);
+    }
+}
+
+/****************************************************************************
+|*
+|* Function: posix_memalign
+|*
+|* Description;
+|*
+|*     posix_memalign() of the C library taking the memory from the active
+|*     memory pool of the thread, if any.
+|*
+|* Return:
+|*     0 on success, EINVAL or ENOMEM otherwise
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+int posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+    void *ptr = NULL;
+
+    if ((alignment & (alignment -1)) != 0 || alignment < sizeof(void *))
+    {
+        return EINVAL;
+    }
+
+    if ((ptr = mppl_alloc(alignment, size)) == NULL &&
+            (ptr = __libc_memalign(alignment, size)) == NULL)
+    {
+        return ENOMEM;
+    }
+    *memptr = ptr;
+
+    return 0;
+}
+
+/****************************************************************************
+|*
+|* Function: mppl_alloc
+|*
+|* Description;
+|*
+|*     Takes size bytes aligned to alignment from the active memory pool of
+|*     the thread, preceded by the tag of the chunk and its size. Nothing is
+|*     taken while the default memory pool is the active one or from inside
+|*     the library itself.
+|*
+|* Return:
+|*     pointer to the memory
+|*     NULL if the memory must be taken from the C library
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|* 20261019    JG    Tag of the chunk
+|*
+****************************************************************************/
+static void *mppl_alloc(size_t alignment, size_t size)
+{
+    uchar *chunk = NULL;
+    int mpid = MP_DEF_MP_ID;
+    int err = mperrno;
+
+    if (mppl_busy || (mpid = mpget()) == MP_DEF_MP_ID)
+    {
+        return NULL;
+    }
+
+    alignment = alignment < MPPL_MIN_ALIGN ? MPPL_MIN_ALIGN : alignment;
+    if (size > ((size_t)-1) - alignment)
+    {
+        return NULL;
+    }
+
+    /* The tag and the size go right before the aligned chunk */
+    mppl_busy = 1;
+    chunk = (uchar *)mpmemalign_mpid(alignment, alignment + size, mpid);
+    mppl_busy = 0;
+    mperrno = err;
+    if (chunk == NULL)
+    {
+        return NULL;
+    }
+
+    mppl_used = 1;
+    chunk += alignment;
+    ((size_t *)chunk)[-2] = MPPL_TAG(chunk);
+    ((size_t *)chunk)[-1] = size;
+
+    return chunk;
+}
+
+/****************************************************************************
+|*
+|* Function: mppl_owned
+|*
+|* Description;
+|*
+|*     Finds out whether ptr was taken from a memory pool by mppl_alloc().
+|*     Until a chunk is taken from a memory pool no lookup is done at all.
+|*     Then only chunks preceded by their tag are looked up: the 16 bytes
+|*     before a chunk of the C library are its header, always readable, and
+|*     a tag found there by chance is still ruled out by the lookup.
+|*
+|* Return:
+|*     pointer to the size stored before the chunk
+|*     NULL if ptr belongs to the C library
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|* 20261019    JG    Lookup only for tagged chunks
+|*
+****************************************************************************/
+static size_t *mppl_owned(void *ptr)
+{
+    int mpid = MP_ERRNO_NOWN;
+    int err = mperrno;
+
+    if (!mppl_used || ((size_t *)ptr)[-2] != MPPL_TAG(ptr))
+    {
+        return NULL;
+    }
+
+    mppl_busy++;
+    mpid = mpowner(ptr);
+    mppl_busy--;
+    mperrno = err;
+
+    return mpid >= 0 ? (size_t *)ptr -1 : NULL;
+}
+
+/* EOF */
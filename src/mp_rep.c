@@ -30,6 +30,7 @@
 |*
 |* When         Who     Pos     What
 |* 20140922     JG              Initial version
+|* 20261019     JG              Fields of mpprn() formatted without overflow
 |*
 ****************************************************************************/
 
@@ -37,6 +38,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdarg.h>
 #if _WIN32
 #   include <STDDEF.h>
 #else
@@ -56,6 +58,7 @@
 static char *mpsz2rnd(char *sizestr, size_t size);
 static size_t mppow(int x, int y);
 static char *mpbin2hex(char *hex, size_t hex_sz, size_t alignment, void* buff, size_t sz);
+static void mpfmt_fld(char *fld, size_t fld_sz, const char *fmt, ...);
 
 /* Structs */
 typedef struct _mpstat_t
@@ -72,7 +75,7 @@ typedef struct _mpstat_t
 } mpstat_t;
 
 /* Global variables */
-extern mp mp_arr[MP_MAX_MP_ID -1];                          /* Array of memory pools */
+extern mp mp_arr[MP_MAX_MP_ID];                             /* Array of memory pools */
 #if MP_THREAD_SAFE == 1 /* { */
 extern MP_TLS_INT mperrno;
 #else /* } MP_THREAD_SAFE { */
@@ -96,13 +99,14 @@ extern int mperrno;
 |*
 |* Modifications:
 |* 20140811    JG    Initial version
+|* 20261019    JG    Fields formatted with mpfmt_fld()
 |*
 ****************************************************************************/
 void mpprn()
 {
     int block_no = 0;
     int i = 0;
-    mpblock *curr_block = NULL;
+    int j = 0;
     size_t size = 0;
     size_t used = 0;
     int tot_block_no = 0;
@@ -129,19 +133,15 @@ void mpprn()
             continue;
         }
 
-        block_no = 0;
+        block_no = mp_arr[i].block_cnt;
         size = 0;
         used = 0;
 
         /* Gather info from all the memory blocks */
-        curr_block = mp_arr[i].head_block;
-        while(curr_block != NULL)
+        for (j = 0; j < block_no; j++)
         {
-            block_no++;
-            size += curr_block->size;
-            used += curr_block->used;
-
-            curr_block = curr_block->next;
+            size += mp_arr[i].blocks[j]->size;
+            used += mp_arr[i].blocks[j]->used;
         }
 
         tot_block_no += block_no;
@@ -151,14 +151,14 @@ void mpprn()
         /* Print out memory pool info details */
         memset(&stat_rec, 0x00, sizeof(stat_rec));
 
-        sprintf(stat_rec.mpid       , "%*d ",     (int) sizeof(stat_rec.mpid    ) -1,    i);
-        sprintf(stat_rec.descr      , "%-*.*s",   (int) sizeof(stat_rec.descr   )   , (int) sizeof(stat_rec.descr),  mp_arr[i].descr);
-        sprintf(stat_rec.blocks     , "%-*d",     (int) sizeof(stat_rec.blocks  )   ,    block_no);
-        sprintf(stat_rec.size       , "%-*s",     (int) sizeof(stat_rec.size    )   ,    mpsz2rnd(sizestr, size));
-        sprintf(stat_rec.used       , "%-*s",     (int) sizeof(stat_rec.used    )   ,    mpsz2rnd(sizestr, used));
-        sprintf(stat_rec.used_prc   , "%%%-*.*f", (int) sizeof(stat_rec.used_prc)   , 2, !size ? 0.0 : (double)(used/(long double)size) * 100);
-        sprintf(stat_rec.free       , "%-*s",     (int) sizeof(stat_rec.free    )   ,    mpsz2rnd(sizestr, size - used));
-        sprintf(stat_rec.free_prc   , "%%%-*.*f", (int) sizeof(stat_rec.free_prc) -1, 2, !size ? 0.0 : (double)((size - used)/(long double)size) * 100);
+        mpfmt_fld(stat_rec.mpid    , sizeof(stat_rec.mpid    ), "%*d ",     (int) sizeof(stat_rec.mpid    ) -1,    i);
+        mpfmt_fld(stat_rec.descr   , sizeof(stat_rec.descr   ), "%-*.*s",   (int) sizeof(stat_rec.descr   )   , (int) sizeof(stat_rec.descr),  mp_arr[i].descr);
+        mpfmt_fld(stat_rec.blocks  , sizeof(stat_rec.blocks  ), "%-*d",     (int) sizeof(stat_rec.blocks  )   ,    block_no);
+        mpfmt_fld(stat_rec.size    , sizeof(stat_rec.size    ), "%-*s",     (int) sizeof(stat_rec.size    )   ,    mpsz2rnd(sizestr, size));
+        mpfmt_fld(stat_rec.used    , sizeof(stat_rec.used    ), "%-*s",     (int) sizeof(stat_rec.used    )   ,    mpsz2rnd(sizestr, used));
+        mpfmt_fld(stat_rec.used_prc, sizeof(stat_rec.used_prc), "%%%-*.*f", (int) sizeof(stat_rec.used_prc)   , 2, !size ? 0.0 : (double)(used/(long double)size) * 100);
+        mpfmt_fld(stat_rec.free    , sizeof(stat_rec.free    ), "%-*s",     (int) sizeof(stat_rec.free    )   ,    mpsz2rnd(sizestr, size - used));
+        mpfmt_fld(stat_rec.free_prc, sizeof(stat_rec.free_prc), "%%%-*.*f", (int) sizeof(stat_rec.free_prc) -1, 2, !size ? 0.0 : (double)((size - used)/(long double)size) * 100);
 
         mptrc(NULL, "%s", (char *)&stat_rec);
     }
@@ -168,14 +168,14 @@ void mpprn()
     /* Print out totals */
     memset(&stat_rec, 0x00, sizeof(stat_rec));
 
-    sprintf(stat_rec.mpid       , "%-*s",     (int) sizeof(stat_rec.mpid    )   ,    "Total");
-    sprintf(stat_rec.descr      , "%-*s",     (int) sizeof(stat_rec.descr   )   ,    "");
-    sprintf(stat_rec.blocks     , "%-*d",     (int) sizeof(stat_rec.blocks  )   ,    tot_block_no);
-    sprintf(stat_rec.size       , "%-*s",     (int) sizeof(stat_rec.size    )   ,    mpsz2rnd(sizestr, tot_size));
-    sprintf(stat_rec.used       , "%-*s",     (int) sizeof(stat_rec.used    )   ,    mpsz2rnd(sizestr, tot_used));
-    sprintf(stat_rec.used_prc   , "%%%-*.*f", (int) sizeof(stat_rec.used_prc)   , 2, !tot_size ? 0.0 : (double)(tot_used/(long double)tot_size) * 100);
-    sprintf(stat_rec.free       , "%-*s",     (int) sizeof(stat_rec.free    )   ,    mpsz2rnd(sizestr, tot_size - tot_used));
-    sprintf(stat_rec.free_prc   , "%%%-*.*f", (int) sizeof(stat_rec.free_prc) -1, 2, !tot_size ? 0.0 : (double)((tot_size - tot_used)/(long double)tot_size) * 100);
+    mpfmt_fld(stat_rec.mpid    , sizeof(stat_rec.mpid    ), "%-*s",     (int) sizeof(stat_rec.mpid    )   ,    "Total");
+    mpfmt_fld(stat_rec.descr   , sizeof(stat_rec.descr   ), "%-*s",     (int) sizeof(stat_rec.descr   )   ,    "");
+    mpfmt_fld(stat_rec.blocks  , sizeof(stat_rec.blocks  ), "%-*d",     (int) sizeof(stat_rec.blocks  )   ,    tot_block_no);
+    mpfmt_fld(stat_rec.size    , sizeof(stat_rec.size    ), "%-*s",     (int) sizeof(stat_rec.size    )   ,    mpsz2rnd(sizestr, tot_size));
+    mpfmt_fld(stat_rec.used    , sizeof(stat_rec.used    ), "%-*s",     (int) sizeof(stat_rec.used    )   ,    mpsz2rnd(sizestr, tot_used));
+    mpfmt_fld(stat_rec.used_prc, sizeof(stat_rec.used_prc), "%%%-*.*f", (int) sizeof(stat_rec.used_prc)   , 2, !tot_size ? 0.0 : (double)(tot_used/(long double)tot_size) * 100);
+    mpfmt_fld(stat_rec.free    , sizeof(stat_rec.free    ), "%-*s",     (int) sizeof(stat_rec.free    )   ,    mpsz2rnd(sizestr, tot_size - tot_used));
+    mpfmt_fld(stat_rec.free_prc, sizeof(stat_rec.free_prc), "%%%-*.*f", (int) sizeof(stat_rec.free_prc) -1, 2, !tot_size ? 0.0 : (double)((tot_size - tot_used)/(long double)tot_size) * 100);
 
     mptrc(NULL, "%s", (char *)&stat_rec);
 
@@ -209,7 +209,6 @@ int mpdmp(char *filename)
 {
     FILE *fd = NULL;
     char date[24] = "";
-    mpblock *curr_block = NULL;
     int i = 0;
     long long j = 0;
     int margin = 0;
@@ -263,11 +262,10 @@ int mpdmp(char *filename)
         mptrc(fd, "----------------------------------------------------------------------------------");
 
         /* Loop all memory pool blocks */
-        blkno = 1;
-        curr_block = mp_arr[i].head_block;
-        while(curr_block != NULL)
+        for (blkno = 1; blkno <= mp_arr[i].block_cnt; blkno++)
         {
 
+            mpblock *curr_block = mp_arr[i].blocks[blkno -1];
             uchar *block = curr_block->block;
             size_t size = curr_block->used;
             margin = (int)((uintptr_t)block % alignment);
@@ -311,9 +309,6 @@ int mpdmp(char *filename)
                     skip = 0;
                 }
             }
-
-            blkno++;
-            curr_block = curr_block->next;
         }
 
     }
@@ -485,4 +480,43 @@ static size_t mppow(int x, int y)
     return pow;
 }
 
+/****************************************************************************
+|*
+|* Function: mpfmt_fld
+|*
+|* Description;
+|*
+|*     Formats a fixed width field of a record of mpprn(): the text is cut
+|*     or padded with blanks to exactly fld_sz bytes, without the 
+|*     terminating nul, so it never writes into the next field.
+|*
+|* Return:
+|*     n/a
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|* 20261019    JG    Initial version
+|*
+****************************************************************************/
+static void mpfmt_fld(char *fld, size_t fld_sz, const char *fmt, ...)
+{
+    char buf[64];
+    va_list ap;
+    int len = 0;
+
+    if (fld_sz >= sizeof(buf))
+    {
+        fld_sz = sizeof(buf) -1;
+    }
+
+    va_start(ap, fmt);
+    len = vsnprintf(buf, fld_sz +1, fmt, ap);
+    va_end(ap);
+
+    len = len < 0 ? 0 : (size_t)len > fld_sz ? (int)fld_sz : len;
+    memset(fld, ' ', fld_sz);
+    memcpy(fld, buf, (size_t)len);
+}
+
 /* EOF */
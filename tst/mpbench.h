@@ -0,0 +1,71 @@
+/****************************************************************************
+|*
+|* tap3edit Tools (http://www.tap3edit.com)
+|*
+|* Copyright (c) 2014-2018, Javier Gutierrez <https://github.com/tap3edit/mp>
+|* 
+|* Permission to use, copy, modify, and/or distribute this software for any
+|* purpose with or without fee is hereby granted, provided that the above
+|* copyright notice and this permission notice appear in all copies.
+|* 
+|* THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+|* WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+|* MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+|* ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+|* WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+|* ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+|* OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+|*
+|*
+|* Module: mpbench.h
+|*
+|* Description: Helpers shared by the benchmark programs
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|*
+|* When         Who     Pos     What
+|* 20261019     JG              Initial version
+|*
+****************************************************************************/
+
+#ifndef _MPBENCH_H_ /* { */
+#define _MPBENCH_H_
+
+/* Includes */
+#if _WIN32 /* { */
+#   include <windows.h>
+#else /* } _WIN32 { */
+#   include <time.h>
+#endif /* } _WIN32 */
+
+/****************************************************************************
+|*
+|* Function: mpbench_now
+|*
+|* Description;
+|*
+|*     Monotonic clock in seconds, for measuring elapsed times
+|*
+|* Return:
+|*     current time in seconds
+|*
+****************************************************************************/
+static double mpbench_now()
+{
+#if _WIN32 /* { */
+    LARGE_INTEGER freq, cnt;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&cnt);
+    return (double)cnt.QuadPart / (double)freq.QuadPart;
+#else /* } _WIN32 { */
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+#endif /* } _WIN32 */
+}
+
+#endif /* } _MPBENCH_H_ */
+
+/* EOF */
@@ -0,0 +1,119 @@
+/****************************************************************************
+|*
+|* tap3edit Tools (http://www.tap3edit.com)
+|*
+|* Copyright (c) 2014-2018, Javier Gutierrez <https://github.com/tap3edit/mp>
+|* 
+|* Permission to use, copy, modify, and/or distribute this software for any
+|* purpose with or without fee is hereby granted, provided that the above
+|* copyright notice and this permission notice appear in all copies.
+|* 
+|* THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+|* WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+|* MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+|* ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+|* WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+|* ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+|* OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+|*
+|*
+|* Module: mpbench_asprintf.c
+|*
+|* Description: Benchmark of mpasprintf_mpid() building small formatted 
+|*              keys, against the former implementation which measured the
+|*              output with vsnprintf(NULL, 0, ...) before formatting it 
+|*              with vsprintf(). Run as:
+|*              ./mpbench_asprintf [number of keys]
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|*
+|* When         Who     Pos     What
+|* 20261019     JG              Initial version
+|*
+****************************************************************************/
+
+#if !_WIN32
+#   define _POSIX_C_SOURCE 199309L                          /* clock_gettime() */
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+
+#include "mp.h"
+#include "mpbench.h"
+
+#define KEY_FMT        "customer:%08d:%s:%x"
+
+/* Former implementation: the format is processed twice */
+static int asprintf_two_pass(char **strp, int mpid, const char *fmt, ...)
+{
+    int rc = -1;
+    int len = 0;
+    va_list ap;
+
+    va_start(ap, fmt);
+    len = vsnprintf(NULL, 0, fmt, ap) + 1;
+    va_end(ap);
+
+    if (len > 0 && (*strp = (char *)mpmalloc_mpid(len, mpid)) != NULL)
+    {
+        va_start(ap, fmt);
+        rc = vsprintf(*strp, fmt, ap);
+        va_end(ap);
+    }
+
+    return rc;
+}
+
+int main(int argc, char *argv[])
+{
+    int cnt = 1000000;
+    int mpid = MP_NO_MP_ID;
+    char *key = NULL;
+    double t0 = 0.0;
+    int i = 0;
+
+    if (argc > 1)
+    {
+        cnt = atoi(argv[1]);
+    }
+
+    if ((mpid = mpnew("mpasprintf")) < 0)
+    {
+        printf("Error on mpnew(): %s\n", mpstrerror());
+        return 1;
+    }
+
+    printf("%d keys\n", cnt);
+
+    t0 = mpbench_now();
+    for (i = 0; i < cnt; i++)
+    {
+        if (asprintf_two_pass(&key, mpid, KEY_FMT, i, "eur", i * 7) < 0)
+        {
+            printf("Error formatting key %d: %s\n", i, mpstrerror());
+            return 1;
+        }
+    }
+    printf("   two passes             %12.6f s\n", mpbench_now() - t0);
+    mpclr(mpid);
+
+    t0 = mpbench_now();
+    for (i = 0; i < cnt; i++)
+    {
+        if (mpasprintf_mpid(&key, mpid, KEY_FMT, i, "eur", i * 7) < 0)
+        {
+            printf("Error formatting key %d: %s\n", i, mpstrerror());
+            return 1;
+        }
+    }
+    printf("   mpasprintf_mpid()      %12.6f s\n", mpbench_now() - t0);
+
+    mpdel_all();
+
+    return 0;
+}
+
+/* EOF */
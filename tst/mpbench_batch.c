@@ -0,0 +1,148 @@
+/****************************************************************************
+|*
+|* tap3edit Tools (http://www.tap3edit.com)
+|*
+|* Copyright (c) 2014-2018, Javier Gutierrez <https://github.com/tap3edit/mp>
+|* 
+|* Permission to use, copy, modify, and/or distribute this software for any
+|* purpose with or without fee is hereby granted, provided that the above
+|* copyright notice and this permission notice appear in all copies.
+|* 
+|* THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+|* WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+|* MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+|* ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+|* WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+|* ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+|* OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+|*
+|*
+|* Module: mpbench_batch.c
+|*
+|* Description: Benchmark of building columnar record batches: the columns
+|*              and the small fields of each batch allocated one by one 
+|*              with mpmemalign_mpid() and mpmalloc_mpid(), against 
+|*              mpmalloc_soa() and mpmalloc_batch(). Run as:
+|*              ./mpbench_batch [rows per batch] [number of batches]
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|*
+|* When         Who     Pos     What
+|* 20261019     JG              Initial version
+|*
+****************************************************************************/
+
+#if !_WIN32
+#   define _POSIX_C_SOURCE 199309L                          /* clock_gettime() */
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mp.h"
+#include "mpbench.h"
+
+#define NCOLS          8                                    /* Columns of each batch */
+#define NFIELDS        16                                   /* Small fields (header, names, etc.) of each batch */
+#define CLR_EVERY      64                                   /* Batches built before clearing the pool */
+
+static const size_t col_sz[NCOLS] = {8, 8, 4, 4, 2, 1, 8, 4};
+static const size_t fld_sz[NFIELDS] = {24, 8, 16, 16, 32, 8, 8, 12, 40, 8, 16, 4, 24, 8, 8, 16};
+
+static void fill(void **cols, size_t rows)
+{
+    int i = 0;
+
+    for (i = 0; i < NCOLS; i++)
+    {
+        memset(cols[i], i, col_sz[i] * rows);
+    }
+}
+
+static double batches(int mpid, int batched, size_t rows, int cnt)
+{
+    double t0 = mpbench_now();
+    void *cols[NCOLS];
+    void *flds[NFIELDS];
+    int i = 0;
+    int j = 0;
+
+    for (i = 0; i < cnt; i++)
+    {
+        if (i % CLR_EVERY == 0)
+        {
+            mpclr(mpid);
+        }
+
+        if (batched)
+        {
+            if (mpmalloc_batch(mpid, NFIELDS, fld_sz, NULL, flds) != MP_ERRNO_SUCCESS ||
+                    mpmalloc_soa(mpid, NCOLS, rows, col_sz, cols) != MP_ERRNO_SUCCESS)
+            {
+                printf("Error allocating batch %d: %s\n", i, mpstrerror());
+                exit(1);
+            }
+        }
+        else
+        {
+            for (j = 0; j < NFIELDS; j++)
+            {
+                if ((flds[j] = mpmalloc_mpid(fld_sz[j], mpid)) == NULL)
+                {
+                    printf("Error allocating batch %d: %s\n", i, mpstrerror());
+                    exit(1);
+                }
+            }
+            for (j = 0; j < NCOLS; j++)
+            {
+                if ((cols[j] = mpmemalign_mpid(MP_SOA_ALIGN, col_sz[j] * rows, mpid)) == NULL)
+                {
+                    printf("Error allocating batch %d: %s\n", i, mpstrerror());
+                    exit(1);
+                }
+            }
+        }
+        memset(flds[0], 0x00, fld_sz[0]);
+        fill(cols, rows);
+    }
+
+    return mpbench_now() - t0;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t rows = 64;
+    int cnt = 1000000;
+    int mpid = MP_NO_MP_ID;
+
+    if (argc > 1)
+    {
+        rows = (size_t)strtoul(argv[1], NULL, 10);
+    }
+    if (argc > 2)
+    {
+        cnt = atoi(argv[2]);
+    }
+
+    /* One block holds the batches built between two mpclr(), so it is reused */
+    mpset_blksz((rows * 48 + NCOLS * MP_SOA_ALIGN + 512) * CLR_EVERY);
+
+    printf("%d batches of %d columns and %d fields, %lu rows\n", cnt, NCOLS, NFIELDS, (unsigned long)rows);
+
+    if ((mpid = mpnew("batch")) < 0)
+    {
+        printf("Error on mpnew(): %s\n", mpstrerror());
+        return 1;
+    }
+
+    printf("   one call per chunk          %12.6f s\n", batches(mpid, 0, rows, cnt));
+    printf("   mpmalloc_batch() + soa()    %12.6f s\n", batches(mpid, 1, rows, cnt));
+
+    mpdel_all();
+
+    return 0;
+}
+
+/* EOF */
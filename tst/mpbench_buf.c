@@ -0,0 +1,104 @@
+/****************************************************************************
+|*
+|* tap3edit Tools (http://www.tap3edit.com)
+|*
+|* Copyright (c) 2014-2018, Javier Gutierrez <https://github.com/tap3edit/mp>
+|*
+|* Permission to use, copy, modify, and/or distribute this software for any
+|* purpose with or without fee is hereby granted, provided that the above
+|* copyright notice and this permission notice appear in all copies.
+|*
+|* THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+|* WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+|* MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+|* ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+|* WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+|* ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+|* OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+|*
+|*
+|* Module: mpbench_buf.c
+|*
+|* Description: Benchmark of short-lived request handlers, each one with
+|*              its own memory pool for a few small chunks: created with
+|*              mpnew() against mpnew_buf() on a buffer of the stack. Run as:
+|*              ./mpbench_buf [chunks per request] [number of requests]
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|*
+|* When         Who     Pos     What
+|* 20261019     JG              Initial version
+|*
+****************************************************************************/
+
+#if !_WIN32
+#   define _POSIX_C_SOURCE 199309L                          /* clock_gettime() */
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mp.h"
+#include "mpbench.h"
+
+#define BUF_SZ         (16 * 1024)                          /* Buffer on the stack of each request */
+#define CHUNK_SZ       48                                   /* Size of the chunks of a request */
+
+static double requests(int on_buf, int chunks, int cnt)
+{
+    double t0 = mpbench_now();
+    double buf[BUF_SZ / sizeof(double)];
+    char *chunk = NULL;
+    int mpid = MP_NO_MP_ID;
+    int i = 0;
+    int j = 0;
+
+    for (i = 0; i < cnt; i++)
+    {
+        mpid = on_buf ? mpnew_buf("request", buf, sizeof(buf)) : mpnew("request");
+        if (mpid < 0)
+        {
+            printf("Error creating memory pool: %s\n", mpstrerror());
+            exit(1);
+        }
+
+        for (j = 0; j < chunks; j++)
+        {
+            if ((chunk = (char *)mpmalloc_mpid(CHUNK_SZ, mpid)) == NULL)
+            {
+                printf("Error allocating request %d: %s\n", i, mpstrerror());
+                exit(1);
+            }
+            memset(chunk, j, CHUNK_SZ);
+        }
+
+        mpdel(mpid);
+    }
+
+    return mpbench_now() - t0;
+}
+
+int main(int argc, char *argv[])
+{
+    int chunks = 16;
+    int cnt = 1000000;
+
+    if (argc > 1)
+    {
+        chunks = atoi(argv[1]);
+    }
+    if (argc > 2)
+    {
+        cnt = atoi(argv[2]);
+    }
+
+    printf("%d requests of %d chunks of %d bytes\n", cnt, chunks, CHUNK_SZ);
+    printf("   mpnew()                     %12.6f s\n", requests(0, chunks, cnt));
+    printf("   mpnew_buf() on the stack    %12.6f s\n", requests(1, chunks, cnt));
+
+    return 0;
+}
+
+/* EOF */
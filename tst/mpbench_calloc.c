@@ -0,0 +1,156 @@
+/****************************************************************************
+|*
+|* tap3edit Tools (http://www.tap3edit.com)
+|*
+|* Copyright (c) 2014-2018, Javier Gutierrez <https://github.com/tap3edit/mp>
+|* 
+|* Permission to use, copy, modify, and/or distribute this software for any
+|* purpose with or without fee is hereby granted, provided that the above
+|* copyright notice and this permission notice appear in all copies.
+|* 
+|* THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+|* WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+|* MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+|* ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+|* WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+|* ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+|* OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+|*
+|*
+|* Module: mpbench_calloc.c
+|*
+|* Description: Benchmark of allocating zeroed tables which are later only
+|*              sparsely written: mpcalloc() on fresh blocks, mpmalloc() 
+|*              followed by memset(), calloc() and mpcalloc() on blocks 
+|*              reused after mpclr(). Run as:
+|*              ./mpbench_calloc [table Kb] [number of tables]
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|*
+|* When         Who     Pos     What
+|* 20261019     JG              Initial version
+|*
+****************************************************************************/
+
+#if !_WIN32
+#   define _POSIX_C_SOURCE 199309L                          /* clock_gettime() */
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mp.h"
+#include "mpbench.h"
+
+#define KB             ((size_t)1024)
+#define STRIDE         (64 * KB)
+
+#define ALLOC_MPCALLOC 0
+#define ALLOC_MPMALLOC 1
+#define ALLOC_CALLOC   2
+
+/* Writes one byte every STRIDE bytes, as a sparse table would be filled */
+static void fill(char *table, size_t table_sz)
+{
+    size_t i = 0;
+
+    for (i = 0; i < table_sz; i += STRIDE)
+    {
+        table[i] = 1;
+    }
+}
+
+static double tables(int mpid, int how, size_t table_sz, int cnt, char **arr)
+{
+    double t0 = mpbench_now();
+    int i = 0;
+
+    for (i = 0; i < cnt; i++)
+    {
+        switch (how)
+        {
+            case ALLOC_MPCALLOC:
+                arr[i] = (char *)mpcalloc_mpid(1, table_sz, mpid);
+                break;
+            case ALLOC_MPMALLOC:
+                if ((arr[i] = (char *)mpmalloc_mpid(table_sz, mpid)) != NULL)
+                {
+                    memset(arr[i], 0x00, table_sz);
+                }
+                break;
+            default:
+                arr[i] = (char *)calloc(1, table_sz);
+        }
+
+        if (arr[i] == NULL)
+        {
+            printf("Error allocating table %d: %s\n", i, mpstrerror());
+            exit(1);
+        }
+        fill(arr[i], table_sz);
+    }
+
+    return mpbench_now() - t0;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t table_sz = 256 * KB;
+    int cnt = 1024;
+    int mpid = MP_NO_MP_ID;
+    char **arr = NULL;
+    int i = 0;
+
+    if (argc > 1)
+    {
+        table_sz = (size_t)strtoul(argv[1], NULL, 10) * KB;
+    }
+    if (argc > 2)
+    {
+        cnt = atoi(argv[2]);
+    }
+
+    if ((arr = (char **)malloc(cnt * sizeof(char *))) == NULL)
+    {
+        printf("Error allocating the array of tables\n");
+        return 1;
+    }
+    mpset_memlim(table_sz * cnt * 4);
+
+    printf("%d tables of %lu Kb\n", cnt, (unsigned long)(table_sz / KB));
+
+    if ((mpid = mpnew("mpcalloc")) < 0)
+    {
+        printf("Error on mpnew(): %s\n", mpstrerror());
+        return 1;
+    }
+    printf("   mpcalloc() fresh blocks     %12.6f s\n", tables(mpid, ALLOC_MPCALLOC, table_sz, cnt, arr));
+    mpdel(mpid);
+
+    if ((mpid = mpnew("mpmalloc")) < 0)
+    {
+        printf("Error on mpnew(): %s\n", mpstrerror());
+        return 1;
+    }
+    printf("   mpmalloc() + memset()       %12.6f s\n", tables(mpid, ALLOC_MPMALLOC, table_sz, cnt, arr));
+
+    /* Same pool, blocks already written */
+    mpclr(mpid);
+    printf("   mpcalloc() after mpclr()    %12.6f s\n", tables(mpid, ALLOC_MPCALLOC, table_sz, cnt, arr));
+    mpdel(mpid);
+
+    printf("   calloc()                    %12.6f s\n", tables(mpid, ALLOC_CALLOC, table_sz, cnt, arr));
+    for (i = 0; i < cnt; i++)
+    {
+        free(arr[i]);
+    }
+
+    free(arr);
+    mpdel_all();
+
+    return 0;
+}
+
+/* EOF */
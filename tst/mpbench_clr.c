@@ -0,0 +1,125 @@
+/****************************************************************************
+|*
+|* tap3edit Tools (http://www.tap3edit.com)
+|*
+|* Copyright (c) 2014-2018, Javier Gutierrez <https://github.com/tap3edit/mp>
+|*
+|* Permission to use, copy, modify, and/or distribute this software for any
+|* purpose with or without fee is hereby granted, provided that the above
+|* copyright notice and this permission notice appear in all copies.
+|*
+|* THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+|* WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+|* MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+|* ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+|* WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+|* ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+|* OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+|*
+|*
+|* Module: mpbench_clr.c
+|*
+|* Description: Benchmark of the clear policies of mpclr() against the size
+|*              of the memory pool: the time of mpclr() itself and the one
+|*              of filling the memory pool again after it, where the pages
+|*              given back by MP_CLR_DISCARD are faulted in. Run as:
+|*              ./mpbench_clr [cycles]
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|*
+|* When         Who     Pos     What
+|* 20261019     JG              Initial version
+|*
+****************************************************************************/
+
+#if !_WIN32
+#   define _POSIX_C_SOURCE 199309L                          /* clock_gettime() */
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mp.h"
+#include "mpbench.h"
+
+#define CHUNK_SZ       4096                                 /* Size of the chunks filling the memory pool */
+
+static void fill(int mpid, size_t size)
+{
+    char *chunk = NULL;
+    size_t i = 0;
+
+    for (i = 0; i + CHUNK_SZ <= size; i += CHUNK_SZ)
+    {
+        if ((chunk = (char *)mpmalloc_mpid(CHUNK_SZ, mpid)) == NULL)
+        {
+            printf("Error allocating memory: %s\n", mpstrerror());
+            exit(1);
+        }
+        memset(chunk, (int)(i / CHUNK_SZ), CHUNK_SZ);
+    }
+}
+
+static void cycles(size_t size, int policy, int cnt, double *t_clr, double *t_fill)
+{
+    double t0 = 0;
+    int mpid = MP_NO_MP_ID;
+    int i = 0;
+
+    /* One block holds the whole memory pool, so it is the one filled again */
+    mpset_blksz(size);
+    if ((mpid = mpnew("clr")) < 0 || mpset_clr(mpid, policy) != MP_ERRNO_SUCCESS)
+    {
+        printf("Error creating memory pool: %s\n", mpstrerror());
+        exit(1);
+    }
+    fill(mpid, size);
+
+    *t_clr = 0;
+    *t_fill = 0;
+    for (i = 0; i < cnt; i++)
+    {
+        t0 = mpbench_now();
+        mpclr(mpid);
+        *t_clr += mpbench_now() - t0;
+
+        t0 = mpbench_now();
+        fill(mpid, size);
+        *t_fill += mpbench_now() - t0;
+    }
+
+    mpdel(mpid);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *name[3] = {"MP_CLR_RESET", "MP_CLR_ZERO", "MP_CLR_DISCARD"};
+    int policy[3] = {MP_CLR_RESET, MP_CLR_ZERO, MP_CLR_DISCARD};
+    size_t size = 0;
+    double t_clr = 0;
+    double t_fill = 0;
+    int cnt = 50;
+    int p = 0;
+
+    if (argc > 1)
+    {
+        cnt = atoi(argv[1]);
+    }
+
+    printf("%d cycles of mpclr() and filling again, times per cycle in ms\n", cnt);
+    printf("   %-10s %-16s %12s %12s\n", "size", "policy", "mpclr()", "fill");
+    for (size = 64 * 1024; size <= 256 * 1024 * 1024; size *= 4)
+    {
+        for (p = 0; p < 3; p++)
+        {
+            cycles(size, policy[p], cnt, &t_clr, &t_fill);
+            printf("   %7lu KB %-16s %12.4f %12.4f\n", (unsigned long)(size / 1024), name[p], t_clr * 1000 / cnt, t_fill * 1000 / cnt);
+        }
+    }
+
+    return 0;
+}
+
+/* EOF */
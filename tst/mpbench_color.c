@@ -0,0 +1,142 @@
+/****************************************************************************
+|*
+|* tap3edit Tools (http://www.tap3edit.com)
+|*
+|* Copyright (c) 2014-2018, Javier Gutierrez <https://github.com/tap3edit/mp>
+|* 
+|* Permission to use, copy, modify, and/or distribute this software for any
+|* purpose with or without fee is hereby granted, provided that the above
+|* copyright notice and this permission notice appear in all copies.
+|* 
+|* THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+|* WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+|* MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+|* ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+|* WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+|* ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+|* OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+|*
+|*
+|* Module: mpbench_color.c
+|*
+|* Description: Benchmark of streaming at the same time through arrays of
+|*              several memory pools, one array per pool, with and without
+|*              coloring of the blocks (mpset_colors()). Without coloring 
+|*              all arrays start at the same offset modulo the page size. 
+|*              Run as:
+|*              ./mpbench_color [number of pools] [array Kb] [rounds]
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|*
+|* When         Who     Pos     What
+|* 20261019     JG              Initial version
+|*
+****************************************************************************/
+
+#if !_WIN32
+#   define _POSIX_C_SOURCE 199309L                          /* clock_gettime() */
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mp.h"
+#include "mpbench.h"
+
+#define KB             ((size_t)1024)
+#define MAX_POOLS      64
+
+/* Each element of the first array is the sum of the elements of the others */
+static double stream(double **arr, int pools, size_t nelem, int rounds)
+{
+    double t0 = mpbench_now();
+    double sum = 0;
+    size_t i = 0;
+    int r = 0;
+    int p = 0;
+
+    for (r = 0; r < rounds; r++)
+    {
+        for (i = 0; i < nelem; i++)
+        {
+            sum = 0;
+            for (p = 1; p < pools; p++)
+            {
+                sum += arr[p][i];
+            }
+            arr[0][i] = sum;
+        }
+    }
+
+    return mpbench_now() - t0;
+}
+
+static double run(int colors, int pools, size_t arr_sz, int rounds)
+{
+    int mpid[MAX_POOLS];
+    double *arr[MAX_POOLS];
+    double t = 0;
+    int p = 0;
+
+    mpset_colors(colors);
+    for (p = 0; p < pools; p++)
+    {
+        if ((mpid[p] = mpnew("color")) < 0 ||
+                (arr[p] = (double *)mpmalloc_mpid(arr_sz, mpid[p])) == NULL)
+        {
+            printf("Error allocating array %d: %s\n", p, mpstrerror());
+            exit(1);
+        }
+        memset(arr[p], 0x00, arr_sz);
+        arr[p][0] = p;
+    }
+
+    t = stream(arr, pools, arr_sz / sizeof(double), rounds);
+    if (arr[0][0] <= 0)
+    {
+        printf("Wrong result\n");
+    }
+
+    for (p = 0; p < pools; p++)
+    {
+        mpdel(mpid[p]);
+    }
+
+    return t;
+}
+
+int main(int argc, char *argv[])
+{
+    int pools = 32;
+    size_t arr_sz = 128 * KB;
+    int rounds = 1000;
+
+    if (argc > 1)
+    {
+        pools = atoi(argv[1]);
+        pools = pools < 2 ? 2 : pools > MAX_POOLS ? MAX_POOLS : pools;
+    }
+    if (argc > 2)
+    {
+        arr_sz = (size_t)strtoul(argv[2], NULL, 10) * KB;
+    }
+    if (argc > 3)
+    {
+        rounds = atoi(argv[3]);
+    }
+
+    /* One block per array, all of the same size */
+    mpset_blksz(arr_sz);
+
+    printf("%d pools, arrays of %lu Kb, %d rounds\n", pools, (unsigned long)(arr_sz / KB), rounds);
+    printf("   no coloring                 %12.6f s\n", run(0, pools, arr_sz, rounds));
+    printf("   %2d colors                   %12.6f s\n", pools, run(pools, pools, arr_sz, rounds));
+
+    mpdel_all();
+
+    return 0;
+}
+
+/* EOF */
@@ -0,0 +1,172 @@
+/****************************************************************************
+|*
+|* tap3edit Tools (http://www.tap3edit.com)
+|*
+|* Copyright (c) 2014-2018, Javier Gutierrez <https://github.com/tap3edit/mp>
+|* 
+|* Permission to use, copy, modify, and/or distribute this software for any
+|* purpose with or without fee is hereby granted, provided that the above
+|* copyright notice and this permission notice appear in all copies.
+|* 
+|* THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+|* WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+|* MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+|* ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+|* WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+|* ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+|* OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+|*
+|*
+|* Module: mpbench_pingpong.c
+|*
+|* Description: Benchmark of a producer thread allocating nodes which a 
+|*              consumer thread gives back once done: objects of a slab pool
+|*              given back from the consumer with mpslab_free(), against
+|*              malloc() and free(). Run as:
+|*              ./mpbench_pingpong [number of nodes]
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|*
+|* When         Who     Pos     What
+|* 20261019     JG              Initial version
+|*
+****************************************************************************/
+
+#if !_WIN32
+#   define _POSIX_C_SOURCE 199309L                          /* clock_gettime(), sched_yield() */
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#if !_WIN32 /* { */
+#   include <pthread.h>
+#   include <sched.h>
+#   define YIELD()     sched_yield()
+#else /* } _WIN32 { */
+#   include <windows.h>
+#   define YIELD()     SwitchToThread()
+#endif /* } _WIN32 */
+
+#include "mp.h"
+#include "mpbench.h"
+
+#define RING           1024                                 /* Slots between producer and consumer */
+
+typedef struct node_t
+{
+    long              seq;
+    char              payload[56];
+} node_t;
+
+static void * volatile ring[RING];
+static long cnt = 10000000;
+static int use_mp = 1;
+static int mpid = MP_NO_MP_ID;
+
+#if !_WIN32
+static void *consumer(void *arg)
+#else
+static DWORD WINAPI consumer(LPVOID arg)
+#endif
+{
+    long i = 0;
+    long sum = 0;
+    node_t *node = NULL;
+
+    for (i = 0; i < cnt; i++)
+    {
+        while ((node = (node_t *)MP_ATOMIC_XCHG_PTR(&ring[i % RING], NULL)) == NULL)
+        {
+            YIELD();
+        }
+        sum += node->seq;
+
+        if (use_mp)
+        {
+            mpslab_free(node, mpid);
+        }
+        else
+        {
+            free(node);
+        }
+    }
+
+    *(long *)arg = sum;
+
+    return 0;
+}
+
+static double pingpong(int with_mp)
+{
+    double t0 = mpbench_now();
+    long sum = 0;
+    long i = 0;
+    node_t *node = NULL;
+#if !_WIN32
+    pthread_t th;
+#else
+    HANDLE th;
+#endif
+
+    use_mp = with_mp;
+
+#if !_WIN32
+    pthread_create(&th, NULL, consumer, &sum);
+#else
+    th = CreateThread(NULL, 0, consumer, &sum, 0, NULL);
+#endif
+
+    for (i = 0; i < cnt; i++)
+    {
+        node = (node_t *)(use_mp ? mpslab_alloc(mpid) : malloc(sizeof(node_t)));
+        if (node == NULL)
+        {
+            printf("Error allocating node %ld: %s\n", i, mpstrerror());
+            exit(1);
+        }
+        node->seq = i;
+
+        while (!MP_ATOMIC_CAS_PTR(&ring[i % RING], NULL, node))
+        {
+            YIELD();
+        }
+    }
+
+#if !_WIN32
+    pthread_join(th, NULL);
+#else
+    WaitForSingleObject(th, INFINITE);
+#endif
+
+    if (sum != cnt * (cnt -1) / 2)
+    {
+        printf("Wrong checksum %ld\n", sum);
+    }
+
+    return mpbench_now() - t0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1)
+    {
+        cnt = atol(argv[1]);
+    }
+
+    if ((mpid = mpnew_slab("pingpong", sizeof(node_t))) < 0)
+    {
+        printf("Error on mpnew_slab(): %s\n", mpstrerror());
+        return 1;
+    }
+
+    printf("%ld nodes of %lu bytes\n", cnt, (unsigned long)sizeof(node_t));
+    printf("   mpslab_alloc() + remote mpslab_free()  %12.6f s\n", pingpong(1));
+    printf("   malloc() + remote free()               %12.6f s\n", pingpong(0));
+
+    mpdel_all();
+
+    return 0;
+}
+
+/* EOF */
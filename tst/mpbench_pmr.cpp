@@ -0,0 +1,195 @@
+/****************************************************************************
+|*
+|* tap3edit Tools (http://www.tap3edit.com)
+|*
+|* Copyright (c) 2014-2018, Javier Gutierrez <https://github.com/tap3edit/mp>
+|*
+|* Permission to use, copy, modify, and/or distribute this software for any
+|* purpose with or without fee is hereby granted, provided that the above
+|* copyright notice and this permission notice appear in all copies.
+|*
+|* THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+|* WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+|* MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+|* ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+|* WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+|* ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+|* OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+|*
+|*
+|* Module: mpbench_pmr.cpp
+|*
+|* Description: Benchmark of C++ containers (vector, string and
+|*              unordered_map) built per request and dropped at once: with
+|*              the default allocator, std::pmr::monotonic_buffer_resource,
+|*              mp::resource and mp::allocator. Run as:
+|*              ./mpbench_pmr [keys per request] [number of requests]
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|*
+|* When         Who     Pos     What
+|* 20261019     JG              Initial version
+|*
+****************************************************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <string_view>
+#include <memory_resource>
+
+#include "mp.hpp"
+#include "mpbench.h"
+
+#define KEY_PREFIX     "request-key-with-some-length-"      /* Keys longer than the small string buffer */
+
+/* std::hash of the strings of any allocator (std::hash covers them only since C++20) */
+struct str_hash
+{
+    template <class S> size_t operator()(const S &s) const noexcept
+    {
+        return std::hash<std::string_view>()(std::string_view(s.data(), s.size()));
+    }
+};
+
+/* One request: a map of keys to vectors of values, using the allocator of the strings S */
+template <class S, class V, class M>
+static size_t request(M &map, size_t keys)
+{
+    size_t sum = 0;
+    size_t i = 0;
+
+    map.reserve(keys);
+    for (i = 0; i < keys; i++)
+    {
+        S key(KEY_PREFIX, map.get_allocator());
+        key += std::to_string(i).c_str();
+        V &vals = map[key];
+        vals.push_back(i);
+        vals.push_back(i * 2);
+        vals.push_back(i * 3);
+    }
+    for (typename M::const_iterator it = map.begin(); it != map.end(); ++it)
+    {
+        sum += it->first.size() + it->second.back();
+    }
+
+    return sum;
+}
+
+static double bench_std(size_t keys, int cnt, size_t *sum)
+{
+    typedef std::string S;
+    typedef std::vector<size_t> V;
+    double t0 = mpbench_now();
+    int i = 0;
+
+    for (i = 0; i < cnt; i++)
+    {
+        std::unordered_map<S, V> map;
+        *sum += request<S, V>(map, keys);
+    }
+
+    return mpbench_now() - t0;
+}
+
+static double bench_monotonic(size_t keys, int cnt, size_t *sum)
+{
+    typedef std::pmr::string S;
+    typedef std::pmr::vector<size_t> V;
+    std::vector<char> buf(keys * 512);
+    double t0 = mpbench_now();
+    int i = 0;
+
+    for (i = 0; i < cnt; i++)
+    {
+        std::pmr::monotonic_buffer_resource res(buf.data(), buf.size());
+        std::pmr::unordered_map<S, V> map(&res);
+        *sum += request<S, V>(map, keys);
+    }
+
+    return mpbench_now() - t0;
+}
+
+static double bench_mp_resource(int mpid, size_t keys, int cnt, size_t *sum)
+{
+    typedef std::pmr::string S;
+    typedef std::pmr::vector<size_t> V;
+    mp::resource res(mpid);
+    double t0 = mpbench_now();
+    int i = 0;
+
+    for (i = 0; i < cnt; i++)
+    {
+        {
+            std::pmr::unordered_map<S, V> map(&res);
+            *sum += request<S, V>(map, keys);
+        }
+        mpclr(mpid);
+    }
+
+    return mpbench_now() - t0;
+}
+
+static double bench_mp_allocator(int mpid, size_t keys, int cnt, size_t *sum)
+{
+    typedef std::basic_string<char, std::char_traits<char>, mp::allocator<char> > S;
+    typedef std::vector<size_t, mp::allocator<size_t> > V;
+    typedef std::unordered_map<S, V, str_hash, std::equal_to<S>, mp::allocator<std::pair<const S, V> > > M;
+    double t0 = mpbench_now();
+    int i = 0;
+
+    for (i = 0; i < cnt; i++)
+    {
+        {
+            M map(0, str_hash(), std::equal_to<S>(), M::allocator_type(mpid));
+            *sum += request<S, V>(map, keys);
+        }
+        mpclr(mpid);
+    }
+
+    return mpbench_now() - t0;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t keys = 64;
+    int cnt = 100000;
+    int mpid = MP_NO_MP_ID;
+    size_t sum = 0;
+
+    if (argc > 1)
+    {
+        keys = (size_t)strtoul(argv[1], NULL, 10);
+    }
+    if (argc > 2)
+    {
+        cnt = atoi(argv[2]);
+    }
+
+    /* One block holds a whole request, so it is reused after mpclr() */
+    mpset_blksz(keys * 512);
+
+    if ((mpid = mpnew((char *)"pmr")) < 0)
+    {
+        printf("Error on mpnew(): %s\n", mpstrerror());
+        return 1;
+    }
+
+    printf("%d requests of %lu keys\n", cnt, (unsigned long)keys);
+    printf("   std::allocator              %12.6f s\n", bench_std(keys, cnt, &sum));
+    printf("   monotonic_buffer_resource   %12.6f s\n", bench_monotonic(keys, cnt, &sum));
+    printf("   mp::resource                %12.6f s\n", bench_mp_resource(mpid, keys, cnt, &sum));
+    printf("   mp::allocator               %12.6f s\n", bench_mp_allocator(mpid, keys, cnt, &sum));
+    printf("   (checksum %lu)\n", (unsigned long)sum);
+
+    mpdel_all();
+
+    return 0;
+}
+
+/* EOF */
@@ -0,0 +1,152 @@
+/****************************************************************************
+|*
+|* tap3edit Tools (http://www.tap3edit.com)
+|*
+|* Copyright (c) 2014-2018, Javier Gutierrez <https://github.com/tap3edit/mp>
+|*
+|* Permission to use, copy, modify, and/or distribute this software for any
+|* purpose with or without fee is hereby granted, provided that the above
+|* copyright notice and this permission notice appear in all copies.
+|*
+|* THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+|* WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+|* MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+|* ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+|* WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+|* ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+|* OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+|*
+|*
+|* Module: mpbench_rcy.c
+|*
+|* Description: Benchmark of threads running short-lived requests, each one
+|*              with its own memory pool of a few blocks: blocks taken from
+|*              the heap against blocks reused from the recycler. Run as:
+|*              ./mpbench_rcy [threads] [blocks per request] [requests]
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|*
+|* When         Who     Pos     What
+|* 20261019     JG              Initial version
+|*
+****************************************************************************/
+
+#if !_WIN32
+#   define _POSIX_C_SOURCE 199309L                          /* clock_gettime() */
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if !_WIN32 /* { */
+#   include <pthread.h>
+#else /* } _WIN32 { */
+#   include <windows.h>
+#endif /* } _WIN32 */
+
+#include "mp.h"
+#include "mpbench.h"
+
+#define MAX_THREADS    64
+#define CHUNK_SZ       1024                                 /* Size of the chunks of a request */
+
+static int blocks = 4;
+static int cnt = 20000;
+
+#if !_WIN32
+static void *requests(void *arg)
+#else
+static DWORD WINAPI requests(LPVOID arg)
+#endif
+{
+    int chunks = (int)(mpget_blksz() / CHUNK_SZ) * blocks;
+    char *chunk = NULL;
+    int mpid = MP_NO_MP_ID;
+    int i = 0;
+    int j = 0;
+
+    for (i = 0; i < cnt; i++)
+    {
+        if ((mpid = mpnew("request")) < 0)
+        {
+            printf("Error creating memory pool: %s\n", mpstrerror());
+            exit(1);
+        }
+
+        for (j = 0; j < chunks; j++)
+        {
+            if ((chunk = (char *)mpmalloc_mpid(CHUNK_SZ, mpid)) == NULL)
+            {
+                printf("Error allocating request %d: %s\n", i, mpstrerror());
+                exit(1);
+            }
+            chunk[0] = (char)j;
+        }
+
+        mpdel(mpid);
+    }
+
+    (void)arg;
+
+    return 0;
+}
+
+static double run(int threads)
+{
+    double t0 = mpbench_now();
+    int i = 0;
+#if !_WIN32
+    pthread_t th[MAX_THREADS];
+#else
+    HANDLE th[MAX_THREADS];
+#endif
+
+    for (i = 0; i < threads; i++)
+    {
+#if !_WIN32
+        pthread_create(&th[i], NULL, requests, NULL);
+#else
+        th[i] = CreateThread(NULL, 0, requests, NULL, 0, NULL);
+#endif
+    }
+    for (i = 0; i < threads; i++)
+    {
+#if !_WIN32
+        pthread_join(th[i], NULL);
+#else
+        WaitForSingleObject(th[i], INFINITE);
+#endif
+    }
+
+    return mpbench_now() - t0;
+}
+
+int main(int argc, char *argv[])
+{
+    int threads = 4;
+
+    if (argc > 1)
+    {
+        threads = atoi(argv[1]);
+        threads = threads < 1 ? 1 : threads > MAX_THREADS ? MAX_THREADS : threads;
+    }
+    if (argc > 2)
+    {
+        blocks = atoi(argv[2]);
+    }
+    if (argc > 3)
+    {
+        cnt = atoi(argv[3]);
+    }
+
+    printf("%d threads, %d requests of %d blocks of %lu bytes each\n", threads, cnt, blocks, (unsigned long)mpget_blksz());
+    printf("   blocks of the heap          %12.6f s\n", run(threads));
+    mpset_rcysz(mpget_blksz() * blocks * threads);
+    printf("   blocks of the recycler      %12.6f s\n", run(threads));
+    mpset_rcysz(0);
+
+    return 0;
+}
+
+/* EOF */
@@ -0,0 +1,115 @@
+/****************************************************************************
+|*
+|* tap3edit Tools (http://www.tap3edit.com)
+|*
+|* Copyright (c) 2014-2018, Javier Gutierrez <https://github.com/tap3edit/mp>
+|* 
+|* Permission to use, copy, modify, and/or distribute this software for any
+|* purpose with or without fee is hereby granted, provided that the above
+|* copyright notice and this permission notice appear in all copies.
+|* 
+|* THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+|* WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+|* MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+|* ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+|* WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+|* ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+|* OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+|*
+|*
+|* Module: mpbench_realloc.c
+|*
+|* Description: Benchmark of mprealloc() growing a buffer from 1 Mb up to
+|*              4 Gb by doubling its size, once with chunks in their own 
+|*              mapping (grown by the system) and once copying them. Run as:
+|*              ./mpbench_realloc [max Mb] [max Mb when copying]
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|*
+|* When         Who     Pos     What
+|* 20261019     JG              Initial version
+|*
+****************************************************************************/
+
+#if !_WIN32
+#   define _POSIX_C_SOURCE 199309L                          /* clock_gettime() */
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "mp.h"
+#include "mpbench.h"
+
+#define MB             ((size_t)1024 * 1024)
+
+static int grow(char *title, size_t max_sz)
+{
+    int mpid = MP_NO_MP_ID;
+    char *buf = NULL;
+    size_t sz = MB;
+    double start = 0.0, t0 = 0.0;
+
+    if ((mpid = mpnew(title)) < 0)
+    {
+        printf("Error on mpnew(): %s\n", mpstrerror());
+        return 1;
+    }
+
+    if ((buf = (char *)mpmalloc_mpid(sz, mpid)) == NULL)
+    {
+        printf("Error on mpmalloc_mpid(): %s\n", mpstrerror());
+        return 1;
+    }
+    buf[sz -1] = 1;
+
+    printf("%s\n", title);
+    start = mpbench_now();
+    for (sz *= 2; sz <= max_sz; sz *= 2)
+    {
+        t0 = mpbench_now();
+        if ((buf = (char *)mprealloc_mpid(buf, sz, mpid)) == NULL)
+        {
+            printf("   Error on mprealloc_mpid() to %lu Mb: %s\n", (unsigned long)(sz / MB), mpstrerror());
+            break;
+        }
+        buf[sz -1] = 1; /* Append something at the end */
+        printf("   %6lu Mb %12.6f s\n", (unsigned long)(sz / MB), mpbench_now() - t0);
+    }
+    printf("   Total     %12.6f s\n", mpbench_now() - start);
+
+    mpdel(mpid);
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t max_sz = 4096 * MB;
+    size_t copy_max_sz = 256 * MB;
+
+    if (argc > 1)
+    {
+        max_sz = (size_t)strtoul(argv[1], NULL, 10) * MB;
+    }
+    if (argc > 2)
+    {
+        copy_max_sz = (size_t)strtoul(argv[2], NULL, 10) * MB;
+    }
+
+    mpset_memlim(max_sz * 4);
+
+    /* Chunks from MP_DEF_MAP_SZ get their own mapping */
+    grow("mprealloc() with own mapping (mremap)", max_sz);
+
+    /* Every growth copies the whole buffer */
+    mpset_mapsz(0);
+    grow("mprealloc() copying", copy_max_sz);
+
+    mpdel_all();
+
+    return 0;
+}
+
+/* EOF */
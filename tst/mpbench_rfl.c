@@ -0,0 +1,156 @@
+/****************************************************************************
+|*
+|* tap3edit Tools (http://www.tap3edit.com)
+|*
+|* Copyright (c) 2014-2018, Javier Gutierrez <https://github.com/tap3edit/mp>
+|*
+|* Permission to use, copy, modify, and/or distribute this software for any
+|* purpose with or without fee is hereby granted, provided that the above
+|* copyright notice and this permission notice appear in all copies.
+|*
+|* THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+|* WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+|* MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+|* ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+|* WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+|* ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+|* OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+|*
+|*
+|* Module: mpbench_rfl.c
+|*
+|* Description: Tail latency of mpmalloc() in a growing memory pool, with
+|*              and without the refill thread keeping a spare block ready
+|*              (mpset_refill(), mpset_spare()). The latency of mpmalloc() 
+|*              alone and the one up to the first write of the chunk, where
+|*              the page faults of a new block land, are given as 
+|*              percentiles. Run as:
+|*              ./mpbench_rfl [block size in Kb] [number of allocations]
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|*
+|* When         Who     Pos     What
+|* 20261019     JG              Initial version
+|*
+****************************************************************************/
+
+#if !_WIN32
+#   define _POSIX_C_SOURCE 199309L                          /* clock_gettime() */
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mp.h"
+#include "mpbench.h"
+
+#define CHUNK_SZ       512                                  /* Size of the chunks */
+
+static int cmp(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static void report(const char *name, double *lat, int cnt)
+{
+    qsort(lat, (size_t)cnt, sizeof(double), cmp);
+    printf("   %-24s %10.2f %10.2f %10.2f %10.2f\n", name, lat[cnt / 2] * 1e6, lat[(int)(cnt * 0.99)] * 1e6,
+            lat[(int)(cnt * 0.999)] * 1e6, lat[cnt -1] * 1e6);
+}
+
+static void run(int spare, int cnt, double *lat_alloc, double *lat_write, unsigned long *sum)
+{
+    unsigned char *chunk = NULL;
+    double t0 = 0;
+    double t1 = 0;
+    int mpid = MP_NO_MP_ID;
+    int i = 0;
+    int j = 0;
+
+    if ((mpid = mpnew("refill")) < 0 || mpset_spare(mpid, spare) != MP_ERRNO_SUCCESS)
+    {
+        printf("Error creating memory pool: %s\n", mpstrerror());
+        exit(1);
+    }
+    mpmalloc_mpid(CHUNK_SZ, mpid);
+
+    for (i = 0; i < cnt; i++)
+    {
+        t0 = mpbench_now();
+        if ((chunk = (unsigned char *)mpmalloc_mpid(CHUNK_SZ, mpid)) == NULL)
+        {
+            printf("Error allocating memory: %s\n", mpstrerror());
+            exit(1);
+        }
+        t1 = mpbench_now();
+        memset(chunk, i, CHUNK_SZ);
+        lat_write[i] = mpbench_now() - t0;
+        lat_alloc[i] = t1 - t0;
+
+        /* Some work on the chunk between allocations, as a request would do */
+        for (j = 0; j < CHUNK_SZ; j += 8)
+        {
+            *sum += chunk[j];
+        }
+    }
+
+    mpdel(mpid);
+}
+
+int main(int argc, char *argv[])
+{
+    double *lat_alloc = NULL;
+    double *lat_write = NULL;
+    unsigned long sum = 0;
+    int cnt = 1000000;
+
+    mpset_blksz(4 * 1024 * 1024);
+    if (argc > 1)
+    {
+        mpset_blksz((size_t)atoi(argv[1]) * 1024);
+    }
+    if (argc > 2)
+    {
+        cnt = atoi(argv[2]);
+    }
+
+    lat_alloc = (double *)malloc(sizeof(double) * (size_t)cnt);
+    lat_write = (double *)malloc(sizeof(double) * (size_t)cnt);
+    if (lat_alloc == NULL || lat_write == NULL)
+    {
+        printf("Error allocating the latencies\n");
+        return 1;
+    }
+
+    printf("%d allocations of %d bytes, blocks of %lu bytes, latencies in us\n", cnt, CHUNK_SZ, (unsigned long)mpget_blksz());
+    printf("   %-24s %10s %10s %10s %10s\n", "", "p50", "p99", "p99.9", "max");
+
+    run(FALSE, cnt, lat_alloc, lat_write, &sum);
+    printf("refill thread off\n");
+    report("mpmalloc()", lat_alloc, cnt);
+    report("mpmalloc() + 1st write", lat_write, cnt);
+
+    if (mpset_refill(TRUE) != MP_ERRNO_SUCCESS)
+    {
+        printf("Error starting the refill thread: %s\n", mpstrerror());
+        return 1;
+    }
+    run(TRUE, cnt, lat_alloc, lat_write, &sum);
+    mpset_refill(FALSE);
+    printf("refill thread on\n");
+    report("mpmalloc()", lat_alloc, cnt);
+    report("mpmalloc() + 1st write", lat_write, cnt);
+    printf("   (checksum %lu)\n", sum);
+
+    free(lat_alloc);
+    free(lat_write);
+
+    return 0;
+}
+
+/* EOF */
@@ -0,0 +1,105 @@
+/****************************************************************************
+|*
+|* tap3edit Tools (http://www.tap3edit.com)
+|*
+|* Copyright (c) 2014-2018, Javier Gutierrez <https://github.com/tap3edit/mp>
+|*
+|* Permission to use, copy, modify, and/or distribute this software for any
+|* purpose with or without fee is hereby granted, provided that the above
+|* copyright notice and this permission notice appear in all copies.
+|*
+|* THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+|* WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+|* MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+|* ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+|* WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+|* ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+|* OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+|*
+|*
+|* Module: mptst_preload.c
+|*
+|* Description: Test of the malloc() interposer. To be run as:
+|*
+|*     LD_PRELOAD=./libmp_preload.so LD_LIBRARY_PATH=. ./tst/mptst_preload
+|*
+|*  Legacy code (here strdup() and the plain C library calls) takes its
+|*  memory from the memory pool pushed around it, and from the C library
+|*  once the memory pool is popped.
+|*
+|* Author: Javier Gutierrez (JG)
+|*
+|* Modifications:
+|*
+|* When         Who     Pos     What
+|* 20261019     JG              Initial version
+|*
+****************************************************************************/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mp.h"
+
+#define CHECK(n, cond, txt) \
+    do { printf("%s. %s: %s\n", n, txt, (cond) ? "OK" : "FAILED"); errors += !(cond); } while (0)
+
+int main(int argc, char *argv[])
+{
+    int mpid = MP_NO_MP_ID;
+    int errors = 0;
+    char *str = NULL;
+    char *str2 = NULL;
+    void *ptr = NULL;
+    void *sys_ptr = NULL;
+
+    if ((mpid = mpnew("legacy")) < 0)
+    {
+        printf("Error on mpnew(): %s\n", mpstrerror());
+        return 1;
+    }
+
+    /* Memory of the C library before any memory pool is pushed */
+    sys_ptr = malloc(100);
+    CHECK("1", sys_ptr != NULL && mpowner(sys_ptr) < 0, "malloc() without memory pool goes to the C library");
+
+    mppush(mpid);
+
+    str = strdup("legacy code");
+    CHECK("2", str != NULL && mpowner(str) == mpid, "strdup() goes to the pushed memory pool");
+
+    str2 = realloc(str, 4096);
+    CHECK("3", str2 != NULL && mpowner(str2) == mpid && strcmp(str2, "legacy code") == 0, "realloc() keeps the content in the memory pool");
+
+    ptr = calloc(64, 8);
+    CHECK("4", ptr != NULL && mpowner(ptr) == mpid && ((char *)ptr)[511] == 0, "calloc() goes to the memory pool zeroed");
+    free(ptr);
+
+    ptr = NULL;
+    CHECK("5", posix_memalign(&ptr, 256, 1000) == 0 && mpowner(ptr) == mpid && ((size_t)ptr % 256) == 0, "posix_memalign() goes to the memory pool aligned");
+
+    free(str2);
+    free(ptr);
+
+    /* Memory of the C library reallocated while the memory pool is active */
+    sys_ptr = realloc(sys_ptr, 200);
+    CHECK("6", sys_ptr != NULL && mpowner(sys_ptr) < 0, "realloc() of the C library memory stays in the C library");
+
+    mppop();
+
+    ptr = malloc(100);
+    CHECK("7", ptr != NULL && mpowner(ptr) < 0, "malloc() after mppop() goes to the C library");
+    free(ptr);
+    free(sys_ptr);
+
+    mpdel(mpid);
+
+    printf("%s\n", errors ? "Some tests FAILED" : "All tests OK");
+
+    return errors != 0;
+}
+
+/* EOF */
@@ -10,9 +10,7 @@
 |*
 |* tap3edit Tools (http://www.tap3edit.com)
 |*
-|* $Id: ut_mp.check 63 2015-01-03 22:18:39Z mrjones $
-|*
-|* Copyright (c) 2014, Javier Gutierrez <jgutierrez@tap3edit.com>
+|* Copyright (c) 2014-2018, Javier Gutierrez <https://github.com/tap3edit/mp>
 |* 
 |* Permission to use, copy, modify, and/or distribute this software for any
 |* purpose with or without fee is hereby granted, provided that the above
@@ -64,12 +62,153 @@ void *mp_thread_fn(void *arg)
     
     return 0;
 }
+
+typedef struct slab_args_t
+{
+    int mpid;
+    void **obj;
+    int cnt;
+} slab_args_t;
+
+void *slab_free_fn(void *arg)
+{
+    slab_args_t *a = (slab_args_t *)arg;
+    int i = 0;
+
+    /* Half with the pool ID, half letting mpfree() find it */
+    for (i = 0; i < a->cnt; i++)
+    {
+        if (i % 2)
+        {
+            mpfree(a->obj[i]);
+        }
+        else
+        {
+            mpslab_free(a->obj[i], a->mpid);
+        }
+    }
+
+    return 0;
+}
+
+void *slab_alloc_fn(void *arg)
+{
+    slab_args_t *a = (slab_args_t *)arg;
+
+    a->obj[0] = mpslab_alloc(a->mpid);
+    a->cnt = mperrno;
+
+    return 0;
+}
+
+void *rcy_request_fn(void *arg)
+{
+    int mpid = mpnew("request");
+    int i = 0;
+
+    /* The blocks given back stay in the magazine of the thread */
+    for (i = 0; i < *(int *)arg; i++)
+    {
+        mpmalloc_mpid(mpget_blksz(), mpid);
+    }
+    mpdel(mpid);
+
+    return 0;
+}
+
+void *rfl_toggle_fn(void *arg)
+{
+    int i = 0;
+
+    /* Starts and stops racing with the other threads */
+    for (i = 0; i < 100; i++)
+    {
+        if (mpset_refill((i + *(int *)arg) % 2) != MP_ERRNO_SUCCESS)
+        {
+            *(int *)arg = -1;
+        }
+    }
+
+    return 0;
+}
 #endif /* } MP_THREAD_SAFE */
 
+int vfmt(char **strp, int mpid, const char *fmt, ...)
+{
+    int rc = 0;
+    va_list ap;
+
+    va_start(ap, fmt);
+    rc = mpid == MP_NO_MP_ID ? mpvasprintf(strp, fmt, ap) : mpvasprintf_mpid(strp, mpid, fmt, ap);
+    va_end(ap);
+
+    return rc;
+}
+
+int slab_sum(void *ptr, void *arg)
+{
+    long *sum = (long *)arg;
+
+    sum[0]++;
+    sum[1] += *(long *)ptr;
+
+    return 0;
+}
+
+int slab_free_all(void *ptr, void *arg)
+{
+    mpslab_free(ptr, *(int *)arg);
+
+    return 0;
+}
+
+typedef struct up_stat_t
+{
+    int allocs;                                             /* Blocks delivered */
+    int frees;                                              /* Blocks given back */
+    size_t bytes;                                           /* Bytes delivered and not given back yet */
+    int fail;                                               /* Fail next allocations */
+} up_stat_t;
+
+void *up_alloc(size_t size, size_t align, void *ctx)
+{
+    up_stat_t *stat = (up_stat_t *)ctx;
+    void *ptr = NULL;
+
+    if (stat->fail || (ptr = malloc(size)) == NULL)
+    {
+        return NULL;
+    }
+    memset(ptr, 0xee, size);
+    stat->allocs++;
+    stat->bytes += size;
+
+    return ptr;
+}
+
+void up_free(void *ptr, size_t size, void *ctx)
+{
+    up_stat_t *stat = (up_stat_t *)ctx;
+
+    stat->frees++;
+    stat->bytes -= size;
+    free(ptr);
+}
+
+char cleanup_log[16] = "";
+
+void cleanup_fn(void *arg)
+{
+    size_t len = strlen(cleanup_log);
+
+    cleanup_log[len] = *(char *)arg;
+    cleanup_log[len +1] = '\0';
+}
+
 
 START_TEST(mpadd_block_def_mpid_not_init)
 {
-#line 64
+#line 203
     int mpid = MP_DEF_MP_ID;
     size_t align = MP_DEF_ALIGN;
     char *ptr = NULL;
@@ -94,7 +233,7 @@ END_TEST
 
 START_TEST(mpadd_block_mpid_not_init)
 {
-#line 84
+#line 223
     int mpid = MP_DEF_MP_ID + 2;
     size_t align = MP_DEF_ALIGN;
 
@@ -114,7 +253,7 @@ END_TEST
 
 START_TEST(mpadd_block_set_mem_limit)
 {
-#line 99
+#line 238
     int mpid = MP_DEF_MP_ID;
     size_t align = MP_DEF_ALIGN;
 
@@ -142,7 +281,7 @@ END_TEST
 
 START_TEST(mpadd_block_check_mem_limit)
 {
-#line 122
+#line 261
     int mpid = MP_DEF_MP_ID;
     size_t align = MP_DEF_ALIGN;
     char *ptr = NULL;
@@ -178,7 +317,7 @@ END_TEST
 
 START_TEST(mpadd_block_def_block_size)
 {
-#line 153
+#line 292
     int mpid = MP_DEF_MP_ID + 3;
     size_t align = MP_DEF_ALIGN;
     size_t blksz = MP_DEF_BLK_SZ;
@@ -190,13 +329,13 @@ START_TEST(mpadd_block_def_block_size)
         ck_abort_msg("Error adding block: %s", mpstrerror());
     }
 
-    if (mp_arr[mpid].head_block == NULL)
+    if (mp_arr[mpid].blocks == NULL)
     {
-        ck_abort_msg("Error the head block is NULL");
+        ck_abort_msg("Error the array of blocks is NULL");
     }
         
     ck_assert_msg(
-        mp_arr[mpid].head_block->size == blksz + align -1
+        mp_arr[mpid].blocks[0]->size == blksz + align -1
         , "Allocated memory block not of default size MP_DEF_BLK_SZ");
 
 }
@@ -204,7 +343,7 @@ END_TEST
 
 START_TEST(mpadd_block_diff_block_size)
 {
-#line 174
+#line 313
     int mpid = MP_DEF_MP_ID + 4;
     size_t align = MP_DEF_ALIGN;
     size_t blksz = MP_DEF_BLK_SZ + (align * 4);
@@ -215,13 +354,13 @@ START_TEST(mpadd_block_diff_block_size)
         ck_abort_msg("Error adding block: %s", mpstrerror());
     }
         
-    if (mp_arr[mpid].head_block == NULL)
+    if (mp_arr[mpid].blocks == NULL)
     {
-        ck_abort_msg("Error the head block is NULL");
+        ck_abort_msg("Error the array of blocks is NULL");
     }
 
     ck_assert_msg(
-        mp_arr[mpid].head_block->size == blksz + align -1
+        mp_arr[mpid].blocks[0]->size == blksz + align -1
         , "Allocated memory block not of the assigned size");
 
 }
@@ -229,7 +368,7 @@ END_TEST
 
 START_TEST(mpadd_block_alignment)
 {
-#line 194
+#line 333
     int mpid = MP_DEF_MP_ID + 5;
     size_t align = MP_DEF_ALIGN;
 
@@ -239,13 +378,13 @@ START_TEST(mpadd_block_alignment)
         ck_abort_msg("Error adding block: %s", mpstrerror());
     }
         
-    if (mp_arr[mpid].head_block == NULL)
+    if (mp_arr[mpid].blocks == NULL)
     {
-        ck_abort_msg("Error the head block is NULL");
+        ck_abort_msg("Error the array of blocks is NULL");
     }
 
     ck_assert_msg(
-        ((uintptr_t)mp_arr[mpid].head_block->block + mp_arr[mpid].head_block->used) % align == 0
+        ((uintptr_t)mp_arr[mpid].blocks[0]->block + mp_arr[mpid].blocks[0]->used) % align == 0
         , "Allocated memory block is not aligned");
 
 }
@@ -253,7 +392,7 @@ END_TEST
 
 START_TEST(mpadd_block_block_next)
 {
-#line 213
+#line 352
     int mpid = MP_DEF_MP_ID + 6;
     size_t align = MP_DEF_ALIGN;
 
@@ -263,21 +402,21 @@ START_TEST(mpadd_block_block_next)
         ck_abort_msg("Error adding block: %s", mpstrerror());
     }
         
-    if (mp_arr[mpid].head_block == NULL)
+    if (mp_arr[mpid].blocks == NULL)
     {
-        ck_abort_msg("Error the head block is NULL");
+        ck_abort_msg("Error the array of blocks is NULL");
     }
 
     ck_assert_msg(
-        mp_arr[mpid].head_block->next == NULL
-        , "Next block of just created block is not NULL");
+        mp_arr[mpid].block_cnt == 1
+        , "Number of blocks of just created block is not 1");
 
 }
 END_TEST
 
 START_TEST(mpadd_block_head_tail)
 {
-#line 232
+#line 371
     int mpid = MP_DEF_MP_ID + 7;
     size_t align = MP_DEF_ALIGN;
 
@@ -287,13 +426,13 @@ START_TEST(mpadd_block_head_tail)
         ck_abort_msg("Error adding block: %s", mpstrerror());
     }
         
-    if (mp_arr[mpid].head_block == NULL)
+    if (mp_arr[mpid].blocks == NULL)
     {
-        ck_abort_msg("Error the head block is NULL");
+        ck_abort_msg("Error the array of blocks is NULL");
     }
 
     ck_assert_msg(
-        mp_arr[mpid].head_block == mp_arr[mpid].tail_block
+        mp_arr[mpid].blocks[0] == mp_arr[mpid].tail_block
         , "Next block of just created block is not NULL");
 
 }
@@ -301,7 +440,7 @@ END_TEST
 
 START_TEST(mpadd_block_set_tot_phy_mem)
 {
-#line 251
+#line 390
     int mpid = MP_DEF_MP_ID;
     size_t align = MP_DEF_ALIGN;
     size_t blksz = MP_DEF_BLK_SZ;
@@ -317,9 +456,9 @@ START_TEST(mpadd_block_set_tot_phy_mem)
         ck_abort_msg("Error adding block: %s", mpstrerror());
     }
 
-    if (mp_arr[mpid].head_block == NULL)
+    if (mp_arr[mpid].blocks == NULL)
     {
-        ck_abort_msg("Error the head block is NULL");
+        ck_abort_msg("Error the array of blocks is NULL");
     }
         
     ck_assert_msg(
@@ -333,9 +472,9 @@ START_TEST(mpadd_block_set_tot_phy_mem)
         ck_abort_msg("Error adding block: %s", mpstrerror());
     }
 
-    if (mp_arr[mpid].head_block == NULL)
+    if (mp_arr[mpid].blocks == NULL)
     {
-        ck_abort_msg("Error the head block is NULL");
+        ck_abort_msg("Error the array of blocks is NULL");
     }
         
     ck_assert_msg(
@@ -345,9 +484,56 @@ START_TEST(mpadd_block_set_tot_phy_mem)
 }
 END_TEST
 
+START_TEST(mpadd_block_inline_header)
+{
+#line 431
+    int mpid = MP_DEF_MP_ID + 7;
+    size_t align = MP_DEF_ALIGN;
+
+    mp_arr[mpid].init = 'Y';
+    if (mpadd_block(0, mpid, align) == NULL)
+    {
+        ck_abort_msg("Error adding block: %s", mpstrerror());
+    }
+
+    ck_assert_msg(
+        mp_arr[mpid].blocks[0]->block == (uchar *)mp_arr[mpid].blocks[0] + MP_BLK_HDR_SZ
+        , "The memory block does not start right after its header");
+
+}
+END_TEST
+
+START_TEST(mpadd_block_array_growth)
+{
+#line 445
+    int mpid = MP_DEF_MP_ID + 7;
+    size_t align = MP_DEF_ALIGN;
+    int i = 0;
+
+    mp_arr[mpid].init = 'Y';
+    for (i = 0; i < MP_DEF_BLK_ARR_SZ * 2 + 1; i++)
+    {
+        if (mpadd_block(0, mpid, align) == NULL)
+        {
+            ck_abort_msg("Error adding block %d: %s", i, mpstrerror());
+        }
+    }
+
+    ck_assert_msg(
+        mp_arr[mpid].block_cnt == MP_DEF_BLK_ARR_SZ * 2 + 1 &&
+        mp_arr[mpid].block_max >= mp_arr[mpid].block_cnt
+        , "The array of blocks has <%d/%d> slots used", mp_arr[mpid].block_cnt, mp_arr[mpid].block_max);
+
+    ck_assert_msg(
+        mp_arr[mpid].blocks[mp_arr[mpid].block_cnt -1] == mp_arr[mpid].tail_block
+        , "The last element of the array of blocks is not the tail block");
+
+}
+END_TEST
+
 START_TEST(mpget_chunk_mpid_not_in_range)
 {
-#line 292
+#line 468
     int mpid = -1;
     size_t align = MP_DEF_ALIGN;
     char *ptr = NULL;
@@ -386,7 +572,7 @@ END_TEST
 
 START_TEST(mpget_chunk_align_not_in_range)
 {
-#line 326
+#line 502
     char *ptr = NULL;
     int mpid = MP_DEF_MP_ID;
     size_t align = sizeof(void *) -1; /* 1. less than size of void */
@@ -417,7 +603,7 @@ END_TEST
 
 START_TEST(mpget_chunk_thread_check_def_mp)
 {
-#line 352
+#line 528
 
 #if MP_THREAD_SAFE == 1
 
@@ -453,7 +639,7 @@ END_TEST
 
 START_TEST(mpget_chunk_thread_check_non_def_mp)
 {
-#line 383
+#line 559
 
 #if MP_THREAD_SAFE == 1
 
@@ -489,7 +675,7 @@ END_TEST
 
 START_TEST(mpget_chunk_used_bytes)
 {
-#line 414
+#line 590
     int mpid = MP_DEF_MP_ID;
     size_t align = MP_DEF_ALIGN;
     size_t sz = align * 2;
@@ -504,7 +690,7 @@ START_TEST(mpget_chunk_used_bytes)
         ck_abort_msg("Error adding chunk: %s", mpstrerror());
     }
 
-    prev_used = mp_arr[mpid].head_block->used;
+    prev_used = mp_arr[mpid].blocks[0]->used;
 
     if (mpget_chunk(sz, mpid, align) == NULL)
     {
@@ -515,16 +701,16 @@ START_TEST(mpget_chunk_used_bytes)
     margin = margin == align ? 0 : margin;
     used = prev_used + margin + sz;
     ck_assert_msg(
-        mp_arr[mpid].head_block->used == used
+        mp_arr[mpid].blocks[0]->used == used
         , "The used bytes in the block was no updated correctly <%zu/%zu>"
-        , mp_arr[mpid].head_block->used, used);
+        , mp_arr[mpid].blocks[0]->used, used);
 
 }
 END_TEST
 
 START_TEST(mpget_chunk_add_new_block)
 {
-#line 444
+#line 620
     int mpid = MP_DEF_MP_ID + 8;
     size_t align = MP_DEF_ALIGN;
     size_t sz = MP_DEF_BLK_SZ + align;
@@ -543,9 +729,9 @@ START_TEST(mpget_chunk_add_new_block)
         ck_abort_msg("Error adding chunk: %s", mpstrerror());
     }
 
-    if (mp_arr[mpid].head_block->next != NULL)
+    if (mp_arr[mpid].block_cnt != 1)
     {
-        ck_abort_msg("The 'next' pointer to the next block is not NULL and we should have only one block allocated");
+        ck_abort_msg("The number of blocks is not 1 and we should have only one block allocated");
     }
 
     /* Now we try to allocate a size bigger than the 
@@ -557,8 +743,8 @@ START_TEST(mpget_chunk_add_new_block)
     }
 
     ck_assert_msg(
-        mp_arr[mpid].head_block->next != NULL
-        , "The 'next' pointer to the next block is NULL and we should have now two blocks allocated");
+        mp_arr[mpid].block_cnt == 2 && mp_arr[mpid].blocks[1] == mp_arr[mpid].tail_block
+        , "The number of blocks is not 2 and we should have now two blocks allocated");
 
 
 }
@@ -566,7 +752,7 @@ END_TEST
 
 START_TEST(mpmalloc_call)
 {
-#line 481
+#line 657
     int mpid = MP_DEF_MP_ID + 8;
     size_t align = MP_DEF_ALIGN;
     size_t cur_blck_used = 0;
@@ -603,7 +789,7 @@ END_TEST
 
 START_TEST(mpmalloc_mpid_call)
 {
-#line 513
+#line 689
     int mpid = MP_DEF_MP_ID + 8;
     size_t align = MP_DEF_ALIGN;
     size_t cur_blck_used = 0;
@@ -639,7 +825,7 @@ END_TEST
 
 START_TEST(mpmemalign_call)
 {
-#line 544
+#line 720
     int mpid = MP_DEF_MP_ID + 8;
     size_t align = MP_DEF_ALIGN;
     size_t cur_blck_used = 0;
@@ -676,7 +862,7 @@ END_TEST
 
 START_TEST(mpmemalign_alignment)
 {
-#line 576
+#line 752
     int mpid = MP_DEF_MP_ID;
     size_t align = MP_DEF_ALIGN * 3; /* 24 is not power of 2 */
     char *ptr = NULL;
@@ -704,7 +890,7 @@ END_TEST
 
 START_TEST(mpmemalign_mpid_call)
 {
-#line 599
+#line 775
     int mpid = MP_DEF_MP_ID + 8;
     size_t align = MP_DEF_ALIGN;
     size_t cur_blck_used = 0;
@@ -740,7 +926,7 @@ END_TEST
 
 START_TEST(mpmemalign_mpid_alignment)
 {
-#line 630
+#line 806
     int mpid = MP_DEF_MP_ID;
     size_t align = MP_DEF_ALIGN * 3; /* 24 is not power of 2 */
     char *ptr = NULL;
@@ -765,9 +951,105 @@ START_TEST(mpmemalign_mpid_alignment)
 }
 END_TEST
 
+START_TEST(mpadd_alncls_pars)
+{
+#line 828
+    int mpid = MP_NO_MP_ID;
+
+    ck_assert_msg(
+        mpadd_alncls(MP_MAX_MP_ID, 64) == MP_ERRNO_MPID &&
+        mpadd_alncls(MP_DEF_MP_ID + 8, 64) == MP_ERRNO_NOIN &&
+        mpadd_alncls(MP_DEF_MP_ID, 48) == MP_ERRNO_EXAL &&
+        mpadd_alncls(MP_DEF_MP_ID, MP_DEF_ALIGN) == MP_ERRNO_EXAL
+        , "Wrong parameters were not rejected");
+
+    if ((mpid = mpnew_slab("alncls", 32)) < 0)
+    {
+        ck_abort_msg("Error creating memory pool: %s", mpstrerror());
+    }
+    ck_assert_msg(
+        mpadd_alncls(mpid, 64) == MP_ERRNO_PARM
+        , "An alignment class was added to a slab pool");
+
+    if ((mpid = mpnew("alncls")) < 0)
+    {
+        ck_abort_msg("Error creating memory pool: %s", mpstrerror());
+    }
+    ck_assert_msg(
+        mpadd_alncls(mpid, 4096) == MP_ERRNO_SUCCESS && mpadd_alncls(mpid, 64) == MP_ERRNO_SUCCESS &&
+        mpadd_alncls(mpid, 64) == MP_ERRNO_SUCCESS && mpadd_alncls(mpid, 16) == MP_ERRNO_SUCCESS &&
+        mpadd_alncls(mpid, 32) == MP_ERRNO_SUCCESS && mpadd_alncls(mpid, 128) == MP_ERRNO_PARM &&
+        mp_arr[mpid].aln_cnt == MP_MAX_ALN_CLS && mp_arr[mpid].aln_cls[0] == 16 &&
+        mp_arr[mpid].aln_cls[2] == 64 && mp_arr[mpid].aln_cls[3] == 4096
+        , "The alignment classes are not kept sorted and unique");
+
+}
+END_TEST
+
+START_TEST(mpadd_alncls_interleave)
+{
+#line 858
+    int mpid = MP_NO_MP_ID;
+    char *small[64];
+    char *vec[64];
+    mpblock *tail_block = NULL;
+    int i = 0;
+
+    if ((mpid = mpnew("alncls")) < 0 || mpadd_alncls(mpid, 64) != MP_ERRNO_SUCCESS)
+    {
+        ck_abort_msg("Error creating memory pool: %s", mpstrerror());
+    }
+
+    for (i = 0; i < 64; i++)
+    {
+        small[i] = (char *)mpmalloc_mpid(MP_DEF_ALIGN, mpid);
+        vec[i] = (char *)mpmemalign_mpid(32, 72, mpid);
+        if (small[i] == NULL || vec[i] == NULL)
+        {
+            ck_abort_msg("Error allocating memory: %s", mpstrerror());
+        }
+    }
+    tail_block = mp_arr[mpid].tail_block;
+
+    for (i = 1; i < 64; i++)
+    {
+        ck_assert_msg(
+            small[i] - small[i -1] == MP_DEF_ALIGN
+            , "Small chunks are not contiguous: chunk %d at %d bytes", i, (int)(small[i] - small[i -1]));
+        ck_assert_msg(
+            (uintptr_t)vec[i] % 64 == 0 && vec[i] - vec[i -1] == 128
+            , "Aligned chunks are padded or not rounded to the class: chunk %d at %d bytes", i, (int)(vec[i] - vec[i -1]));
+    }
+
+    ck_assert_msg(
+        mp_arr[mpid].block_cnt == 2 && mp_arr[mpid].aln_block[0] != tail_block &&
+        mpowner(vec[10]) == mpid && mpowner(small[10]) == mpid &&
+        (uchar *)vec[0] >= mp_arr[mpid].aln_block[0]->block &&
+        (uchar *)vec[63] < mp_arr[mpid].aln_block[0]->block + mp_arr[mpid].aln_block[0]->size
+        , "The aligned chunks do not have their own block");
+
+    /* After mpclr() both cursors start again on their blocks */
+    mpclr(mpid);
+    ck_assert_msg(
+        mpmemalign_mpid(64, 10, mpid) == vec[0] && mpmalloc_mpid(MP_DEF_ALIGN, mpid) == small[0] &&
+        mp_arr[mpid].block_cnt == 2
+        , "The blocks of the alignment classes were not reused after mpclr()");
+
+    /* Chunks bigger than the block still work */
+    vec[0] = (char *)mpmemalign_mpid(64, mpget_blksz() + 1, mpid);
+    ck_assert_msg(
+        vec[0] != NULL && (uintptr_t)vec[0] % 64 == 0 && mp_arr[mpid].tail_block == tail_block &&
+        (vec[1] = (char *)mpmemalign_mpid(64, 1, mpid)) != NULL && (uintptr_t)vec[1] % 64 == 0
+        , "Chunks bigger than a block are not delivered by the alignment class");
+
+    mpdel(mpid);
+
+}
+END_TEST
+
 START_TEST(mpcalloc_call)
 {
-#line 652
+#line 914
     int mpid = MP_DEF_MP_ID + 8;
     size_t align = MP_DEF_ALIGN;
     size_t cur_blck_used = 0;
@@ -804,7 +1086,7 @@ END_TEST
 
 START_TEST(mpcalloc_elements)
 {
-#line 684
+#line 946
     int mpid = MP_DEF_MP_ID + 8;
     size_t align = MP_DEF_ALIGN;
     size_t cur_blck_used = 0;
@@ -835,7 +1117,7 @@ START_TEST(mpcalloc_elements)
     }
 
     ck_assert_msg(
-        mp_arr[mpid].head_block->used == cur_blck_used + margin + (sz * 3)
+        mp_arr[mpid].blocks[0]->used == cur_blck_used + margin + (sz * 3)
         , "The block allocated is not the number of elements times the size");
 
 
@@ -844,7 +1126,7 @@ END_TEST
 
 START_TEST(mpcalloc_mpid_call)
 {
-#line 719
+#line 981
     int mpid = MP_DEF_MP_ID + 8;
     size_t align = MP_DEF_ALIGN;
     size_t cur_blck_used = 0;
@@ -880,7 +1162,7 @@ END_TEST
 
 START_TEST(mpcalloc_mpid_elements)
 {
-#line 750
+#line 1012
     int mpid = MP_DEF_MP_ID + 8;
     size_t align = MP_DEF_ALIGN;
     size_t cur_blck_used = 0;
@@ -909,165 +1191,225 @@ START_TEST(mpcalloc_mpid_elements)
     }
 
     ck_assert_msg(
-        mp_arr[mpid].head_block->used == cur_blck_used + margin + (sz * 3)
+        mp_arr[mpid].blocks[0]->used == cur_blck_used + margin + (sz * 3)
         , "The block allocated is not the number of elements times the size");
 
 }
 END_TEST
 
-START_TEST(mprealloc_call)
+START_TEST(mpcalloc_fresh_block)
 {
-#line 782
-    int mpid = MP_DEF_MP_ID + 8;
-    size_t align = MP_DEF_ALIGN;
-    size_t cur_blck_used = 0;
-    mp_cur_mpid = mpid;
-
-    /* We have to make sure that the function 
-    allocates memory from the current mpid */
+#line 1044
+    int mpid = MP_DEF_MP_ID;
+    char *ptr = NULL;
+    size_t sz = 4096;
+    size_t i = 0;
 
-    mp_arr[mpid].init = 'Y';
-#if MP_THREAD_SAFE == 1
-    mp_arr[mpid].thread_id = MP_CURR_THREAD;
-#endif
-    /* First we allocate a dummy size of bytes to 
-    make sure the block is initialized 
-    and the first memory block is allocated */
-    if (mpget_chunk(align + 1, mpid, align) == NULL)
+    if ((ptr = (char *)mpcalloc_mpid(4, sz, mpid)) == NULL)
     {
-        ck_abort_msg("Error adding chunk: %s", mpstrerror());
+        ck_abort_msg("Error allocating memory: %s", mpstrerror());
     }
 
-    cur_blck_used = mp_arr[mpid].tail_block->used;
+    ck_assert_msg(
+        mp_arr[mpid].last_dirty == 0 &&
+        mp_arr[mpid].tail_block->zero == mp_arr[mpid].tail_block->used
+        , "The chunk of a fresh block was not known to be zero");
 
-    if (mprealloc(NULL, align * 2) == NULL)
+    for (i = 0; i < 4 * sz; i++)
     {
-        ck_abort_msg("Error allocating memory in the current Memory Pool");
+        ck_assert_msg(ptr[i] == 0, "Byte <%zu> is not zero", i);
     }
 
-    ck_assert_msg(
-        cur_blck_used != mp_arr[mpid].tail_block->used
-        , "The memory was not allocated in the current block");
-
 }
 END_TEST
 
-START_TEST(mprealloc_copy_content)
+START_TEST(mpcalloc_reused_block)
 {
-#line 814
-    int mpid = MP_DEF_MP_ID + 8;
-    size_t align = MP_DEF_ALIGN;
+#line 1065
+    int mpid = MP_DEF_MP_ID;
     char *ptr = NULL;
-    char *ptr2 = NULL;
+    size_t sz = 4096;
+    size_t i = 0;
 
-    mp_cur_mpid = mpid;
+    if ((ptr = (char *)mpmalloc_mpid(sz, mpid)) == NULL)
+    {
+        ck_abort_msg("Error allocating memory: %s", mpstrerror());
+    }
+    memset(ptr, 0xff, sz);
+    mpclr(mpid);
 
-    mp_arr[mpid].init = 'Y';
-#if MP_THREAD_SAFE == 1
-    mp_arr[mpid].thread_id = MP_CURR_THREAD;
-#endif
-    /* First we allocate a dummy size of bytes to 
-    make sure the block is initialized 
-    and the first memory block is allocated */
-    if ((ptr = (char *)mpget_chunk(align * 3, mpid, align)) == NULL)
+    /* Half of the chunk was used before the clear, the other half never */
+    if ((ptr = (char *)mpcalloc_mpid(2, sz, mpid)) == NULL)
     {
-        ck_abort_msg("Error adding chunk: %s", mpstrerror());
+        ck_abort_msg("Error allocating memory: %s", mpstrerror());
     }
 
-    strncpy(ptr, "This is a test", align * 3);
-    ptr[(align * 3) -1] = '\0';
+    ck_assert_msg(
+        mp_arr[mpid].last_dirty == sz &&
+        mp_arr[mpid].tail_block->zero == 2 * sz
+        , "Wrong known-zero mark <%zu> <%zu>", mp_arr[mpid].last_dirty, mp_arr[mpid].tail_block->zero);
 
-    if ((ptr2 = mprealloc(ptr, align * 2)) == NULL)
+    for (i = 0; i < 2 * sz; i++)
     {
-        ck_abort_msg("Error allocating memory in the current Memory Pool");
+        ck_assert_msg(ptr[i] == 0, "Byte <%zu> is not zero", i);
     }
 
+}
+END_TEST
+
+START_TEST(mpcalloc_overflow)
+{
+#line 1094
+    int mpid = MP_DEF_MP_ID;
+
     ck_assert_msg(
-        strcmp(ptr, ptr2) == 0
-        , "The content of the memory was not copied");
+        mpcalloc_mpid(((size_t)-1) / 2 + 1, 2, mpid) == NULL &&
+        mperrno == MP_ERRNO_PARM
+        , "The overflow of nelem * size was not detected");
+
+    ck_assert_msg(
+        mpcalloc_mpid((size_t)1 << (sizeof(size_t) * 4), 16, mpid) != NULL ||
+        mperrno != MP_ERRNO_PARM
+        , "A product without overflow was rejected");
 
 }
 END_TEST
 
-START_TEST(mprealloc_mpid_call)
+START_TEST(mpmalloc_batch_pars)
 {
-#line 846
-    int mpid = MP_DEF_MP_ID + 8;
-    size_t align = MP_DEF_ALIGN;
-    size_t cur_blck_used = 0;
-
-    /* We have to make sure that the function 
-    allocates memory from the current mpid */
+#line 1107
+    size_t sizes[2] = {8, 8};
+    size_t aligns[2] = {8, 12};
+    void *ptrs[2] = {NULL, NULL};
 
-    mp_arr[mpid].init = 'Y';
-#if MP_THREAD_SAFE == 1
-    mp_arr[mpid].thread_id = MP_CURR_THREAD;
-#endif
-    /* First we allocate a dummy size of bytes to 
-    make sure the block is initialized 
-    and the first memory block is allocated */
-    if (mpget_chunk(align + 1, mpid, align) == NULL)
-    {
-        ck_abort_msg("Error adding chunk: %s", mpstrerror());
-    }
+    ck_assert_msg(
+        mpmalloc_batch(MP_DEF_MP_ID, 0, sizes, NULL, ptrs) == MP_ERRNO_PARM &&
+        mpmalloc_batch(MP_DEF_MP_ID, 2, NULL, NULL, ptrs) == MP_ERRNO_PARM &&
+        mpmalloc_batch(MP_DEF_MP_ID, 2, sizes, NULL, NULL) == MP_ERRNO_PARM
+        , "Wrong parameters were not rejected with MP_ERRNO_PARM");
 
-    cur_blck_used = mp_arr[mpid].tail_block->used;
+    ck_assert_msg(
+        mpmalloc_batch(MP_DEF_MP_ID, 2, sizes, aligns, ptrs) == MP_ERRNO_EXAL &&
+        ptrs[0] == NULL && ptrs[1] == NULL
+        , "An alignment not power of 2 was not rejected with MP_ERRNO_EXAL");
 
-    if (mprealloc_mpid(NULL, align * 2, mpid) == NULL)
-    {
-        ck_abort_msg("Error allocating memory in specific Memory Pool <%d>", mpid);
-    }
+    sizes[1] = (size_t)-1;
+    ck_assert_msg(
+        mpmalloc_batch(MP_DEF_MP_ID, 2, sizes, NULL, ptrs) == MP_ERRNO_PARM
+        , "The overflow of the total size was not detected");
 
+    sizes[1] = 8;
     ck_assert_msg(
-        cur_blck_used != mp_arr[mpid].tail_block->used
-        , "The memory was not allocated in the current block");
+        mpmalloc_batch(MP_MAX_MP_ID, 2, sizes, NULL, ptrs) == MP_ERRNO_MPID &&
+        mpmalloc_batch(MP_DEF_MP_ID + 8, 2, sizes, NULL, ptrs) == MP_ERRNO_NOIN
+        , "Wrong memory pools were not rejected");
 
 }
 END_TEST
 
-START_TEST(mprealloc_mpid_copy_content)
+START_TEST(mpmalloc_batch_layout)
 {
-#line 877
-    int mpid = MP_DEF_MP_ID + 8;
-    size_t align = MP_DEF_ALIGN;
-    char *ptr = NULL;
-    char *ptr2 = NULL;
-
-    mp_arr[mpid].init = 'Y';
-#if MP_THREAD_SAFE == 1
-    mp_arr[mpid].thread_id = MP_CURR_THREAD;
-#endif
-    /* First we allocate a dummy size of bytes to 
-    make sure the block is initialized 
-    and the first memory block is allocated */
-    if ((ptr = (char *)mpget_chunk(align + 1, mpid, align)) == NULL)
+#line 1134
+    int mpid = MP_DEF_MP_ID;
+    size_t sizes[4] = {3, 100, 0, 40};
+    size_t aligns[4] = {8, 64, 16, 256};
+    void *ptrs[4] = {NULL, NULL, NULL, NULL};
+    size_t used = 0;
+    int i = 0;
+
+    if (mpmalloc_mpid(1, mpid) == NULL)
     {
-        ck_abort_msg("Error adding chunk: %s", mpstrerror());
+        ck_abort_msg("Error allocating memory: %s", mpstrerror());
     }
+    used = mp_arr[mpid].tail_block->used;
 
-    strncpy(ptr, "This is a test", align * 3);
-    ptr[(align * 3) -1] = '\0';
+    ck_assert_msg(
+        mpmalloc_batch(mpid, 4, sizes, aligns, ptrs) == MP_ERRNO_SUCCESS
+        , "Error allocating the batch: %s", mpstrerror());
 
-    if ((ptr2 = mprealloc_mpid(ptr, align * 2, mpid)) == NULL)
+    for (i = 0; i < 4; i++)
     {
-        ck_abort_msg("Error allocating memory in specific Memory Pool <%d>", mpid);
+        ck_assert_msg(
+            ptrs[i] != NULL && (uintptr_t)ptrs[i] % aligns[i] == 0 &&
+            mpowner(ptrs[i]) == mpid
+            , "Chunk %d <%p> is not aligned to %d in the pool", i, ptrs[i], (int)aligns[i]);
     }
 
     ck_assert_msg(
-        strcmp(ptr, ptr2) == 0
-        , "The content of the memory was not copied");
+        (uchar *)ptrs[0] + 3 <= (uchar *)ptrs[1] && (uchar *)ptrs[1] + 100 <= (uchar *)ptrs[2] &&
+        (uchar *)ptrs[2] + 1 <= (uchar *)ptrs[3] &&
+        (uchar *)ptrs[3] + 40 == mp_arr[mpid].tail_block->block + mp_arr[mpid].tail_block->used &&
+        mp_arr[mpid].tail_block->used - used < 3 * 256 + 40
+        , "The chunks are not laid out back to back in one piece");
+
+    ck_assert_msg(
+        mprealloc_mpid(ptrs[3], 80, mpid) == ptrs[3]
+        , "The last chunk of the batch was not resized in place");
+
+    memset(ptrs[0], 'a', 3);
+    ck_assert_msg(
+        mpmalloc_batch(mpid, 2, sizes, NULL, ptrs) == MP_ERRNO_SUCCESS &&
+        (uintptr_t)ptrs[0] % MP_DEF_ALIGN == 0 && (uintptr_t)ptrs[1] % MP_DEF_ALIGN == 0 &&
+        (uchar *)ptrs[1] - (uchar *)ptrs[0] == MP_DEF_ALIGN
+        , "Without alignments the chunks are not aligned to MP_DEF_ALIGN");
 
 }
 END_TEST
 
-START_TEST(mpstrdup_call)
+START_TEST(mpmalloc_soa_layout)
+{
+#line 1178
+    int mpid = MP_DEF_MP_ID;
+    size_t elem_sizes[3] = {sizeof(double), sizeof(int), 1};
+    void *cols[3] = {NULL, NULL, NULL};
+    double *col0 = NULL;
+    int *col1 = NULL;
+    int i = 0;
+
+    ck_assert_msg(
+        mpmalloc_soa(mpid, 0, 10, elem_sizes, cols) == MP_ERRNO_PARM &&
+        mpmalloc_soa(mpid, 3, 10, NULL, cols) == MP_ERRNO_PARM &&
+        mpmalloc_soa(mpid, 3, ((size_t)-1) / 4, elem_sizes, cols) == MP_ERRNO_PARM &&
+        cols[0] == NULL
+        , "Wrong parameters were not rejected with MP_ERRNO_PARM");
+
+    ck_assert_msg(
+        mpmalloc_soa(mpid, 3, 1001, elem_sizes, cols) == MP_ERRNO_SUCCESS
+        , "Error allocating the columns: %s", mpstrerror());
+
+    for (i = 0; i < 3; i++)
+    {
+        ck_assert_msg(
+            (uintptr_t)cols[i] % MP_SOA_ALIGN == 0
+            , "Column %d <%p> is not aligned to MP_SOA_ALIGN", i, cols[i]);
+    }
+
+    ck_assert_msg(
+        (uchar *)cols[1] - (uchar *)cols[0] == 8064 &&
+        (uchar *)cols[2] - (uchar *)cols[1] == 4032
+        , "The columns are not laid out back to back");
+
+    col0 = cols[0];
+    col1 = cols[1];
+    for (i = 0; i < 1001; i++)
+    {
+        col0[i] = i;
+        col1[i] = -i;
+        ((char *)cols[2])[i] = 'x';
+    }
+    ck_assert_msg(
+        col0[1000] == 1000 && col1[1000] == -1000 && col1[0] == 0
+        , "The columns overlap");
+
+}
+END_TEST
+
+START_TEST(mprealloc_call)
 {
-#line 907
+#line 1221
     int mpid = MP_DEF_MP_ID + 8;
     size_t align = MP_DEF_ALIGN;
     size_t cur_blck_used = 0;
-    char * ptr = NULL;
-
     mp_cur_mpid = mpid;
 
     /* We have to make sure that the function 
@@ -1087,7 +1429,7 @@ START_TEST(mpstrdup_call)
 
     cur_blck_used = mp_arr[mpid].tail_block->used;
 
-    if ((ptr = mpstrdup("This is another test")) == NULL)
+    if (mprealloc(NULL, align * 2) == NULL)
     {
         ck_abort_msg("Error allocating memory in the current Memory Pool");
     }
@@ -1096,24 +1438,18 @@ START_TEST(mpstrdup_call)
         cur_blck_used != mp_arr[mpid].tail_block->used
         , "The memory was not allocated in the current block");
 
-    ck_assert_msg(
-        strcmp(ptr, "This is another test") == 0
-        , "The string was not duplciated");
-
-
 }
 END_TEST
 
-START_TEST(mpstrdup_mpid_call)
+START_TEST(mprealloc_copy_content)
 {
-#line 946
-    int mpid = MP_DEF_MP_ID;
+#line 1253
+    int mpid = MP_DEF_MP_ID + 8;
     size_t align = MP_DEF_ALIGN;
-    size_t cur_blck_used = 0;
-    char * ptr = NULL;
+    char *ptr = NULL;
+    char *ptr2 = NULL;
 
-    /* We have to make sure that the function 
-    allocates memory from the current mpid */
+    mp_cur_mpid = mpid;
 
     mp_arr[mpid].init = 'Y';
 #if MP_THREAD_SAFE == 1
@@ -1122,61 +1458,32 @@ START_TEST(mpstrdup_mpid_call)
     /* First we allocate a dummy size of bytes to 
     make sure the block is initialized 
     and the first memory block is allocated */
-    if (mpget_chunk(align + 1, mpid, align) == NULL)
+    if ((ptr = (char *)mpget_chunk(align * 3, mpid, align)) == NULL)
     {
         ck_abort_msg("Error adding chunk: %s", mpstrerror());
     }
 
-    cur_blck_used = mp_arr[mpid].tail_block->used;
+    strncpy(ptr, "This is a test", align * 3);
+    ptr[(align * 3) -1] = '\0';
 
-    if ((ptr = mpstrdup("This is another test")) == NULL)
+    if ((ptr2 = mprealloc(ptr, align * 2)) == NULL)
     {
         ck_abort_msg("Error allocating memory in the current Memory Pool");
     }
 
     ck_assert_msg(
-        cur_blck_used != mp_arr[mpid].tail_block->used
-        , "The memory was not allocated in the current block");
-
-    ck_assert_msg(
-        strcmp(ptr, "This is another test") == 0
-        , "The string was not duplciated");
-
-}
-END_TEST
-
-START_TEST(mpasprintf_pars)
-{
-#line 982
-    char *ptr = NULL;
-
-    mpasprintf(&ptr, NULL);
-
-    ck_assert_msg(
-        mperrno == MP_ERRNO_PARM
-    , "One of the parameters is NULL but mperrno is not MP_ERRNO_PARM");
-
-    mpasprintf(NULL, "%s", "Test");
-
-    ck_assert_msg(
-        mperrno == MP_ERRNO_PARM
-    , "One of the parameters is NULL but mperrno is not MP_ERRNO_PARM");
+        strcmp(ptr, ptr2) == 0
+        , "The content of the memory was not copied");
 
 }
 END_TEST
 
-START_TEST(mpasprintf_call)
+START_TEST(mprealloc_mpid_call)
 {
-#line 997
+#line 1285
     int mpid = MP_DEF_MP_ID + 8;
     size_t align = MP_DEF_ALIGN;
     size_t cur_blck_used = 0;
-    char * ptr = NULL;
-    int rc1 = 0;
-    int rc2 = 0;
-    char str[32] = "";
-
-    mp_cur_mpid = mpid;
 
     /* We have to make sure that the function 
     allocates memory from the current mpid */
@@ -1195,63 +1502,25 @@ START_TEST(mpasprintf_call)
 
     cur_blck_used = mp_arr[mpid].tail_block->used;
 
-    sprintf(str, "%s: %d", "This is yet another test", 3);
-    rc1 = strlen(str);
-    rc2 = mpasprintf(&ptr, "%s: %d", "This is yet another test", 3);
-    if (ptr == NULL)
+    if (mprealloc_mpid(NULL, align * 2, mpid) == NULL)
     {
-        ck_abort_msg("Error allocating memory in the current Memory Pool");
+        ck_abort_msg("Error allocating memory in specific Memory Pool <%d>", mpid);
     }
 
     ck_assert_msg(
         cur_blck_used != mp_arr[mpid].tail_block->used
         , "The memory was not allocated in the current block");
 
-    ck_assert_msg(
-        strcmp(ptr, str) == 0
-        , "The string was not duplciated");
-
-    ck_assert_msg(
-        rc1 == rc2
-        , "The number of characters copied is not the same; it is %d but should be %d", rc2, rc1);
-
-}
-END_TEST
-
-START_TEST(mpasprintf_mpid_pars)
-{
-#line 1045
-    char *ptr = NULL;
-
-    mpasprintf(&ptr, NULL);
-
-    ck_assert_msg(
-        mperrno == MP_ERRNO_PARM
-    , "One of the parameters is NULL but mperrno is not MP_ERRNO_PARM");
-
-    mpasprintf_mpid(NULL, MP_DEF_MP_ID, "%s", "Test");
-
-    ck_assert_msg(
-        mperrno == MP_ERRNO_PARM
-    , "One of the parameters is NULL but mperrno is not MP_ERRNO_PARM");
-
-
 }
 END_TEST
 
-START_TEST(mpasprintf_mpid_call)
+START_TEST(mprealloc_mpid_copy_content)
 {
-#line 1061
-    int mpid = MP_DEF_MP_ID;
+#line 1316
+    int mpid = MP_DEF_MP_ID + 8;
     size_t align = MP_DEF_ALIGN;
-    size_t cur_blck_used = 0;
-    char * ptr = NULL;
-    int rc1 = 0;
-    int rc2 = 0;
-    char str[32] = "";
-
-    /* We have to make sure that the function 
-    allocates memory from the current mpid */
+    char *ptr = NULL;
+    char *ptr2 = NULL;
 
     mp_arr[mpid].init = 'Y';
 #if MP_THREAD_SAFE == 1
@@ -1260,104 +1529,1878 @@ START_TEST(mpasprintf_mpid_call)
     /* First we allocate a dummy size of bytes to 
     make sure the block is initialized 
     and the first memory block is allocated */
-    if (mpget_chunk(align + 1, mpid, align) == NULL)
+    if ((ptr = (char *)mpget_chunk(align + 1, mpid, align)) == NULL)
     {
         ck_abort_msg("Error adding chunk: %s", mpstrerror());
     }
 
-    cur_blck_used = mp_arr[mpid].tail_block->used;
+    strncpy(ptr, "This is a test", align * 3);
+    ptr[(align * 3) -1] = '\0';
 
-    sprintf(str, "%s: %d", "This is yet another test", 3);
-    rc1 = strlen(str);
-    rc2 = mpasprintf(&ptr, "%s: %d", "This is yet another test", 3);
+    if ((ptr2 = mprealloc_mpid(ptr, align * 2, mpid)) == NULL)
+    {
+        ck_abort_msg("Error allocating memory in specific Memory Pool <%d>", mpid);
+    }
+
+    ck_assert_msg(
+        strcmp(ptr, ptr2) == 0
+        , "The content of the memory was not copied");
+
+}
+END_TEST
+
+START_TEST(mprealloc_last_chunk_in_place)
+{
+#line 1346
+    int mpid = MP_DEF_MP_ID;
+    char *ptr = NULL;
+    char *ptr2 = NULL;
+    size_t used = 0;
+
+    ptr = (char *)mpmalloc_mpid(16, mpid);
     if (ptr == NULL)
     {
-        ck_abort_msg("Error allocating memory in the current Memory Pool");
+        ck_abort_msg("Error allocating memory: %s", mpstrerror());
     }
+    strcpy(ptr, "in place");
+
+    ptr2 = (char *)mprealloc_mpid(ptr, 1024, mpid);
+    used = ptr2 - (char *)mp_arr[mpid].tail_block->block + 1024;
 
     ck_assert_msg(
-        cur_blck_used != mp_arr[mpid].tail_block->used
-        , "The memory was not allocated in the current block");
+        ptr2 == ptr && strcmp(ptr2, "in place") == 0
+        , "The last chunk of the pool was not resized in place");
 
     ck_assert_msg(
-        strcmp(ptr, str) == 0
-        , "The string was not duplciated");
+        mp_arr[mpid].tail_block->used == used
+        , "The used bytes of the block <%zu> are not <%zu> after resizing", mp_arr[mpid].tail_block->used, used);
+
+    /* Not the last chunk anymore */
+    if (mpmalloc_mpid(16, mpid) == NULL)
+    {
+        ck_abort_msg("Error allocating memory: %s", mpstrerror());
+    }
 
     ck_assert_msg(
-        rc1 == rc2
-        , "The number of characters copied is not the same");
+        mprealloc_mpid(ptr, 2048, mpid) != ptr
+        , "A chunk which is not the last one of the pool was resized in place");
 
 }
 END_TEST
 
-START_TEST(mpnew_pars)
+START_TEST(mpmalloc_map_big_chunk)
 {
-#line 1107
-    int mpid = mpnew(NULL);
-
-    ck_assert_msg(
-        strcmp(mp_arr[mpid].descr, "-") == 0
-        , "No description is passed and the stored description is <%s> instead of '-'", mp_arr[mpid].descr);
+#line 1380
+    int mpid = MP_DEF_MP_ID;
+    char *ptr = NULL;
+    char *ptr2 = NULL;
+    mpblock *curr_block = NULL;
 
-    mpid = mpnew("Test pool");
+    ptr = (char *)mpmalloc_mpid(MP_DEF_MAP_SZ, mpid);
+    if (ptr == NULL)
+    {
+        ck_abort_msg("Error allocating memory: %s", mpstrerror());
+    }
 
+    curr_block = mp_arr[mpid].blocks[mp_arr[mpid].block_cnt -1];
     ck_assert_msg(
-        strcmp(mp_arr[mpid].descr, "Test pool") == 0
-        , "The description of the new Memory Pool <%s> doesn't match the one passed as parameter <%s>", 
-            mp_arr[mpid].descr,
-            "Test Pool");
+        curr_block->type == MP_BLK_MAP &&
+        mp_arr[mpid].map_cnt == 1 &&
+        (uchar *)ptr >= curr_block->block &&
+        (uchar *)ptr < curr_block->block + curr_block->size
+        , "The big chunk was not given its own mapping");
 
+    ptr2 = (char *)mpmalloc_mpid(16, mpid);
+    ck_assert_msg(
+        ptr2 != NULL &&
+        mp_arr[mpid].tail_block != curr_block &&
+        ((uchar *)ptr2 < curr_block->block || (uchar *)ptr2 >= curr_block->block + curr_block->size)
+        , "A chunk was taken from the mapping of a big chunk");
 
 }
 END_TEST
 
-START_TEST(mpnew_check_limit)
+START_TEST(mprealloc_map_grow)
 {
-#line 1123
-    int i = 0;
-    int mpid = 0;
+#line 1407
+    int mpid = MP_DEF_MP_ID;
+    char *ptr = NULL;
+    size_t sz = MP_DEF_MAP_SZ * 2;
+    size_t sz2 = MP_DEF_MAP_SZ * 64;
+    size_t tot_phy_mem = 0;
+    mpblock *curr_block = NULL;
 
-    for (i = 0; i < MP_MAX_MP_ID + 1; i++)
+    ptr = (char *)mpmalloc_mpid(sz, mpid);
+    if (ptr == NULL)
     {
-        mpid = mpnew(NULL);
-        if (mperrno != MP_ERRNO_SUCCESS)
-        {
-            break;
-        }
+        ck_abort_msg("Error allocating memory: %s", mpstrerror());
+    }
+    ptr[0] = 'a';
+    ptr[sz -1] = 'z';
+    tot_phy_mem = mp_tot_phy_mem - mp_arr[mpid].blocks[mp_arr[mpid].block_cnt -1]->size;
+
+    ptr = (char *)mprealloc_mpid(ptr, sz2, mpid);
+    if (ptr == NULL)
+    {
+        ck_abort_msg("Error reallocating memory: %s", mpstrerror());
     }
+    ptr[sz2 -1] = 'x';
 
+    curr_block = mp_arr[mpid].blocks[mp_arr[mpid].block_cnt -1];
     ck_assert_msg(
-        mperrno == MP_ERRNO_EXMP
-        , "The limit of Memory Pools was exceeded but the mperrno is not MP_ERRNO_EXMP <%d>", mperrno);
+        ptr[0] == 'a' && ptr[sz -1] == 'z'
+        , "The content of the chunk was not kept when growing its mapping");
 
     ck_assert_msg(
-        mpid == MP_ERRNO_EXMP
-        , "The limit of Memory Pools was exceeded but the returned value was not MP_ERRNO_EXMP");
+        curr_block->type == MP_BLK_MAP &&
+        mp_arr[mpid].block_cnt == 1 &&
+        curr_block->size >= sz2 &&
+        (uchar *)ptr >= curr_block->block
+        , "The mapping of the chunk was not grown");
 
-    for (i = 0; i < MP_MAX_MP_ID; i++)
-    {
-        if (
-            mp_arr[i].init == 'Y' &&
-            mp_arr[i].head_block == NULL
-        )
-        {
-            mp_arr[i].init = 'N';
-        }
-    }
+    ck_assert_msg(
+        mp_tot_phy_mem == tot_phy_mem + curr_block->size
+        , "The total physical memory <%zu> does not follow the grown mapping <%zu>", mp_tot_phy_mem, tot_phy_mem + curr_block->size);
 
 }
 END_TEST
 
-START_TEST(mppush_mpid_not_in_range)
+START_TEST(mpclr_release_map)
 {
-#line 1155
+#line 1447
     int mpid = 0;
-    int rc = 0;
+    size_t tot_phy_mem = 0;
+
+    mpid = mpnew("mpclr_release_map");
+    if (mpmalloc_mpid(16, mpid) == NULL)
+    {
+        ck_abort_msg("Error allocating memory: %s", mpstrerror());
+    }
+    tot_phy_mem = mp_tot_phy_mem;
+
+    if (mpmalloc_mpid(MP_DEF_MAP_SZ, mpid) == NULL)
+    {
+        ck_abort_msg("Error allocating memory: %s", mpstrerror());
+    }
+
+    mpclr(mpid);
+
+    ck_assert_msg(
+        mp_arr[mpid].block_cnt == 1 &&
+        mp_arr[mpid].map_cnt == 0 &&
+        mp_arr[mpid].blocks[0] == mp_arr[mpid].tail_block &&
+        mp_tot_phy_mem == tot_phy_mem
+        , "The blocks with own mapping were not given back by mpclr()");
+
+}
+END_TEST
+
+START_TEST(mpowner_chunk)
+{
+#line 1472
+    int mpid = MP_DEF_MP_ID;
+    int mpid2 = MP_NO_MP_ID;
+    char *ptr = NULL;
+    char *ptr2 = NULL;
+    char local = 'a';
+
+    if ((mpid2 = mpnew("mpowner")) < 0)
+    {
+        ck_abort_msg("Error creating memory pool: %s", mpstrerror());
+    }
+    ptr = (char *)mpmalloc_mpid(16, mpid);
+    ptr2 = (char *)mpmalloc_mpid(16, mpid2);
+    if (ptr == NULL || ptr2 == NULL)
+    {
+        ck_abort_msg("Error allocating memory: %s", mpstrerror());
+    }
+
+    ck_assert_msg(
+        mpowner(ptr) == mpid && mpowner(ptr2) == mpid2 && mperrno == MP_ERRNO_SUCCESS
+        , "The owner of the chunks was not found");
+
+    ck_assert_msg(
+        mpowner(&local) == MP_ERRNO_NOWN && mperrno == MP_ERRNO_NOWN
+        , "A pointer not delivered by any pool was found in a pool");
+
+    ck_assert_msg(
+        mpowner(NULL) == MP_ERRNO_PARM && mperrno == MP_ERRNO_PARM
+        , "A NULL pointer was accepted");
+
+    mpdel(mpid2);
+    ck_assert_msg(
+        mpowner(ptr2) == MP_ERRNO_NOWN && mpowner(ptr) == mpid
+        , "The blocks of the deleted pool were not removed from the index");
+
+}
+END_TEST
+
+START_TEST(mpowner_many_blocks)
+{
+#line 1507
+    int mpid = MP_NO_MP_ID;
+    int mpid2 = MP_NO_MP_ID;
+    char *ptr[1000];
+    int i = 0;
+
+    mpset_blksz(64);
+    if ((mpid = mpnew("mpowner 1")) < 0 || (mpid2 = mpnew("mpowner 2")) < 0)
+    {
+        ck_abort_msg("Error creating memory pool: %s", mpstrerror());
+    }
+
+    /* One block per chunk, interleaving both pools */
+    for (i = 0; i < 1000; i++)
+    {
+        if ((ptr[i] = (char *)mpmalloc_mpid(100, i % 2 ? mpid2 : mpid)) == NULL)
+        {
+            ck_abort_msg("Error allocating memory: %s", mpstrerror());
+        }
+    }
+
+    ck_assert_msg(
+        mp_rng_cnt == 1000 && mp_rng_srt > 1000 - MP_RNG_TAIL
+        , "The ranges of the blocks were not merged into the index");
+
+    for (i = 0; i < 1000; i++)
+    {
+        ck_assert_msg(
+            mpowner(ptr[i]) == (i % 2 ? mpid2 : mpid) &&
+            mpowner(ptr[i] + 99) == (i % 2 ? mpid2 : mpid)
+            , "Wrong owner for chunk <%d>", i);
+    }
+
+    mpdel(mpid);
+    ck_assert_msg(
+        mp_rng_cnt == 500
+        , "The ranges of the deleted pool were not removed <%d>", mp_rng_cnt);
+    for (i = 1; i < 1000; i += 2)
+    {
+        ck_assert_msg(
+            mpowner(ptr[i]) == mpid2
+            , "Wrong owner for chunk <%d> after deleting a pool", i);
+    }
+
+    mpdel(mpid2);
+    ck_assert_msg(
+        mp_rng_cnt == 0 && mp_rng_seq % 2 == 0
+        , "The index was not emptied <%d>", mp_rng_cnt);
+
+    /* The arrays are kept for lock-free readers until mpdel_all() */
+    mpdel_all();
+    ck_assert_msg(
+        mp_rng_arr == NULL && mp_rng_max == 0
+        , "The index was not freed");
+
+}
+END_TEST
+
+START_TEST(mprealloc_owner_route)
+{
+#line 1562
+    int mpid = MP_NO_MP_ID;
+    int mpid2 = MP_NO_MP_ID;
+    char *ptr = NULL;
+    char *ptr2 = NULL;
+
+    if ((mpid = mpnew("mprealloc 1")) < 0 || (mpid2 = mpnew("mprealloc 2")) < 0)
+    {
+        ck_abort_msg("Error creating memory pool: %s", mpstrerror());
+    }
+    if ((ptr = (char *)mpmalloc_mpid(16, mpid)) == NULL ||
+            mpmalloc_mpid(16, mpid) == NULL)
+    {
+        ck_abort_msg("Error allocating memory: %s", mpstrerror());
+    }
+    strcpy(ptr, "routed");
+
+    /* The current pool is not the one owning ptr */
+    mpset(mpid2);
+    mpfree(ptr);
+    if ((ptr2 = (char *)mprealloc(ptr, 32)) == NULL)
+    {
+        ck_abort_msg("Error reallocating memory: %s", mpstrerror());
+    }
+
+    ck_assert_msg(
+        mpowner(ptr2) == mpid && mp_arr[mpid2].block_cnt == 0 &&
+        strcmp(ptr2, "routed") == 0
+        , "The chunk was not reallocated in the pool owning it");
+
+}
+END_TEST
+
+START_TEST(mprealloc_map_owner)
+{
+#line 1592
+    int mpid = MP_DEF_MP_ID;
+    char *ptr = NULL;
+
+    if ((ptr = (char *)mpmalloc_mpid(MP_DEF_MAP_SZ, mpid)) == NULL)
+    {
+        ck_abort_msg("Error allocating memory: %s", mpstrerror());
+    }
+    if ((ptr = (char *)mprealloc_mpid(ptr, MP_DEF_MAP_SZ * 64, mpid)) == NULL)
+    {
+        ck_abort_msg("Error reallocating memory: %s", mpstrerror());
+    }
+
+    ck_assert_msg(
+        mpowner(ptr) == mpid && mpowner(ptr + MP_DEF_MAP_SZ * 64 -1) == mpid &&
+        mp_rng_cnt == 1
+        , "The index does not follow the grown mapping");
+
+    mpclr(mpid);
+    ck_assert_msg(
+        mp_rng_cnt == 0
+        , "The released mapping was not removed from the index");
+
+}
+END_TEST
+
+START_TEST(mpstrdup_call)
+{
+#line 1615
+    int mpid = MP_DEF_MP_ID + 8;
+    size_t align = MP_DEF_ALIGN;
+    size_t cur_blck_used = 0;
+    char * ptr = NULL;
+
+    mp_cur_mpid = mpid;
+
+    /* We have to make sure that the function 
+    allocates memory from the current mpid */
+
+    mp_arr[mpid].init = 'Y';
+#if MP_THREAD_SAFE == 1
+    mp_arr[mpid].thread_id = MP_CURR_THREAD;
+#endif
+    /* First we allocate a dummy size of bytes to 
+    make sure the block is initialized 
+    and the first memory block is allocated */
+    if (mpget_chunk(align + 1, mpid, align) == NULL)
+    {
+        ck_abort_msg("Error adding chunk: %s", mpstrerror());
+    }
+
+    cur_blck_used = mp_arr[mpid].tail_block->used;
+
+    if ((ptr = mpstrdup("This is another test")) == NULL)
+    {
+        ck_abort_msg("Error allocating memory in the current Memory Pool");
+    }
+
+    ck_assert_msg(
+        cur_blck_used != mp_arr[mpid].tail_block->used
+        , "The memory was not allocated in the current block");
+
+    ck_assert_msg(
+        strcmp(ptr, "This is another test") == 0
+        , "The string was not duplciated");
+
+
+}
+END_TEST
+
+START_TEST(mpstrdup_mpid_call)
+{
+#line 1654
+    int mpid = MP_DEF_MP_ID;
+    size_t align = MP_DEF_ALIGN;
+    size_t cur_blck_used = 0;
+    char * ptr = NULL;
+
+    /* We have to make sure that the function 
+    allocates memory from the current mpid */
+
+    mp_arr[mpid].init = 'Y';
+#if MP_THREAD_SAFE == 1
+    mp_arr[mpid].thread_id = MP_CURR_THREAD;
+#endif
+    /* First we allocate a dummy size of bytes to 
+    make sure the block is initialized 
+    and the first memory block is allocated */
+    if (mpget_chunk(align + 1, mpid, align) == NULL)
+    {
+        ck_abort_msg("Error adding chunk: %s", mpstrerror());
+    }
+
+    cur_blck_used = mp_arr[mpid].tail_block->used;
+
+    if ((ptr = mpstrdup("This is another test")) == NULL)
+    {
+        ck_abort_msg("Error allocating memory in the current Memory Pool");
+    }
+
+    ck_assert_msg(
+        cur_blck_used != mp_arr[mpid].tail_block->used
+        , "The memory was not allocated in the current block");
+
+    ck_assert_msg(
+        strcmp(ptr, "This is another test") == 0
+        , "The string was not duplciated");
+
+}
+END_TEST
+
+START_TEST(mpintern_pars)
+{
+#line 1690
+    ck_assert_msg(
+        mpintern(MP_DEF_MP_ID, NULL, 0) == NULL && mperrno == MP_ERRNO_PARM
+        , "The string is NULL but mperrno is not MP_ERRNO_PARM");
+
+    ck_assert_msg(
+        mpintern(MP_MAX_MP_ID, "abc", 3) == NULL && mperrno == MP_ERRNO_MPID
+        , "Memory pool ID out of range but mperrno is not MP_ERRNO_MPID");
+
+    ck_assert_msg(
+        mpintern(MP_DEF_MP_ID + 8, "abc", 3) == NULL && mperrno == MP_ERRNO_NOIN
+        , "Memory pool not initialized but mperrno is not MP_ERRNO_NOIN");
+
+}
+END_TEST
+
+START_TEST(mpintern_canonical)
+{
+#line 1703
+    int mpid = MP_DEF_MP_ID;
+    int mpid2 = MP_NO_MP_ID;
+    const char *str = NULL;
+    char buf[8] = "";
+
+    if ((mpid2 = mpnew("mpintern")) < 0)
+    {
+        ck_abort_msg("Error creating memory pool: %s", mpstrerror());
+    }
+
+    str = mpintern(mpid, "ESPTE", 5);
+    strcpy(buf, "ESPTE");
+
+    ck_assert_msg(
+        str != NULL && strcmp(str, "ESPTE") == 0 && str != buf &&
+        mpintern(mpid, buf, 5) == str && mpintern(mpid, "ESPTELEFONICA", 5) == str
+        , "The same string was not interned once");
+
+    ck_assert_msg(
+        mpintern(mpid, "ESPT", 4) != str && mpintern(mpid, "", 0) != NULL &&
+        mpintern(mpid2, "ESPTE", 5) != str && mp_arr[mpid].intern_cnt == 3
+        , "Different strings or pools share the interned copy");
+
+}
+END_TEST
+
+START_TEST(mpintern_many)
+{
+#line 1727
+    int mpid = MP_DEF_MP_ID;
+    const char *str[1000];
+    char buf[16] = "";
+    int i = 0;
+
+    for (i = 0; i < 1000; i++)
+    {
+        sprintf(buf, "key%d", i);
+        if ((str[i] = mpintern(mpid, buf, strlen(buf))) == NULL)
+        {
+            ck_abort_msg("Error interning string: %s", mpstrerror());
+        }
+    }
+
+    ck_assert_msg(
+        mp_arr[mpid].intern_cnt == 1000 && mp_arr[mpid].intern_max == 2048
+        , "The intern table did not grow <%zu> <%zu>", mp_arr[mpid].intern_cnt, mp_arr[mpid].intern_max);
+
+    for (i = 0; i < 1000; i++)
+    {
+        sprintf(buf, "key%d", i);
+        ck_assert_msg(
+            mpintern(mpid, buf, strlen(buf)) == str[i] && strcmp(str[i], buf) == 0
+            , "String <%s> lost after growing the table", buf);
+    }
+
+}
+END_TEST
+
+START_TEST(mpintern_clr_del)
+{
+#line 1754
+    int mpid = MP_NO_MP_ID;
+
+    if ((mpid = mpnew("mpintern")) < 0)
+    {
+        ck_abort_msg("Error creating memory pool: %s", mpstrerror());
+    }
+    if (mpintern(mpid, "GBRVF", 5) == NULL)
+    {
+        ck_abort_msg("Error interning string: %s", mpstrerror());
+    }
+
+    mpclr(mpid);
+    ck_assert_msg(
+        mp_arr[mpid].intern_tbl == NULL && mp_arr[mpid].intern_cnt == 0
+        , "The intern table was not emptied by mpclr()");
+
+    if (mpintern(mpid, "GBRVF", 5) == NULL)
+    {
+        ck_abort_msg("Error interning string: %s", mpstrerror());
+    }
+    mpdel(mpid);
+    ck_assert_msg(
+        mp_arr[mpid].intern_tbl == NULL && mp_arr[mpid].intern_cnt == 0
+        , "The intern table was not emptied by mpdel()");
+
+}
+END_TEST
+
+START_TEST(mpasprintf_pars)
+{
+#line 1780
+    char *ptr = NULL;
+
+    mpasprintf(&ptr, NULL);
+
+    ck_assert_msg(
+        mperrno == MP_ERRNO_PARM
+    , "One of the parameters is NULL but mperrno is not MP_ERRNO_PARM");
+
+    mpasprintf(NULL, "%s", "Test");
+
+    ck_assert_msg(
+        mperrno == MP_ERRNO_PARM
+    , "One of the parameters is NULL but mperrno is not MP_ERRNO_PARM");
+
+}
+END_TEST
+
+START_TEST(mpasprintf_call)
+{
+#line 1795
+    int mpid = MP_DEF_MP_ID + 8;
+    size_t align = MP_DEF_ALIGN;
+    size_t cur_blck_used = 0;
+    char * ptr = NULL;
+    int rc1 = 0;
+    int rc2 = 0;
+    char str[32] = "";
+
+    mp_cur_mpid = mpid;
+
+    /* We have to make sure that the function 
+    allocates memory from the current mpid */
+
+    mp_arr[mpid].init = 'Y';
+#if MP_THREAD_SAFE == 1
+    mp_arr[mpid].thread_id = MP_CURR_THREAD;
+#endif
+    /* First we allocate a dummy size of bytes to 
+    make sure the block is initialized 
+    and the first memory block is allocated */
+    if (mpget_chunk(align + 1, mpid, align) == NULL)
+    {
+        ck_abort_msg("Error adding chunk: %s", mpstrerror());
+    }
+
+    cur_blck_used = mp_arr[mpid].tail_block->used;
+
+    sprintf(str, "%s: %d", "This is yet another test", 3);
+    rc1 = strlen(str);
+    rc2 = mpasprintf(&ptr, "%s: %d", "This is yet another test", 3);
+    if (ptr == NULL)
+    {
+        ck_abort_msg("Error allocating memory in the current Memory Pool");
+    }
+
+    ck_assert_msg(
+        cur_blck_used != mp_arr[mpid].tail_block->used
+        , "The memory was not allocated in the current block");
+
+    ck_assert_msg(
+        strcmp(ptr, str) == 0
+        , "The string was not duplciated");
+
+    ck_assert_msg(
+        rc1 == rc2
+        , "The number of characters copied is not the same; it is %d but should be %d", rc2, rc1);
+
+}
+END_TEST
+
+START_TEST(mpasprintf_mpid_pars)
+{
+#line 1843
+    char *ptr = NULL;
+
+    mpasprintf(&ptr, NULL);
+
+    ck_assert_msg(
+        mperrno == MP_ERRNO_PARM
+    , "One of the parameters is NULL but mperrno is not MP_ERRNO_PARM");
+
+    mpasprintf_mpid(NULL, MP_DEF_MP_ID, "%s", "Test");
+
+    ck_assert_msg(
+        mperrno == MP_ERRNO_PARM
+    , "One of the parameters is NULL but mperrno is not MP_ERRNO_PARM");
+
+
+}
+END_TEST
+
+START_TEST(mpasprintf_mpid_call)
+{
+#line 1859
+    int mpid = MP_DEF_MP_ID;
+    size_t align = MP_DEF_ALIGN;
+    size_t cur_blck_used = 0;
+    char * ptr = NULL;
+    int rc1 = 0;
+    int rc2 = 0;
+    char str[32] = "";
+
+    /* We have to make sure that the function 
+    allocates memory from the current mpid */
+
+    mp_arr[mpid].init = 'Y';
+#if MP_THREAD_SAFE == 1
+    mp_arr[mpid].thread_id = MP_CURR_THREAD;
+#endif
+    /* First we allocate a dummy size of bytes to 
+    make sure the block is initialized 
+    and the first memory block is allocated */
+    if (mpget_chunk(align + 1, mpid, align) == NULL)
+    {
+        ck_abort_msg("Error adding chunk: %s", mpstrerror());
+    }
+
+    cur_blck_used = mp_arr[mpid].tail_block->used;
+
+    sprintf(str, "%s: %d", "This is yet another test", 3);
+    rc1 = strlen(str);
+    rc2 = mpasprintf(&ptr, "%s: %d", "This is yet another test", 3);
+    if (ptr == NULL)
+    {
+        ck_abort_msg("Error allocating memory in the current Memory Pool");
+    }
+
+    ck_assert_msg(
+        cur_blck_used != mp_arr[mpid].tail_block->used
+        , "The memory was not allocated in the current block");
+
+    ck_assert_msg(
+        strcmp(ptr, str) == 0
+        , "The string was not duplciated");
+
+    ck_assert_msg(
+        rc1 == rc2
+        , "The number of characters copied is not the same");
+
+}
+END_TEST
+
+START_TEST(mpasprintf_single_pass)
+{
+#line 1905
+    int mpid = MP_DEF_MP_ID;
+    char *ptr = NULL;
+    uchar *dst = NULL;
+    int rc = 0;
+
+    if (mpmalloc_mpid(3, mpid) == NULL)
+    {
+        ck_abort_msg("Error allocating memory: %s", mpstrerror());
+    }
+    dst = mp_arr[mpid].tail_block->block + ((mp_arr[mpid].tail_block->used + MP_DEF_ALIGN -1) & ~((size_t)MP_DEF_ALIGN -1));
+
+    rc = mpasprintf_mpid(&ptr, mpid, "key-%d-%s", 42, "abc");
+
+    ck_assert_msg(
+        rc == 10 && strcmp(ptr, "key-42-abc") == 0
+        , "Wrong string <%s> or length <%d>", ptr, rc);
+
+    ck_assert_msg(
+        (uchar *)ptr == dst && mp_arr[mpid].last_chunk == dst &&
+        mp_arr[mpid].tail_block->used == (size_t)(dst - mp_arr[mpid].tail_block->block) + 11
+        , "The string was not formatted in place taking only the bytes used");
+
+}
+END_TEST
+
+START_TEST(mpasprintf_not_fit)
+{
+#line 1928
+    int mpid = MP_DEF_MP_ID;
+    char *ptr = NULL;
+    mpblock *curr_block = NULL;
+    int rc = 0;
+
+    mpset_blksz(64);
+    if (mpmalloc_mpid(32, mpid) == NULL)
+    {
+        ck_abort_msg("Error allocating memory: %s", mpstrerror());
+    }
+    curr_block = mp_arr[mpid].tail_block;
+
+    rc = mpasprintf_mpid(&ptr, mpid, "%0200d", 7);
+
+    ck_assert_msg(
+        rc == 200 && strlen(ptr) == 200 && ptr[199] == '7' && ptr[0] == '0'
+        , "Wrong string or length <%d>", rc);
+
+    ck_assert_msg(
+        mp_arr[mpid].block_cnt == 2 && curr_block->used == 32 && 
+        curr_block->zero == curr_block->size
+        , "The first pass was not accounted in the old tail block");
+
+}
+END_TEST
+
+START_TEST(mpasprintf_vm)
+{
+#line 1952
+    int mpid = MP_NO_MP_ID;
+    char *ptr = NULL;
+    int rc = 0;
+
+    if ((mpid = mpnew_vm("mpasprintf", 4 * 1024 * 1024)) < 0)
+    {
+        ck_abort_msg("Error creating memory pool: %s", mpstrerror());
+    }
+
+    /* Bigger than the committed pages */
+    rc = mpasprintf_mpid(&ptr, mpid, "%0300000d", 7);
+
+    ck_assert_msg(
+        rc == 300000 && strlen(ptr) == 300000 && ptr[299999] == '7' &&
+        mp_arr[mpid].vm_commit >= MP_BLK_HDR_SZ + 300001
+        , "Wrong string or length <%d> in a virtual memory pool", rc);
+
+}
+END_TEST
+
+START_TEST(mpvasprintf_call)
+{
+#line 1970
+    int mpid = MP_DEF_MP_ID;
+    char *ptr = NULL;
+    int rc = 0;
+
+    mp_cur_mpid = mpid;
+    rc = vfmt(&ptr, MP_NO_MP_ID, "%s-%05d", "mpvasprintf", 12);
+
+    ck_assert_msg(
+        rc == 17 && strcmp(ptr, "mpvasprintf-00012") == 0 && mpowner(ptr) == mpid
+        , "Wrong string <%s> or length <%d>", ptr, rc);
+
+    ck_assert_msg(
+        vfmt(NULL, MP_NO_MP_ID, "%s", "Test") == -1 && mperrno == MP_ERRNO_PARM
+        , "One of the parameters is NULL but mperrno is not MP_ERRNO_PARM");
+
+}
+END_TEST
+
+START_TEST(mpvasprintf_mpid_call)
+{
+#line 1986
+    int mpid = MP_NO_MP_ID;
+    char *ptr = NULL;
+    int rc = 0;
+
+    if ((mpid = mpnew("mpvasprintf_mpid")) < 0)
+    {
+        ck_abort_msg("Error creating memory pool: %s", mpstrerror());
+    }
+    rc = vfmt(&ptr, mpid, "%s-%x", "mpvasprintf_mpid", 255);
+
+    ck_assert_msg(
+        rc == 19 && strcmp(ptr, "mpvasprintf_mpid-ff") == 0 && mpowner(ptr) == mpid
+        , "Wrong string <%s> or length <%d>", ptr, rc);
+
+    ck_assert_msg(
+        vfmt(&ptr, MP_MAX_MP_ID, "%s", "Test") == -1 && mperrno == MP_ERRNO_MPID
+        , "Memory pool ID out of range but mperrno is not MP_ERRNO_MPID");
+
+}
+END_TEST
+
+START_TEST(mpnew_slab_pars)
+{
+#line 2005
+    ck_assert_msg(
+        mpnew_slab("slab", 0) == MP_ERRNO_PARM && mperrno == MP_ERRNO_PARM
+        , "Objects of size 0 were accepted");
+
+}
+END_TEST
+
+START_TEST(mpslab_alloc_free)
+{
+#line 2010
+    int mpid = MP_NO_MP_ID;
+    char *obj1 = NULL;
+    char *obj2 = NULL;
+    char *obj3 = NULL;
+
+    if ((mpid = mpnew_slab("slab", 20)) < 0)
+    {
+        ck_abort_msg("Error creating memory pool: %s", mpstrerror());
+    }
+
+    obj1 = (char *)mpslab_alloc(mpid);
+    obj2 = (char *)mpslab_alloc(mpid);
+    if (obj1 == NULL || obj2 == NULL)
+    {
+        ck_abort_msg("Error allocating object: %s", mpstrerror());
+    }
+
+    ck_assert_msg(
+        mp_arr[mpid].slab_sz == 24 && obj2 == obj1 + 24 &&
+        ((uintptr_t)obj1 % MP_DEF_ALIGN) == 0 && mp_arr[mpid].block_cnt == 1
+        , "The objects are not packed one after the other");
+
+    mpslab_free(obj1, mpid);
+    obj3 = (char *)mpslab_alloc(mpid);
+    ck_assert_msg(
+        obj3 == obj1 && mp_arr[mpid].slab_free == NULL && mp_arr[mpid].slab_free_cnt == 0
+        , "The free object was not reused");
+
+    ck_assert_msg(
+        mpmalloc_mpid(8, mpid) == NULL && mperrno == MP_ERRNO_PARM
+        , "mpmalloc_mpid() was accepted on a slab pool");
+
+    ck_assert_msg(
+        mpslab_alloc(MP_DEF_MP_ID) == NULL && mperrno == MP_ERRNO_PARM
+        , "mpslab_alloc() was accepted on a pool which is not a slab");
+
+}
+END_TEST
+
+START_TEST(mpslab_alloc_blocks)
+{
+#line 2047
+    int mpid = MP_NO_MP_ID;
+    void *obj = NULL;
+    int i = 0;
+
+    mpset_blksz(1000);
+    if ((mpid = mpnew_slab("slab", 100)) < 0)
+    {
+        ck_abort_msg("Error creating memory pool: %s", mpstrerror());
+    }
+
+    for (i = 0; i < 100; i++)
+    {
+        if ((obj = mpslab_alloc(mpid)) == NULL)
+        {
+            ck_abort_msg("Error allocating object: %s", mpstrerror());
+        }
+        ck_assert_msg(mpowner(obj) == mpid, "Object <%d> out of the pool", i);
+    }
+
+    /* 9 objects of 104 bytes per block */
+    ck_assert_msg(
+        mp_arr[mpid].block_cnt == 12
+        , "Wrong number of blocks <%d> for 100 objects", mp_arr[mpid].block_cnt);
+
+    mpclr(mpid);
+    ck_assert_msg(
+        mpslab_alloc(mpid) == mp_arr[mpid].tail_block->block &&
+        mp_arr[mpid].slab_free == NULL
+        , "The slab pool was not cleared");
+
+}
+END_TEST
+
+START_TEST(mpslab_foreach_live)
+{
+#line 2078
+    int mpid = MP_NO_MP_ID;
+    long *obj[300];
+    long sum[2] = {0, 0};
+    int i = 0;
+    int rc = 0;
+
+    mpset_blksz(1024);
+    if ((mpid = mpnew_slab("slab", sizeof(long))) < 0)
+    {
+        ck_abort_msg("Error creating memory pool: %s", mpstrerror());
+    }
+
+    for (i = 0; i < 300; i++)
+    {
+        if ((obj[i] = (long *)mpslab_alloc(mpid)) == NULL)
+        {
+            ck_abort_msg("Error allocating object: %s", mpstrerror());
+        }
+        *obj[i] = i;
+    }
+    for (i = 0; i < 300; i += 3)
+    {
+        mpslab_free(obj[i], mpid);
+    }
+
+    rc = mpslab_foreach(mpid, slab_sum, sum);
+    ck_assert_msg(
+        rc == 200 && sum[0] == 200 && sum[1] == 300 * 299 / 2 - 3 * (100 * 99 / 2)
+        , "Wrong sweep of the live objects <%d> <%ld> <%ld>", rc, sum[0], sum[1]);
+
+    ck_assert_msg(
+        mpslab_foreach(mpid, NULL, NULL) == MP_ERRNO_PARM &&
+        mpslab_foreach(MP_DEF_MP_ID, slab_sum, sum) == MP_ERRNO_PARM
+        , "Wrong parameters were accepted");
+
+}
+END_TEST
+
+START_TEST(mpslab_foreach_free)
+{
+#line 2114
+    int mpid = MP_NO_MP_ID;
+    long sum[2] = {0, 0};
+    int i = 0;
+
+    if ((mpid = mpnew_slab("slab", sizeof(long))) < 0)
+    {
+        ck_abort_msg("Error creating memory pool: %s", mpstrerror());
+    }
+    for (i = 0; i < 10; i++)
+    {
+        *(long *)mpslab_alloc(mpid) = i;
+    }
+
+    /* The sweep gives back every object */
+    ck_assert_msg(
+        mpslab_foreach(mpid, slab_free_all, &mpid) == 10 &&
+        mpslab_foreach(mpid, slab_sum, sum) == 0 && mp_arr[mpid].slab_free_cnt == 10
+        , "The objects were not freed during the sweep");
+
+}
+END_TEST
+
+START_TEST(mpslab_alloc_thread)
+{
+#line 2134
+#if MP_THREAD_SAFE == 1
+    pthread_t th1;
+    slab_args_t args;
+    void *obj[1] = {NULL};
+    void *free_obj = NULL;
+    size_t used = 0;
+    int mpid = MP_NO_MP_ID;
+
+    if ((mpid = mpnew_slab("slab", 32)) < 0)
+    {
+        ck_abort_msg("Error creating memory pool: %s", mpstrerror());
+    }
+    free_obj = mpslab_alloc(mpid);
+    mpslab_alloc(mpid);
+    mpslab_free(free_obj, mpid);
+
+    /* Free list path */
+    args.mpid = mpid;
+    args.obj = obj;
+    pthread_create(&th1, NULL, &slab_alloc_fn, &args);
+    pthread_join(th1, NULL);
+    ck_assert_msg(
+        obj[0] == NULL && args.cnt == MP_ERRNO_THRD && mp_arr[mpid].slab_free == free_obj
+        , "An object of the free list was delivered to another thread");
+
+    /* Tail block path */
+    mpslab_alloc(mpid);
+    used = mp_arr[mpid].tail_block->used;
+    pthread_create(&th1, NULL, &slab_alloc_fn, &args);
+    pthread_join(th1, NULL);
+    ck_assert_msg(
+        obj[0] == NULL && args.cnt == MP_ERRNO_THRD && mp_arr[mpid].tail_block->used == used
+        , "An object of the tail block was delivered to another thread");
+#endif /* MP_THREAD_SAFE */
+
+}
+END_TEST
+
+START_TEST(mpslab_free_remote)
+{
+#line 2170
+#if MP_THREAD_SAFE == 1
+    pthread_t th1;
+    slab_args_t args;
+    void *obj[1000];
+    int mpid = MP_NO_MP_ID;
+    int block_cnt = 0;
+    int i = 0;
+
+    if ((mpid = mpnew_slab("slab", 32)) < 0)
+    {
+        ck_abort_msg("Error creating memory pool: %s", mpstrerror());
+    }
+    for (i = 0; i < 1000; i++)
+    {
+        if ((obj[i] = mpslab_alloc(mpid)) == NULL)
+        {
+            ck_abort_msg("Error allocating object: %s", mpstrerror());
+        }
+    }
+    block_cnt = mp_arr[mpid].block_cnt;
+
+    args.mpid = mpid;
+    args.obj = obj;
+    args.cnt = 1000;
+    if (pthread_create(&th1, NULL, &slab_free_fn, &args) != 0)
+    {
+        ck_abort_msg("Error creating thread");
+    }
+    pthread_join(th1, NULL);
+
+    ck_assert_msg(
+        mp_arr[mpid].slab_remote == obj[999] && mp_arr[mpid].slab_free == NULL
+        , "The objects were not pushed on the remote stack");
+
+    /* The owner drains the stack on its next allocation */
+    ck_assert_msg(
+        mpslab_alloc(mpid) == obj[999] && mp_arr[mpid].slab_remote == NULL &&
+        mp_arr[mpid].slab_free_cnt == 999
+        , "The remote stack was not drained <%zu>", mp_arr[mpid].slab_free_cnt);
+
+    for (i = 1; i < 1000; i++)
+    {
+        if (mpslab_alloc(mpid) == NULL)
+        {
+            ck_abort_msg("Error allocating object: %s", mpstrerror());
+        }
+    }
+    ck_assert_msg(
+        mp_arr[mpid].block_cnt == block_cnt && mp_arr[mpid].slab_free == NULL
+        , "The objects given back by the other thread were not reused");
+#endif /* MP_THREAD_SAFE */
+
+}
+END_TEST
+
+START_TEST(mpnew_pars)
+{
+#line 2223
+    int mpid = mpnew(NULL);
+
+    ck_assert_msg(
+        strcmp(mp_arr[mpid].descr, "-") == 0
+        , "No description is passed and the stored description is <%s> instead of '-'", mp_arr[mpid].descr);
+
+    mpid = mpnew("Test pool");
+
+    ck_assert_msg(
+        strcmp(mp_arr[mpid].descr, "Test pool") == 0
+        , "The description of the new Memory Pool <%s> doesn't match the one passed as parameter <%s>", 
+            mp_arr[mpid].descr,
+            "Test Pool");
+
+
+}
+END_TEST
+
+START_TEST(mpnew_check_limit)
+{
+#line 2239
+    int i = 0;
+    int mpid = 0;
+
+    for (i = 0; i < MP_MAX_MP_ID + 1; i++)
+    {
+        mpid = mpnew(NULL);
+        if (mperrno != MP_ERRNO_SUCCESS)
+        {
+            break;
+        }
+    }
+
+    ck_assert_msg(
+        mperrno == MP_ERRNO_EXMP
+        , "The limit of Memory Pools was exceeded but the mperrno is not MP_ERRNO_EXMP <%d>", mperrno);
+
+    ck_assert_msg(
+        mpid == MP_ERRNO_EXMP
+        , "The limit of Memory Pools was exceeded but the returned value was not MP_ERRNO_EXMP");
+
+    for (i = 0; i < MP_MAX_MP_ID; i++)
+    {
+        if (
+            mp_arr[i].init == 'Y' &&
+            mp_arr[i].blocks == NULL
+        )
+        {
+            mp_arr[i].init = 'N';
+        }
+    }
+
+}
+END_TEST
+
+START_TEST(mpnew_vm_contiguous)
+{
+#line 2271
+    int mpid = 0;
+    int i = 0;
+    char *ptr = NULL;
+    char *prev = NULL;
+    size_t sz = 1000;
+
+    mpid = mpnew_vm("mpnew_vm_contiguous", 64 * 1024 * 1024);
+    if (mpid < 0)
+    {
+        ck_abort_msg("Error creating memory pool: %s", mpstrerror());
+    }
+
+    ck_assert_msg(
+        mp_arr[mpid].type == MP_TYPE_VM &&
+        mp_arr[mpid].block_cnt == 1 &&
+        (uchar *)mp_arr[mpid].tail_block + MP_BLK_HDR_SZ == mp_arr[mpid].tail_block->block
+        , "The memory pool is not made of a single block at the start of the reserved range");
+
+    for (i = 0; i < (int)(MP_DEF_BLK_SZ / sz) * 4; i++)
+    {
+        ptr = (char *)mpmalloc_mpid(sz, mpid);
+        if (ptr == NULL)
+        {
+            ck_abort_msg("Error allocating memory: %s", mpstrerror());
+        }
+        memset(ptr, 0xff, sz);
+        if (prev != NULL && ptr != prev + sz)
+        {
+            ck_abort_msg("Chunk %d is not contiguous to the previous one", i);
+        }
+        prev = ptr;
+    }
+
+    ck_assert_msg(
+        mp_arr[mpid].block_cnt == 1
+        , "The memory pool has <%d> blocks instead of 1", mp_arr[mpid].block_cnt);
+
+    ck_assert_msg(
+        mp_arr[mpid].vm_commit >= MP_BLK_HDR_SZ + mp_arr[mpid].tail_block->used &&
+        mp_arr[mpid].vm_commit < 64 * 1024 * 1024
+        , "The committed size <%zu> does not follow the used size <%zu>", mp_arr[mpid].vm_commit, mp_arr[mpid].tail_block->used);
+
+}
+END_TEST
+
+START_TEST(mpnew_vm_realloc_in_place)
+{
+#line 2314
+    int mpid = 0;
+    char *ptr = NULL;
+    char *ptr2 = NULL;
+    size_t sz = 16 * 1024 * 1024;
+
+    mpid = mpnew_vm(NULL, 0);
+    if (mpid < 0)
+    {
+        ck_abort_msg("Error creating memory pool: %s", mpstrerror());
+    }
+
+    ptr = (char *)mpmalloc_mpid(100, mpid);
+    if (ptr == NULL)
+    {
+        ck_abort_msg("Error allocating memory: %s", mpstrerror());
+    }
+    strcpy(ptr, "mpnew_vm_realloc_in_place");
+
+    ptr2 = (char *)mprealloc_mpid(ptr, sz, mpid);
+
+    ck_assert_msg(
+        ptr2 == ptr && strcmp(ptr2, "mpnew_vm_realloc_in_place") == 0
+        , "The last chunk of the pool was not grown in place");
+
+    ptr2[sz -1] = 'x';
+    ck_assert_msg(
+        mp_arr[mpid].vm_commit >= MP_BLK_HDR_SZ + (size_t)(ptr2 - (char *)mp_arr[mpid].tail_block->block) + sz
+        , "The grown chunk is not committed");
+
+}
+END_TEST
+
+START_TEST(mpnew_vm_exhausted)
+{
+#line 2344
+    int mpid = 0;
+    size_t sz = 1024 * 1024;
+
+    mpid = mpnew_vm(NULL, sz);
+    if (mpid < 0)
+    {
+        ck_abort_msg("Error creating memory pool: %s", mpstrerror());
+    }
+
+    ck_assert_msg(
+        mpmalloc_mpid(sz * 2, mpid) == NULL &&
+        mperrno == MP_ERRNO_NOMM
+        , "Allocation bigger than the reserved range didn't fail with MP_ERRNO_NOMM but <%d>", mperrno);
+
+    ck_assert_msg(
+        mp_arr[mpid].block_cnt == 1
+        , "A block was added to a memory pool of type MP_TYPE_VM");
+
+}
+END_TEST
+
+START_TEST(mpnew_vm_clr_del)
+{
+#line 2363
+    int mpid = 0;
+    size_t tot_phy_mem = mp_tot_phy_mem;
+    size_t pgsz = mp_vm_pgsz();
+    char *ptr = NULL;
+
+    mpid = mpnew_vm(NULL, 0);
+    if (mpid < 0)
+    {
+        ck_abort_msg("Error creating memory pool: %s", mpstrerror());
+    }
+
+    ptr = (char *)mpmalloc_mpid(MP_DEF_BLK_SZ * 8, mpid);
+    if (ptr == NULL)
+    {
+        ck_abort_msg("Error allocating memory: %s", mpstrerror());
+    }
+    memset(ptr, 0xff, MP_DEF_BLK_SZ * 8);
+
+    ck_assert_msg(
+        mp_tot_phy_mem == tot_phy_mem + mp_arr[mpid].vm_commit
+        , "The total physical memory does not count the committed pages");
+
+    mpclr(mpid);
+
+    ck_assert_msg(
+        mp_arr[mpid].vm_commit == pgsz &&
+        mp_tot_phy_mem == tot_phy_mem + pgsz &&
+        mp_arr[mpid].tail_block->used == 0
+        , "The pages of the memory pool were not given back by mpclr()");
+
+    ptr = (char *)mpmalloc_mpid(MP_DEF_BLK_SZ, mpid);
+    ck_assert_msg(
+        ptr != NULL && ptr[MP_DEF_BLK_SZ -1] == 0
+        , "The memory pool cannot be used after mpclr()");
+
+    mpdel(mpid);
+
+    ck_assert_msg(
+        mp_tot_phy_mem == tot_phy_mem &&
+        mp_arr[mpid].blocks == NULL &&
+        mp_arr[mpid].tail_block == NULL
+        , "The memory pool of type MP_TYPE_VM was not released by mpdel()");
+
+}
+END_TEST
+
+START_TEST(mppush_mpid_not_in_range)
+{
+#line 2407
+    int mpid = 0;
+    int rc = 0;
+
+    mp_prev_mpid = MP_NO_MP_ID;
+
+    mpid = -1;
+    rc = mppush(mpid);
+
+    ck_assert_msg(
+        mperrno == MP_ERRNO_MPID
+        , "The mpid is out of range and the mperrno is not MP_ERRNO_MPID");
+
+    ck_assert_msg(
+        rc == MP_ERRNO_MPID
+        , "The mpid is out of range and the return code is not MP_ERRNO_MPID");
+
+    mpid = MP_MAX_MP_ID;
+    rc = mppush(mpid);
+
+    ck_assert_msg(
+        mperrno == MP_ERRNO_MPID
+        , "The mpid is out of range and the mperrno is not MP_ERRNO_MPID");
+
+    ck_assert_msg(
+        rc == MP_ERRNO_MPID
+        , "The mpid is out of range and the return code is not MP_ERRNO_MPID");
+
+
+}
+END_TEST
+
+START_TEST(mppush_mpid_not_init)
+{
+#line 2436
+    int mpid = -1;
+    int i = 0;
+    int rc = 0;
+
+    mp_prev_mpid = MP_NO_MP_ID;
+
+    for(i = 0; i < MP_MAX_MP_ID; i++)
+    {
+        if (mp_arr[i].init != 'Y' && i != MP_DEF_MP_ID)
+        {
+            mpid = i;
+            break;
+        }
+    }
+
+    if (mpid == -1)
+    {
+        ck_abort_msg("Not found any un-initialized Memory Pool. Rewrite test case");
+    }
+
+    rc = mppush(mpid);
+     
+    ck_assert_msg(
+        mperrno == MP_ERRNO_NOIN
+        , "The mpid is out of range and the mperrno is not MP_ERRNO_NOIN");
+
+    ck_assert_msg(
+        rc == MP_ERRNO_NOIN
+        , "The mpid is out of range and the return code is not MP_ERRNO_NOIN");
+
+    
+}
+END_TEST
+
+START_TEST(mppush_prev_mpid)
+{
+#line 2468
+    int mpid = -1;
+    int mpid2 = -1;
+    int i = 0;
+    int rc = 0;
+
+    mp_prev_mpid = MP_NO_MP_ID;
+
+    /* Getting the Memory Pool ID to use as current one */
+    for(i = 1; i < MP_MAX_MP_ID; i++)
+    {
+        if (mp_arr[i].init != 'Y')
+        {
+            mp_arr[i].init = 'Y';
+            mpid = i;
+            break;
+        }
+    }
+
+    if (mpid == -1)
+    {
+        ck_abort_msg("Not found any initialized Memory Pool. Rewrite test case");
+    }
+
+    /* Getting the Memory Pool ID to push */
+    for(i = mpid + 1; i < MP_MAX_MP_ID; i++)
+    {
+        if (mp_arr[i].init != 'Y')
+        {
+            mp_arr[i].init = 'Y';
+            mpid2 = i;
+            break;
+        }
+    }
+
+    if (mpid2 == -1)
+    {
+        ck_abort_msg("Not found any initialized Memory Pool. Rewrite test case");
+    }
+
+    mp_cur_mpid = mpid;
+
+    rc = mppush(mpid2);
+     
+    ck_assert_msg(
+        mp_cur_mpid == mpid2   
+        , "The current mpid is not set correctly, it should be %d but it is %d", mpid2, mp_cur_mpid);
+
+    ck_assert_msg(
+        mp_prev_mpid == mpid   
+        , "The previous mpid is not set correctly, it should be %d but it is %d", mpid, mp_prev_mpid);
+
+    ck_assert_msg(
+        rc == MP_ERRNO_SUCCESS
+        , "The return code should be MP_ERRNO_SUCCESS but it is %d", rc);
+
+}
+END_TEST
+
+START_TEST(mppop_mpid_not_in_range)
+{
+#line 2524
+    int rc = 0;
+
+    mp_prev_mpid = -1;
+    rc = mppop();
+
+    ck_assert_msg(
+        mperrno == MP_ERRNO_NOPP
+        , "The mp_prev_mpid is out of range and the mperrno is not MP_ERRNO_NOPP");
+
+    ck_assert_msg(
+        rc == MP_ERRNO_NOPP
+        , "The mpid is out of range and the return code is not MP_ERRNO_NOPP");
+
+    mp_prev_mpid = MP_MAX_MP_ID;
+    rc = mppop();
+
+    ck_assert_msg(
+        mperrno == MP_ERRNO_NOPP
+        , "The mp_prev_mpid is out of range and the mperrno is not MP_ERRNO_NOPP");
+
+    ck_assert_msg(
+        rc == MP_ERRNO_NOPP
+        , "The mpid is out of range and the return code is not MP_ERRNO_NOPP");
+
+
+}
+END_TEST
+
+START_TEST(mppop_prev_mpid)
+{
+#line 2550
+    int mpid = -1;
+    int i = 0;
+    int rc = 0;
+
+    mp_prev_mpid = MP_NO_MP_ID;
+
+    /* Getting the Memory Pool ID to pop */
+    for(i = 1; i < MP_MAX_MP_ID; i++)
+    {
+        if (mp_arr[i].init != 'Y')
+        {
+            mp_arr[i].init = 'Y';
+            mpid = i;
+            break;
+        }
+    }
+
+    if (mpid == MP_NO_MP_ID)
+    {
+        ck_abort_msg("Not found any initialized Memory Pool. Rewrite test case");
+    }
+
+    mp_cur_mpid = MP_NO_MP_ID;
+    mp_prev_mpid = mpid;
+
+    rc = mppop();
+     
+    ck_assert_msg(
+        mp_cur_mpid == mpid
+        , "The current mpid is not set correctly, it should be %d but it is %d", mpid, mp_cur_mpid);
+
+    ck_assert_msg(
+        mp_prev_mpid == MP_NO_MP_ID   
+        , "The previous mpid is not set correctly, it should be %d but it is %d", MP_NO_MP_ID, mp_prev_mpid);
+
+    ck_assert_msg(
+        rc == MP_ERRNO_SUCCESS
+        , "The return code should be MP_ERRNO_SUCCESS but it is %d", rc);
+
+}
+END_TEST
+
+START_TEST(mpset_mpid_not_in_range)
+{
+#line 2590
+    int rc = 0;
+    int mpid = 0;
+
+    mpid = -1;
+    rc = mpset(mpid);
+
+    ck_assert_msg(
+        mperrno == MP_ERRNO_MPID
+        , "The mpid is out of range and the mperrno is not MP_ERRNO_MPID");
+
+    ck_assert_msg(
+        rc == MP_ERRNO_MPID
+        , "The mpid is out of range and the return code is not MP_ERRNO_MPID");
+
+    mpid = MP_MAX_MP_ID;
+    rc = mpset(mpid);
+
+    ck_assert_msg(
+        mperrno == MP_ERRNO_MPID
+        , "The mpid is out of range and the mperrno is not MP_ERRNO_MPID");
+
+    ck_assert_msg(
+        rc == MP_ERRNO_MPID
+        , "The mpid is out of range and the return code is not MP_ERRNO_MPID");
+
+}
+END_TEST
+
+START_TEST(mpset_mpid_not_init)
+{
+#line 2616
+    int mpid = -1;
+    int i = 0;
+    int rc = 0;
+
+    mp_prev_mpid = MP_NO_MP_ID;
+
+    for(i = 0; i < MP_MAX_MP_ID; i++)
+    {
+        if (mp_arr[i].init != 'Y' && i != MP_DEF_MP_ID)
+        {
+            mpid = i;
+            break;
+        }
+    }
+
+    if (mpid == -1)
+    {
+        ck_abort_msg("Not found any un-initialized Memory Pool. Rewrite test case");
+    }
+
+    rc = mpset(mpid);
+     
+    ck_assert_msg(
+        mperrno == MP_ERRNO_NOIN
+        , "The mpid is out of range and the mperrno is not MP_ERRNO_NOIN");
+
+    ck_assert_msg(
+        rc == MP_ERRNO_NOIN
+        , "The mpid is out of range and the return code is not MP_ERRNO_NOIN");
+
+}
+END_TEST
+
+START_TEST(mpset_set)
+{
+#line 2647
+    int mpid = MP_DEF_MP_ID;
+    int rc = 0;
+
+#if MP_THREAD_SAFE == 1
+    mp_arr[mpid].thread_id = MP_CURR_THREAD;
+#endif
+
+    rc = mpset(mpid);
+
+    ck_assert_msg(
+        mp_cur_mpid == mpid   
+        , "The current mpid is not set correctly, it should be %d but it is %d", mpid, mp_cur_mpid);
+
+    ck_assert_msg(
+        rc == MP_ERRNO_SUCCESS
+        , "The return code should be MP_ERRNO_SUCCESS but it is %d", rc);
+    
+}
+END_TEST
+
+START_TEST(mpset_def_not_init)
+{
+#line 2665
+    int rc = 0;
+    mp def = mp_arr[MP_DEF_MP_ID];
+
+    /* The default memory pool was not used yet, so no thread owns it */
+    mp_arr[MP_DEF_MP_ID].init = 'N';
+#if MP_THREAD_SAFE == 1
+    memset(&mp_arr[MP_DEF_MP_ID].thread_id, 0xff, sizeof(mp_arr[MP_DEF_MP_ID].thread_id));
+#endif
+    mp_cur_mpid = MP_NO_MP_ID;
+
+    rc = mpset(MP_DEF_MP_ID);
+    mp_arr[MP_DEF_MP_ID] = def;
+
+    ck_assert_msg(
+        rc == MP_ERRNO_SUCCESS && mp_cur_mpid == MP_DEF_MP_ID
+        , "The default memory pool not used yet could not be set <%d>", rc);
+
+}
+END_TEST
+
+START_TEST(mpget_get)
+{
+#line 2683
+    int mpid = MP_DEF_MP_ID;
+
+    mp_cur_mpid = mpid;
+
+    ck_assert_msg(
+        mpid == mpget()
+        , "The current mpid is not retrieved correctly, it should be %d but it is %d", mpid, mpget());
+
+}
+END_TEST
+
+START_TEST(mpdel_mpid_not_in_range)
+{
+#line 2692
+    int rc = 0;
+    int mpid = 0;
+
+    mpid = -1;
+    rc = mpdel(mpid);
+
+    ck_assert_msg(
+        mperrno == MP_ERRNO_MPID
+        , "The mpid is out of range and the mperrno is not MP_ERRNO_MPID");
+
+    ck_assert_msg(
+        rc == MP_ERRNO_MPID
+        , "The mpid is out of range and the return code is not MP_ERRNO_MPID");
+
+    mpid = MP_MAX_MP_ID;
+    rc = mpdel(mpid);
+
+    ck_assert_msg(
+        mperrno == MP_ERRNO_MPID
+        , "The mpid is out of range and the mperrno is not MP_ERRNO_MPID");
+
+    ck_assert_msg(
+        rc == MP_ERRNO_MPID
+        , "The mpid is out of range and the return code is not MP_ERRNO_MPID");
+
+
+}
+END_TEST
+
+START_TEST(mpdel_delete_mem_block)
+{
+#line 2719
+    int rc = 0;
+    int mpid = 0;
+    char *str = NULL;
+    int strlen = 64;
+    unsigned char *mem_start = NULL;
+    unsigned char *mem_end = NULL;
+    size_t tot_phy_mem = 0;
+
+    /* Get and set a new Memory pool */
+    mpid = mpnew("mpdel_mpid_not_in_range");
+
+    if (mperrno != MP_ERRNO_SUCCESS)
+    {
+        ck_abort_msg("Error creating new memory pool");
+    }
+
+    rc = mpset(mpid);
+
+    if (mperrno != MP_ERRNO_SUCCESS || rc != MP_ERRNO_SUCCESS)
+    {
+        ck_abort_msg("Error setting the new memory pool");
+    }
+
+    /* Allocate a chunk of that memory pool */
+    str = (char*)mpmalloc(sizeof(char) * strlen);
+
+    if (mperrno != MP_ERRNO_SUCCESS || str == NULL)
+    {
+        ck_abort_msg("Error allocating memory");
+    }
+
+    strcpy(str, "mpdel_mpid_not_in_range");
+
+    if (mp_arr[mpid].blocks == NULL)
+    {
+        ck_abort_msg("memory was created successfully with right function but actualy memory block is NULL");
+    }
+    
+    /* Check that the allocated chunk is between the ranges of the memory block */
+    mem_start = mp_arr[mpid].tail_block->block;
+    mem_end = mp_arr[mpid].tail_block->block + mp_arr[mpid].tail_block->size;
+
+    if ((uintptr_t)str < (uintptr_t)mem_start || (uintptr_t)str > (uintptr_t)mem_end)
+    {
+        ck_abort_msg("The memory allocated is not in the range of the memory block");
+    }
+
+    /* Delete the memory block */
+    tot_phy_mem = mp_tot_phy_mem;
+    tot_phy_mem -= mp_arr[mpid].tail_block->size;
+    rc = mpdel(mpid);
+
+    /* Check that the memory block is empty */
+    ck_assert_msg(
+        mp_arr[mpid].blocks == NULL
+        , "Memory pool should be deleted but the array of blocks is not NULL");
+
+    ck_assert_msg(
+        mp_arr[mpid].tail_block == NULL
+        , "Memory pool should be deleted but the tail_block is not NULL");
+
+    /* Check that the total physical memory varible is set correctly */
+    ck_assert_msg(
+        mp_tot_phy_mem == tot_phy_mem
+        , "The total physical memory is not zero after deleting all memory pools");
+
+    /* Check the return code */
+    ck_assert_msg(
+        rc == MP_ERRNO_SUCCESS
+        , "Return code is not MP_ERRNO_SUCCESS");
+
+}
+END_TEST
+
+START_TEST(mpdel_thread)
+{
+#line 2791
+#if MP_THREAD_SAFE == 1
+    pthread_t th1;
+    args_t args;
+    int mpid = mpnew(NULL);
+
+    memset(&args, 0x00, sizeof(args));
+    args.mpid = mpid;
+    args.fn = &mpdel;
+
+    if (pthread_create(&th1, NULL, &mp_thread_fn, &args) != 0)
+    {
+        ck_abort_msg("Error creating thread");
+    }
+
+    pthread_join(th1, NULL);
+
+    ck_assert_msg(
+        args.rc == MP_ERRNO_THRD
+        , "Memory pool ID %d used by another thread and no error <%d>", mpid, args.rc);
+
+    ck_assert_msg(
+        args.mperrno == MP_ERRNO_THRD
+        , "Memory pool ID %d used by another thread and mperrno is not MP_ERRNO_THRD but <%d>", args.mperrno);
+
+#endif /* MP_THREAD_SAFE */
+
+}
+END_TEST
+
+START_TEST(mpdel_all_delete_mem_block)
+{
+#line 2818
+    int rc = 0;
+    int mpid = 0;
+    int mpid2 = 0;
+    char *str = NULL;
+    int strlen = 64;
+    unsigned char *mem_start = NULL;
+    unsigned char *mem_end = NULL;
+
+    /* Get and set a new Memory pool */
+    mpid = mpnew("mpdel_all_mpid_not_in_range");
+    mpid2 = mpid;
+
+    if (mperrno != MP_ERRNO_SUCCESS)
+    {
+        ck_abort_msg("Error creating new memory pool");
+    }
+
+    rc = mpset(mpid);
+
+    if (mperrno != MP_ERRNO_SUCCESS || rc != MP_ERRNO_SUCCESS)
+    {
+        ck_abort_msg("Error setting the new memory pool");
+    }
+
+    /* Allocate a chunk of that memory pool */
+    str = (char*)mpmalloc(sizeof(char) * strlen);
+
+    if (mperrno != MP_ERRNO_SUCCESS || str == NULL)
+    {
+        ck_abort_msg("Error allocating memory");
+    }
+
+    strcpy(str, "mpdel_all_mpid_not_in_range");
+
+    if (mp_arr[mpid].blocks == NULL)
+    {
+        ck_abort_msg("memory was created successfully with right function but actualy memory block is NULL");
+    }
+    
+    /* Check that the allocated chunk is between the ranges of the memory block */
+    mem_start = mp_arr[mpid].tail_block->block;
+    mem_end = mp_arr[mpid].tail_block->block + mp_arr[mpid].tail_block->size;
+
+    if ((uintptr_t)str < (uintptr_t)mem_start || (uintptr_t)str > (uintptr_t)mem_end)
+    {
+        ck_abort_msg("The memory allocated is not in the range of the memory block");
+    }
+
+
+
+    /* Now set the Default memory pool */
+    mpid = MP_DEF_MP_ID;
+#if MP_THREAD_SAFE == 1
+    mp_arr[mpid].thread_id = MP_CURR_THREAD;
+#endif
+    rc = mpset(MP_DEF_MP_ID);
+
+    if (mperrno != MP_ERRNO_SUCCESS || rc != MP_ERRNO_SUCCESS)
+    {
+        ck_abort_msg("Error setting the new memory pool");
+    }
+
+    /* Allocate a chunk of that memory pool */
+    str = (char*)mpmalloc(sizeof(char) * strlen);
+
+    if (mperrno != MP_ERRNO_SUCCESS || str == NULL)
+    {
+        ck_abort_msg("Error allocating memory");
+    }
+
+    strcpy(str, "mpdel_all_mpid_not_in_range");
+
+    if (mp_arr[mpid].blocks == NULL)
+    {
+        ck_abort_msg("memory was created successfully with right function but actualy memory block is NULL");
+    }
+    
+    /* Check that the allocated chunk is between the ranges of the memory block */
+    mem_start = mp_arr[mpid].tail_block->block;
+    mem_end = mp_arr[mpid].tail_block->block + mp_arr[mpid].tail_block->size;
+
+    if ((uintptr_t)str < (uintptr_t)mem_start || (uintptr_t)str > (uintptr_t)mem_end)
+    {
+        ck_abort_msg("The memory allocated is not in the range of the memory block");
+    }
 
-    mp_prev_mpid = MP_NO_MP_ID;
+
+
+    /* Delete all memory blocks */
+    rc = mpdel_all();
+
+    /* Check that blocks are empty */
+    mpid = mpid2;
+    ck_assert_msg(
+        mp_arr[mpid].blocks == NULL
+        , "Memory pool %d should be deleted but the array of blocks is not NULL", mpid);
+
+    ck_assert_msg(
+        mp_arr[mpid].tail_block == NULL
+        , "Memory pool %d should be deleted but the tail_block is not NULL", mpid);
+
+    mpid = MP_DEF_MP_ID;
+    ck_assert_msg(
+        mp_arr[mpid].blocks == NULL
+        , "Memory pool %d should be deleted but the array of blocks is not NULL", mpid);
+
+    ck_assert_msg(
+        mp_arr[mpid].tail_block == NULL
+        , "Memory pool %d should be deleted but the tail_block is not NULL", mpid);
+
+    /* Check that the total physical memory varible is set to zero */
+    ck_assert_msg(
+        mp_tot_phy_mem == 0
+        , "The total physical memory is not zero after deleting all memory pools");
+
+    /* Check the return code */
+    ck_assert_msg(
+        rc == MP_ERRNO_SUCCESS
+        , "Return code is not MP_ERRNO_SUCCESS");
+
+
+}
+END_TEST
+
+START_TEST(mpclr_mpid_not_in_range)
+{
+#line 2940
+    int rc = 0;
+    int mpid = 0;
 
     mpid = -1;
-    rc = mppush(mpid);
+    rc = mpclr(mpid);
 
     ck_assert_msg(
         mperrno == MP_ERRNO_MPID
@@ -1368,7 +3411,7 @@ START_TEST(mppush_mpid_not_in_range)
         , "The mpid is out of range and the return code is not MP_ERRNO_MPID");
 
     mpid = MP_MAX_MP_ID;
-    rc = mppush(mpid);
+    rc = mpdel(mpid);
 
     ck_assert_msg(
         mperrno == MP_ERRNO_MPID
@@ -1378,746 +3421,1243 @@ START_TEST(mppush_mpid_not_in_range)
         rc == MP_ERRNO_MPID
         , "The mpid is out of range and the return code is not MP_ERRNO_MPID");
 
-
 }
 END_TEST
 
-START_TEST(mppush_mpid_not_init)
+START_TEST(mpclr_clear_mem_block)
 {
-#line 1184
-    int mpid = -1;
-    int i = 0;
+#line 2966
     int rc = 0;
+    int mpid = 0;
+    char *str = NULL;
+    int strlen = 64;
+    unsigned char *mem_start = NULL;
+    unsigned char *mem_end = NULL;
+    size_t used = 0;
 
-    mp_prev_mpid = MP_NO_MP_ID;
+    /* Get and set a new Memory pool */
+    mpid = mpnew("mpdel_mpid_not_in_range");
 
-    for(i = 0; i < MP_MAX_MP_ID; i++)
+    if (mperrno != MP_ERRNO_SUCCESS)
     {
-        if (mp_arr[i].init != 'Y' && i != MP_DEF_MP_ID)
-        {
-            mpid = i;
-            break;
-        }
+        ck_abort_msg("Error creating new memory pool");
     }
 
-    if (mpid == -1)
+    rc = mpset(mpid);
+
+    if (mperrno != MP_ERRNO_SUCCESS || rc != MP_ERRNO_SUCCESS)
     {
-        ck_abort_msg("Not found any un-initialized Memory Pool. Rewrite test case");
+        ck_abort_msg("Error setting the new memory pool");
     }
 
-    rc = mppush(mpid);
-     
+    /* Allocate a chunk of that memory pool */
+    str = (char*)mpmalloc(sizeof(char) * strlen);
+
+    if (mperrno != MP_ERRNO_SUCCESS || str == NULL)
+    {
+        ck_abort_msg("Error allocating memory");
+    }
+
+    strcpy(str, "mpdel_mpid_not_in_range");
+
+    if (mp_arr[mpid].blocks == NULL)
+    {
+        ck_abort_msg("memory was created successfully with right function but actualy memory block is NULL");
+    }
+    
+    /* Check that the allocated chunk is between the ranges of the memory block */
+    mem_start = mp_arr[mpid].tail_block->block;
+    mem_end = mp_arr[mpid].tail_block->block + mp_arr[mpid].tail_block->size;
+
+    if ((uintptr_t)str < (uintptr_t)mem_start || (uintptr_t)str > (uintptr_t)mem_end)
+    {
+        ck_abort_msg("The memory allocated is not in the range of the memory block");
+    }
+
+    /* Save the current used after usage */
+    used = mp_arr[mpid].tail_block->used;
+    if (used == 0)
+    {
+        ck_abort_msg("The given memory pool was used but its size is 0");
+    }
+
+    /* Clear the memory block */
+    rc = mpclr(mpid);
+
+    /* Check that the memory block is cleared */
     ck_assert_msg(
-        mperrno == MP_ERRNO_NOIN
-        , "The mpid is out of range and the mperrno is not MP_ERRNO_NOIN");
+        mp_arr[mpid].tail_block->used == 0
+        , "Memory pool should be deleted but the head_block is not NULL");
+
+}
+END_TEST
+
+START_TEST(mpclr_thread)
+{
+#line 3029
+#if MP_THREAD_SAFE == 1
+    pthread_t th1;
+    args_t args;
+    int mpid = mpnew(NULL);
+
+    memset(&args, 0x00, sizeof(args));
+    args.mpid = mpid;
+    args.fn = &mpclr;
+
+    if (pthread_create(&th1, NULL, &mp_thread_fn, &args) != 0)
+    {
+        ck_abort_msg("Error creating thread");
+    }
+
+    pthread_join(th1, NULL);
 
     ck_assert_msg(
-        rc == MP_ERRNO_NOIN
-        , "The mpid is out of range and the return code is not MP_ERRNO_NOIN");
+        args.rc == MP_ERRNO_THRD
+        , "Memory pool ID %d used by another thread and no error <%d>", mpid, args.rc);
+
+    ck_assert_msg(
+        args.mperrno == MP_ERRNO_THRD
+        , "Memory pool ID %d used by another thread and mperrno is not MP_ERRNO_THRD but <%d>", args.mperrno);
+
+#endif /* MP_THREAD_SAFE */
 
-    
 }
 END_TEST
 
-START_TEST(mppush_prev_mpid)
+START_TEST(mpset_clr_pars)
 {
-#line 1216
-    int mpid = -1;
-    int mpid2 = -1;
-    int i = 0;
-    int rc = 0;
+#line 3056
+    int mpid = mpnew("clr");
 
-    mp_prev_mpid = MP_NO_MP_ID;
+    ck_assert_msg(
+        mpset_clr(MP_MAX_MP_ID, MP_CLR_ZERO) == MP_ERRNO_MPID && mpset_clr(MP_MAX_MP_ID -1, MP_CLR_ZERO) == MP_ERRNO_NOIN &&
+        mpset_clr(mpid, 3) == MP_ERRNO_PARM && mpset_clr(mpid, -1) == MP_ERRNO_PARM
+        , "Wrong parameters not rejected");
 
-    /* Getting the Memory Pool ID to use as current one */
-    for(i = 1; i < MP_MAX_MP_ID; i++)
+    ck_assert_msg(
+        mp_arr[mpid].clr_policy == MP_CLR_RESET && mpset_clr(mpid, MP_CLR_DISCARD) == MP_ERRNO_SUCCESS &&
+        mp_arr[mpid].clr_policy == MP_CLR_DISCARD
+        , "Clear policy not set");
+
+    mpdel(mpid);
+
+}
+END_TEST
+
+START_TEST(mpclr_policies)
+{
+#line 3071
+    int policy[3] = {MP_CLR_RESET, MP_CLR_ZERO, MP_CLR_DISCARD};
+    size_t sizes[2] = {1000, 0};
+    uchar *chunk = NULL;
+    mpblock *curr_block = NULL;
+    int mpid = MP_NO_MP_ID;
+    int p = 0;
+    int s = 0;
+    size_t i = 0;
+
+    /* A small chunk, and a block full of data discarded by pages */
+    sizes[1] = mpget_blksz();
+    for (p = 0; p < 3; p++)
     {
-        if (mp_arr[i].init != 'Y')
+        for (s = 0; s < 2; s++)
         {
-            mp_arr[i].init = 'Y';
-            mpid = i;
-            break;
+            mpid = mpnew("clr");
+            mpset_clr(mpid, policy[p]);
+            chunk = (uchar *)mpmalloc_mpid(sizes[s], mpid);
+            memset(chunk, 0xff, sizes[s]);
+            curr_block = mp_arr[mpid].tail_block;
+
+            mpclr(mpid);
+            for (i = 0; i < sizes[s] && chunk[i] == (policy[p] == MP_CLR_RESET ? 0xff : 0); i++)
+                ;
+            ck_assert_msg(
+                i == sizes[s] && curr_block->used == 0 && (policy[p] == MP_CLR_RESET || curr_block->zero == 0)
+                , "Policy %d on <%lu> bytes: byte %lu not cleared as expected", policy[p], (unsigned long)sizes[s], (unsigned long)i);
+
+            /* The memory is zero again for mpcalloc() */
+            chunk = (uchar *)mpcalloc_mpid(1, sizes[s], mpid);
+            for (i = 0; i < sizes[s] && chunk[i] == 0; i++)
+                ;
+            ck_assert_msg(
+                i == sizes[s]
+                , "Policy %d on <%lu> bytes: memory of mpcalloc() not zero", policy[p], (unsigned long)sizes[s]);
+
+            mpdel(mpid);
         }
     }
 
-    if (mpid == -1)
-    {
-        ck_abort_msg("Not found any initialized Memory Pool. Rewrite test case");
-    }
+}
+END_TEST
 
-    /* Getting the Memory Pool ID to push */
-    for(i = mpid + 1; i < MP_MAX_MP_ID; i++)
+START_TEST(mptrim_pars)
+{
+#line 3112
+    ck_assert_msg(
+        mptrim(MP_MAX_MP_ID, 0) == MP_ERRNO_MPID && mptrim(-1, 0) == MP_ERRNO_MPID && mptrim(MP_MAX_MP_ID -1, 0) == MP_ERRNO_NOIN
+        , "Wrong memory pool ID not rejected");
+
+    ck_assert_msg(
+        mpset_trim(MP_MAX_MP_ID, 0) == MP_ERRNO_MPID && mpset_trim(MP_MAX_MP_ID -1, 0) == MP_ERRNO_NOIN
+        , "Wrong memory pool ID not rejected by mpset_trim()");
+
+}
+END_TEST
+
+START_TEST(mptrim_blocks)
+{
+#line 3121
+    size_t tot_phy_mem = 0;
+    mpblock *tail_block = NULL;
+    char *chunk = NULL;
+    char *freed = NULL;
+    int mpid = MP_NO_MP_ID;
+    int i = 0;
+
+    mpid = mpnew("trim");
+    for (i = 0; i < 6; i++)
     {
-        if (mp_arr[i].init != 'Y')
+        if ((chunk = (char *)mpmalloc_mpid(mpget_blksz(), mpid)) == NULL)
         {
-            mp_arr[i].init = 'Y';
-            mpid2 = i;
-            break;
+            ck_abort_msg("Error allocating memory: %s", mpstrerror());
         }
+        memset(chunk, 0xff, mpget_blksz());
+        freed = i == 2 ? chunk : freed;
     }
 
-    if (mpid2 == -1)
+    /* Blocks holding chunks are kept */
+    ck_assert_msg(
+        mptrim(mpid, 0) == MP_ERRNO_SUCCESS && mp_arr[mpid].block_cnt == 6
+        , "Blocks in use given back");
+
+    /* Empty blocks beyond two are given back, the tail block is kept */
+    mpclr(mpid);
+    tail_block = mp_arr[mpid].tail_block;
+    tot_phy_mem = mp_tot_phy_mem;
+    ck_assert_msg(
+        mptrim(mpid, tail_block->size * 2) == MP_ERRNO_SUCCESS && mp_arr[mpid].block_cnt == 2 &&
+        mp_arr[mpid].tail_block == tail_block && mp_arr[mpid].blocks[1] == tail_block &&
+        mp_tot_phy_mem == tot_phy_mem - tail_block->size * 4 && mpowner(freed) < 0
+        , "Empty blocks not trimmed to the memory to keep: <%d> blocks", mp_arr[mpid].block_cnt);
+
+    ck_assert_msg(
+        (chunk = (char *)mpmalloc_mpid(100, mpid)) != NULL && mpowner(chunk) == mpid && (uchar *)chunk == tail_block->block
+        , "The tail block kept is not used");
+
+    /* Nothing kept */
+    mpclr(mpid);
+    ck_assert_msg(
+        mptrim(mpid, 0) == MP_ERRNO_SUCCESS && mp_arr[mpid].block_cnt == 0 && mp_arr[mpid].tail_block == NULL &&
+        (chunk = (char *)mpmalloc_mpid(100, mpid)) != NULL && mpowner(chunk) == mpid
+        , "The memory pool cannot be used after trimming all its blocks");
+
+    mpdel(mpid);
+
+}
+END_TEST
+
+START_TEST(mptrim_rcy)
+{
+#line 3168
+    size_t tot_phy_mem = 0;
+    size_t size = 0;
+    int mag_cnt = 0;
+    int mpid = MP_NO_MP_ID;
+    int i = 0;
+
+    /* Trimmed blocks are given back to the heap, not kept by the recycler */
+    mpset_rcysz(mprcy_unit() * MP_RCY_MAG_SZ);
+    mpid = mpnew("trim");
+    for (i = 0; i < 4; i++)
     {
-        ck_abort_msg("Not found any initialized Memory Pool. Rewrite test case");
+        mpmalloc_mpid(mpget_blksz(), mpid);
     }
+    mpclr(mpid);
+    size = mp_arr[mpid].tail_block->size;
+    tot_phy_mem = mp_tot_phy_mem;
+    mag_cnt = mp_rcy_mag_cnt;
+    ck_assert_msg(
+        mptrim(mpid, 0) == MP_ERRNO_SUCCESS && mp_arr[mpid].block_cnt == 0 &&
+        mp_tot_phy_mem == tot_phy_mem - size * 4 && mp_rcy_mag_cnt == mag_cnt
+        , "Trimmed blocks kept by the recycler <%lu> <%d>", (unsigned long)mp_tot_phy_mem, mp_rcy_mag_cnt);
 
-    mp_cur_mpid = mpid;
+    mpdel(mpid);
+    mpset_rcysz(0);
 
-    rc = mppush(mpid2);
-     
+}
+END_TEST
+
+START_TEST(mpset_trim_clr)
+{
+#line 3194
+    int mpid = MP_NO_MP_ID;
+    int i = 0;
+
+    mpid = mpnew("trim");
     ck_assert_msg(
-        mp_cur_mpid == mpid2   
-        , "The current mpid is not set correctly, it should be %d but it is %d", mpid2, mp_cur_mpid);
+        mpset_trim(mpid, 0) == MP_ERRNO_SUCCESS && mp_arr[mpid].trim_clr && mp_arr[mpid].trim_keep == 0
+        , "Trim policy not set");
 
+    for (i = 0; i < 4; i++)
+    {
+        mpmalloc_mpid(mpget_blksz(), mpid);
+    }
+    mpset_trim(mpid, mp_arr[mpid].tail_block->size);
+    mpclr(mpid);
     ck_assert_msg(
-        mp_prev_mpid == mpid   
-        , "The previous mpid is not set correctly, it should be %d but it is %d", mpid, mp_prev_mpid);
+        mp_arr[mpid].block_cnt == 1 && mp_arr[mpid].tail_block == mp_arr[mpid].blocks[0]
+        , "mpclr() does not trim the memory pool: <%d> blocks", mp_arr[mpid].block_cnt);
 
+    for (i = 0; i < 4; i++)
+    {
+        mpmalloc_mpid(mpget_blksz(), mpid);
+    }
+    mpset_trim(mpid, MP_NO_TRIM);
+    mpclr(mpid);
     ck_assert_msg(
-        rc == MP_ERRNO_SUCCESS
-        , "The return code should be MP_ERRNO_SUCCESS but it is %d", rc);
+        !mp_arr[mpid].trim_clr && mp_arr[mpid].block_cnt == 4
+        , "mpclr() trims with the policy off: <%d> blocks", mp_arr[mpid].block_cnt);
+
+    mpdel(mpid);
 
 }
 END_TEST
 
-START_TEST(mppop_mpid_not_in_range)
+START_TEST(mptrim_vm)
 {
-#line 1272
-    int rc = 0;
+#line 3225
+    size_t pgsz = mp_vm_pgsz();
+    size_t tot_phy_mem = 0;
+    char *chunk = NULL;
+    int mpid = MP_NO_MP_ID;
 
-    mp_prev_mpid = -1;
-    rc = mppop();
+    mpid = mpnew_vm(NULL, 0);
+    chunk = (char *)mpmalloc_mpid(4 * 1024 * 1024, mpid);
+    memset(chunk, 0xff, 4 * 1024 * 1024);
 
+    /* The committed pages of the chunk stay */
     ck_assert_msg(
-        mperrno == MP_ERRNO_NOPP
-        , "The mp_prev_mpid is out of range and the mperrno is not MP_ERRNO_NOPP");
+        mptrim(mpid, 0) == MP_ERRNO_SUCCESS && mp_arr[mpid].vm_commit >= MP_BLK_HDR_SZ + 4 * 1024 * 1024
+        , "Pages holding a chunk decommitted");
 
+    /* Shrunk in place, the pages beyond it are given back */
+    tot_phy_mem = mp_tot_phy_mem - mp_arr[mpid].vm_commit;
+    chunk = (char *)mprealloc_mpid(chunk, 100, mpid);
     ck_assert_msg(
-        rc == MP_ERRNO_NOPP
-        , "The mpid is out of range and the return code is not MP_ERRNO_NOPP");
+        mptrim(mpid, 0) == MP_ERRNO_SUCCESS && mp_arr[mpid].vm_commit == pgsz &&
+        mp_tot_phy_mem == tot_phy_mem + pgsz && chunk[99] == (char)0xff
+        , "Pages beyond the chunk not decommitted <%lu>", (unsigned long)mp_arr[mpid].vm_commit);
 
-    mp_prev_mpid = MP_MAX_MP_ID;
-    rc = mppop();
+    mpdel(mpid);
+
+}
+END_TEST
+
+START_TEST(mpreserve_pars)
+{
+#line 3250
+    int mpid = MP_NO_MP_ID;
 
+    mpid = mpnew("reserve");
     ck_assert_msg(
-        mperrno == MP_ERRNO_NOPP
-        , "The mp_prev_mpid is out of range and the mperrno is not MP_ERRNO_NOPP");
+        mpreserve(MP_MAX_MP_ID, 100, 0) == MP_ERRNO_MPID && mpreserve(MP_MAX_MP_ID -1, 100, 0) == MP_ERRNO_NOIN &&
+        mpreserve(mpid, 100, 0x10) == MP_ERRNO_PARM && mpreserve(mpid, 0, 0) == MP_ERRNO_SUCCESS &&
+        mp_arr[mpid].block_cnt == 0
+        , "Wrong parameters accepted");
+
+    mpdel(mpid);
+
+}
+END_TEST
 
+START_TEST(mpreserve_alncls)
+{
+#line 3262
+    int block_cnt = 0;
+    int mpid = MP_NO_MP_ID;
+
+    /* The empty block of an alignment class is not reserved memory */
+    mpid = mpnew("reserve");
+    if (mpadd_alncls(mpid, 256) != MP_ERRNO_SUCCESS ||
+            mpmalloc_mpid(100, mpid) == NULL || mpmemalign_mpid(256, 100, mpid) == NULL)
+    {
+        ck_abort_msg("Error allocating memory: %s", mpstrerror());
+    }
+    mpclr(mpid);
     ck_assert_msg(
-        rc == MP_ERRNO_NOPP
-        , "The mpid is out of range and the return code is not MP_ERRNO_NOPP");
+        mpreserve(mpid, mpget_blksz() * 2, 0) == MP_ERRNO_SUCCESS && mp_arr[mpid].block_cnt == 3
+        , "Block of an alignment class counted as reserved: <%d> blocks", mp_arr[mpid].block_cnt);
+
+    block_cnt = mp_arr[mpid].block_cnt;
+    ck_assert_msg(
+        mpmalloc_mpid(mpget_blksz(), mpid) != NULL && mpmalloc_mpid(mpget_blksz(), mpid) != NULL &&
+        mp_arr[mpid].block_cnt == block_cnt
+        , "Blocks added with memory reserved: <%d> blocks", mp_arr[mpid].block_cnt);
 
+    mpdel(mpid);
 
 }
 END_TEST
 
-START_TEST(mppop_prev_mpid)
+START_TEST(mpreserve_blocks)
 {
-#line 1298
-    int mpid = -1;
+#line 3286
+    size_t tot_phy_mem = 0;
+    char *chunk = NULL;
+    int block_cnt = 0;
+    int mpid = MP_NO_MP_ID;
     int i = 0;
-    int rc = 0;
 
-    mp_prev_mpid = MP_NO_MP_ID;
+    mpid = mpnew("reserve");
+    mpmalloc_mpid(100, mpid);
 
-    /* Getting the Memory Pool ID to pop */
-    for(i = 1; i < MP_MAX_MP_ID; i++)
+    /* Empty blocks added, the tail block stays */
+    ck_assert_msg(
+        mpreserve(mpid, mpget_blksz() * 3, MP_RSV_PREFAULT) == MP_ERRNO_SUCCESS && mp_arr[mpid].block_cnt == 4 &&
+        mp_arr[mpid].tail_block == mp_arr[mpid].blocks[0] && mp_arr[mpid].blocks[3]->used == 0
+        , "Blocks not reserved: <%d> blocks", mp_arr[mpid].block_cnt);
+
+    /* Already reserved */
+    tot_phy_mem = mp_tot_phy_mem;
+    ck_assert_msg(
+        mpreserve(mpid, mpget_blksz() * 2, 0) == MP_ERRNO_SUCCESS && mp_arr[mpid].block_cnt == 4 &&
+        mp_tot_phy_mem == tot_phy_mem
+        , "Memory reserved twice");
+
+    /* The allocations take the reserved blocks */
+    for (i = 0; i < 3; i++)
     {
-        if (mp_arr[i].init != 'Y')
-        {
-            mp_arr[i].init = 'Y';
-            mpid = i;
-            break;
-        }
+        chunk = (char *)mpmalloc_mpid(mpget_blksz(), mpid);
+        memset(chunk, 0xff, mpget_blksz());
+        ck_assert_msg(
+            mpowner(chunk) == mpid && (uchar *)chunk == mp_arr[mpid].blocks[i +1]->block
+            , "Reserved block <%d> not used", i +1);
     }
+    ck_assert_msg(
+        mp_arr[mpid].block_cnt == 4 && mp_tot_phy_mem == tot_phy_mem
+        , "Blocks added with memory reserved");
 
-    if (mpid == MP_NO_MP_ID)
+    /* The same blocks again after clearing */
+    block_cnt = mp_arr[mpid].block_cnt;
+    for (i = 0; i < 10; i++)
     {
-        ck_abort_msg("Not found any initialized Memory Pool. Rewrite test case");
+        mpclr(mpid);
+        mpmalloc_mpid(mpget_blksz(), mpid);
+        mpmalloc_mpid(mpget_blksz(), mpid);
+        chunk = (char *)mpcalloc_mpid(1, mpget_blksz(), mpid);
     }
+    ck_assert_msg(
+        mp_arr[mpid].block_cnt == block_cnt && mp_tot_phy_mem == tot_phy_mem && chunk[0] == 0 &&
+        chunk[mpget_blksz() -1] == 0
+        , "Memory pool grows on each clear: <%d> blocks", mp_arr[mpid].block_cnt);
 
-    mp_cur_mpid = MP_NO_MP_ID;
-    mp_prev_mpid = mpid;
+    mpdel(mpid);
 
-    rc = mppop();
-     
-    ck_assert_msg(
-        mp_cur_mpid == mpid
-        , "The current mpid is not set correctly, it should be %d but it is %d", mpid, mp_cur_mpid);
+}
+END_TEST
 
-    ck_assert_msg(
-        mp_prev_mpid == MP_NO_MP_ID   
-        , "The previous mpid is not set correctly, it should be %d but it is %d", MP_NO_MP_ID, mp_prev_mpid);
+START_TEST(mpreserve_vm)
+{
+#line 3338
+    char *chunk = NULL;
+    int mpid = MP_NO_MP_ID;
 
+    mpid = mpnew_vm(NULL, 8 * 1024 * 1024);
+    chunk = (char *)mpmalloc_mpid(100, mpid);
     ck_assert_msg(
-        rc == MP_ERRNO_SUCCESS
-        , "The return code should be MP_ERRNO_SUCCESS but it is %d", rc);
+        mpreserve(mpid, 1024 * 1024, MP_RSV_PREFAULT) == MP_ERRNO_SUCCESS &&
+        mp_arr[mpid].vm_commit >= MP_BLK_HDR_SZ + 100 + 1024 * 1024 &&
+        mpreserve(mpid, 16 * 1024 * 1024, 0) == MP_ERRNO_NOMM && mpowner(chunk) == mpid
+        , "Pages not committed <%lu>", (unsigned long)mp_arr[mpid].vm_commit);
+
+    mpdel(mpid);
 
 }
 END_TEST
 
-START_TEST(mpset_mpid_not_in_range)
+START_TEST(mpset_memlim_set)
 {
-#line 1338
-    int rc = 0;
-    int mpid = 0;
+#line 3352
+    size_t memlim = 100000;
 
-    mpid = -1;
-    rc = mpset(mpid);
+    mpset_memlim(memlim);
 
     ck_assert_msg(
-        mperrno == MP_ERRNO_MPID
-        , "The mpid is out of range and the mperrno is not MP_ERRNO_MPID");
+        mp_mem_limit == memlim
+        , "Memory limit not set correctly");
 
-    ck_assert_msg(
-        rc == MP_ERRNO_MPID
-        , "The mpid is out of range and the return code is not MP_ERRNO_MPID");
+}
+END_TEST
 
-    mpid = MP_MAX_MP_ID;
-    rc = mpset(mpid);
+START_TEST(mpget_memlim_get)
+{
+#line 3361
+    size_t memlim = 100000;
 
-    ck_assert_msg(
-        mperrno == MP_ERRNO_MPID
-        , "The mpid is out of range and the mperrno is not MP_ERRNO_MPID");
+    mpset_memlim(memlim);
 
     ck_assert_msg(
-        rc == MP_ERRNO_MPID
-        , "The mpid is out of range and the return code is not MP_ERRNO_MPID");
+        mpget_memlim() == memlim
+        , "Memory limit not retieved correctly");
 
 }
 END_TEST
 
-START_TEST(mpset_mpid_not_init)
+START_TEST(mpset_blksz_set)
 {
-#line 1364
-    int mpid = -1;
-    int i = 0;
-    int rc = 0;
+#line 3370
+    size_t blksz = 100000;
 
-    mp_prev_mpid = MP_NO_MP_ID;
+    mpset_blksz(blksz);
 
-    for(i = 0; i < MP_MAX_MP_ID; i++)
-    {
-        if (mp_arr[i].init != 'Y' && i != MP_DEF_MP_ID)
-        {
-            mpid = i;
-            break;
-        }
-    }
+    ck_assert_msg(
+        mp_blk_sz == blksz
+        , "Block size not set correctly");
 
-    if (mpid == -1)
-    {
-        ck_abort_msg("Not found any un-initialized Memory Pool. Rewrite test case");
-    }
+}
+END_TEST
 
-    rc = mpset(mpid);
-     
-    ck_assert_msg(
-        mperrno == MP_ERRNO_NOIN
-        , "The mpid is out of range and the mperrno is not MP_ERRNO_NOIN");
+START_TEST(mpget_blksz_get)
+{
+#line 3379
+    size_t blksz = 100000;
+
+    mpset_blksz(blksz);
 
     ck_assert_msg(
-        rc == MP_ERRNO_NOIN
-        , "The mpid is out of range and the return code is not MP_ERRNO_NOIN");
+        mpget_blksz() == blksz
+        , "Block size not retieved correctly");
 
 }
 END_TEST
 
-START_TEST(mpset_set)
+START_TEST(mpset_mapsz_set)
 {
-#line 1395
-    int mpid = MP_DEF_MP_ID;
-    int rc = 0;
-
-#if MP_THREAD_SAFE == 1
-    mp_arr[mpid].thread_id = MP_CURR_THREAD;
-#endif
+#line 3388
+    size_t mapsz = 2000000;
 
-    rc = mpset(mpid);
+    mpset_mapsz(mapsz);
 
     ck_assert_msg(
-        mp_cur_mpid == mpid   
-        , "The current mpid is not set correctly, it should be %d but it is %d", mpid, mp_cur_mpid);
+        mp_map_sz == mapsz
+        , "Size of chunks with own mapping not set correctly");
 
-    ck_assert_msg(
-        rc == MP_ERRNO_SUCCESS
-        , "The return code should be MP_ERRNO_SUCCESS but it is %d", rc);
-    
 }
 END_TEST
 
-START_TEST(mpget_get)
+START_TEST(mpget_mapsz_get)
 {
-#line 1413
-    int mpid = MP_DEF_MP_ID;
+#line 3397
+    size_t mapsz = 2000000;
 
-    mp_cur_mpid = mpid;
+    mpset_mapsz(mapsz);
 
     ck_assert_msg(
-        mpid == mpget()
-        , "The current mpid is not retrieved correctly, it should be %d but it is %d", mpid, mpget());
+        mpget_mapsz() == mapsz
+        , "Size of chunks with own mapping not retieved correctly");
 
 }
 END_TEST
 
-START_TEST(mpdel_mpid_not_in_range)
+START_TEST(mpset_colors_set)
 {
-#line 1422
-    int rc = 0;
-    int mpid = 0;
-
-    mpid = -1;
-    rc = mpdel(mpid);
+#line 3406
+    mpset_colors(16);
 
     ck_assert_msg(
-        mperrno == MP_ERRNO_MPID
-        , "The mpid is out of range and the mperrno is not MP_ERRNO_MPID");
+        mp_colors == 16
+        , "Number of colors not set correctly");
+
+    mpset_colors(-1);
 
     ck_assert_msg(
-        rc == MP_ERRNO_MPID
-        , "The mpid is out of range and the return code is not MP_ERRNO_MPID");
+        mp_colors == 0
+        , "A negative number of colors was not taken as no coloring");
 
-    mpid = MP_MAX_MP_ID;
-    rc = mpdel(mpid);
+}
+END_TEST
 
-    ck_assert_msg(
-        mperrno == MP_ERRNO_MPID
-        , "The mpid is out of range and the mperrno is not MP_ERRNO_MPID");
+START_TEST(mpget_colors_get)
+{
+#line 3419
+    mpset_colors(8);
 
     ck_assert_msg(
-        rc == MP_ERRNO_MPID
-        , "The mpid is out of range and the return code is not MP_ERRNO_MPID");
+        mpget_colors() == 8
+        , "Number of colors not retieved correctly");
 
+    mpset_colors(MP_DEF_COLORS);
 
 }
 END_TEST
 
-START_TEST(mpdel_delete_mem_block)
+START_TEST(mpadd_block_colors)
 {
-#line 1449
-    int rc = 0;
-    int mpid = 0;
-    char *str = NULL;
-    int strlen = 64;
-    unsigned char *mem_start = NULL;
-    unsigned char *mem_end = NULL;
-    size_t tot_phy_mem = 0;
-
-    /* Get and set a new Memory pool */
-    mpid = mpnew("mpdel_mpid_not_in_range");
+#line 3428
+    int mpid1 = MP_NO_MP_ID;
+    int mpid2 = MP_NO_MP_ID;
+    size_t off1 = 0;
+    size_t off2 = 0;
+    char *ptr = NULL;
+    int i = 0;
 
-    if (mperrno != MP_ERRNO_SUCCESS)
+    mpset_colors(4);
+    if ((mpid1 = mpnew("color1")) < 0 || (mpid2 = mpnew("color2")) < 0)
     {
-        ck_abort_msg("Error creating new memory pool");
+        ck_abort_msg("Error creating memory pool: %s", mpstrerror());
     }
 
-    rc = mpset(mpid);
-
-    if (mperrno != MP_ERRNO_SUCCESS || rc != MP_ERRNO_SUCCESS)
+    /* Five blocks in each pool */
+    for (i = 0; i < 5; i++)
     {
-        ck_abort_msg("Error setting the new memory pool");
+        if (mpmalloc_mpid(mpget_blksz(), mpid1) == NULL || mpmalloc_mpid(mpget_blksz(), mpid2) == NULL)
+        {
+            ck_abort_msg("Error allocating memory: %s", mpstrerror());
+        }
     }
 
-    /* Allocate a chunk of that memory pool */
-    str = (char*)mpmalloc(sizeof(char) * strlen);
-
-    if (mperrno != MP_ERRNO_SUCCESS || str == NULL)
+    for (i = 0; i < 5; i++)
     {
-        ck_abort_msg("Error allocating memory");
+        off1 = mp_arr[mpid1].blocks[i]->block - (uchar *)mp_arr[mpid1].blocks[i] - MP_BLK_HDR_SZ;
+        off2 = mp_arr[mpid2].blocks[i]->block - (uchar *)mp_arr[mpid2].blocks[i] - MP_BLK_HDR_SZ;
+        ck_assert_msg(
+            off1 == (size_t)((mpid1 + i) % 4) * MP_CACHE_LINE && off2 == (size_t)((mpid2 + i) % 4) * MP_CACHE_LINE
+            , "Block %d does not start on its color: <%d> <%d>", i, (int)off1, (int)off2);
     }
 
-    strcpy(str, "mpdel_mpid_not_in_range");
-
-    if (mp_arr[mpid].head_block == NULL)
-    {
-        ck_abort_msg("memory was created successfully with right function but actualy memory block is NULL");
-    }
-    
-    /* Check that the allocated chunk is between the ranges of the memory block */
-    mem_start = mp_arr[mpid].tail_block->block;
-    mem_end = mp_arr[mpid].tail_block->block + mp_arr[mpid].tail_block->size;
+    ptr = (char *)mp_arr[mpid1].blocks[4]->block;
+    ck_assert_msg(
+        mpowner(ptr) == mpid1 && mpowner(ptr + mpget_blksz() -1) == mpid1
+        , "The colored blocks are not found by mpowner()");
 
-    if ((uintptr_t)str < (uintptr_t)mem_start || (uintptr_t)str > (uintptr_t)mem_end)
-    {
-        ck_abort_msg("The memory allocated is not in the range of the memory block");
-    }
+    mpdel(mpid1);
+    mpdel(mpid2);
+    mpset_colors(MP_DEF_COLORS);
 
-    /* Delete the memory block */
-    tot_phy_mem = mp_tot_phy_mem;
-    tot_phy_mem -= mp_arr[mpid].tail_block->size;
-    rc = mpdel(mpid);
+}
+END_TEST
 
-    /* Check that the memory block is empty */
-    ck_assert_msg(
-        mp_arr[mpid].head_block == NULL
-        , "Memory pool should be deleted but the head_block is not NULL");
+START_TEST(mpset_numa_pars)
+{
+#line 3469
+    int mpid = MP_NO_MP_ID;
 
     ck_assert_msg(
-        mp_arr[mpid].tail_block == NULL
-        , "Memory pool should be deleted but the tail_block is not NULL");
-
-    /* Check that the total physical memory varible is set correctly */
+        mpset_numa(MP_MAX_MP_ID, MP_NUMA_LOCAL, 0) == MP_ERRNO_MPID &&
+        mpset_numa(MP_DEF_MP_ID + 8, MP_NUMA_LOCAL, 0) == MP_ERRNO_NOIN &&
+        mpset_numa(MP_DEF_MP_ID, MP_NUMA_INTERLEAVE + 1, 0) == MP_ERRNO_PARM &&
+        mpset_numa(MP_DEF_MP_ID, MP_NUMA_BIND, -1) == MP_ERRNO_PARM &&
+        mpset_numa(MP_DEF_MP_ID, MP_NUMA_BIND, mp_numa_nodes()) == MP_ERRNO_PARM
+        , "Wrong parameters were not rejected");
+
+    if ((mpid = mpnew("numa")) < 0)
+    {
+        ck_abort_msg("Error creating memory pool: %s", mpstrerror());
+    }
     ck_assert_msg(
-        mp_tot_phy_mem == tot_phy_mem
-        , "The total physical memory is not zero after deleting all memory pools");
+        mp_arr[mpid].numa_policy == MP_NUMA_NONE &&
+        mpset_numa(mpid, MP_NUMA_BIND, 0) == MP_ERRNO_SUCCESS &&
+        mp_arr[mpid].numa_policy == MP_NUMA_BIND && mp_arr[mpid].numa_node == 0
+        , "The NUMA policy was not set");
 
-    /* Check the return code */
+    mpdel(mpid);
     ck_assert_msg(
-        rc == MP_ERRNO_SUCCESS
-        , "Return code is not MP_ERRNO_SUCCESS");
+        (mpid = mpnew("numa")) >= 0 && mp_arr[mpid].numa_policy == MP_NUMA_NONE
+        , "The NUMA policy was kept by a new memory pool");
+    mpdel(mpid);
 
 }
 END_TEST
 
-START_TEST(mpdel_thread)
+START_TEST(mpset_numa_alloc)
 {
-#line 1521
-#if MP_THREAD_SAFE == 1
-    pthread_t th1;
-    args_t args;
-    int mpid = mpnew(NULL);
+#line 3496
+    int policy[3] = {MP_NUMA_LOCAL, MP_NUMA_BIND, MP_NUMA_INTERLEAVE};
+    int mpid = MP_NO_MP_ID;
+    char *ptr = NULL;
+    size_t i = 0;
+    int p = 0;
 
-    memset(&args, 0x00, sizeof(args));
-    args.mpid = mpid;
-    args.fn = &mpdel;
+    ck_assert_msg(
+        mp_numa_nodes() >= 1 && mp_numa_nodes() <= MP_NUMA_MAX_NODES
+        , "Wrong number of NUMA nodes <%d>", mp_numa_nodes());
 
-    if (pthread_create(&th1, NULL, &mp_thread_fn, &args) != 0)
+    for (p = 0; p < 3; p++)
     {
-        ck_abort_msg("Error creating thread");
-    }
+        if ((mpid = mpnew("numa")) < 0 || mpset_numa(mpid, policy[p], 0) != MP_ERRNO_SUCCESS)
+        {
+            ck_abort_msg("Error creating memory pool: %s", mpstrerror());
+        }
 
-    pthread_join(th1, NULL);
+        /* Heap blocks, a block with own mapping and known zero memory */
+        ck_assert_msg(
+            mpmalloc_mpid(mpget_blksz(), mpid) != NULL && mpmalloc_mpid(mpget_blksz(), mpid) != NULL &&
+            mpmalloc_mpid(mpget_mapsz(), mpid) != NULL &&
+            (ptr = (char *)mpcalloc_mpid(1, 10000, mpid)) != NULL
+            , "Error allocating memory with NUMA policy <%d>: %s", policy[p], mpstrerror());
 
-    ck_assert_msg(
-        args.rc == MP_ERRNO_THRD
-        , "Memory pool ID %d used by another thread and no error <%d>", mpid, args.rc);
+        for (i = 0; i < 10000 && ptr[i] == 0; i++)
+            ;
+        ck_assert_msg(
+            i == 10000
+            , "Memory of a block placed with NUMA policy <%d> is not zero", policy[p]);
 
-    ck_assert_msg(
-        args.mperrno == MP_ERRNO_THRD
-        , "Memory pool ID %d used by another thread and mperrno is not MP_ERRNO_THRD but <%d>", args.mperrno);
+        /* Reset to the default policy when given back */
+        ck_assert_msg(
+            mp_arr[mpid].tail_block->numa && 
+            mp_numa_bind(mp_arr[mpid].tail_block, MP_BLK_HDR_SZ + mp_arr[mpid].tail_block->size, MP_NUMA_NONE, 0) == MP_ERRNO_SUCCESS
+            , "Block placed with NUMA policy <%d> not marked to be reset", policy[p]);
 
-#endif /* MP_THREAD_SAFE */
+        mpdel(mpid);
+    }
+
+    mpid = mpnew("numa");
+    mpmalloc_mpid(10, mpid);
+    ck_assert_msg(!mp_arr[mpid].tail_block->numa, "Block without NUMA policy marked to be reset");
+    mpdel(mpid);
+
+    if ((mpid = mpnew_vm("numa", 1024 * 1024)) < 0)
+    {
+        ck_abort_msg("Error creating memory pool: %s", mpstrerror());
+    }
+    ck_assert_msg(
+        mpset_numa(mpid, MP_NUMA_INTERLEAVE, 0) == MP_ERRNO_SUCCESS &&
+        mpmalloc_mpid(100000, mpid) != NULL
+        , "The NUMA policy was not set on the range of a pool of type MP_TYPE_VM");
+    mpdel(mpid);
 
 }
 END_TEST
 
-START_TEST(mpdel_all_delete_mem_block)
+START_TEST(mpcleanup_register_pars)
 {
-#line 1548
-    int rc = 0;
-    int mpid = 0;
-    int mpid2 = 0;
-    char *str = NULL;
-    int strlen = 64;
-    unsigned char *mem_start = NULL;
-    unsigned char *mem_end = NULL;
+#line 3551
+    int mpid = mpnew("cleanup");
+    char c = 'a';
 
-    /* Get and set a new Memory pool */
-    mpid = mpnew("mpdel_all_mpid_not_in_range");
-    mpid2 = mpid;
+    ck_assert_msg(
+        mpcleanup_register(MP_MAX_MP_ID, &cleanup_fn, &c) == MP_ERRNO_MPID &&
+        mpcleanup_register(-1, &cleanup_fn, &c) == MP_ERRNO_MPID &&
+        mpcleanup_register(mpid, NULL, &c) == MP_ERRNO_PARM
+        , "Wrong parameters accepted by mpcleanup_register()");
 
-    if (mperrno != MP_ERRNO_SUCCESS)
-    {
-        ck_abort_msg("Error creating new memory pool");
-    }
+    mpdel(mpid);
 
-    rc = mpset(mpid);
+    ck_assert_msg(
+        mpcleanup_register(mpid, &cleanup_fn, &c) == MP_ERRNO_NOIN
+        , "Callback registered on a deleted memory pool");
 
-    if (mperrno != MP_ERRNO_SUCCESS || rc != MP_ERRNO_SUCCESS)
-    {
-        ck_abort_msg("Error setting the new memory pool");
-    }
+}
+END_TEST
 
-    /* Allocate a chunk of that memory pool */
-    str = (char*)mpmalloc(sizeof(char) * strlen);
+START_TEST(mpcleanup_register_run)
+{
+#line 3567
+    int mpid = mpnew("cleanup");
+    int mpid2 = mpnew("cleanup2");
+    char *obj = NULL;
+    char *grown = NULL;
+
+    /* Run in LIFO order by mpclr(), once */
+    cleanup_log[0] = '\0';
+    obj = mpstrdup_mpid("abc", mpid);
+    mpcleanup_register(mpid, &cleanup_fn, obj);
+    mpcleanup_register(mpid, &cleanup_fn, obj + 1);
+    mpcleanup_register(mpid, &cleanup_fn, obj + 2);
+    mpclr(mpid);
+    mpclr(mpid);
 
-    if (mperrno != MP_ERRNO_SUCCESS || str == NULL)
-    {
-        ck_abort_msg("Error allocating memory");
-    }
+    ck_assert_msg(
+        strcmp(cleanup_log, "cba") == 0
+        , "Callbacks not run by mpclr() in LIFO order once: <%s>", cleanup_log);
+
+    /* Registering takes no chunk: the last chunk still grows in place */
+    cleanup_log[0] = '\0';
+    obj = mpstrdup_mpid("x", mpid);
+    mpcleanup_register(mpid, &cleanup_fn, obj);
+    grown = (char *)mprealloc_mpid(obj, 1000, mpid);
+    ck_assert_msg(
+        grown == obj && mp_arr[mpid].last_chunk == (uchar *)obj
+        , "The last chunk was moved after registering a callback");
+    memset(grown + 1, 'y', 999);
+    mpdel(mpid);
 
-    strcpy(str, "mpdel_all_mpid_not_in_range");
+    ck_assert_msg(
+        strcmp(cleanup_log, "x") == 0
+        , "Callback not run by mpdel(): <%s>", cleanup_log);
 
-    if (mp_arr[mpid].head_block == NULL)
-    {
-        ck_abort_msg("memory was created successfully with right function but actualy memory block is NULL");
-    }
-    
-    /* Check that the allocated chunk is between the ranges of the memory block */
-    mem_start = mp_arr[mpid].tail_block->block;
-    mem_end = mp_arr[mpid].tail_block->block + mp_arr[mpid].tail_block->size;
+    /* mpdel_all() runs all the callbacks before giving back any memory */
+    cleanup_log[0] = '\0';
+    obj = mpstrdup_mpid("z", mpid2);
+    mpcleanup_register(mpid2, &cleanup_fn, obj);
+    mpdel_all();
 
-    if ((uintptr_t)str < (uintptr_t)mem_start || (uintptr_t)str > (uintptr_t)mem_end)
-    {
-        ck_abort_msg("The memory allocated is not in the range of the memory block");
-    }
+    ck_assert_msg(
+        strcmp(cleanup_log, "z") == 0
+        , "Callback not run by mpdel_all(): <%s>", cleanup_log);
 
+}
+END_TEST
 
+START_TEST(mpcleanup_register_slab)
+{
+#line 3611
+    int slab = mpnew_slab("cleanup", 32);
+    long sum[2] = {0, 0};
+    char *obj = NULL;
+    int cnt = 0;
+
+    /* Objects of a slab pool with a callback, the record is not an object */
+    cleanup_log[0] = '\0';
+    obj = (char *)mpslab_alloc(slab);
+    strcpy(obj, "s");
+    ck_assert_msg(
+        mpcleanup_register(slab, &cleanup_fn, obj) == MP_ERRNO_SUCCESS &&
+        mp_arr[slab].tail_block->used == 32
+        , "Callback not registered on a slab pool");
+    cnt = mpslab_foreach(slab, slab_sum, sum);
+    mpdel(slab);
 
-    /* Now set the Default memory pool */
-    mpid = MP_DEF_MP_ID;
-#if MP_THREAD_SAFE == 1
-    mp_arr[mpid].thread_id = MP_CURR_THREAD;
-#endif
-    rc = mpset(MP_DEF_MP_ID);
+    ck_assert_msg(
+        cnt == 1 && strcmp(cleanup_log, "s") == 0
+        , "Callback of a slab pool not run by mpdel(): <%s> <%d>", cleanup_log, cnt);
 
-    if (mperrno != MP_ERRNO_SUCCESS || rc != MP_ERRNO_SUCCESS)
-    {
-        ck_abort_msg("Error setting the new memory pool");
-    }
+}
+END_TEST
 
-    /* Allocate a chunk of that memory pool */
-    str = (char*)mpmalloc(sizeof(char) * strlen);
+START_TEST(mpnew_buf_pars)
+{
+#line 3632
+    char buf[64];
 
-    if (mperrno != MP_ERRNO_SUCCESS || str == NULL)
-    {
-        ck_abort_msg("Error allocating memory");
-    }
+    ck_assert_msg(
+        mpnew_buf("buf", NULL, sizeof(buf)) == MP_ERRNO_PARM &&
+        mpnew_buf("buf", buf, MP_BLK_HDR_SZ) == MP_ERRNO_PARM
+        , "Memory pool created without buffer or on a too small buffer");
 
-    strcpy(str, "mpdel_all_mpid_not_in_range");
+}
+END_TEST
+
+START_TEST(mpnew_buf_alloc)
+{
+#line 3640
+    double buf[1024];                                       /* Aligned, so the header takes its first bytes */
+    char *chunk = NULL;
+    size_t tot_phy_mem = mp_tot_phy_mem;
+    int mpid = mpnew_buf("buf", buf, sizeof(buf));
+    int i = 0;
 
-    if (mp_arr[mpid].head_block == NULL)
+    if (mpid < 0)
     {
-        ck_abort_msg("memory was created successfully with right function but actualy memory block is NULL");
+        ck_abort_msg("Error creating memory pool: %s", mpstrerror());
     }
-    
-    /* Check that the allocated chunk is between the ranges of the memory block */
-    mem_start = mp_arr[mpid].tail_block->block;
-    mem_end = mp_arr[mpid].tail_block->block + mp_arr[mpid].tail_block->size;
 
-    if ((uintptr_t)str < (uintptr_t)mem_start || (uintptr_t)str > (uintptr_t)mem_end)
+    /* Small chunks are taken from the buffer, without any block from the heap */
+    for (i = 0; i < 10; i++)
     {
-        ck_abort_msg("The memory allocated is not in the range of the memory block");
+        chunk = (char *)mpmalloc_mpid(100, mpid);
+        ck_assert_msg(
+            chunk >= (char *)buf && chunk + 100 <= (char *)buf + sizeof(buf) && mpowner(chunk) == mpid
+            , "Chunk %d not taken from the buffer", i);
     }
-
-
-
-    /* Delete all memory blocks */
-    rc = mpdel_all();
-
-    /* Check that blocks are empty */
-    mpid = mpid2;
     ck_assert_msg(
-        mp_arr[mpid].head_block == NULL
-        , "Memory pool %d should be deleted but the head_block is not NULL", mpid);
+        mp_arr[mpid].block_cnt == 1 && mp_tot_phy_mem == tot_phy_mem
+        , "Block taken from the heap while the buffer has room");
+
+    /* Zeroed chunks of the buffer, whose content is not known */
+    memset(mp_arr[mpid].blocks[0]->block, 0xff, mp_arr[mpid].blocks[0]->size);
+    mpclr(mpid);
+    chunk = (char *)mpcalloc_mpid(1, 100, mpid);
+    for (i = 0; i < 100 && chunk[i] == 0; i++)
+        ;
+    ck_assert_msg(
+        i == 100
+        , "Chunk of the buffer not set to zero by mpcalloc_mpid()");
 
+    /* Overflow into the heap, given back by mpclr() */
+    chunk = (char *)mpmalloc_mpid(sizeof(buf), mpid);
     ck_assert_msg(
-        mp_arr[mpid].tail_block == NULL
-        , "Memory pool %d should be deleted but the tail_block is not NULL", mpid);
+        chunk != NULL && (chunk < (char *)buf || chunk >= (char *)buf + sizeof(buf)) &&
+        mp_arr[mpid].block_cnt == 2 && mp_tot_phy_mem > tot_phy_mem
+        , "Chunk bigger than the buffer not taken from the heap");
 
-    mpid = MP_DEF_MP_ID;
+    mpclr(mpid);
+    chunk = (char *)mpmalloc_mpid(100, mpid);
     ck_assert_msg(
-        mp_arr[mpid].head_block == NULL
-        , "Memory pool %d should be deleted but the head_block is not NULL", mpid);
+        mp_arr[mpid].block_cnt == 1 && mp_tot_phy_mem == tot_phy_mem &&
+        chunk >= (char *)buf && chunk < (char *)buf + sizeof(buf)
+        , "The memory pool does not start again on the buffer after mpclr()");
 
+    /* The buffer on the stack is not given back */
     ck_assert_msg(
-        mp_arr[mpid].tail_block == NULL
-        , "Memory pool %d should be deleted but the tail_block is not NULL", mpid);
+        mpdel(mpid) == MP_ERRNO_SUCCESS && mp_tot_phy_mem == tot_phy_mem
+        , "Error deleting the memory pool on a buffer");
+
+}
+END_TEST
+
+START_TEST(mpset_upstream_pars)
+{
+#line 3693
+    up_stat_t stat;
+    mpupstream up = {&up_alloc, &up_free, &stat, FALSE};
+    mpupstream no_free = {&up_alloc, NULL, &stat, FALSE};
+    int mpid = mpnew("upstream");
+    int vm = mpnew_vm("upstream", 1024 * 1024);
 
-    /* Check that the total physical memory varible is set to zero */
     ck_assert_msg(
-        mp_tot_phy_mem == 0
-        , "The total physical memory is not zero after deleting all memory pools");
+        mpset_upstream(MP_MAX_MP_ID, &up) == MP_ERRNO_MPID &&
+        mpset_upstream(mpid, &no_free) == MP_ERRNO_PARM &&
+        mpset_upstream(vm, &up) == MP_ERRNO_PARM
+        , "Wrong parameters accepted by mpset_upstream()");
 
-    /* Check the return code */
+    mpmalloc_mpid(10, mpid);
     ck_assert_msg(
-        rc == MP_ERRNO_SUCCESS
-        , "Return code is not MP_ERRNO_SUCCESS");
+        mpset_upstream(mpid, &up) == MP_ERRNO_PARM
+        , "Provider changed on a memory pool with blocks");
 
+    mpdel(vm);
+    mpdel(mpid);
 
 }
 END_TEST
 
-START_TEST(mpclr_mpid_not_in_range)
+START_TEST(mpset_upstream_blocks)
 {
-#line 1670
-    int rc = 0;
-    int mpid = 0;
+#line 3714
+    up_stat_t stat;
+    mpupstream up = {&up_alloc, &up_free, &stat, FALSE};
+    int mpid = mpnew("upstream");
+    char *chunk = NULL;
+    int i = 0;
 
-    mpid = -1;
-    rc = mpclr(mpid);
+    memset(&stat, 0x00, sizeof(stat));
+    if (mpset_upstream(mpid, &up) != MP_ERRNO_SUCCESS)
+    {
+        ck_abort_msg("Error setting the provider: %s", mpstrerror());
+    }
 
+    /* Blocks, also of big chunks and alignment classes, from the provider */
+    mpadd_alncls(mpid, 64);
     ck_assert_msg(
-        mperrno == MP_ERRNO_MPID
-        , "The mpid is out of range and the mperrno is not MP_ERRNO_MPID");
-
+        mpmalloc_mpid(100, mpid) != NULL &&
+        mpmalloc_mpid(mpget_mapsz(), mpid) != NULL &&
+        mpmemalign_mpid(64, 100, mpid) != NULL &&
+        stat.allocs == 3 && mp_arr[mpid].map_cnt == 0
+        , "Blocks not taken from the provider <%d>", stat.allocs);
+
+    /* Its memory is not zero */
+    chunk = (char *)mpcalloc_mpid(1, 1000, mpid);
+    for (i = 0; i < 1000 && chunk[i] == 0; i++)
+        ;
     ck_assert_msg(
-        rc == MP_ERRNO_MPID
-        , "The mpid is out of range and the return code is not MP_ERRNO_MPID");
-
-    mpid = MP_MAX_MP_ID;
-    rc = mpdel(mpid);
+        i == 1000
+        , "Chunk of a block of the provider not set to zero by mpcalloc_mpid()");
 
+    /* Errors of the provider */
+    stat.fail = 1;
     ck_assert_msg(
-        mperrno == MP_ERRNO_MPID
-        , "The mpid is out of range and the mperrno is not MP_ERRNO_MPID");
+        mpmalloc_mpid(mpget_blksz() * 2, mpid) == NULL && mperrno == MP_ERRNO_ALLO
+        , "Failure of the provider not reported");
+    stat.fail = 0;
 
+    /* All blocks given back with the size delivered */
+    mpdel(mpid);
     ck_assert_msg(
-        rc == MP_ERRNO_MPID
-        , "The mpid is out of range and the return code is not MP_ERRNO_MPID");
+        stat.frees == stat.allocs && stat.bytes == 0
+        , "Blocks not given back to the provider <%d/%d, %lu>", stat.frees, stat.allocs, (unsigned long)stat.bytes);
 
 }
 END_TEST
 
-START_TEST(mpclr_clear_mem_block)
+START_TEST(mpupstream_builtin)
 {
-#line 1696
-    int rc = 0;
-    int mpid = 0;
-    char *str = NULL;
-    int strlen = 64;
-    unsigned char *mem_start = NULL;
-    unsigned char *mem_end = NULL;
-    size_t used = 0;
+#line 3757
+    const mpupstream *up[2];
+    char *chunk = NULL;
+    int mpid = MP_NO_MP_ID;
+    int p = 0;
+    int i = 0;
 
-    /* Get and set a new Memory pool */
-    mpid = mpnew("mpdel_mpid_not_in_range");
+    up[0] = mpupstream_malloc();
+    up[1] = mpupstream_mmap();
 
-    if (mperrno != MP_ERRNO_SUCCESS)
+    for (p = 0; p < 2; p++)
     {
-        ck_abort_msg("Error creating new memory pool");
-    }
+        mpid = mpnew("upstream");
+        if (mpset_upstream(mpid, up[p]) != MP_ERRNO_SUCCESS)
+        {
+            ck_abort_msg("Error setting the provider %d: %s", p, mpstrerror());
+        }
 
-    rc = mpset(mpid);
+        memset(mpmalloc_mpid(1000, mpid), 0xff, 1000);
+        mpclr(mpid);
+        chunk = (char *)mpcalloc_mpid(1, 2000, mpid);
+        for (i = 0; i < 2000 && chunk[i] == 0; i++)
+            ;
+        ck_assert_msg(
+            i == 2000 && mpmalloc_mpid(mpget_blksz() * 2, mpid) != NULL && mpowner(chunk) == mpid
+            , "Error allocating from the provider %d", p);
 
-    if (mperrno != MP_ERRNO_SUCCESS || rc != MP_ERRNO_SUCCESS)
-    {
-        ck_abort_msg("Error setting the new memory pool");
+        mpdel(mpid);
     }
 
-    /* Allocate a chunk of that memory pool */
-    str = (char*)mpmalloc(sizeof(char) * strlen);
+}
+END_TEST
 
-    if (mperrno != MP_ERRNO_SUCCESS || str == NULL)
-    {
-        ck_abort_msg("Error allocating memory");
-    }
+START_TEST(mpset_rcysz_set)
+{
+#line 3787
+    mpset_rcysz(1024 * 1024);
 
-    strcpy(str, "mpdel_mpid_not_in_range");
+    ck_assert_msg(
+        mp_rcy_sz == 1024 * 1024 && mpget_rcysz() == 1024 * 1024
+        , "Size of the depot of the recycler not set correctly");
 
-    if (mp_arr[mpid].head_block == NULL)
-    {
-        ck_abort_msg("memory was created successfully with right function but actualy memory block is NULL");
-    }
-    
-    /* Check that the allocated chunk is between the ranges of the memory block */
-    mem_start = mp_arr[mpid].tail_block->block;
-    mem_end = mp_arr[mpid].tail_block->block + mp_arr[mpid].tail_block->size;
+    mpset_rcysz(MP_DEF_RCY_SZ);
 
-    if ((uintptr_t)str < (uintptr_t)mem_start || (uintptr_t)str > (uintptr_t)mem_end)
-    {
-        ck_abort_msg("The memory allocated is not in the range of the memory block");
-    }
+}
+END_TEST
 
-    /* Save the current used after usage */
-    used = mp_arr[mpid].tail_block->used;
-    if (used == 0)
-    {
-        ck_abort_msg("The given memory pool was used but its size is 0");
-    }
+START_TEST(mprcy_reuse)
+{
+#line 3796
+    uchar *block = NULL;
+    char *chunk = NULL;
+    size_t tot_phy_mem = mp_tot_phy_mem;
+    int mpid = MP_NO_MP_ID;
+    int i = 0;
 
-    /* Clear the memory block */
-    rc = mpclr(mpid);
+    mpset_rcysz(1024 * 1024);
+
+    mpid = mpnew("recycled");
+    chunk = (char *)mpmalloc_mpid(1000, mpid);
+    memset(chunk, 0xff, 1000);
+    block = (uchar *)mp_arr[mpid].blocks[0];
+    mpdel(mpid);
 
-    /* Check that the memory block is cleared */
     ck_assert_msg(
-        mp_arr[mpid].tail_block->used == 0
-        , "Memory pool should be deleted but the head_block is not NULL");
+        mp_rcy_mag == block && mp_rcy_mag_cnt == 1 && mp_tot_phy_mem == tot_phy_mem + mprcy_unit()
+        , "The block of the deleted pool is not kept, counted as used memory");
+
+    /* The next pool gets the same block, not zero any more */
+    mpid = mpnew("recycled");
+    chunk = (char *)mpcalloc_mpid(1, 1000, mpid);
+    for (i = 0; i < 1000 && chunk[i] == 0; i++)
+        ;
+    ck_assert_msg(
+        (uchar *)mp_arr[mpid].blocks[0] == block && mp_rcy_mag == NULL && i == 1000 && mpowner(chunk) == mpid
+        , "The recycled block is not reused, or mpcalloc() does not clear it");
+
+    mpdel(mpid);
+    mpflush_rcy();
+
+    ck_assert_msg(
+        mp_rcy_mag == NULL && mp_rcy_mag_cnt == 0 && mp_tot_phy_mem == tot_phy_mem
+        , "The recycled blocks are not given back <%lu> <%lu>", (unsigned long)mp_tot_phy_mem, (unsigned long)tot_phy_mem);
+
+    mpset_rcysz(MP_DEF_RCY_SZ);
 
 }
 END_TEST
 
-START_TEST(mpclr_thread)
+START_TEST(mprcy_depot)
 {
-#line 1759
-#if MP_THREAD_SAFE == 1
-    pthread_t th1;
-    args_t args;
-    int mpid = mpnew(NULL);
+#line 3833
+    size_t tot_phy_mem = mp_tot_phy_mem;
+    int mpid = MP_NO_MP_ID;
+    int i = 0;
 
-    memset(&args, 0x00, sizeof(args));
-    args.mpid = mpid;
-    args.fn = &mpclr;
+    mpset_rcysz(mprcy_unit() * 2);
 
-    if (pthread_create(&th1, NULL, &mp_thread_fn, &args) != 0)
+    /* More blocks than a magazine and the depot hold */
+    mpid = mpnew("recycled");
+    for (i = 0; i < MP_RCY_MAG_SZ * 3; i++)
     {
-        ck_abort_msg("Error creating thread");
+        if (mpmalloc_mpid(mpget_blksz(), mpid) == NULL)
+        {
+            ck_abort_msg("Error allocating memory: %s", mpstrerror());
+        }
     }
+    mpdel(mpid);
 
-    pthread_join(th1, NULL);
+    ck_assert_msg(
+        mp_rcy_mag_cnt <= MP_RCY_MAG_SZ && mp_rcy_depot_sz == mprcy_unit() * 2 &&
+        mp_tot_phy_mem == tot_phy_mem + mp_rcy_depot_sz + mp_rcy_mag_cnt * mprcy_unit()
+        , "Magazine <%d> or depot <%lu> not bounded", mp_rcy_mag_cnt, (unsigned long)mp_rcy_depot_sz);
+
+    /* Blocks of a former size are not reused */
+    mpset_blksz(mpget_blksz() * 2);
+    mpid = mpnew("recycled");
+    mpmalloc_mpid(10, mpid);
+    ck_assert_msg(
+        mp_arr[mpid].blocks[0]->size == mpget_blksz() + MP_CACHE_LINE -1 && mp_rcy_mag == NULL
+        , "A block of a former size was reused");
+    mpdel(mpid);
+    mpset_blksz(MP_DEF_BLK_SZ);
 
+    mpset_rcysz(0);
     ck_assert_msg(
-        args.rc == MP_ERRNO_THRD
-        , "Memory pool ID %d used by another thread and no error <%d>", mpid, args.rc);
+        mp_rcy_depot == NULL && mp_rcy_depot_sz == 0 && mp_rcy_mag == NULL && mp_tot_phy_mem == tot_phy_mem
+        , "The recycler is not emptied when disabled");
+
+}
+END_TEST
 
+START_TEST(mpset_spare_pars)
+{
+#line 3871
+    int mpid = MP_NO_MP_ID;
+
+    mpid = mpnew_vm(NULL, 0);
     ck_assert_msg(
-        args.mperrno == MP_ERRNO_THRD
-        , "Memory pool ID %d used by another thread and mperrno is not MP_ERRNO_THRD but <%d>", args.mperrno);
+        mpset_spare(MP_MAX_MP_ID, TRUE) == MP_ERRNO_MPID && mpset_spare(MP_MAX_MP_ID -1, TRUE) == MP_ERRNO_NOIN &&
+        mpset_spare(mpid, TRUE) == MP_ERRNO_PARM
+        , "Wrong parameters accepted");
+    mpdel(mpid);
 
-#endif /* MP_THREAD_SAFE */
+    mpid = mpnew("spare");
+    ck_assert_msg(
+        mpset_spare(mpid, TRUE) == MP_ERRNO_SUCCESS && mp_arr[mpid].spare && 
+        mpset_spare(mpid, FALSE) == MP_ERRNO_SUCCESS && !mp_arr[mpid].spare
+        , "Spare block flag not set");
+    mpdel(mpid);
 
 }
 END_TEST
 
-START_TEST(mpset_memlim_set)
+START_TEST(mprfl_spare)
 {
-#line 1786
-    size_t memlim = 100000;
+#line 3888
+#if MP_THREAD_SAFE == 1
+    mpblock *spare_block = NULL;
+    size_t tot_phy_mem0 = mp_tot_phy_mem;
+    size_t tot_phy_mem = 0;
+    char *chunk = NULL;
+    time_t t0 = 0;
+    int mpid = MP_NO_MP_ID;
+
+    mpid = mpnew("spare");
+    mpmalloc_mpid(10, mpid);
+    mpset_spare(mpid, TRUE);
+
+    /* The refill thread makes the spare block */
+    t0 = time(NULL);
+    ck_assert_msg(mpset_refill(TRUE) == MP_ERRNO_SUCCESS && mpset_refill(TRUE) == MP_ERRNO_SUCCESS, "Refill thread not started");
+    while (mp_arr[mpid].spare_block == NULL && time(NULL) < t0 + 10)
+        ;
+    spare_block = mp_arr[mpid].spare_block;
+    ck_assert_msg(
+        spare_block != NULL && spare_block->size == mprcy_unit()
+        , "No spare block made");
 
-    mpset_memlim(memlim);
+    /* Swapped in when the tail block is full, zero, and a new one made */
+    tot_phy_mem = mp_tot_phy_mem;
+    chunk = (char *)mpcalloc_mpid(1, mpget_blksz(), mpid);
+    ck_assert_msg(
+        mp_arr[mpid].block_cnt == 2 && mp_arr[mpid].tail_block == spare_block && mpowner(chunk) == mpid &&
+        chunk[0] == 0 && chunk[mpget_blksz() -1] == 0 && mp_tot_phy_mem == tot_phy_mem + spare_block->size
+        , "Spare block not used");
+    t0 = time(NULL);
+    while (mp_arr[mpid].spare_block == NULL && time(NULL) < t0 + 10)
+        ;
+    ck_assert_msg(
+        mp_arr[mpid].spare_block != NULL && mp_arr[mpid].spare_block != spare_block
+        , "Spare block not made again");
 
+    /* Given back with the memory pool, the thread stops */
+    mpdel(mpid);
     ck_assert_msg(
-        mp_mem_limit == memlim
-        , "Memory limit not set correctly");
+        mpset_refill(FALSE) == MP_ERRNO_SUCCESS && !mp_rfl_run && mp_tot_phy_mem == tot_phy_mem0
+        , "Refill thread not stopped");
+#endif
 
 }
 END_TEST
 
-START_TEST(mpget_memlim_get)
+START_TEST(mprfl_start_stop)
 {
-#line 1795
-    size_t memlim = 100000;
+#line 3932
+#if MP_THREAD_SAFE == 1
+    pthread_t th[4];
+    int args[4];
+    int i = 0;
 
-    mpset_memlim(memlim);
+    for (i = 0; i < 4; i++)
+    {
+        args[i] = i;
+        pthread_create(&th[i], NULL, &rfl_toggle_fn, &args[i]);
+    }
+    for (i = 0; i < 4; i++)
+    {
+        pthread_join(th[i], NULL);
+        ck_assert_msg(args[i] >= 0, "Refill thread not started or stopped by thread <%d>", i);
+    }
 
+    /* A single thread left at most, stopped at once */
     ck_assert_msg(
-        mpget_memlim() == memlim
-        , "Memory limit not retieved correctly");
+        mpset_refill(FALSE) == MP_ERRNO_SUCCESS && !mp_rfl_run &&
+        mpset_refill(FALSE) == MP_ERRNO_SUCCESS && !mp_rfl_run
+        , "Refill thread not stopped");
+#endif
 
 }
 END_TEST
 
-START_TEST(mpset_blksz_set)
+START_TEST(mprcy_thread_exit)
 {
-#line 1804
-    size_t blksz = 100000;
+#line 3956
+#if MP_THREAD_SAFE == 1
+    size_t tot_phy_mem = mp_tot_phy_mem;
+    pthread_t th1;
+    int blocks = MP_RCY_MAG_SZ / 2;
 
-    mpset_blksz(blksz);
+    /* The magazine of an ended thread goes to the depot */
+    mpset_rcysz(mprcy_unit() * MP_RCY_MAG_SZ);
+    pthread_create(&th1, NULL, &rcy_request_fn, &blocks);
+    pthread_join(th1, NULL);
+    ck_assert_msg(
+        mp_rcy_depot_sz == mprcy_unit() * blocks && mp_tot_phy_mem == tot_phy_mem + mp_rcy_depot_sz
+        , "Magazine of an ended thread not in the depot <%lu>", (unsigned long)mp_rcy_depot_sz);
 
+    /* What does not fit in the depot is given back */
+    mpset_rcysz(0);
+    mpset_rcysz(mprcy_unit());
+    pthread_create(&th1, NULL, &rcy_request_fn, &blocks);
+    pthread_join(th1, NULL);
     ck_assert_msg(
-        mp_blk_sz == blksz
-        , "Block size not set correctly");
+        mp_rcy_depot_sz == mprcy_unit() && mp_tot_phy_mem == tot_phy_mem + mprcy_unit()
+        , "Magazine of an ended thread kept beyond the depot <%lu>", (unsigned long)mp_rcy_depot_sz);
+
+    mpset_rcysz(0);
+    ck_assert_msg(mp_tot_phy_mem == tot_phy_mem, "Recycled blocks still counted");
+#endif
 
 }
 END_TEST
 
-START_TEST(mpget_blksz_get)
+START_TEST(mpdel_all_rcy)
 {
-#line 1813
-    size_t blksz = 100000;
-
-    mpset_blksz(blksz);
+#line 3983
+    size_t tot_phy_mem = 0;
 
+    /* Memory counted elsewhere, as the magazine of another thread, stays counted */
+    mpdel_all();
+    tot_phy_mem = mp_tot_phy_mem;
+    mpadd_tot_phy_mem(mprcy_unit(), +1);
+    mpmalloc_mpid(10, mpnew("all"));
+    mpdel_all();
     ck_assert_msg(
-        mpget_blksz() == blksz
-        , "Block size not retieved correctly");
+        mp_tot_phy_mem == tot_phy_mem + mprcy_unit()
+        , "Memory used not kept by mpdel_all() <%lu>", (unsigned long)mp_tot_phy_mem);
+    mpadd_tot_phy_mem(mprcy_unit(), -1);
 
 }
 END_TEST
 
 START_TEST(mpset_thread)
 {
-#line 1822
+#line 3997
 #if MP_THREAD_SAFE == 1
     pthread_t th1;
     args_t args;
@@ -2150,7 +4690,7 @@ END_TEST
 
 START_TEST(mpstrerrno_check)
 {
-#line 1850
+#line 4025
     char *str = NULL;
     int i = 0;
     int errno_arr[] = {
@@ -2167,6 +4707,7 @@ START_TEST(mpstrerrno_check)
         MP_ERRNO_DISP,
         MP_ERRNO_PARM,
         MP_ERRNO_THRD,
+        MP_ERRNO_NOWN,
         MP_ERRNO_SYSE,
         999
     };
@@ -2217,6 +4758,9 @@ START_TEST(mpstrerrno_check)
             case MP_ERRNO_THRD:
                 str = MP_ERRSTR_THRD;
                 break;
+            case MP_ERRNO_NOWN:
+                str = MP_ERRSTR_NOWN;
+                break;
             case MP_ERRNO_SYSE:
                 str = strerror(errno);
                 break;
@@ -2252,6 +4796,8 @@ int main(void)
     tcase_add_test(tc1_1, mpadd_block_block_next);
     tcase_add_test(tc1_1, mpadd_block_head_tail);
     tcase_add_test(tc1_1, mpadd_block_set_tot_phy_mem);
+    tcase_add_test(tc1_1, mpadd_block_inline_header);
+    tcase_add_test(tc1_1, mpadd_block_array_growth);
     tcase_add_test(tc1_1, mpget_chunk_mpid_not_in_range);
     tcase_add_test(tc1_1, mpget_chunk_align_not_in_range);
     tcase_add_test(tc1_1, mpget_chunk_thread_check_def_mp);
@@ -2264,22 +4810,58 @@ int main(void)
     tcase_add_test(tc1_1, mpmemalign_alignment);
     tcase_add_test(tc1_1, mpmemalign_mpid_call);
     tcase_add_test(tc1_1, mpmemalign_mpid_alignment);
+    tcase_add_test(tc1_1, mpadd_alncls_pars);
+    tcase_add_test(tc1_1, mpadd_alncls_interleave);
     tcase_add_test(tc1_1, mpcalloc_call);
     tcase_add_test(tc1_1, mpcalloc_elements);
     tcase_add_test(tc1_1, mpcalloc_mpid_call);
     tcase_add_test(tc1_1, mpcalloc_mpid_elements);
+    tcase_add_test(tc1_1, mpcalloc_fresh_block);
+    tcase_add_test(tc1_1, mpcalloc_reused_block);
+    tcase_add_test(tc1_1, mpcalloc_overflow);
+    tcase_add_test(tc1_1, mpmalloc_batch_pars);
+    tcase_add_test(tc1_1, mpmalloc_batch_layout);
+    tcase_add_test(tc1_1, mpmalloc_soa_layout);
     tcase_add_test(tc1_1, mprealloc_call);
     tcase_add_test(tc1_1, mprealloc_copy_content);
     tcase_add_test(tc1_1, mprealloc_mpid_call);
     tcase_add_test(tc1_1, mprealloc_mpid_copy_content);
+    tcase_add_test(tc1_1, mprealloc_last_chunk_in_place);
+    tcase_add_test(tc1_1, mpmalloc_map_big_chunk);
+    tcase_add_test(tc1_1, mprealloc_map_grow);
+    tcase_add_test(tc1_1, mpclr_release_map);
+    tcase_add_test(tc1_1, mpowner_chunk);
+    tcase_add_test(tc1_1, mpowner_many_blocks);
+    tcase_add_test(tc1_1, mprealloc_owner_route);
+    tcase_add_test(tc1_1, mprealloc_map_owner);
     tcase_add_test(tc1_1, mpstrdup_call);
     tcase_add_test(tc1_1, mpstrdup_mpid_call);
+    tcase_add_test(tc1_1, mpintern_pars);
+    tcase_add_test(tc1_1, mpintern_canonical);
+    tcase_add_test(tc1_1, mpintern_many);
+    tcase_add_test(tc1_1, mpintern_clr_del);
     tcase_add_test(tc1_1, mpasprintf_pars);
     tcase_add_test(tc1_1, mpasprintf_call);
     tcase_add_test(tc1_1, mpasprintf_mpid_pars);
     tcase_add_test(tc1_1, mpasprintf_mpid_call);
+    tcase_add_test(tc1_1, mpasprintf_single_pass);
+    tcase_add_test(tc1_1, mpasprintf_not_fit);
+    tcase_add_test(tc1_1, mpasprintf_vm);
+    tcase_add_test(tc1_1, mpvasprintf_call);
+    tcase_add_test(tc1_1, mpvasprintf_mpid_call);
+    tcase_add_test(tc1_1, mpnew_slab_pars);
+    tcase_add_test(tc1_1, mpslab_alloc_free);
+    tcase_add_test(tc1_1, mpslab_alloc_blocks);
+    tcase_add_test(tc1_1, mpslab_foreach_live);
+    tcase_add_test(tc1_1, mpslab_foreach_free);
+    tcase_add_test(tc1_1, mpslab_alloc_thread);
+    tcase_add_test(tc1_1, mpslab_free_remote);
     tcase_add_test(tc1_1, mpnew_pars);
     tcase_add_test(tc1_1, mpnew_check_limit);
+    tcase_add_test(tc1_1, mpnew_vm_contiguous);
+    tcase_add_test(tc1_1, mpnew_vm_realloc_in_place);
+    tcase_add_test(tc1_1, mpnew_vm_exhausted);
+    tcase_add_test(tc1_1, mpnew_vm_clr_del);
     tcase_add_test(tc1_1, mppush_mpid_not_in_range);
     tcase_add_test(tc1_1, mppush_mpid_not_init);
     tcase_add_test(tc1_1, mppush_prev_mpid);
@@ -2288,6 +4870,7 @@ int main(void)
     tcase_add_test(tc1_1, mpset_mpid_not_in_range);
     tcase_add_test(tc1_1, mpset_mpid_not_init);
     tcase_add_test(tc1_1, mpset_set);
+    tcase_add_test(tc1_1, mpset_def_not_init);
     tcase_add_test(tc1_1, mpget_get);
     tcase_add_test(tc1_1, mpdel_mpid_not_in_range);
     tcase_add_test(tc1_1, mpdel_delete_mem_block);
@@ -2296,10 +4879,44 @@ int main(void)
     tcase_add_test(tc1_1, mpclr_mpid_not_in_range);
     tcase_add_test(tc1_1, mpclr_clear_mem_block);
     tcase_add_test(tc1_1, mpclr_thread);
+    tcase_add_test(tc1_1, mpset_clr_pars);
+    tcase_add_test(tc1_1, mpclr_policies);
+    tcase_add_test(tc1_1, mptrim_pars);
+    tcase_add_test(tc1_1, mptrim_blocks);
+    tcase_add_test(tc1_1, mptrim_rcy);
+    tcase_add_test(tc1_1, mpset_trim_clr);
+    tcase_add_test(tc1_1, mptrim_vm);
+    tcase_add_test(tc1_1, mpreserve_pars);
+    tcase_add_test(tc1_1, mpreserve_alncls);
+    tcase_add_test(tc1_1, mpreserve_blocks);
+    tcase_add_test(tc1_1, mpreserve_vm);
     tcase_add_test(tc1_1, mpset_memlim_set);
     tcase_add_test(tc1_1, mpget_memlim_get);
     tcase_add_test(tc1_1, mpset_blksz_set);
     tcase_add_test(tc1_1, mpget_blksz_get);
+    tcase_add_test(tc1_1, mpset_mapsz_set);
+    tcase_add_test(tc1_1, mpget_mapsz_get);
+    tcase_add_test(tc1_1, mpset_colors_set);
+    tcase_add_test(tc1_1, mpget_colors_get);
+    tcase_add_test(tc1_1, mpadd_block_colors);
+    tcase_add_test(tc1_1, mpset_numa_pars);
+    tcase_add_test(tc1_1, mpset_numa_alloc);
+    tcase_add_test(tc1_1, mpcleanup_register_pars);
+    tcase_add_test(tc1_1, mpcleanup_register_run);
+    tcase_add_test(tc1_1, mpcleanup_register_slab);
+    tcase_add_test(tc1_1, mpnew_buf_pars);
+    tcase_add_test(tc1_1, mpnew_buf_alloc);
+    tcase_add_test(tc1_1, mpset_upstream_pars);
+    tcase_add_test(tc1_1, mpset_upstream_blocks);
+    tcase_add_test(tc1_1, mpupstream_builtin);
+    tcase_add_test(tc1_1, mpset_rcysz_set);
+    tcase_add_test(tc1_1, mprcy_reuse);
+    tcase_add_test(tc1_1, mprcy_depot);
+    tcase_add_test(tc1_1, mpset_spare_pars);
+    tcase_add_test(tc1_1, mprfl_spare);
+    tcase_add_test(tc1_1, mprfl_start_stop);
+    tcase_add_test(tc1_1, mprcy_thread_exit);
+    tcase_add_test(tc1_1, mpdel_all_rcy);
     tcase_add_test(tc1_1, mpset_thread);
     tcase_add_test(tc1_1, mpstrerrno_check);
 